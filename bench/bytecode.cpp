@@ -0,0 +1,88 @@
+/** Compare the tree walking evaluator with the bytecode interpreter
+ *
+ * Every expression is evaluated many times for changing variables,
+ * once by walking the abstract syntax tree, once by running the
+ * compiled program with a lookup callback, once by running it with
+ * the variables given by slot and once for all rows in a single batch,
+ * which is also evaluated in single precision by a FloatExpression.
+ * The time is the median per evaluated row.
+ */
+#include "harness.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+constexpr std::size_t samples = 20000;
+/// Rows of a batch
+constexpr std::size_t rows = 20000;
+
+} // namespace
+
+int main() {
+    char const *const corpus[] = {
+        "x + 1",
+        "x*x*x + 2*x*x - 3*x + 4",
+        "sin(x)**2 + cos(x)**2",
+        "ifelse(x > 0.5, sqrt(x), x * (1 - x)) + abs(x - 0.25) / 3",
+        "((((x+1)*(x+2))*((x+3)*(x+4)))*(((x+5)*(x+6))*((x+7)*(x+8))))",
+    };
+
+    std::vector<double> batch_x(rows);
+    for (std::size_t i = 0; i < rows; ++i) {
+        batch_x[i] = i * 1e-6;
+    }
+    std::vector<float> const float_x(batch_x.begin(), batch_x.end());
+
+    std::printf("%-64s %10s %10s %10s %10s %10s\n", "expression",
+                "tree [ns]", "vm [ns]", "slots [ns]", "batch [ns]",
+                "float [ns]");
+    volatile double sink = 0;
+    for (char const *expr : corpus) {
+        matheval::Parser parser;
+        parser.parse(expr);
+        parser.optimize();
+
+        double x = 0;
+        auto fn = [&x](std::string const &) { return x; };
+        auto lookup = [&](std::size_t k) {
+            x = k * 1e-6;
+            sink = sink + parser.evaluate(fn);
+        };
+        double const tree = bench::median(samples, lookup);
+        parser.compile();
+        double const vm = bench::median(samples, lookup);
+
+        std::vector<double> values(parser.variables().size());
+        double const slots = bench::median(samples, [&](std::size_t k) {
+            std::fill(values.begin(), values.end(), k * 1e-6);
+            sink = sink + parser.evaluate(values.data());
+        });
+
+        std::vector<double const *> columns(parser.variables().size(),
+                                            batch_x.data());
+        std::vector<double> results(rows);
+        double const batch = bench::median(20, [&](std::size_t) {
+            parser.evaluate(rows, columns.data(), results.data());
+        }) / rows;
+
+        matheval::FloatExpression const single(parser);
+        std::vector<float const *> float_columns(single.variables().size(),
+                                                 float_x.data());
+        std::vector<float> float_results(rows);
+        double const floats = bench::median(20, [&](std::size_t) {
+            single.evaluate(rows, float_columns.data(), float_results.data());
+        }) / rows;
+
+        std::printf("%-64s %10.1f %10.1f %10.1f %10.1f %10.1f\n", expr, tree,
+                    vm, slots, batch, floats);
+    }
+    return 0;
+}
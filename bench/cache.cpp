@@ -0,0 +1,49 @@
+/** Convenience function parse() with and without the expression cache
+ *
+ * A small set of recurring expressions is evaluated through
+ * matheval::parse, once parsing every call and once with the shared
+ * expression cache enabled.  The time is the median per call.
+ */
+#include "harness.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <map>
+#include <string>
+
+#include "matheval.hpp"
+
+namespace {
+
+constexpr std::size_t samples = 20000;
+
+} // namespace
+
+int main() {
+    char const *const corpus[] = {
+        "x + 1",
+        "x*x*x + 2*x*y - 3/y + 4",
+        "ifelse(x > 0.5, sqrt(x), x * (1 - x)) + abs(y - 0.25) / 3",
+        "sin(x) * cos(y) + tan(x / (1 + y*y))",
+    };
+    std::map<std::string, double> st = {std::make_pair("x", 0.75),
+                                        std::make_pair("y", 1.25)};
+
+    volatile double sink = 0;
+    auto run = [&](std::size_t k) {
+        sink = sink + matheval::parse(corpus[k % 4], st);
+    };
+
+    double const uncached = bench::median(samples, run);
+    matheval::ExpressionCache::shared().set_capacity(16);
+    double const cached = bench::median(samples, run);
+    auto stats = matheval::ExpressionCache::shared().stats();
+
+    std::printf("%-12s %12s\n", "cache", "call [ns]");
+    std::printf("%-12s %12.1f\n", "disabled", uncached);
+    std::printf("%-12s %12.1f\n", "enabled", cached);
+    std::printf("hits %llu, misses %llu\n",
+                static_cast<unsigned long long>(stats.hits),
+                static_cast<unsigned long long>(stats.misses));
+    return 0;
+}
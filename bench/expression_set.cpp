@@ -0,0 +1,72 @@
+/** Many expressions with shared subexpressions
+ *
+ * A generated set of formulas over the same variables, which share
+ * many terms, is evaluated once formula by formula with one compiled
+ * Parser each and once as a single ExpressionSet.  The time is the
+ * median of evaluating all formulas.
+ */
+#include "harness.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+constexpr int formulas = 2000;
+constexpr std::size_t samples = 200;
+
+} // namespace
+
+int main() {
+    char const *const terms[] = {
+        "sqrt(a*a + b*b)", "exp(-c / 10)", "sin(d) * cos(e)",
+        "log(1 + f*f)",    "abs(g - h)",   "atan2(a, b)",
+        "(c + d) / (1 + e*e)", "max(f, g) - min(g, h)",
+    };
+    std::vector<std::string> exprs;
+    for (int i = 0; i < formulas; ++i) {
+        exprs.push_back(std::string(terms[i % 8]) + " * " +
+                        terms[(i / 8) % 8] + " + " + std::to_string(i) +
+                        " * " + terms[(i / 64) % 8]);
+    }
+
+    std::vector<std::unique_ptr<matheval::Parser>> parsers;
+    for (std::string const &expr : exprs) {
+        parsers.emplace_back(new matheval::Parser());
+        parsers.back()->parse(expr);
+        parsers.back()->optimize();
+        parsers.back()->compile();
+    }
+    matheval::ExpressionSet const set(exprs);
+
+    // The parsers need the values in the slots of their own variables
+    std::vector<std::vector<double>> rows;
+    for (auto const &parser : parsers) {
+        rows.emplace_back(parser->variables().size(), 0.5);
+    }
+    std::vector<double> values(set.variables().size(), 0.5);
+    std::vector<double> results(set.size());
+
+    volatile double sink = 0;
+    double const separate = bench::median(samples, [&](std::size_t) {
+        for (std::size_t k = 0; k < parsers.size(); ++k) {
+            sink = sink + parsers[k]->evaluate(rows[k].data());
+        }
+    }) / 1000;
+    double const together = bench::median(samples, [&](std::size_t) {
+        set.evaluate(values.data(), results.data());
+        sink = sink + results[0];
+    }) / 1000;
+
+    std::printf("%d formulas, %zu distinct subexpressions\n", formulas,
+                set.nodes());
+    std::printf("%-12s %12s\n", "evaluation", "call [us]");
+    std::printf("%-12s %12.1f\n", "separate", separate);
+    std::printf("%-12s %12.1f\n", "set", together);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/** Gradients by forward differences and by dual numbers
+ *
+ * The gradient of formulas with respect to all of their variables is
+ * computed once by forward differences, i.e. with one evaluation of
+ * the compiled program for the point and one for every variable, and
+ * once in a single pass of a GradientExpression.  The time is the
+ * median per point.
+ */
+#include "harness.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+constexpr std::size_t samples = 20000;
+
+} // namespace
+
+int main() {
+    char const *const corpus[] = {
+        "x * y + z",
+        "sqrt(x*x + y*y) / (1 + exp(-x)) - log(1 + y*y)",
+        "(a + 1) * (b - 2) * (c + 3) / (1 + abs(a * b * c)) + d**2 - e * f",
+        "ifelse(x > y, sin(x) * cos(y), atan2(y, x)) + max(x, y) ** 1.5",
+    };
+
+    std::printf("%-68s %10s %10s %10s\n", "expression", "value [ns]",
+                "diffs [ns]", "dual [ns]");
+    volatile double sink = 0;
+    for (char const *expr : corpus) {
+        matheval::Parser parser;
+        parser.parse(expr);
+        parser.optimize();
+        matheval::CompiledExpression const f(parser);
+        matheval::GradientExpression const g(parser, parser.variables());
+
+        std::size_t const n = parser.variables().size();
+        std::vector<double> values(n, 0.5);
+        std::vector<double> gradient(n);
+
+        double const value = bench::median(samples, [&](std::size_t k) {
+            values[0] = 0.5 + k * 1e-6;
+            sink = sink + f.evaluate(values.data());
+        });
+        double const diffs = bench::median(samples, [&](std::size_t k) {
+            values[0] = 0.5 + k * 1e-6;
+            double const y = f.evaluate(values.data());
+            for (std::size_t s = 0; s < n; ++s) {
+                double const x = values[s];
+                double const h = 1e-8 * std::fmax(1.0, std::fabs(x));
+                values[s] = x + h;
+                gradient[s] = (f.evaluate(values.data()) - y) / h;
+                values[s] = x;
+            }
+            sink = sink + gradient[0];
+        });
+        double const dual = bench::median(samples, [&](std::size_t k) {
+            values[0] = 0.5 + k * 1e-6;
+            sink = sink + g.evaluate(values.data(), gradient.data());
+        });
+        std::printf("%-68s %10.1f %10.1f %10.1f\n", expr, value, diffs, dual);
+    }
+    return 0;
+}
@@ -0,0 +1,195 @@
+/** A minimal micro-benchmark harness
+ *
+ * A measurement repeats an operation many times and keeps the time of
+ * every sample, so that the distribution and not only the mean can be
+ * reported.  Operations which are much faster than the clock are
+ * repeated within a sample, and the time per call is the time of the
+ * sample divided by the repetitions.
+ */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+/// @brief Times in nanoseconds per call of all samples
+struct samples {
+    std::vector<double> ns;
+    std::size_t batch = 1; ///< calls per sample
+};
+
+/// @brief The distribution of the samples
+struct summary {
+    std::size_t count;
+    std::size_t batch;
+    double min;
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+};
+
+/// Samples shorter than this are dominated by the clock
+constexpr double min_sample_ns = 2000;
+
+using clock = std::chrono::steady_clock;
+
+inline double elapsed(clock::time_point start, clock::time_point stop) {
+    return std::chrono::duration<double, std::nano>(stop - start).count();
+}
+
+/// @brief Call @p f for sample @c k as <tt>f(k)</tt> and time it
+///
+/// The number of calls per sample is chosen such that a sample takes
+/// at least min_sample_ns.  One round of warm-up calls is not timed.
+template <typename F>
+samples measure(std::size_t count, F &&f) {
+    samples result;
+    clock::time_point start = clock::now();
+    for (std::size_t k = 0; k < count; ++k) {
+        f(k);
+    }
+    double const warmup = elapsed(start, clock::now()) / count;
+    if (warmup < min_sample_ns) {
+        result.batch = static_cast<std::size_t>(min_sample_ns / warmup) + 1;
+    }
+
+    result.ns.reserve(count);
+    for (std::size_t k = 0; k < count; ++k) {
+        start = clock::now();
+        for (std::size_t b = 0; b < result.batch; ++b) {
+            f(k);
+        }
+        result.ns.push_back(elapsed(start, clock::now()) / result.batch);
+    }
+    return result;
+}
+
+/// @brief Time @p f for sample @c k after preparing it with @p setup
+///
+/// Every sample is a single call, because @p setup has to run before
+/// each call.  Use this when a call changes the state it works on.
+template <typename Setup, typename F>
+samples measure(std::size_t count, Setup &&setup, F &&f) {
+    samples result;
+    result.ns.reserve(count);
+    for (std::size_t k = 0; k < count; ++k) {
+        setup(k);
+        clock::time_point const start = clock::now();
+        f(k);
+        result.ns.push_back(elapsed(start, clock::now()));
+    }
+    return result;
+}
+
+/// @brief The nearest-rank percentile @p p of the sorted @p v
+inline double percentile(std::vector<double> const &v, double p) {
+    std::size_t rank = static_cast<std::size_t>(p / 100 * v.size() + 0.5);
+    rank = std::max<std::size_t>(rank, 1);
+    return v[std::min(rank, v.size()) - 1];
+}
+
+inline summary summarize(samples s) {
+    std::vector<double> &v = s.ns;
+    std::sort(v.begin(), v.end());
+    double sum = 0;
+    for (double x : v) {
+        sum += x;
+    }
+    summary r;
+    r.count = v.size();
+    r.batch = s.batch;
+    r.min = v.empty() ? 0 : v.front();
+    r.mean = v.empty() ? 0 : sum / v.size();
+    r.p50 = v.empty() ? 0 : percentile(v, 50);
+    r.p90 = v.empty() ? 0 : percentile(v, 90);
+    r.p99 = v.empty() ? 0 : percentile(v, 99);
+    r.max = v.empty() ? 0 : v.back();
+    return r;
+}
+
+/// @brief The median time per call of @p f in nanoseconds, see measure()
+template <typename F>
+double median(std::size_t count, F &&f) {
+    return summarize(measure(count, std::forward<F>(f))).p50;
+}
+
+/// @brief Writes the results as one JSON object
+///
+/// @code
+/// {"backend": "x3", ..., "results": [
+///   {"corpus": "small", "phase": "parse", "p50_ns": 812.5, ...},
+///   ...
+/// ]}
+/// @endcode
+class json {
+public:
+    explicit json(std::FILE *out) : out(out) {}
+
+    /// @brief A string member of the outer object, before any result
+    void property(char const *key, std::string const &value) {
+        std::fprintf(out, "%s\n  \"%s\": \"%s\"", first ? "{" : ",", key,
+                     escape(value).c_str());
+        first = false;
+    }
+
+    /// @brief A measurement of @p phase over @p corpus
+    ///
+    /// @param[in] bytes  input size per call for a throughput, or 0
+    void result(char const *corpus, char const *phase,
+                std::size_t expressions, std::size_t bytes,
+                summary const &s) {
+        std::fprintf(out, "%s\n    {\"corpus\": \"%s\", \"phase\": \"%s\", "
+                          "\"expressions\": %zu, \"samples\": %zu, "
+                          "\"batch\": %zu,\n     \"min_ns\": %.1f, "
+                          "\"mean_ns\": %.1f, \"p50_ns\": %.1f, "
+                          "\"p90_ns\": %.1f, \"p99_ns\": %.1f, "
+                          "\"max_ns\": %.1f",
+                     results == 0 ? (first ? "{\n  \"results\": ["
+                                           : ",\n  \"results\": [")
+                                  : ",",
+                     corpus, phase, expressions, s.count, s.batch, s.min,
+                     s.mean, s.p50, s.p90, s.p99, s.max);
+        if (bytes != 0 && s.mean > 0) {
+            // Bytes per nanosecond are gigabytes per second
+            std::fprintf(out, ", \"mb_per_s\": %.1f",
+                         bytes / s.mean * 1000);
+        }
+        std::fprintf(out, "}");
+        first = false;
+        ++results;
+    }
+
+    /// @brief Close the object
+    void finish() {
+        if (first) {
+            std::fprintf(out, "{");
+        }
+        std::fprintf(out, "%s\n}\n", results == 0 ? "" : "\n  ]");
+    }
+
+private:
+    static std::string escape(std::string const &s) {
+        std::string r;
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                r += '\\';
+            }
+            r += c;
+        }
+        return r;
+    }
+
+    std::FILE *out;
+    bool first = true;
+    std::size_t results = 0;
+};
+
+} // namespace bench
@@ -0,0 +1,73 @@
+/** Compare the bytecode interpreter with the generated machine code
+ *
+ * Every expression is evaluated many times for changing variables
+ * given by slot, once by the interpreter and once by the machine code
+ * of Parser::compile_native(), both throwing and without throwing.
+ * The time is the median per evaluation.
+ */
+#include "harness.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+constexpr std::size_t samples = 100000;
+
+/// @brief Median time of evaluating @p parser for changing variables
+double run(matheval::Parser &parser) {
+    std::vector<double> values(parser.variables().size());
+    volatile double sink = 0;
+    return bench::median(samples, [&](std::size_t k) {
+        std::fill(values.begin(), values.end(), k * 1e-6);
+        sink = sink + parser.evaluate(values.data());
+    });
+}
+
+/// @brief run() without throwing
+double run_nothrow(matheval::Parser &parser) {
+    std::vector<double> values(parser.variables().size());
+    volatile double sink = 0;
+    matheval::errc error;
+    return bench::median(samples, [&](std::size_t k) {
+        std::fill(values.begin(), values.end(), k * 1e-6);
+        sink = sink + parser.evaluate(values.data(), error);
+    });
+}
+
+} // namespace
+
+int main() {
+    char const *const corpus[] = {
+        "x + 1",
+        "x*x*x + 2*x*x - 3*x + 4",
+        "sin(x)**2 + cos(x)**2",
+        "ifelse(x > 0.5, sqrt(x), x * (1 - x)) + abs(x - 0.25) / 3",
+        "((((x+1)*(x+2))*((x+3)*(x+4)))*(((x+5)*(x+6))*((x+7)*(x+8))))",
+    };
+
+    std::printf("%-64s %10s %10s %10s %10s\n", "expression", "vm [ns]",
+                "jit [ns]", "vm errc", "jit errc");
+    for (char const *expr : corpus) {
+        matheval::Parser parser;
+        parser.parse(expr);
+        parser.optimize();
+        parser.compile();
+        double const vm = run(parser);
+        double const vm_nothrow = run_nothrow(parser);
+        if (!parser.compile_native()) {
+            std::printf("%-64s %10.1f %10s %10.1f %10s\n", expr, vm, "-",
+                        vm_nothrow, "-");
+            continue;
+        }
+        double const jit = run(parser);
+        double const jit_nothrow = run_nothrow(parser);
+        std::printf("%-64s %10.1f %10.1f %10.1f %10.1f\n", expr, vm, jit,
+                    vm_nothrow, jit_nothrow);
+    }
+    return 0;
+}
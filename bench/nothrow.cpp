@@ -0,0 +1,82 @@
+/** Compare exceptions with error codes when some rows fail
+ *
+ * Every expression is evaluated for rows of which a given fraction
+ * fails, once with the throwing evaluation, which has to catch an
+ * exception for every failing row, once with the error code of the
+ * non-throwing evaluation and once for all rows in a single batch
+ * with an error mask.  The time per row is the median of a few passes
+ * over all rows, so that it includes the failing ones.
+ */
+#include "harness.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+constexpr std::size_t rows = 200000;
+constexpr std::size_t passes = 5;
+
+} // namespace
+
+int main() {
+    char const *const corpus[] = {
+        "log(x) + 1 / y",
+        "sqrt(x) * y - x / y",
+    };
+    double const fractions[] = {0.0, 0.01, 0.05};
+
+    std::printf("%-32s %8s %12s %12s %12s\n", "expression", "failing",
+                "throw [ns]", "errc [ns]", "batch [ns]");
+    volatile double sink = 0;
+    for (char const *expr : corpus) {
+        for (double fraction : fractions) {
+            matheval::Parser parser;
+            parser.parse(expr);
+            parser.compile();
+
+            // Every failing row has a negative x and a zero y
+            std::size_t const every =
+                fraction > 0 ? static_cast<std::size_t>(1 / fraction) : 0;
+            std::vector<double> x(rows);
+            std::vector<double> y(rows);
+            for (std::size_t r = 0; r < rows; ++r) {
+                bool fail = every && r % every == 0;
+                x[r] = fail ? -1.0 : 1.0 + r * 1e-6;
+                y[r] = fail ? 0.0 : 2.0 - r * 1e-6;
+            }
+
+            double const thrown = bench::median(passes, [&](std::size_t) {
+                for (std::size_t r = 0; r < rows; ++r) {
+                    double const values[] = {x[r], y[r]};
+                    try {
+                        sink = sink + parser.evaluate(values);
+                    } catch (matheval::exception const &) {
+                    }
+                }
+            }) / rows;
+            double const code = bench::median(passes, [&](std::size_t) {
+                for (std::size_t r = 0; r < rows; ++r) {
+                    double const values[] = {x[r], y[r]};
+                    matheval::errc error;
+                    double res = parser.evaluate(values, error);
+                    if (error == matheval::errc::none) {
+                        sink = sink + res;
+                    }
+                }
+            }) / rows;
+            std::vector<double> results(rows);
+            std::vector<matheval::errc> errors(rows);
+            double const *columns[] = {x.data(), y.data()};
+            double const batch = bench::median(passes, [&](std::size_t) {
+                parser.evaluate(rows, columns, results.data(), errors.data());
+            }) / rows;
+            std::printf("%-32s %7.0f%% %12.1f %12.1f %12.1f\n", expr,
+                        fraction * 100, thrown, code, batch);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+/** Scaling of the parallel batch evaluation
+ *
+ * Every expression is evaluated for many rows with the serial batch
+ * evaluation and with thread pools of increasing size, up to the
+ * number of hardware threads.  The time per row is the median of a
+ * few passes over all rows.
+ */
+#include "harness.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+constexpr std::size_t rows = 4000000;
+constexpr std::size_t passes = 5;
+
+} // namespace
+
+int main() {
+    char const *const corpus[] = {
+        "x*x*x + 2*x*y - 3/y + 4",
+        "sin(x)**2 + cos(y)**2",
+    };
+
+    std::vector<double> x(rows);
+    std::vector<double> y(rows);
+    for (std::size_t r = 0; r < rows; ++r) {
+        x[r] = 1.5 + std::sin(1e-5 * r);
+        y[r] = 2.5 + std::cos(3e-5 * r);
+    }
+    double const *columns[] = {x.data(), y.data()};
+    std::vector<double> results(rows);
+
+    std::size_t const hardware =
+        std::max(1u, std::thread::hardware_concurrency());
+    std::printf("%-32s %8s %12s %8s\n", "expression", "threads", "row [ns]",
+                "speedup");
+    for (char const *expr : corpus) {
+        matheval::Parser parser;
+        parser.parse(expr);
+        parser.compile();
+        double const serial = bench::median(passes, [&](std::size_t) {
+            parser.evaluate(rows, columns, results.data());
+        }) / rows;
+        std::printf("%-32s %8s %12.2f %8.2f\n", expr, "serial", serial, 1.0);
+        for (std::size_t threads = 1; threads <= hardware; threads *= 2) {
+            matheval::ThreadPool pool(threads);
+            double const parallel = bench::median(passes, [&](std::size_t) {
+                parser.evaluate_parallel(rows, columns, results.data(), pool);
+            }) / rows;
+            std::printf("%-32s %8zu %12.2f %8.2f\n", expr, threads, parallel,
+                        serial / parallel);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+/** Parsing many formulas
+ *
+ * A corpus of generated formulas is parsed once with a single parser
+ * which is reused for every formula and once with a fresh parser per
+ * formula, which is what the convenience function parse() does.
+ * Finally every formula is made invalid by a trailing operator, and
+ * the cost of reporting the error is measured.  The time is the
+ * median per formula.
+ */
+#include "harness.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+constexpr int formulas = 20000;
+
+std::vector<std::string> corpus() {
+    char const *const terms[] = {
+        "x * y", "sin(x)", "2.5 / (1 + y)", "ifelse(x > y, x, y)",
+        "pow(x, 3)", "abs(y - 0.25)", "sqrt(x*x + y*y)", "max(x, 1e-3)",
+    };
+    std::vector<std::string> result;
+    for (int i = 0; i < formulas; ++i) {
+        std::string expr = "x";
+        for (int t = 0; t < 2 + i % 7; ++t) {
+            expr += t % 2 ? " - " : " + ";
+            expr += terms[(i + 3 * t) % 8];
+        }
+        result.push_back(expr);
+    }
+    return result;
+}
+
+} // namespace
+
+int main() {
+    std::vector<std::string> const exprs = corpus();
+
+    matheval::Parser reused;
+    double const shared = bench::median(exprs.size(), [&](std::size_t k) {
+        reused.parse(exprs[k]);
+    });
+    double const fresh = bench::median(exprs.size(), [&](std::size_t k) {
+        matheval::Parser parser;
+        parser.parse(exprs[k]);
+    });
+
+    std::vector<std::string> invalid;
+    for (std::string const &expr : exprs) {
+        invalid.push_back(expr + " *");
+    }
+    double const rejected = bench::median(invalid.size(), [&](std::size_t k) {
+        try {
+            reused.parse(invalid[k]);
+        } catch (matheval::parse_error const &) {
+        }
+    });
+    std::size_t errors = 0;
+    for (std::string const &expr : invalid) {
+        try {
+            reused.parse(expr);
+        } catch (matheval::parse_error const &) {
+            ++errors;
+        }
+    }
+
+    std::printf("%-12s %12s\n", "parser", "parse [ns]");
+    std::printf("%-12s %12.1f\n", "reused", shared);
+    std::printf("%-12s %12.1f\n", "fresh", fresh);
+    std::printf("%-12s %12.1f\n", "rejected", rejected);
+    if (errors != invalid.size()) {
+        std::printf("only %zu of %zu formulas were rejected\n", errors,
+                    invalid.size());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,236 @@
+/** Parse, optimize and evaluate a corpus of expressions
+ *
+ * The corpus has four kinds of expressions: small ones with a few
+ * operations, medium ones like typical formulas, deep ones with long
+ * chains of nested operands and very wide ones with a thousand terms.
+ * For every kind the time of parsing, of Parser::optimize() and of a
+ * single evaluation is measured, both of the compiled program and of
+ * the syntax tree with a symbol table.  Finally a file of many
+ * formulas is loaded, once one formula after the other, once with
+ * load_expressions() on all threads and once from the trees stored
+ * by Parser::serialize(), which skips parsing and optimizing.  The
+ * results are written as JSON with percentiles of the time per call,
+ * to the file given as the first argument or to the standard output.
+ */
+#include "harness.hpp"
+
+#include <boost/version.hpp>
+
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+#ifndef MATHEVAL_BACKEND
+#define MATHEVAL_BACKEND "unknown"
+#endif
+
+#ifndef MATHEVAL_BUILD_TYPE
+#define MATHEVAL_BUILD_TYPE ""
+#endif
+
+namespace {
+
+struct corpus {
+    char const *name;
+    std::vector<std::string> exprs;
+    std::size_t samples;
+};
+
+std::vector<std::string> small() {
+    return {"x + 1", "2 * x * y", "sin(x)",  "x < y",
+            "abs(x - y)", "-x", "pi * x", "x / 3"};
+}
+
+std::vector<std::string> medium() {
+    return {
+        "sqrt(x*x + y*y) / (1 + exp(-x)) - log(1 + y*y)",
+        "ifelse(x > y, sin(x) * cos(y), atan2(y, x)) + 3 * x**2",
+        "(x + 1) * (y - 2) * (z + 3) / (1 + abs(x * y * z))",
+        "max(x, y) - min(y, z) + floor(10 * x) % 7",
+        "x > 0 && y > 0 || z < 0.25 * (x + y)",
+        "tanh(x) * 0.5 + 0.5 * erf(y / sqrt(2)) - cbrt(z)",
+    };
+}
+
+std::vector<std::string> deep() {
+    std::string parens = "x";
+    std::string calls = "x";
+    std::string powers = "x";
+    for (int i = 0; i < 64; ++i) {
+        parens = "(" + parens + " + 1) * 0.5";
+        calls = (i % 2 ? "sin(" : "cos(") + calls + ")";
+        powers += " ** 1";
+    }
+    return {parens, calls, powers};
+}
+
+std::vector<std::string> wide() {
+    char const *const terms[] = {"v%d * %d.5", "sin(v%d) * %d",
+                                 "v%d / (%d + 1)", "sqrt(v%d + %d)"};
+    std::vector<std::string> result;
+    for (int e = 0; e < 2; ++e) {
+        std::string expr;
+        for (int i = 0; i < 1000; ++i) {
+            char term[64];
+            std::snprintf(term, sizeof(term), terms[(i + e) % 4], i % 50,
+                          i % 10);
+            expr += (i == 0 ? "" : i % 3 ? " + " : " - ") + std::string(term);
+        }
+        result.push_back(expr);
+    }
+    return result;
+}
+
+std::size_t bytes(std::vector<std::string> const &exprs) {
+    std::size_t total = 0;
+    for (std::string const &expr : exprs) {
+        total += expr.size();
+    }
+    return total / exprs.size();
+}
+
+void run(corpus const &c, bench::json &out) {
+    std::vector<std::string> const &exprs = c.exprs;
+    std::size_t const n = exprs.size();
+
+    matheval::Parser parser;
+    out.result(c.name, "parse", n, bytes(exprs),
+               bench::summarize(bench::measure(c.samples, [&](std::size_t k) {
+                   parser.parse(exprs[k % n]);
+               })));
+
+    out.result(c.name, "optimize", n, 0,
+               bench::summarize(bench::measure(
+                   c.samples,
+                   [&](std::size_t k) { parser.parse(exprs[k % n]); },
+                   [&](std::size_t) { parser.optimize(); })));
+
+    // Every expression gets its own parsers and values, so that
+    // nothing but the evaluation is timed
+    std::vector<std::unique_ptr<matheval::Parser>> compiled;
+    std::vector<std::unique_ptr<matheval::Parser>> trees;
+    std::vector<std::vector<double>> values;
+    std::vector<std::map<std::string, double>> tables;
+    for (std::string const &expr : exprs) {
+        compiled.emplace_back(new matheval::Parser());
+        compiled.back()->parse(expr);
+        compiled.back()->optimize();
+        compiled.back()->compile();
+        trees.emplace_back(new matheval::Parser());
+        trees.back()->parse(expr);
+        values.emplace_back(compiled.back()->variables().size(), 0.5);
+        tables.emplace_back();
+        for (std::string const &var : trees.back()->variables()) {
+            tables.back()[var] = 0.5;
+        }
+    }
+
+    volatile double sink = 0;
+    out.result(c.name, "evaluate", n, 0,
+               bench::summarize(bench::measure(c.samples, [&](std::size_t k) {
+                   sink = compiled[k % n]->evaluate(values[k % n].data());
+               })));
+    out.result(c.name, "evaluate_tree", n, 0,
+               bench::summarize(bench::measure(c.samples, [&](std::size_t k) {
+                   sink = trees[k % n]->evaluate(tables[k % n]);
+               })));
+}
+
+/// @brief Load a file of many formulas
+void load(bench::json &out) {
+    std::vector<std::string> const kinds = medium();
+    std::vector<std::string> lines;
+    std::string text;
+    for (int i = 0; i < 20000; ++i) {
+        lines.push_back(kinds[i % kinds.size()] + " + " + std::to_string(i));
+        text += lines.back() + '\n';
+    }
+    char const *const path = "matheval.bench.suite.txt";
+    std::ofstream(path, std::ios::binary) << text;
+
+    out.result("file", "load_serial", lines.size(), text.size(),
+               bench::summarize(bench::measure(5, [&](std::size_t) {
+                   std::vector<matheval::CompiledExpression> expressions;
+                   matheval::Parser parser;
+                   for (std::string const &line : lines) {
+                       parser.parse(line);
+                       parser.optimize();
+                       expressions.emplace_back(parser);
+                   }
+               })));
+    out.result("file", "load", lines.size(), text.size(),
+               bench::summarize(bench::measure(5, [&](std::size_t) {
+                   matheval::load_expressions(text.data(), text.size());
+               })));
+    out.result("file", "load_file", lines.size(), text.size(),
+               bench::summarize(bench::measure(5, [&](std::size_t) {
+                   matheval::load_expression_file(path);
+               })));
+    std::remove(path);
+
+    std::string binary;
+    {
+        matheval::Parser parser;
+        for (std::string const &line : lines) {
+            parser.parse(line);
+            parser.optimize();
+            binary += parser.serialize();
+        }
+    }
+    out.result("file", "load_binary", lines.size(), binary.size(),
+               bench::summarize(bench::measure(5, [&](std::size_t) {
+                   std::vector<matheval::CompiledExpression> expressions;
+                   matheval::Parser parser;
+                   for (std::size_t pos = 0; pos != binary.size();) {
+                       pos += parser.deserialize(binary.data() + pos,
+                                                 binary.size() - pos);
+                       expressions.emplace_back(parser);
+                   }
+               })));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::FILE *file = stdout;
+    if (argc > 1) {
+        file = std::fopen(argv[1], "w");
+        if (file == nullptr) {
+            std::perror(argv[1]);
+            return 1;
+        }
+    }
+
+    bench::json out(file);
+    out.property("backend", MATHEVAL_BACKEND);
+    out.property("build", MATHEVAL_BUILD_TYPE);
+    out.property("boost", BOOST_LIB_VERSION);
+#ifdef __VERSION__
+    out.property("compiler", __VERSION__);
+#endif
+    out.property("unit", "ns per call");
+
+    corpus const corpora[] = {
+        {"small", small(), 2000},
+        {"medium", medium(), 1000},
+        {"deep", deep(), 300},
+        {"wide", wide(), 100},
+    };
+    for (corpus const &c : corpora) {
+        run(c, out);
+    }
+    load(out);
+    out.finish();
+
+    if (file != stdout) {
+        std::fclose(file);
+        std::printf("%s: results written to %s\n", argv[0], argv[1]);
+    }
+    return 0;
+}
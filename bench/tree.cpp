@@ -0,0 +1,91 @@
+/** Footprint of the syntax tree of a long expression
+ *
+ * A generated expression with 10000 terms is parsed while all heap
+ * allocations of the process are counted.  The memory held by the
+ * parser afterwards is the size of the syntax tree.  The tree is then
+ * walked by evaluating without compiling to bytecode and optimized by
+ * constant folding, and the median time of both is reported.
+ */
+#include "harness.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "matheval.hpp"
+
+namespace {
+
+std::size_t live = 0;
+std::size_t peak = 0;
+std::size_t count = 0;
+
+constexpr int terms = 10000;
+constexpr std::size_t samples = 20;
+
+} // namespace
+
+// Every allocation records its size in front of the memory
+void *operator new(std::size_t size) {
+    void *p = std::malloc(size + alignof(std::max_align_t));
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    *static_cast<std::size_t *>(p) = size;
+    live += size;
+    peak = live > peak ? live : peak;
+    ++count;
+    return static_cast<char *>(p) + alignof(std::max_align_t);
+}
+
+void operator delete(void *p) noexcept {
+    if (p == nullptr) {
+        return;
+    }
+    char *base = static_cast<char *>(p) - alignof(std::max_align_t);
+    live -= *reinterpret_cast<std::size_t *>(base);
+    std::free(base);
+}
+
+void operator delete(void *p, std::size_t) noexcept { operator delete(p); }
+
+int main() {
+    char const *const ops[] = {" + ", " - ", " * ", " / "};
+    std::string expr = "x";
+    for (int t = 1; t < terms; ++t) {
+        expr += ops[t % 4];
+        expr += t % 3 ? std::to_string(t) : "y";
+    }
+
+    std::size_t const before = live;
+    count = 0;
+    peak = live;
+    matheval::Parser parser;
+    parser.parse(expr);
+    std::size_t const allocations = count;
+    std::size_t const held = live - before;
+    std::size_t const parse_peak = peak - before;
+
+    auto fn = [](std::string const &) { return 1.5; };
+    volatile double sink = 0;
+    double const walk = bench::median(samples, [&](std::size_t) {
+        sink = sink + parser.evaluate(fn);
+    }) / 1000;
+    double const fold = bench::median(samples, [&](std::size_t) {
+        matheval::Parser p;
+        p.parse(expr);
+        p.optimize();
+    }) / 1000;
+
+    std::printf("terms                  %12d\n", terms);
+    std::printf("allocations in parse   %12zu\n", allocations);
+    std::printf("peak during parse [kB] %12.1f\n", parse_peak / 1024.);
+    std::printf("tree [kB]              %12.1f\n", held / 1024.);
+    std::printf("tree [B/term]          %12.1f\n",
+                static_cast<double>(held) / terms);
+    std::printf("evaluate tree [us]     %12.1f\n", walk);
+    std::printf("parse + optimize [us]  %12.1f\n", fold);
+    return 0;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "math.hpp"
+
+#include <boost/math/constants/constants.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace matheval {
+
+/// @brief The names of the grammar and what they stand for
+///
+/// The tables are the single source of the symbols of every parser,
+/// the Spirit grammars as well as the compile-time parser of
+/// static_expression.hpp.  They are constant expressions, so they
+/// can be searched at compile time.
+namespace builtins {
+
+/// @brief A named value or function
+template <typename T>
+struct symbol {
+    char const *name;
+    T value;
+};
+
+using unary_fn = double (*)(double);
+using binary_fn = double (*)(double, double);
+using ternary_fn = double (*)(double, double, double);
+
+// clang-format off
+
+constexpr symbol<double> constants[] = {
+    {"e"      , boost::math::constants::e<double>()},
+    {"epsilon", std::numeric_limits<double>::epsilon()},
+    {"phi"    , boost::math::constants::phi<double>()},
+    {"pi"     , boost::math::constants::pi<double>()},
+};
+
+constexpr symbol<unary_fn> unary_functions[] = {
+    {"abs"   , static_cast<unary_fn>(&std::abs)},
+    {"acos"  , static_cast<unary_fn>(&math::acos)},
+    {"acosh" , static_cast<unary_fn>(&math::acosh)},
+    {"asin"  , static_cast<unary_fn>(&math::asin)},
+    {"asinh" , static_cast<unary_fn>(&std::asinh)},
+    {"atan"  , static_cast<unary_fn>(&std::atan)},
+    {"atanh" , static_cast<unary_fn>(&math::atanh)},
+    {"cbrt"  , static_cast<unary_fn>(&std::cbrt)},
+    {"ceil"  , static_cast<unary_fn>(&std::ceil)},
+    {"cos"   , static_cast<unary_fn>(&math::cos)},
+    {"cosh"  , static_cast<unary_fn>(&std::cosh)},
+    {"deg"   , static_cast<unary_fn>(&math::deg)},
+    {"erf"   , static_cast<unary_fn>(&std::erf)},
+    {"erfc"  , static_cast<unary_fn>(&std::erfc)},
+    {"exp"   , static_cast<unary_fn>(&std::exp)},
+    {"exp2"  , static_cast<unary_fn>(&std::exp2)},
+    {"floor" , static_cast<unary_fn>(&std::floor)},
+    {"isinf" , static_cast<unary_fn>(&math::isinf)},
+    {"isnan" , static_cast<unary_fn>(&math::isnan)},
+    {"log"   , static_cast<unary_fn>(&math::log)},
+    {"log2"  , static_cast<unary_fn>(&math::log2)},
+    {"log10" , static_cast<unary_fn>(&math::log10)},
+    {"rad"   , static_cast<unary_fn>(&math::rad)},
+    {"round" , static_cast<unary_fn>(&std::round)},
+    {"sgn"   , static_cast<unary_fn>(&math::sgn)},
+    {"sin"   , static_cast<unary_fn>(&math::sin)},
+    {"sinh"  , static_cast<unary_fn>(&std::sinh)},
+    {"sqrt"  , static_cast<unary_fn>(&math::sqrt)},
+    {"tan"   , static_cast<unary_fn>(&math::tan)},
+    {"tanh"  , static_cast<unary_fn>(&std::tanh)},
+    {"tgamma", static_cast<unary_fn>(&math::tgamma)},
+};
+
+constexpr symbol<binary_fn> binary_functions[] = {
+    {"atan2", static_cast<binary_fn>(&std::atan2)},
+    {"max"  , static_cast<binary_fn>(&std::fmax)},
+    {"min"  , static_cast<binary_fn>(&std::fmin)},
+    {"pow"  , static_cast<binary_fn>(&math::pow)},
+};
+
+constexpr symbol<ternary_fn> ternary_functions[] = {
+    {"ifelse", static_cast<ternary_fn>(&math::ifelse)},
+};
+
+constexpr symbol<unary_fn> unary_operators[] = {
+    {"+", static_cast<unary_fn>(&math::plus)},
+    {"-", static_cast<unary_fn>(&math::minus)},
+    {"!", static_cast<unary_fn>(&math::unary_not)},
+};
+
+constexpr symbol<binary_fn> additive_operators[] = {
+    {"+", static_cast<binary_fn>(&math::plus)},
+    {"-", static_cast<binary_fn>(&math::minus)},
+};
+
+constexpr symbol<binary_fn> multiplicative_operators[] = {
+    {"*", static_cast<binary_fn>(&math::multiplies)},
+    {"/", static_cast<binary_fn>(&math::divides)},
+    {"%", static_cast<binary_fn>(&math::fmod)},
+};
+
+constexpr symbol<binary_fn> logical_operators[] = {
+    {"&&", static_cast<binary_fn>(&math::logical_and)},
+    {"||", static_cast<binary_fn>(&math::logical_or)},
+};
+
+constexpr symbol<binary_fn> relational_operators[] = {
+    {"<" , static_cast<binary_fn>(&math::less)},
+    {"<=", static_cast<binary_fn>(&math::less_equals)},
+    {">" , static_cast<binary_fn>(&math::greater)},
+    {">=", static_cast<binary_fn>(&math::greater_equals)},
+};
+
+constexpr symbol<binary_fn> equality_operators[] = {
+    {"==", static_cast<binary_fn>(&math::equals)},
+    {"!=", static_cast<binary_fn>(&math::not_equals)},
+};
+
+constexpr symbol<binary_fn> power_operators[] = {
+    {"**", static_cast<binary_fn>(&math::pow)},
+};
+
+// clang-format on
+
+} // namespace builtins
+
+} // namespace matheval
@@ -0,0 +1,535 @@
+#pragma once
+
+#include <boost/math/constants/constants.hpp>
+#include <cmath>
+#include <limits>
+#include "matheval.hpp"
+#if defined(__linux__)
+#include <fenv.h>
+#endif
+
+namespace matheval {
+
+/// @brief The functions and operators of the grammar
+///
+/// They are public, so that header-only code like
+/// static_expression.hpp calls the very same functions as parsed
+/// expressions.
+namespace math {
+
+/// @brief Domain errors of the checked functions
+///
+/// Each checked function has an overload taking an error argument
+/// which returns NaN and sets the error instead of throwing.
+using error = matheval::errc;
+
+/// @brief Throw the exception which corresponds to an error
+///
+/// @param[in] e    the error, must not be error::none
+/// @param[in] arg  the argument of the failing function
+[[noreturn]] inline void raise(error e, double arg) {
+  switch (e) {
+  case error::divideByZero:       throw matheval::divideByZero{};
+  case error::moduloByZero:       throw matheval::moduloByZero{};
+  case error::moduloWithInfinity: throw matheval::moduloWithInfinity{};
+  case error::powInvalid:         throw matheval::powInvalid{};
+  case error::powDivideByZero:    throw matheval::powDivideByZero{};
+  case error::powOverflow:        throw matheval::powOverflow{};
+  case error::powUnderflow:       throw matheval::powUnderflow{};
+  case error::acosInvalid:        throw matheval::acosInvalid{arg};
+  case error::acoshInvalid:       throw matheval::acoshInvalid{arg};
+  case error::asinInvalid:        throw matheval::asinInvalid{arg};
+  case error::atanhInvalid:       throw matheval::atanhInvalid{arg};
+  case error::atanhDivideByZero:  throw matheval::atanhDivideByZero{};
+  case error::cosInvalid:         throw matheval::cosInvalid{};
+  case error::logInvalid:         throw matheval::logInvalid{arg};
+  case error::logDivideByZero:    throw matheval::logDivideByZero{};
+  case error::sinInvalid:         throw matheval::sinInvalid{};
+  case error::sqrtInvalid:        throw matheval::sqrtInvalid{arg};
+  case error::tanInvalid:         throw matheval::tanInvalid{};
+  case error::tgammaDivideByZero: throw matheval::tgammaDivideByZero{};
+  case error::tgammaInvalid:      throw matheval::tgammaInvalid{arg};
+  case error::none:               break;
+  }
+  throw matheval::invalid_argument("raise called without an error");
+}
+
+/// @brief Throw if a checked function reported an error
+///
+/// The error is taken by reference, so that it is read only after
+/// the result has been computed.
+template <typename T>
+T checked(T res, error const &e, T arg) {
+  if (e != error::none) {
+    raise(e, arg);
+  }
+  return res;
+}
+
+/// @brief Report an error and return NaN
+template <typename T>
+T fail(error &e, error what) {
+  e = what;
+  return std::numeric_limits<T>::quiet_NaN();
+}
+
+/// @brief Sign function
+template <typename T>
+T sgn(T x) {
+    return (T{0} < x) - (x < T{0});
+}
+
+/// @brief isnan function with adjusted return type
+template <typename T>
+T isnan(T x) {
+    return std::isnan(x);
+}
+
+/// @brief isinf function with adjusted return type
+template <typename T>
+T isinf(T x) {
+    return std::isinf(x);
+}
+
+/// @brief Convert radians to degrees
+template <typename T>
+T deg(T x) {
+    return x * boost::math::constants::radian<T>();
+}
+
+/// @brief Convert degrees to radians
+template <typename T>
+T rad(T x) {
+    return x * boost::math::constants::degree<T>();
+}
+
+/// @brief acosinus
+template <typename T>
+T acos(T x, error &e) {
+  if (std::fabs(x) > 1) {
+    return fail<T>(e, error::acosInvalid);
+  }
+  return std::acos(x);
+}
+
+/// @brief acosinus
+template <typename T>
+T acos(T x) {
+  error e = error::none;
+  return checked(acos(x, e), e, x);
+}
+
+/// @brief cosinus
+template <typename T>
+T cos(T x, error &e) {
+  if (std::isinf(x)) {
+    return fail<T>(e, error::cosInvalid);
+  }
+  return std::cos(x);
+}
+
+/// @brief cosinus
+template <typename T>
+T cos(T x) {
+  error e = error::none;
+  return checked(cos(x, e), e, x);
+}
+
+/// @brief inverse hyperbolic cosine
+template <typename T>
+T acosh(T x, error &e) {
+  if (x < 1.0) {
+    return fail<T>(e, error::acoshInvalid);
+  }
+  return std::acosh(x);
+}
+
+/// @brief inverse hyperbolic cosine
+template <typename T>
+T acosh(T x) {
+  error e = error::none;
+  return checked(acosh(x, e), e, x);
+}
+
+/// @brief asinus
+template <typename T>
+T asin(T x, error &e) {
+  if (std::fabs(x) > 1) {
+    return fail<T>(e, error::asinInvalid);
+  }
+  return std::asin(x);
+}
+
+/// @brief asinus
+template <typename T>
+T asin(T x) {
+  error e = error::none;
+  return checked(asin(x, e), e, x);
+}
+
+/// @brief inverse hyperbolic tangent
+template <typename T>
+T atanh(T x, error &e) {
+  const T abs_x = std::fabs(x);
+  if (abs_x > 1) {
+    return fail<T>(e, error::atanhInvalid);
+  } else if (abs_x == 1.0) {
+    return fail<T>(e, error::atanhDivideByZero);
+  }
+  return std::atanh(x);
+}
+
+/// @brief inverse hyperbolic tangent
+template <typename T>
+T atanh(T x) {
+  error e = error::none;
+  return checked(atanh(x, e), e, x);
+}
+
+/// @brief unary plus
+template <typename T>
+T plus(T x) {
+    return x;
+}
+
+/// @brief natural logarithm
+template <typename T>
+T log(T x, error &e) {
+  if (x == 0.0) {
+    return fail<T>(e, error::logDivideByZero);
+  } else if (x < 0.0) {
+    return fail<T>(e, error::logInvalid);
+  }
+  return std::log(x);
+}
+
+/// @brief natural logarithm
+template <typename T>
+T log(T x) {
+  error e = error::none;
+  return checked(log(x, e), e, x);
+}
+
+/// @brief log2
+template <typename T>
+T log2(T x, error &e) {
+  if (x == 0.0) {
+    return fail<T>(e, error::logDivideByZero);
+  } else if (x < 0.0) {
+    return fail<T>(e, error::logInvalid);
+  }
+  return std::log2(x);
+}
+
+/// @brief log2
+template <typename T>
+T log2(T x) {
+  error e = error::none;
+  return checked(log2(x, e), e, x);
+}
+
+/// @brief log10
+template <typename T>
+T log10(T x, error &e) {
+  if (x == 0.0) {
+    return fail<T>(e, error::logDivideByZero);
+  } else if (x < 0.0) {
+    return fail<T>(e, error::logInvalid);
+  }
+  return std::log10(x);
+}
+
+/// @brief log10
+template <typename T>
+T log10(T x) {
+  error e = error::none;
+  return checked(log10(x, e), e, x);
+}
+
+/// @brief sinus
+template <typename T>
+T sin(T x, error &e) {
+  if (isinf(x)) {
+    return fail<T>(e, error::sinInvalid);
+  }
+  return std::sin(x);
+}
+
+/// @brief sinus
+template <typename T>
+T sin(T x) {
+  error e = error::none;
+  return checked(sin(x, e), e, x);
+}
+
+/// @brief square root
+template <typename T>
+T sqrt(T x, error &e) {
+  if (x < 0.0) {
+    return fail<T>(e, error::sqrtInvalid);
+  }
+  return std::sqrt(x);
+}
+
+/// @brief square root
+template <typename T>
+T sqrt(T x) {
+  error e = error::none;
+  return checked(sqrt(x, e), e, x);
+}
+
+/// @brief tangens
+template <typename T>
+T tan(T x, error &e) {
+  if (isinf(x)) {
+    return fail<T>(e, error::tanInvalid);
+  }
+  return std::tan(x);
+}
+
+/// @brief tangens
+template <typename T>
+T tan(T x) {
+  error e = error::none;
+  return checked(tan(x, e), e, x);
+}
+
+/// @brief gamma
+template <typename T>
+T tgamma(T x, error &e) {
+  if (x == 0) {
+    return fail<T>(e, error::tgammaDivideByZero);
+  } else if (x == -INFINITY) {
+    return fail<T>(e, error::tgammaInvalid);
+  } else if (x < 0 && x == ceil(x)) {
+    return fail<T>(e, error::tgammaInvalid);
+  }
+#if 0
+  int psigngam;
+  return lgamma_r(x, &psigngam);
+#else
+  return std::tgamma(x);
+#endif
+}
+
+/// @brief gamma
+template <typename T>
+T tgamma(T x) {
+  error e = error::none;
+  return checked(tgamma(x, e), e, x);
+}
+
+/// @brief if/else function
+template <typename T>
+T ifelse(T expr, T res_true, T res_false) {
+  return expr ? res_true : res_false;
+}
+
+/// @brief binary plus
+template <typename T>
+T plus(T x, T y) {
+    return x + y;
+}
+
+/// @brief unary minus
+template <typename T>
+T minus(T x) {
+    return -x;
+}
+
+/// @brief binary minus
+template <typename T>
+T minus(T x, T y) {
+    return x - y;
+}
+
+/// @brief multiply
+template <typename T>
+T multiplies(T x, T y) {
+    return x * y;
+}
+
+/// @brief divide
+template <typename T>
+T divides(T x, T y, error &e) {
+  if (y == 0) {
+    return fail<T>(e, error::divideByZero);
+  }
+    return x / y;
+}
+
+/// @brief divide
+template <typename T>
+T divides(T x, T y) {
+  error e = error::none;
+  return checked(divides(x, y, e), e, x);
+}
+
+/// @brief modulo
+template <typename T>
+T fmod(T x, T y, error &e) {
+  if (y == 0) {
+    return fail<T>(e, error::moduloByZero);
+  }
+  if (isinf(x)) {
+    return fail<T>(e, error::moduloWithInfinity);
+  }
+  return std::fmod(x,y);
+}
+
+/// @brief modulo
+template <typename T>
+T fmod(T x, T y) {
+  error e = error::none;
+  return checked(fmod(x, y, e), e, x);
+}
+
+/// @brief power
+template <typename T>
+T pow(T x, T y, error &e) {
+#if defined(__linux__)
+  errno = 0;
+  feclearexcept(FE_ALL_EXCEPT);
+  T res = std::pow(x,y);
+  if (fetestexcept(FE_INVALID)) {
+    return fail<T>(e, error::powInvalid);
+  } else if (fetestexcept(FE_DIVBYZERO)) {
+    return fail<T>(e, error::powDivideByZero);
+  } else if (fetestexcept(FE_OVERFLOW)) {
+    return fail<T>(e, error::powOverflow);
+  } else if (fetestexcept(FE_UNDERFLOW)) {
+    return fail<T>(e, error::powUnderflow);
+  }
+  return res;
+#elif defined(__APPLE__) && defined(__clang__)
+  if (y < 0) {
+    return fail<T>(e, error::powDivideByZero);
+  } else if (x < 0 &&
+	     isfinite(y) &&
+	     y != floor(y)) {
+    return fail<T>(e, error::powInvalid);
+  } else if (x == 0 && y < 0) {
+    return fail<T>(e, error::powInvalid);
+  }
+  return std::pow(x,y);
+#else
+#error unknown platform
+#endif
+}
+
+/// @brief power
+template <typename T>
+T pow(T x, T y) {
+  error e = error::none;
+  return checked(pow(x, y, e), e, x);
+}
+
+/// @brief power with a small integer exponent, pow(x, N)
+///
+/// Multiplies instead of calling pow, which spends most of its time
+/// on the floating-point environment.  Results close to overflow or
+/// underflow are left to pow, so that the same errors are reported.
+/// The product is rounded after each factor and may differ from pow
+/// in the last bit.
+template <int N, typename T>
+T powi(T x, error &e) {
+  T res = x;
+  for (int i = 1; i < (N < 0 ? -N : N); ++i) {
+    res *= x;
+  }
+  if (N < 0) {
+    res = 1 / res;
+  }
+  T const a = std::fabs(res);
+  if ((a > 2 * std::numeric_limits<T>::min() &&
+       a < std::numeric_limits<T>::max() / 2) ||
+      (N > 0 && x == 0) || std::isnan(x)) {
+    return res;
+  }
+  return pow(x, static_cast<T>(N), e);
+}
+
+/// @brief power with a small integer exponent, pow(x, N)
+template <int N, typename T>
+T powi(T x) {
+  error e = error::none;
+  return checked(powi<N>(x, e), e, x);
+}
+
+/// @brief square root as a power, pow(x, 0.5)
+///
+/// Unlike sqrt, pow(-0, 0.5) is +0, pow(-inf, 0.5) is +inf and
+/// negative numbers are a powInvalid error, so only positive numbers
+/// take the square root.
+template <typename T>
+T pow_half(T x, error &e) {
+  if (x > 0) {
+    return std::sqrt(x);
+  }
+  return pow(x, static_cast<T>(0.5), e);
+}
+
+/// @brief square root as a power, pow(x, 0.5)
+template <typename T>
+T pow_half(T x) {
+  error e = error::none;
+  return checked(pow_half(x, e), e, x);
+}
+
+/// @brief unary not
+template <typename T>
+T unary_not(T x) {
+    return !x;
+}
+
+/// @brief logical and
+template <typename T>
+T logical_and(T x, T y) {
+    return x && y;
+}
+
+/// @brief logical or
+template <typename T>
+T logical_or(T x, T y) {
+    return x || y;
+}
+
+/// @brief less
+template <typename T>
+T less(T x, T y) {
+    return x < y;
+}
+
+/// @brief less equals
+template <typename T>
+T less_equals(T x, T y) {
+    return x <= y;
+}
+
+/// @brief greater
+template <typename T>
+T greater(T x, T y) {
+    return x > y;
+}
+
+/// @brief greater equals
+template <typename T>
+T greater_equals(T x, T y) {
+    return x >= y;
+}
+
+/// @brief equals
+template <typename T>
+T equals(T x, T y) {
+    return x == y;
+}
+
+/// @brief not equals
+template <typename T>
+T not_equals(T x, T y) {
+    return x != y;
+}
+
+} // namespace math
+
+} // namespace matheval
@@ -1,9 +1,19 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <map>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <vector>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#define MATHEVAL_HAS_STRING_VIEW 1
+#include <string_view>
+#endif
 
 namespace matheval {
 
@@ -23,6 +33,104 @@ public:
   explicit invalid_argument(const std::string& what_arg) : exception(what_arg) {}
 };
 
+/// @brief Where and why an expression could not be parsed
+///
+/// The names are string literals, which live as long as the program.
+struct parse_diagnostic {
+    std::size_t offset = 0;    ///< byte offset of the failure in the input
+    char const *expected = ""; ///< what was expected there, e.g. "')'"
+    char const *rule = "";     ///< the grammar rule which failed
+};
+
+/// @brief Error codes of the non-throwing evaluation
+///
+/// Every domain error of the mathematical functions is named after
+/// the exception class which is thrown for it by the throwing
+/// evaluation, e.g. @c errc::logInvalid corresponds to
+/// matheval::logInvalid.
+enum class errc : unsigned char {
+    none = 0,
+    divideByZero,
+    moduloByZero,
+    moduloWithInfinity,
+    powInvalid,
+    powDivideByZero,
+    powOverflow,
+    powUnderflow,
+    acosInvalid,
+    acoshInvalid,
+    asinInvalid,
+    atanhInvalid,
+    atanhDivideByZero,
+    cosInvalid,
+    logInvalid,
+    logDivideByZero,
+    sinInvalid,
+    sqrtInvalid,
+    tanInvalid,
+    tgammaDivideByZero,
+    tgammaInvalid,
+};
+
+/// @brief Interface of a thread pool for the parallel evaluation
+///
+/// Implement this to run the parallel evaluation on your own threads
+/// instead of a matheval::ThreadPool.
+class Executor {
+public:
+    virtual ~Executor() = default;
+
+    /// @brief Call @p task once for every index in [0, @p n)
+    ///
+    /// The calls may run concurrently and in any order.  The function
+    /// returns when all of them have returned.
+    virtual void parallel_for(std::size_t n,
+                              std::function<void(std::size_t)> const &task) = 0;
+};
+
+/// @brief A work-stealing thread pool
+///
+/// The indices of a parallel_for() are split into one contiguous range
+/// per thread.  A thread takes the next index from the front of its own
+/// range and, when that is exhausted, steals the back half of the range
+/// of another thread, so that uneven tasks are balanced without a
+/// shared queue.  The calling thread takes part in the work.
+///
+/// A parallel_for() which is called from inside a task runs serially
+/// on the calling thread.  Calls from different threads are executed
+/// one after another.
+class ThreadPool : public Executor {
+    class impl;
+    std::unique_ptr<impl> pimpl;
+
+public:
+    /// @brief Constructor
+    ///
+    /// @param[in] threads  number of threads including the caller of
+    ///                     parallel_for(), 0 for one per hardware thread
+    explicit ThreadPool(std::size_t threads = 0);
+
+    /// @brief Destructor, joins all threads
+    ~ThreadPool() override;
+
+    /// @brief Number of threads including the caller of parallel_for()
+    std::size_t size() const;
+
+    /// @brief Call @p task once for every index in [0, @p n)
+    ///
+    /// If a task throws, the remaining tasks still run and the first
+    /// exception is rethrown.
+    void parallel_for(std::size_t n,
+                      std::function<void(std::size_t)> const &task) override;
+
+    /// @brief A process-wide pool with one thread per hardware thread
+    ///
+    /// The pool is created on first use.
+    static ThreadPool &shared();
+};
+
+class CompiledExpression;
+
 /// @brief Parse a mathematical expression
 ///
 /// This can parse and evaluate a mathematical expression for a given
@@ -43,6 +151,13 @@ class Parser {
     class impl;
     std::unique_ptr<impl> pimpl;
 
+    friend class CompiledExpression;
+    friend class IncrementalExpression;
+    friend class ExpressionSet;
+    friend class GradientExpression;
+    template <typename T>
+    friend class TypedExpression;
+
 public:
     using variable_callback_fn = std::function<double(std::string const&)>;
 
@@ -57,8 +172,107 @@ public:
     /// @param[in] expr The expression given as a std::string
     void parse(std::string const &expr);
 
-    /// @brief Perform constant folding onto the abstract syntax tree
-    void optimize();
+    /// @brief Parse the expression in the first @p size characters of
+    ///        @p expr
+    ///
+    /// The characters are not copied and need not be null-terminated,
+    /// so an expression can be parsed right where it is, e.g. in a
+    /// network buffer.  Only the names of the variables are copied
+    /// into the tree, once per distinct name.
+    void parse(char const *expr, std::size_t size);
+
+    /// @brief Parse the null-terminated expression @p expr
+    void parse(char const *expr) { parse(expr, std::strlen(expr)); }
+
+#ifdef MATHEVAL_HAS_STRING_VIEW
+    /// @brief Parse the expression viewed by @p expr without copying it
+    void parse(std::string_view expr) { parse(expr.data(), expr.size()); }
+#endif
+
+    /// @brief What optimize() did to the abstract syntax tree
+    struct optimization {
+        std::size_t folded;     ///< nodes removed by constant folding
+        std::size_t simplified; ///< operations replaced by cheaper ones
+        std::size_t eliminated; ///< nodes removed by merging equal subtrees
+    };
+
+    /// @brief Optimize the abstract syntax tree
+    ///
+    /// Subtrees whose arguments are all constant are replaced by their
+    /// value.  Operations with a constant argument are simplified,
+    /// e.g. @c x*1 becomes @c x, @c x**2 a product and @c x/4 a
+    /// multiplication by 0.25.  Then structurally identical subtrees
+    /// are merged, which turns the tree into a DAG whose shared nodes
+    /// are computed only once per evaluation, e.g. the square root of
+    /// @c sqrt(x**2+y**2) / (1 + sqrt(x**2+y**2)).  None of this
+    /// changes the error of any evaluation, and only integer powers
+    /// other than 2 and -1 may change the last bit of a result,
+    /// because every factor is rounded.  If the expression has
+    /// already been compiled, the program is regenerated from the
+    /// optimized tree.
+    ///
+    /// @return what each step did
+    optimization optimize();
+
+    /// @brief Lower the abstract syntax tree into a bytecode program
+    ///
+    /// The program is a contiguous array of instructions which is
+    /// executed by a small stack machine.  After this call evaluate()
+    /// runs the program instead of walking the abstract syntax tree,
+    /// which saves the pointer chasing and the visitor dispatch for
+    /// every node.  Parsing a new expression discards the program.
+    ///
+    /// @throw matheval::invalid_argument if nothing has been parsed
+    void compile();
+
+    /// @brief Compile the expression and translate the program into
+    ///        native machine code
+    ///
+    /// Afterwards evaluate(double const *) and the overloads which
+    /// take a single row call the machine code instead of
+    /// interpreting the program.  Additions, subtractions,
+    /// multiplications and comparisons are inlined and all other
+    /// functions are called, so the results and errors are exactly
+    /// those of the interpreter.  A CompiledExpression constructed
+    /// from this parser shares the machine code.  Machine code is
+    /// generated for x86-64 on systems with the System V calling
+    /// convention like Linux and macOS; everywhere else the
+    /// interpreter is used.  Parsing a new expression discards the
+    /// machine code, while optimize() regenerates it.
+    ///
+    /// @return whether machine code is used
+    /// @throw matheval::invalid_argument if nothing has been parsed
+    bool compile_native();
+
+    /// @brief Store the abstract syntax tree in a compact binary form
+    ///
+    /// The tree is stored as it is, so after optimize() reading it
+    /// back with deserialize() skips both parsing and optimizing.
+    /// Functions are stored by identifiers which are the same in
+    /// every build and version of the library, never by address, so
+    /// the bytes can be written to a file and read by another
+    /// process.  Numbers are stored in the byte order of the machine.
+    ///
+    /// @return the serialized tree, which begins with a version
+    /// @throw matheval::invalid_argument if the tree is larger than
+    ///        4 GiB
+    std::string serialize() const;
+
+    /// @brief Replace the expression by a tree stored by serialize()
+    ///
+    /// The tree is read from the beginning of the @p size bytes at
+    /// @p data, which need not be aligned, so that many trees can be
+    /// stored one after the other, e.g. in a memory-mapped file.
+    /// Reading only copies the nodes and looks up the functions by
+    /// their identifiers.  Like parse() this discards the compiled
+    /// program.
+    ///
+    /// @return the number of bytes read, i.e. the offset of the next
+    ///         tree
+    /// @throw matheval::invalid_argument if the bytes are not a valid
+    ///        tree of the current version; the previous expression
+    ///        is kept then
+    std::size_t deserialize(char const *data, std::size_t size);
 
     /// @brief Evaluate the abstract syntax tree for a given symbol table
     ///
@@ -67,6 +281,112 @@ public:
     /// @throw exceptions derived from std::exception
     double evaluate(variable_callback_fn fn = nullptr);
 
+    /// @brief Names of the variables in the expression
+    ///
+    /// The variables are resolved when the expression is parsed and
+    /// listed in the order of their first appearance.  The position
+    /// of a name in this list is its slot, which stays the same after
+    /// optimize() and compile().
+    std::vector<std::string> const &variables() const;
+
+    /// @brief Evaluate the expression for variables given by slot
+    ///
+    /// The value of the variable named @c variables()[i] is
+    /// @c values[i].  No names are looked up, so this is the fastest
+    /// way to evaluate an expression repeatedly.  The expression is
+    /// compiled on the first call if compile() has not been called.
+    ///
+    /// @param[in] values  array of at least variables().size() values
+    /// @throw various exceptions derived from matheval::exception
+    double evaluate(double const *values);
+
+    /// @brief Evaluate the expression for variables given by slot
+    ///
+    /// @param[in] values  the values indexed by slot
+    /// @throw matheval::invalid_argument if there are fewer values
+    ///        than variables
+    /// @throw various exceptions derived from matheval::exception
+    double evaluate(std::vector<double> const &values);
+
+    /// @brief Evaluate the expression for many rows at once
+    ///
+    /// The variables are given as one column per slot, i.e. the value
+    /// of the variable named @c variables()[i] in row @c r is
+    /// @c columns[i][r].  The rows are processed in blocks and every
+    /// operation is applied to a whole block before moving on to the
+    /// next operation, which amortizes the dispatch over many rows.
+    /// Arithmetic, comparisons and square roots use the widest vector
+    /// instructions that the running CPU supports (SSE2, AVX2 or
+    /// AVX-512).  The results are bit-for-bit the same as evaluating
+    /// every row on its own.  The expression is compiled on the first
+    /// call if compile() has not been called.
+    ///
+    /// @param[in]  rows     number of rows
+    /// @param[in]  columns  variables().size() arrays of @p rows values
+    /// @param[out] results  array of @p rows values
+    /// @throw various exceptions derived from matheval::exception if
+    ///        any row fails to evaluate, namely the exception of the
+    ///        lowest failing row; the contents of @p results are
+    ///        unspecified in that case
+    void evaluate(std::size_t rows, double const *const *columns,
+                  double *results);
+
+    /// @brief Evaluate the expression without throwing on domain errors
+    ///
+    /// Domain errors of the mathematical functions, like a division
+    /// by zero or the logarithm of a negative number, do not throw an
+    /// exception.  The result is NaN instead and @p error is set to
+    /// the code of the first error, i.e. the one whose exception
+    /// evaluate(double const *) would have thrown.  Otherwise the
+    /// result is the same and @p error is errc::none.
+    ///
+    /// @param[in]  values  array of at least variables().size() values
+    /// @param[out] error   the error code
+    double evaluate(double const *values, errc &error);
+
+    /// @brief Evaluate the expression for many rows without throwing
+    ///
+    /// Like the throwing overload, but failing rows do not throw.
+    /// Their result is NaN and the error code is stored in the same
+    /// row of @p errors, while the error code of every other row is
+    /// errc::none.
+    ///
+    /// @param[in]  rows     number of rows
+    /// @param[in]  columns  variables().size() arrays of @p rows values
+    /// @param[out] results  array of @p rows values
+    /// @param[out] errors   array of @p rows error codes
+    void evaluate(std::size_t rows, double const *const *columns,
+                  double *results, errc *errors);
+
+    /// @brief Evaluate the expression for many rows on many threads
+    ///
+    /// The rows are split into chunks whose inputs and outputs fit
+    /// into the cache, and the chunks are evaluated by @p executor.
+    /// The results are the same as those of the serial evaluation.
+    ///
+    /// @param[in]  rows      number of rows
+    /// @param[in]  columns   variables().size() arrays of @p rows values
+    /// @param[out] results   array of @p rows values
+    /// @param[in]  executor  the thread pool
+    /// @throw various exceptions derived from matheval::exception for
+    ///        the lowest failing row, independent of the scheduling;
+    ///        the contents of @p results are unspecified in that case
+    void evaluate_parallel(std::size_t rows, double const *const *columns,
+                           double *results,
+                           Executor &executor = ThreadPool::shared());
+
+    /// @brief Evaluate the expression for many rows on many threads
+    /// without throwing
+    ///
+    /// @param[in]  rows      number of rows
+    /// @param[in]  columns   variables().size() arrays of @p rows values
+    /// @param[out] results   array of @p rows values, NaN for failing rows
+    /// @param[out] errors    array of @p rows error codes
+    /// @param[in]  executor  the thread pool
+    void evaluate_parallel(std::size_t rows, double const *const *columns,
+                           double *results, errc *errors,
+                           Executor &executor = ThreadPool::shared());
+
   /// @brief Evaluate the abstract syntax tree for a given symbol table
   ///
   /// @param[in] st    the symbol table for variable lookup.
@@ -84,10 +404,500 @@ public:
   }
 };
 
+/// @brief An immutable compiled expression
+///
+/// The expression is compiled from the current state of a Parser, so
+/// parse() and optionally optimize() have to be called first.  Later
+/// changes to the Parser do not affect the compiled expression.
+///
+/// All member functions are const and the compiled program is never
+/// modified after construction, so any number of threads can evaluate
+/// the same object or copies of it concurrently without
+/// synchronization.  Copies share the program, which makes copying as
+/// cheap as copying a std::shared_ptr.
+class CompiledExpression {
+    class impl;
+    std::shared_ptr<impl const> pimpl;
+
+public:
+    using variable_callback_fn = Parser::variable_callback_fn;
+
+    /// @brief Compile the expression which was parsed by @p parser
+    ///
+    /// @throw matheval::invalid_argument if nothing has been parsed
+    explicit CompiledExpression(Parser const &parser);
+
+    /// @brief Names of the variables, see Parser::variables()
+    std::vector<std::string> const &variables() const;
+
+    /// @brief Evaluate the expression, see Parser::evaluate()
+    ///
+    /// @param[in] fn    the callback function for variable lookup, can be NULL.
+    /// @throw various exceptions derived from matheval::exception
+    double evaluate(variable_callback_fn fn = nullptr) const;
+
+    /// @brief Evaluate the expression for variables given by slot
+    ///
+    /// @param[in] values  array of at least variables().size() values
+    /// @throw various exceptions derived from matheval::exception
+    double evaluate(double const *values) const;
+
+    /// @brief Evaluate the expression for variables given by slot
+    ///
+    /// @param[in] values  the values indexed by slot
+    /// @throw matheval::invalid_argument if there are fewer values
+    ///        than variables
+    /// @throw various exceptions derived from matheval::exception
+    double evaluate(std::vector<double> const &values) const;
+
+    /// @brief Evaluate the expression for many rows at once
+    ///
+    /// @param[in]  rows     number of rows
+    /// @param[in]  columns  variables().size() arrays of @p rows values
+    /// @param[out] results  array of @p rows values
+    /// @throw various exceptions derived from matheval::exception for
+    ///        the lowest failing row
+    void evaluate(std::size_t rows, double const *const *columns,
+                  double *results) const;
+
+    /// @brief Evaluate the expression without throwing on domain errors
+    ///
+    /// @param[in]  values  array of at least variables().size() values
+    /// @param[out] error   the error code
+    double evaluate(double const *values, errc &error) const;
+
+    /// @brief Evaluate the expression for many rows without throwing
+    ///
+    /// @param[in]  rows     number of rows
+    /// @param[in]  columns  variables().size() arrays of @p rows values
+    /// @param[out] results  array of @p rows values
+    /// @param[out] errors   array of @p rows error codes
+    void evaluate(std::size_t rows, double const *const *columns,
+                  double *results, errc *errors) const;
+
+    /// @brief Evaluate the expression for many rows on many threads
+    ///
+    /// See Parser::evaluate_parallel()
+    void evaluate_parallel(std::size_t rows, double const *const *columns,
+                           double *results,
+                           Executor &executor = ThreadPool::shared()) const;
+
+    /// @brief Evaluate the expression for many rows on many threads
+    /// without throwing
+    ///
+    /// See Parser::evaluate_parallel()
+    void evaluate_parallel(std::size_t rows, double const *const *columns,
+                           double *results, errc *errors,
+                           Executor &executor = ThreadPool::shared()) const;
+
+    /// @brief Evaluate the expression for a given symbol table
+    ///
+    /// @param[in] st    the symbol table for variable lookup.
+    /// @throw various exceptions derived from matheval::exception
+    double evaluate(std::map<std::string, double> const &st) const
+    {
+        return evaluate([&st](std::string const &var) {
+            auto it = st.find(var);
+            if (it == st.end()) {
+                throw matheval::invalid_argument("Unknown variable " + var); // NOLINT
+            }
+            return it->second;
+        });
+    }
+};
+
+/// @brief An expression which remembers its previous evaluation
+///
+/// Every node of the syntax tree keeps its value from one evaluation
+/// to the next, and only the nodes which depend on a variable whose
+/// value changed are computed again.  When few of many variables
+/// change between calls, e.g. in a parameter sweep or an interactive
+/// model, this is much cheaper than evaluating the whole expression.
+/// recomputed() tells how many nodes the last evaluation computed.
+///
+/// The expression is taken from the current state of a Parser, so
+/// parse() and optionally optimize() have to be called first.  Unlike
+/// CompiledExpression the object changes on every evaluation and must
+/// not be used by several threads at once.
+class IncrementalExpression {
+    class impl;
+    std::unique_ptr<impl> pimpl;
+
+public:
+    /// @brief Take the expression which was parsed by @p parser
+    ///
+    /// @throw matheval::invalid_argument if nothing has been parsed
+    explicit IncrementalExpression(Parser const &parser);
+
+    /// @brief Destructor
+    ~IncrementalExpression();
+
+    IncrementalExpression(IncrementalExpression &&) noexcept;
+    IncrementalExpression &operator=(IncrementalExpression &&) noexcept;
+
+    /// @brief Names of the variables, see Parser::variables()
+    std::vector<std::string> const &variables() const;
+
+    /// @brief Evaluate the expression for variables given by slot
+    ///
+    /// The values are compared bitwise with those of the previous
+    /// call, so a change from 0 to -0 is noticed as well.  If the
+    /// evaluation throws, the next call computes the failed nodes
+    /// again.
+    ///
+    /// @param[in] values  array of at least variables().size() values
+    /// @throw various exceptions derived from matheval::exception
+    double evaluate(double const *values);
+
+    /// @brief Evaluate the expression for variables given by slot
+    ///
+    /// @param[in] values  the values indexed by slot
+    /// @throw matheval::invalid_argument if there are fewer values
+    ///        than variables
+    /// @throw various exceptions derived from matheval::exception
+    double evaluate(std::vector<double> const &values);
+
+    /// @brief Evaluate the expression for a given symbol table
+    ///
+    /// @param[in] st    the symbol table for variable lookup.
+    /// @throw various exceptions derived from matheval::exception
+    double evaluate(std::map<std::string, double> const &st)
+    {
+        std::vector<double> values;
+        for (std::string const &var : variables()) {
+            auto it = st.find(var);
+            if (it == st.end()) {
+                throw matheval::invalid_argument("Unknown variable " + var); // NOLINT
+            }
+            values.push_back(it->second);
+        }
+        return evaluate(values);
+    }
+
+    /// @brief Number of nodes computed by the last evaluation
+    std::size_t recomputed() const;
+};
+
+/// @brief An expression which is evaluated in the number type @p T
+///
+/// Every constant is rounded to @p T when the expression is created,
+/// the variables are given in @p T, and every operation and function
+/// is carried out in @p T by the same templates of math.hpp which
+/// evaluate doubles.  Hence the same errors are reported, but for
+/// float, which has about 7 significant digits, the results usually
+/// differ from those of double in the last few digits, and they
+/// overflow much earlier.  Constants are folded by Parser::optimize()
+/// in double before they are rounded.  Halving the size of the
+/// numbers halves the memory traffic of large batches, and arithmetic
+/// on a batch can use twice as many lanes of the vector unit.
+///
+/// Instantiated for @c float, see FloatExpression, and for @c double,
+/// which gives the same results as CompiledExpression.  Like that it
+/// is immutable, cheap to copy, and all of its member functions can be
+/// called concurrently.
+template <typename T>
+class TypedExpression {
+    class impl;
+    std::shared_ptr<impl const> pimpl;
+
+public:
+    /// @brief Take the expression which was parsed by @p parser
+    ///
+    /// @throw matheval::invalid_argument if nothing has been parsed
+    explicit TypedExpression(Parser const &parser);
+
+    /// @brief Names of the variables, see Parser::variables()
+    std::vector<std::string> const &variables() const;
+
+    /// @brief Evaluate the expression for variables given by slot
+    ///
+    /// @param[in] values  array of at least variables().size() values
+    /// @throw various exceptions derived from matheval::exception
+    T evaluate(T const *values) const;
+
+    /// @brief Evaluate the expression for variables given by slot
+    ///
+    /// @param[in] values  the values indexed by slot
+    /// @throw matheval::invalid_argument if there are fewer values
+    ///        than variables
+    /// @throw various exceptions derived from matheval::exception
+    T evaluate(std::vector<T> const &values) const;
+
+    /// @brief Evaluate the expression for many rows at once
+    ///
+    /// The variables are given as columns like for
+    /// Parser::evaluate(std::size_t, double const *const *, double *).
+    /// Expressions without conditionals are computed for a block of
+    /// rows at a time, with additions, subtractions and
+    /// multiplications inlined so that the compiler can vectorize
+    /// them.  Expressions with conditionals are computed one row after
+    /// the other.  The results are the same as evaluating every row on
+    /// its own.
+    ///
+    /// @param[in]  rows     number of rows
+    /// @param[in]  columns  variables().size() arrays of @p rows values
+    /// @param[out] results  array of @p rows values
+    /// @throw various exceptions derived from matheval::exception if
+    ///        any row fails to evaluate, namely the exception of the
+    ///        lowest failing row
+    void evaluate(std::size_t rows, T const *const *columns,
+                  T *results) const;
+};
+
+extern template class TypedExpression<float>;
+extern template class TypedExpression<double>;
+
+/// @brief An expression which is evaluated in single precision
+using FloatExpression = TypedExpression<float>;
+
+/// @brief An expression which is evaluated together with its gradient
+///
+/// One evaluation computes the value of the expression and its partial
+/// derivatives with respect to the chosen variables in a single pass
+/// over the syntax tree.  Every subexpression carries its value and
+/// its derivatives, which follow exactly from the derivatives of the
+/// functions by the chain rule, so they are as accurate as the value
+/// and not approximations like finite differences, which need one
+/// evaluation more for every variable.
+///
+/// Where a derivative does not exist, the following conventions hold:
+/// floor, ceil, round, sgn, the comparisons and the logical operators
+/// have the derivative 0, abs has the derivative 0 at 0, max and min
+/// have the derivatives of the argument they select, and of
+/// @c ifelse only the branch which is taken is differentiated.  The
+/// derivative of x**y with respect to y is NaN for negative x.
+///
+/// Like CompiledExpression it is immutable, cheap to copy, and all of
+/// its member functions can be called concurrently.
+class GradientExpression {
+    class impl;
+    std::shared_ptr<impl const> pimpl;
+
+public:
+    /// @brief Take the expression which was parsed by @p parser
+    ///
+    /// @param[in] parser  the parser
+    /// @param[in] wrt     the variables to differentiate with respect
+    ///                    to, in the order of the gradient.  Names
+    ///                    which do not occur in the expression get the
+    ///                    derivative 0.
+    /// @throw matheval::invalid_argument if nothing has been parsed
+    GradientExpression(Parser const &parser,
+                       std::vector<std::string> const &wrt);
+
+    /// @brief Names of the variables, see Parser::variables()
+    std::vector<std::string> const &variables() const;
+
+    /// @brief Names of the variables of the gradient
+    std::vector<std::string> const &with_respect_to() const;
+
+    /// @brief Evaluate the expression and its gradient for variables
+    ///        given by slot
+    ///
+    /// @param[in]  values    array of at least variables().size() values
+    /// @param[out] gradient  array of with_respect_to().size() values
+    /// @return the value of the expression
+    /// @throw various exceptions derived from matheval::exception
+    double evaluate(double const *values, double *gradient) const;
+
+    /// @brief Evaluate the expression and its gradient for variables
+    ///        given by slot
+    ///
+    /// @param[in]  values    the values indexed by slot
+    /// @param[out] gradient  resized to with_respect_to().size()
+    /// @return the value of the expression
+    /// @throw matheval::invalid_argument if there are fewer values
+    ///        than variables
+    /// @throw various exceptions derived from matheval::exception
+    double evaluate(std::vector<double> const &values,
+                    std::vector<double> &gradient) const;
+};
+
+/// @brief Many expressions which are evaluated together
+///
+/// Every expression is parsed and optimized like by Parser::optimize(),
+/// and then all of them are merged into one DAG in which subexpressions
+/// that occur in several expressions are computed only once.  The
+/// variables of all expressions share one table of slots, so every
+/// variable is looked up once per evaluation, and one call computes
+/// the results of all expressions.
+///
+/// Like CompiledExpression the set is immutable, cheap to copy, and
+/// all of its member functions can be called concurrently.
+class ExpressionSet {
+    class impl;
+    std::shared_ptr<impl const> pimpl;
+
+public:
+    /// @brief Parse and merge the expressions
+    ///
+    /// @param[in] exprs  the expressions, which can be empty
+    /// @throw matheval::parse_error if an expression cannot be parsed
+    explicit ExpressionSet(std::vector<std::string> const &exprs);
+
+    /// @brief Number of expressions
+    std::size_t size() const;
+
+    /// @brief Names of the variables of all expressions
+    ///
+    /// The variables are listed in the order of their first appearance
+    /// in the expressions, the first expression first.
+    std::vector<std::string> const &variables() const;
+
+    /// @brief Number of distinct subexpressions of all expressions
+    ///
+    /// An evaluation computes each of them at most once.
+    std::size_t nodes() const;
+
+    /// @brief Evaluate all expressions for variables given by slot
+    ///
+    /// @param[in]  values   array of at least variables().size() values
+    /// @param[out] results  array of size() values, the result of
+    ///                      every expression in the given order
+    /// @throw various exceptions derived from matheval::exception, the
+    ///        exception of the first expression which fails; the
+    ///        contents of @p results are unspecified in that case
+    void evaluate(double const *values, double *results) const;
+
+    /// @brief Evaluate all expressions for variables given by slot
+    ///
+    /// @param[in] values  the values indexed by slot
+    /// @return the result of every expression
+    /// @throw matheval::invalid_argument if there are fewer values
+    ///        than variables
+    /// @throw various exceptions derived from matheval::exception
+    std::vector<double> evaluate(std::vector<double> const &values) const;
+
+    /// @brief Evaluate all expressions for a given symbol table
+    ///
+    /// @param[in] st    the symbol table for variable lookup.
+    /// @return the result of every expression
+    /// @throw various exceptions derived from matheval::exception
+    std::vector<double> evaluate(std::map<std::string, double> const &st) const
+    {
+        std::vector<double> values;
+        for (std::string const &var : variables()) {
+            auto it = st.find(var);
+            if (it == st.end()) {
+                throw matheval::invalid_argument("Unknown variable " + var); // NOLINT
+            }
+            values.push_back(it->second);
+        }
+        return evaluate(values);
+    }
+};
+
+/// @brief A bounded cache of compiled expressions
+///
+/// The cache maps expression strings to compiled expressions and
+/// evicts the least recently used entries when it is full.  It is
+/// split into shards by the hash of the expression, each with its own
+/// lock and its own share of the capacity, so that concurrent lookups
+/// of different expressions rarely wait for each other.  Expressions
+/// are parsed outside of the locks.
+class ExpressionCache {
+    class impl;
+    std::unique_ptr<impl> pimpl;
+
+public:
+    /// @brief Counters of the cache
+    struct statistics {
+        std::uint64_t hits;   ///< lookups which found the expression
+        std::uint64_t misses; ///< lookups which had to parse it
+        std::size_t size;     ///< number of cached expressions
+    };
+
+    /// @brief Constructor
+    ///
+    /// Every shard holds an equal share of the capacity, rounded up.
+    /// Small caches use fewer shards, so that every shard can hold at
+    /// least 8 expressions.
+    ///
+    /// @param[in] capacity  maximum number of expressions, 0 disables
+    ///                      the cache
+    /// @param[in] shards    number of independently locked shards
+    explicit ExpressionCache(std::size_t capacity, std::size_t shards = 16);
+
+    /// @brief Destructor
+    ~ExpressionCache();
+
+    /// @brief Get the compiled expression, parsing it on a miss
+    ///
+    /// If the capacity is 0, the expression is parsed but not stored.
+    ///
+    /// @throw matheval::parse_error if the expression cannot be parsed
+    CompiledExpression get(std::string const &expr);
+
+    /// @brief The maximum number of expressions
+    std::size_t capacity() const;
+
+    /// @brief Change the capacity, evicting entries if it shrinks
+    void set_capacity(std::size_t capacity);
+
+    /// @brief Remove all entries and reset the counters
+    void clear();
+
+    /// @brief Current counters
+    statistics stats() const;
+
+    /// @brief The cache used by the convenience functions parse()
+    ///
+    /// Its capacity is 0 until it is enabled with set_capacity().
+    static ExpressionCache &shared();
+};
+
+/// @brief The expressions of a file or buffer, see load_expressions()
+///        and load_expression_file()
+struct LoadedExpressions {
+    /// @brief An entry which could not be parsed
+    struct error {
+        std::size_t entry;  ///< index of the entry, counting from 0
+        std::size_t offset; ///< byte offset of the entry in the input
+        /// Why it failed; the offset is relative to the entry
+        parse_diagnostic diagnostic;
+    };
+
+    /// The expressions which could be parsed, in the order of the input
+    std::vector<CompiledExpression> expressions;
+    /// The index of the entry of every expression
+    std::vector<std::size_t> entries;
+    /// The entries which could not be parsed, in the order of the input
+    std::vector<error> errors;
+};
+
+/// @brief Parse and compile every entry of the @p size characters at
+///        @p data in parallel
+///
+/// The entries are separated by @p delimiter, e.g. one expression per
+/// line.  Entries which contain nothing but white space are skipped
+/// without an error, but are still counted, so that the index of an
+/// entry is its line number minus one.  Every expression is optimized
+/// before it is compiled.  The entries are parsed in place by one
+/// matheval::Parser per thread of @p executor.
+///
+/// @throw exceptions other than matheval::parse_error
+LoadedExpressions load_expressions(char const *data, std::size_t size,
+                                   char delimiter = '\n',
+                                   Executor &executor = ThreadPool::shared());
+
+/// @brief Parse and compile every entry of the file @p path in parallel
+///
+/// The file is mapped into memory where the platform supports it and
+/// read otherwise, then parsed like load_expressions(char const *,
+/// std::size_t, char, Executor &).
+///
+/// @throw matheval::exception if the file cannot be read
+/// @throw exceptions other than matheval::parse_error
+LoadedExpressions
+load_expression_file(std::string const &path, char delimiter = '\n',
+                     Executor &executor = ThreadPool::shared());
+
 /// @brief Convenience function
 ///
 /// This function builds the grammar, parses the iterator to an AST,
-/// evaluates it, and returns the result.
+/// evaluates it, and returns the result.  If ExpressionCache::shared()
+/// has been enabled, recurring expressions are taken from the cache
+/// and not parsed again.
 ///
 /// @param[in] expr  mathematical expression
 /// @param[in] fn    the callback function for variable lookup, can be NULL.
@@ -95,6 +905,10 @@ public:
 /// @throw exceptions derived from std::exception
 inline double parse(std::string const &expr,
 		    Parser::variable_callback_fn fn = nullptr) {
+    ExpressionCache &cache = ExpressionCache::shared();
+    if (cache.capacity() != 0) {
+        return cache.get(expr).evaluate(fn);
+    }
     Parser parser;
     parser.parse(expr);
     return parser.evaluate(fn);
@@ -103,7 +917,9 @@ inline double parse(std::string const &expr,
 /// @brief Convenience function
 ///
 /// This function builds the grammar, parses the iterator to an AST,
-/// evaluates it, and returns the result.
+/// evaluates it, and returns the result.  If ExpressionCache::shared()
+/// has been enabled, recurring expressions are taken from the cache
+/// and not parsed again.
 ///
 /// @param[in] expr  mathematical expression
 /// @param[in] st    symbol table for variable lookups.
@@ -112,15 +928,74 @@ inline double parse(std::string const &expr,
 inline double parse(std::string const &expr,
 		    std::map<std::string,double> const &st)
 {
+    ExpressionCache &cache = ExpressionCache::shared();
+    if (cache.capacity() != 0) {
+        return cache.get(expr).evaluate(st);
+    }
     Parser parser;
     parser.parse(expr);
     return parser.evaluate(st);
 }
 
+/// @brief Convenience function for an expression which is not a
+///        std::string
+///
+/// Like parse(std::string const &, Parser::variable_callback_fn), but
+/// the expression is the first @p size characters of @p expr.  They
+/// are only copied if ExpressionCache::shared() has been enabled,
+/// because the cache keeps the expression.
+///
+/// @param[in] expr  mathematical expression
+/// @param[in] size  number of characters of the expression
+/// @param[in] fn    the callback function for variable lookup, can be NULL.
+/// @throw various exceptions derived from matheval::exception
+/// @throw exceptions derived from std::exception
+inline double parse(char const *expr, std::size_t size,
+                    Parser::variable_callback_fn fn = nullptr) {
+    ExpressionCache &cache = ExpressionCache::shared();
+    if (cache.capacity() != 0) {
+        return cache.get(std::string(expr, size)).evaluate(fn);
+    }
+    Parser parser;
+    parser.parse(expr, size);
+    return parser.evaluate(fn);
+}
+
+/// @brief Convenience function for an expression which is not a
+///        std::string
+///
+/// Like parse(std::string const &, std::map<std::string,double> const &),
+/// but the expression is the first @p size characters of @p expr.
+/// They are only copied if ExpressionCache::shared() has been enabled,
+/// because the cache keeps the expression.
+///
+/// @param[in] expr  mathematical expression
+/// @param[in] size  number of characters of the expression
+/// @param[in] st    symbol table for variable lookups.
+/// @throw various exceptions derived from matheval::exception
+/// @throw exceptions derived from std::exception
+inline double parse(char const *expr, std::size_t size,
+                    std::map<std::string, double> const &st) {
+    ExpressionCache &cache = ExpressionCache::shared();
+    if (cache.capacity() != 0) {
+        return cache.get(std::string(expr, size)).evaluate(st);
+    }
+    Parser parser;
+    parser.parse(expr, size);
+    return parser.evaluate(st);
+}
+
 class parse_error : public exception
 {
 public:
   explicit parse_error(const std::string& what_arg) : exception(what_arg) {}
+  explicit parse_error(parse_diagnostic const& d);
+
+  /// @brief Where parsing failed, empty if the error has no position
+  parse_diagnostic const& diagnostic() const { return diag; }
+
+private:
+  parse_diagnostic diag;
 };
 
 class divideByZero : public exception
@@ -0,0 +1,706 @@
+#pragma once
+
+#include "builtins.hpp"
+#include "matheval.hpp"
+
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#if __cplusplus < 201402L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+#error "static_expression.hpp requires C++14"
+#endif
+
+namespace matheval {
+
+/// @brief Parser for expressions which are known at compile time
+///
+/// The parser follows the grammar of the Spirit parsers rule by rule
+/// and looks up names in the same tables of builtins.hpp, but all of
+/// its functions are constexpr.  It produces the same post-order tree
+/// as the runtime parsers, in a fixed size array.
+namespace static_parser {
+
+enum class kind { constant, variable, unary, binary, ternary };
+
+/// @brief Why an expression could not be parsed
+enum class error {
+    none,
+    expected_operand, ///< no number, variable, function or '(' found
+    expected_open,    ///< a function name is not followed by '('
+    expected_comma,   ///< a function has too few arguments
+    expected_close,   ///< a '(' is not closed
+    unexpected,       ///< text is left after the expression
+};
+
+/// @brief A node of the tree, see ast::node
+struct node {
+    kind type = kind::constant;
+    std::size_t args[3] = {0, 0, 0};
+    double value = 0;
+    std::size_t slot = 0;
+    builtins::unary_fn unary = nullptr;
+    builtins::binary_fn binary = nullptr;
+    builtins::ternary_fn ternary = nullptr;
+};
+
+/// @brief The name of a variable as a slice of the source
+struct name {
+    std::size_t first = 0;
+    std::size_t length = 0;
+};
+
+/// @brief The result of parsing an expression of fewer than @p N
+///        characters
+///
+/// Every node consumes at least one character, so there are fewer
+/// than @p N nodes and variables.  On error the tree holds the nodes
+/// which were completed before the error.
+template <std::size_t N>
+struct tree {
+    node nodes[N];
+    std::size_t size = 0;
+    name variables[N];
+    std::size_t variable_count = 0;
+    error status = error::none;
+    std::size_t position = 0; ///< byte offset of the error
+};
+
+constexpr std::size_t length(char const *s) {
+    std::size_t n = 0;
+    while (s[n] != '\0') {
+        ++n;
+    }
+    return n;
+}
+
+/// @brief 10 to the power of @p e, like the table of Spirit
+///
+/// Powers up to 1e22 are exact, larger ones may differ from the
+/// correctly rounded value in the last bit.
+constexpr double pow10(int e) {
+    double p = 1;
+    while (e >= 22) {
+        p *= 1e22;
+        e -= 22;
+    }
+    double const exact[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                            1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                            1e16, 1e17, 1e18, 1e19, 1e20, 1e21};
+    return p * exact[e];
+}
+
+template <std::size_t N>
+class parser {
+public:
+    constexpr explicit parser(char const *s) : s(s) {}
+
+    constexpr tree<N> operator()() {
+        expression();
+        skip();
+        if (ok() && s[pos] != '\0') {
+            fail(error::unexpected);
+        }
+        return result;
+    }
+
+private:
+    // Rules, in the same order as parser_def.hpp
+
+    constexpr void expression() { logical(); }
+
+    constexpr void logical() {
+        equality();
+        builtins::binary_fn f = nullptr;
+        while (ok() && match(builtins::logical_operators, f)) {
+            equality();
+            binary(f);
+        }
+    }
+
+    constexpr void equality() {
+        relational();
+        builtins::binary_fn f = nullptr;
+        while (ok() && match(builtins::equality_operators, f)) {
+            relational();
+            binary(f);
+        }
+    }
+
+    constexpr void relational() {
+        additive();
+        builtins::binary_fn f = nullptr;
+        while (ok() && match(builtins::relational_operators, f)) {
+            additive();
+            binary(f);
+        }
+    }
+
+    constexpr void additive() {
+        multiplicative();
+        builtins::binary_fn f = nullptr;
+        while (ok() && match(builtins::additive_operators, f)) {
+            multiplicative();
+            binary(f);
+        }
+    }
+
+    constexpr void multiplicative() {
+        factor();
+        builtins::binary_fn f = nullptr;
+        while (ok() && match(builtins::multiplicative_operators, f)) {
+            factor();
+            binary(f);
+        }
+    }
+
+    constexpr void factor() {
+        primary();
+        builtins::binary_fn f = nullptr;
+        while (ok() && match(builtins::power_operators, f)) {
+            factor();
+            binary(f);
+        }
+    }
+
+    constexpr void primary() {
+        builtins::unary_fn u = nullptr;
+        builtins::binary_fn b = nullptr;
+        builtins::ternary_fn t = nullptr;
+        double c = 0;
+        skip();
+        if (number()) {
+            return;
+        }
+        if (s[pos] == '(') {
+            ++pos;
+            expression();
+            expect(')', error::expected_close);
+        } else if (match(builtins::unary_operators, u)) {
+            primary();
+            unary(u);
+        } else if (match(builtins::ternary_functions, t)) {
+            expect('(', error::expected_open);
+            expression();
+            expect(',', error::expected_comma);
+            expression();
+            expect(',', error::expected_comma);
+            expression();
+            expect(')', error::expected_close);
+            ternary(t);
+        } else if (match(builtins::binary_functions, b)) {
+            expect('(', error::expected_open);
+            expression();
+            expect(',', error::expected_comma);
+            expression();
+            expect(')', error::expected_close);
+            binary(b);
+        } else if (match(builtins::unary_functions, u)) {
+            expect('(', error::expected_open);
+            expression();
+            expect(')', error::expected_close);
+            unary(u);
+        } else if (match(builtins::constants, c)) {
+            constant(c);
+        } else if (alpha(s[pos])) {
+            variable();
+        } else {
+            fail(error::expected_operand);
+        }
+    }
+
+    /// @brief A number with the syntax of Spirit's double_
+    ///
+    /// @return false without consuming anything if there is none
+    constexpr bool number() {
+        std::size_t p = pos;
+        bool negative = false;
+        if (s[p] == '+' || s[p] == '-') {
+            negative = s[p] == '-';
+            ++p;
+        }
+
+        double n = 0;
+        bool digits = false;
+        while (digit(s[p])) {
+            n = n * 10 + (s[p++] - '0');
+            digits = true;
+        }
+
+        if (!digits) {
+            std::size_t const k = keyword(p, "nan");
+            std::size_t const i = keyword(p, "infinity") != 0
+                                      ? keyword(p, "infinity")
+                                      : keyword(p, "inf");
+            if (k != 0 || i != 0) {
+                double const v = k != 0
+                                     ? std::numeric_limits<double>::quiet_NaN()
+                                     : std::numeric_limits<double>::infinity();
+                pos = p + k + i;
+                constant(negative ? -v : v);
+                return true;
+            }
+        }
+
+        int exponent = 0;
+        if (s[p] == '.') {
+            std::size_t q = p + 1;
+            while (digit(s[q])) {
+                n = n * 10 + (s[q++] - '0');
+                --exponent;
+            }
+            if (!digits && q == p + 1) {
+                return false;
+            }
+            p = q;
+        } else if (!digits) {
+            return false;
+        }
+
+        if (s[p] == 'e' || s[p] == 'E') {
+            std::size_t q = p + 1;
+            bool const minus = s[q] == '-';
+            if (s[q] == '+' || s[q] == '-') {
+                ++q;
+            }
+            if (digit(s[q])) {
+                int e = 0;
+                while (digit(s[q])) {
+                    e = e < 100000 ? e * 10 + (s[q] - '0') : e;
+                    ++q;
+                }
+                exponent += minus ? -e : e;
+                p = q;
+            }
+        }
+
+        if (!scale(exponent, n)) {
+            return false;
+        }
+        pos = p;
+        constant(negative ? -n : n);
+        return true;
+    }
+
+    /// @brief Multiply @p n by 10 to the power of @p e like Spirit
+    ///
+    /// @return false if the exponent is out of range
+    static constexpr bool scale(int e, double &n) {
+        int const max_exp = std::numeric_limits<double>::max_exponent10;
+        int const min_exp = std::numeric_limits<double>::min_exponent10;
+        if (e >= 0) {
+            if (e > max_exp) {
+                return false;
+            }
+            // Overflowing to infinity is not a constant expression
+            if (n > std::numeric_limits<double>::max() / pow10(e)) {
+                return false;
+            }
+            n *= pow10(e);
+        } else if (e < min_exp) {
+            n /= pow10(-min_exp);
+            e += -min_exp;
+            if (e < min_exp) {
+                return false;
+            }
+            n /= pow10(-e);
+        } else {
+            n /= pow10(-e);
+        }
+        return true;
+    }
+
+    constexpr void variable() {
+        std::size_t const first = pos;
+        while (alpha(s[pos]) || digit(s[pos]) || s[pos] == '_') {
+            ++pos;
+        }
+        name const id{first, pos - first};
+        std::size_t slot = 0;
+        while (slot < result.variable_count &&
+               !same(result.variables[slot], id)) {
+            ++slot;
+        }
+        if (slot == result.variable_count) {
+            result.variables[result.variable_count++] = id;
+        }
+        node x;
+        x.type = kind::variable;
+        x.slot = slot;
+        push(x);
+    }
+
+    // Building the tree, like ast::builder
+
+    constexpr void constant(double value) {
+        node x;
+        x.value = value;
+        push(x);
+    }
+
+    constexpr void unary(builtins::unary_fn f) {
+        if (!ok()) {
+            return;
+        }
+        node x;
+        x.type = kind::unary;
+        x.unary = f;
+        x.args[0] = pop();
+        push(x);
+    }
+
+    constexpr void binary(builtins::binary_fn f) {
+        if (!ok()) {
+            return;
+        }
+        node x;
+        x.type = kind::binary;
+        x.binary = f;
+        x.args[1] = pop();
+        x.args[0] = pop();
+        push(x);
+    }
+
+    constexpr void ternary(builtins::ternary_fn f) {
+        if (!ok()) {
+            return;
+        }
+        node x;
+        x.type = kind::ternary;
+        x.ternary = f;
+        x.args[2] = pop();
+        x.args[1] = pop();
+        x.args[0] = pop();
+        push(x);
+    }
+
+    constexpr void push(node const &x) {
+        stack[depth++] = result.size;
+        result.nodes[result.size++] = x;
+    }
+
+    constexpr std::size_t pop() { return stack[--depth]; }
+
+    // Lexical helpers
+
+    constexpr bool ok() const { return result.status == error::none; }
+
+    constexpr void fail(error e) {
+        if (ok()) {
+            result.status = e;
+            result.position = pos;
+        }
+    }
+
+    static constexpr bool digit(char c) { return c >= '0' && c <= '9'; }
+
+    static constexpr bool alpha(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    static constexpr bool space(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\v' ||
+               c == '\f' || c == '\r';
+    }
+
+    constexpr void skip() {
+        while (space(s[pos])) {
+            ++pos;
+        }
+    }
+
+    constexpr void expect(char c, error e) {
+        if (!ok()) {
+            return;
+        }
+        skip();
+        if (s[pos] == c) {
+            ++pos;
+        } else {
+            fail(e);
+        }
+    }
+
+    /// Length of @p word if it starts at @p p, ignoring case
+    constexpr std::size_t keyword(std::size_t p, char const *word) const {
+        std::size_t i = 0;
+        for (; word[i] != '\0'; ++i) {
+            char c = s[p + i];
+            if (c >= 'A' && c <= 'Z') {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+            if (c != word[i]) {
+                return 0;
+            }
+        }
+        return i;
+    }
+
+    /// Length of @p word if it starts at the current position
+    constexpr std::size_t prefix(char const *word) const {
+        std::size_t i = 0;
+        for (; word[i] != '\0'; ++i) {
+            if (s[pos + i] != word[i]) {
+                return 0;
+            }
+        }
+        return i;
+    }
+
+    /// @brief The longest entry of @p table at the current position,
+    ///        like x3::symbols
+    template <typename T, std::size_t M>
+    constexpr bool match(builtins::symbol<T> const (&table)[M], T &value) {
+        skip();
+        std::size_t longest = 0;
+        for (std::size_t k = 0; k < M; ++k) {
+            std::size_t const n = prefix(table[k].name);
+            if (n > longest) {
+                longest = n;
+                value = table[k].value;
+            }
+        }
+        pos += longest;
+        return longest != 0;
+    }
+
+    constexpr bool same(name const &a, name const &b) const {
+        if (a.length != b.length) {
+            return false;
+        }
+        for (std::size_t i = 0; i < a.length; ++i) {
+            if (s[a.first + i] != s[b.first + i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    char const *s;
+    std::size_t pos = 0;
+    tree<N> result{};
+    std::size_t stack[N] = {};
+    std::size_t depth = 0;
+};
+
+/// @brief Parse @p s, which must be shorter than @p N characters
+template <std::size_t N>
+constexpr tree<N> parse(char const *s) {
+    return parser<N>(s)();
+}
+
+/// @brief The tree of the expression returned by @c Source::str()
+template <typename Source>
+struct parsed {
+    static constexpr std::size_t capacity = length(Source::str()) + 1;
+    static constexpr tree<capacity> value = parse<capacity>(Source::str());
+};
+
+template <typename Source>
+constexpr std::size_t parsed<Source>::capacity;
+
+template <typename Source>
+constexpr tree<parsed<Source>::capacity> parsed<Source>::value;
+
+/// @brief Code for the node @p I of an expression
+///
+/// Every node becomes a function of its own, whose function pointer
+/// and constants are compile-time constants, so the whole expression
+/// is inlined into straight-line code.  Arguments are evaluated from
+/// left to right like in the runtime evaluators, and conditionals
+/// skip the operands which do not decide the result, so that the
+/// first error is the same.
+template <typename Source, std::size_t I,
+          kind K = parsed<Source>::value.nodes[I].type>
+struct code;
+
+template <typename Source, std::size_t I>
+struct code<Source, I, kind::constant> {
+    static double apply(double const *) {
+        constexpr double value = parsed<Source>::value.nodes[I].value;
+        return value;
+    }
+};
+
+template <typename Source, std::size_t I>
+struct code<Source, I, kind::variable> {
+    static double apply(double const *values) {
+        constexpr std::size_t slot = parsed<Source>::value.nodes[I].slot;
+        return values[slot];
+    }
+};
+
+template <typename Source, std::size_t I>
+struct code<Source, I, kind::unary> {
+    static constexpr node const &x = parsed<Source>::value.nodes[I];
+
+    static double apply(double const *values) {
+        constexpr builtins::unary_fn f = x.unary;
+        return f(code<Source, x.args[0]>::apply(values));
+    }
+};
+
+template <typename Source, std::size_t I>
+constexpr node const &code<Source, I, kind::unary>::x;
+
+template <typename Source, std::size_t I>
+struct code<Source, I, kind::binary> {
+    static constexpr node const &x = parsed<Source>::value.nodes[I];
+
+    static double apply(double const *values) {
+        constexpr builtins::binary_fn f = x.binary;
+        double const a = code<Source, x.args[0]>::apply(values);
+        if (f == static_cast<builtins::binary_fn>(&math::logical_and)) {
+            return a != 0 && code<Source, x.args[1]>::apply(values) != 0;
+        }
+        if (f == static_cast<builtins::binary_fn>(&math::logical_or)) {
+            return a != 0 || code<Source, x.args[1]>::apply(values) != 0;
+        }
+        double const b = code<Source, x.args[1]>::apply(values);
+        return f(a, b);
+    }
+};
+
+template <typename Source, std::size_t I>
+constexpr node const &code<Source, I, kind::binary>::x;
+
+template <typename Source, std::size_t I>
+struct code<Source, I, kind::ternary> {
+    static constexpr node const &x = parsed<Source>::value.nodes[I];
+
+    static double apply(double const *values) {
+        constexpr builtins::ternary_fn f = x.ternary;
+        double const a = code<Source, x.args[0]>::apply(values);
+        if (f == static_cast<builtins::ternary_fn>(&math::ifelse)) {
+            return a != 0 ? code<Source, x.args[1]>::apply(values)
+                          : code<Source, x.args[2]>::apply(values);
+        }
+        double const b = code<Source, x.args[1]>::apply(values);
+        double const c = code<Source, x.args[2]>::apply(values);
+        return f(a, b, c);
+    }
+};
+
+template <typename Source, std::size_t I>
+constexpr node const &code<Source, I, kind::ternary>::x;
+
+/// @brief Reports a parse error as a static assertion
+///
+/// The byte offset of the error is a template argument, so that it
+/// shows up in the instantiation notes of the compiler.
+template <error E, std::size_t Offset>
+struct diagnose {
+    static_assert(E != error::expected_operand,
+                  "matheval: expected a number, variable, function or '('");
+    static_assert(E != error::expected_open,
+                  "matheval: expected '(' after the function name");
+    static_assert(E != error::expected_comma,
+                  "matheval: expected ',' between function arguments");
+    static_assert(E != error::expected_close, "matheval: expected ')'");
+    static_assert(E != error::unexpected,
+                  "matheval: unexpected text after the expression");
+    static constexpr bool value = E == error::none;
+};
+
+} // namespace static_parser
+
+/// @brief An expression which is parsed at compile time
+///
+/// Use MATHEVAL_STATIC_EXPRESSION to create one from a string
+/// literal.  The expression is parsed during compilation by the
+/// constexpr parser of namespace static_parser, which accepts the
+/// same grammar and uses the same functions as Parser, and its tree
+/// becomes a type whose evaluation the compiler can inline, so that
+/// @c x*x + 2*x + 1 compiles to the same code as the handwritten C++.
+/// Syntax errors are reported as static assertions.  Domain errors
+/// throw the same exceptions as Parser::evaluate().
+///
+/// The variables are numbered in the order of their first appearance,
+/// like Parser::variables().
+///
+/// @tparam Source  a class whose static constexpr member function
+///                 @c str() returns the expression
+template <typename Source>
+class StaticExpression {
+    using tree = static_parser::parsed<Source>;
+
+    static_assert(static_parser::diagnose<tree::value.status,
+                                          tree::value.position>::value,
+                  "matheval: the expression cannot be parsed");
+
+    static constexpr std::size_t root =
+        tree::value.size == 0 ? 0 : tree::value.size - 1;
+
+public:
+    /// @brief Number of variables
+    static constexpr std::size_t arity = tree::value.variable_count;
+
+    /// @brief Names of the variables in the order of their slots
+    static std::vector<std::string> variables() {
+        std::vector<std::string> names;
+        for (std::size_t i = 0; i < arity; ++i) {
+            static_parser::name const &id = tree::value.variables[i];
+            names.emplace_back(Source::str() + id.first, id.length);
+        }
+        return names;
+    }
+
+    /// @brief Evaluate the expression for variables given by slot
+    ///
+    /// @param[in] values  array of at least arity values
+    /// @throw various exceptions derived from matheval::exception
+    double evaluate(double const *values) const {
+        return static_parser::code<Source, root>::apply(values);
+    }
+
+    /// @brief Evaluate the expression for a given symbol table
+    ///
+    /// @throw matheval::invalid_argument if a variable is missing
+    /// @throw various exceptions derived from matheval::exception
+    double evaluate(std::map<std::string, double> const &st) const {
+        std::vector<double> values;
+        for (std::string const &var : variables()) {
+            auto it = st.find(var);
+            if (it == st.end()) {
+                throw matheval::invalid_argument("Unknown variable " + var); // NOLINT
+            }
+            values.push_back(it->second);
+        }
+        return evaluate(values.data());
+    }
+
+    /// @brief Evaluate the expression for the variables in the order
+    ///        of their slots
+    template <typename... Args>
+    double operator()(Args... args) const {
+        static_assert(sizeof...(Args) == arity,
+                      "matheval: expected one argument per variable");
+        double const values[] = {static_cast<double>(args)..., 0.0};
+        return evaluate(values);
+    }
+};
+
+template <typename Source>
+constexpr std::size_t StaticExpression<Source>::root;
+
+template <typename Source>
+constexpr std::size_t StaticExpression<Source>::arity;
+
+} // namespace matheval
+
+/// @brief Parse a string literal at compile time into a
+///        matheval::StaticExpression
+///
+/// @code
+/// auto const f = MATHEVAL_STATIC_EXPRESSION("x*x + 2*x + 1");
+/// double y = f(3.0); // 16
+/// @endcode
+#define MATHEVAL_STATIC_EXPRESSION(text)                                \
+    ([] {                                                               \
+        struct matheval_source {                                        \
+            static constexpr char const *str() { return text; }         \
+        };                                                              \
+        return ::matheval::StaticExpression<matheval_source>{};         \
+    }())
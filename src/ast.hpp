@@ -0,0 +1,228 @@
+#ifndef MATHEVAL_IMPLEMENTATION
+#error "Do not include ast.hpp directly!"
+#endif
+
+#pragma once
+
+#include "math.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace matheval {
+
+namespace ast {
+
+using unary_fn = double (*)(double);
+using binary_fn = double (*)(double, double);
+using ternary_fn = double (*)(double, double, double);
+
+enum class kind : std::uint8_t {
+    constant, ///< a number
+    variable, ///< a variable, looked up when evaluating
+    unary,    ///< a unary function of one child
+    binary,   ///< a binary function of two children
+    ternary,  ///< a ternary function of three children
+};
+
+/// @brief A node of the syntax tree
+///
+/// Children are referred to by their index in the tree, so that a
+/// node is only 24 bytes wide and holds no pointers to other nodes.
+struct node {
+    kind type;
+    std::uint32_t args[3];
+    union {
+        double value;
+        std::uint32_t slot; ///< index of the name in tree::variables
+        unary_fn unary;
+        binary_fn binary;
+        ternary_fn ternary;
+    };
+
+    node(double v) : type(kind::constant), args{0, 0, 0}, value(v) {}
+    node(std::uint32_t s)
+        : type(kind::variable), args{0, 0, 0}, value(0) {
+        slot = s;
+    }
+    node(unary_fn f, std::uint32_t a)
+        : type(kind::unary), args{a, 0, 0}, unary(f) {}
+    node(binary_fn f, std::uint32_t a, std::uint32_t b)
+        : type(kind::binary), args{a, b, 0}, binary(f) {}
+    node(ternary_fn f, std::uint32_t a, std::uint32_t b, std::uint32_t c)
+        : type(kind::ternary), args{a, b, c}, ternary(f) {}
+
+    /// Number of children
+    std::size_t arity() const {
+        return type < kind::unary ? 0 : static_cast<std::size_t>(type) - 1;
+    }
+};
+
+/// @brief Which children of a node are evaluated
+enum class control : std::uint8_t {
+    eager,       ///< all of them, from the first to the last
+    ifelse,      ///< the first, then the second if it is true, else the third
+    logical_and, ///< the first, then the second if the first is true
+    logical_or,  ///< the first, then the second if the first is false
+};
+
+/// @brief How the children of @p x are evaluated
+///
+/// Conditionals and logical operators short-circuit, so that the
+/// operands which do not decide the result are neither computed nor
+/// able to fail.  A NaN condition counts as true, like in C++.
+inline control flow(node const &x) {
+    if (x.type == kind::ternary &&
+        x.ternary == static_cast<ternary_fn>(&math::ifelse)) {
+        return control::ifelse;
+    }
+    if (x.type == kind::binary) {
+        if (x.binary == static_cast<binary_fn>(&math::logical_and)) {
+            return control::logical_and;
+        }
+        if (x.binary == static_cast<binary_fn>(&math::logical_or)) {
+            return control::logical_or;
+        }
+    }
+    return control::eager;
+}
+
+/// @brief Abstract syntax tree in one contiguous array
+///
+/// The nodes are stored in post-order, i.e. the children of a node
+/// immediately precede it, from the first to the last child, and the
+/// root is the last node.  Going through the nodes front to back
+/// therefore visits them in the same order as a depth-first walk of
+/// the tree, without following any links.
+///
+/// After ast::CommonSubexpressionEliminator a node may be the child
+/// of several nodes.  The children still come before their parents,
+/// but no longer immediately.
+struct tree {
+    std::vector<node> nodes;
+
+    /// Names of the variables in the order of their first appearance
+    std::vector<std::string> variables;
+
+    bool empty() const { return nodes.empty(); }
+
+    void clear() {
+        nodes.clear();
+        variables.clear();
+    }
+
+    /// @brief Index of the name in @c variables, which is appended
+    ///        if it is not there yet
+    ///
+    /// The name is only copied when it is appended.
+    std::uint32_t intern(char const *name, std::size_t size) {
+        auto it = std::find_if(variables.begin(), variables.end(),
+                               [&](std::string const &v) {
+                                   return v.size() == size &&
+                                          v.compare(0, size, name, size) == 0;
+                               });
+        if (it == variables.end()) {
+            variables.emplace_back(name, size);
+            return static_cast<std::uint32_t>(variables.size() - 1);
+        }
+        return static_cast<std::uint32_t>(it - variables.begin());
+    }
+
+    std::uint32_t intern(std::string const &name) {
+        return intern(name.data(), name.size());
+    }
+};
+
+/// @brief Several trees which share one array of nodes
+///
+/// The nodes are ordered like those of a DAG, i.e. children come
+/// before their parents, but every tree has its own root and a node
+/// may belong to several trees.  All trees use the same variable
+/// slots.
+struct forest {
+    /// The nodes and variables of all trees
+    tree shared;
+
+    /// Index of the root of every tree
+    std::vector<std::uint32_t> roots;
+
+    /// @brief Append the nodes of @p t as a new tree
+    ///
+    /// @throw matheval::invalid_argument if @p t is empty
+    void add(tree const &t) {
+        if (t.empty()) {
+            throw matheval::invalid_argument("operator nil called");
+        }
+        std::uint32_t const offset =
+            static_cast<std::uint32_t>(shared.nodes.size());
+        for (node x : t.nodes) {
+            if (x.type == kind::variable) {
+                x.slot = shared.intern(t.variables[x.slot]);
+            }
+            for (std::size_t k = 0; k < x.arity(); ++k) {
+                x.args[k] += offset;
+            }
+            shared.nodes.push_back(x);
+        }
+        roots.push_back(static_cast<std::uint32_t>(shared.nodes.size() - 1));
+    }
+};
+
+/// @brief Builds a tree from the callbacks of a parser
+///
+/// The parser reports every operand after its children, so the nodes
+/// are appended in post-order.  The indices of the finished subtrees
+/// are kept on a stack until their parent arrives.
+class builder {
+public:
+    /// @brief Start building into @p t, which is cleared but keeps
+    ///        its memory
+    explicit builder(tree &t) : t(t) { t.clear(); }
+
+    void constant(double value) { push(node{value}); }
+
+    /// @brief The variable named by the characters [@p first, @p last)
+    void variable(char const *first, char const *last) {
+        push(node{t.intern(first, static_cast<std::size_t>(last - first))});
+    }
+
+    void unary(unary_fn f) {
+        std::uint32_t a = pop();
+        push(node{f, a});
+    }
+
+    void binary(binary_fn f) {
+        std::uint32_t b = pop();
+        std::uint32_t a = pop();
+        push(node{f, a, b});
+    }
+
+    void ternary(ternary_fn f) {
+        std::uint32_t c = pop();
+        std::uint32_t b = pop();
+        std::uint32_t a = pop();
+        push(node{f, a, b, c});
+    }
+
+private:
+    void push(node const &n) {
+        stack.push_back(static_cast<std::uint32_t>(t.nodes.size()));
+        t.nodes.push_back(n);
+    }
+
+    std::uint32_t pop() {
+        std::uint32_t top = stack.back();
+        stack.pop_back();
+        return top;
+    }
+
+    tree &t;
+    std::vector<std::uint32_t> stack;
+};
+
+} // namespace ast
+
+} // namespace matheval
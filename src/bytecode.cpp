@@ -0,0 +1,739 @@
+#define MATHEVAL_IMPLEMENTATION
+
+#include "bytecode.hpp"
+#include "jit.hpp"
+#include "math.hpp"
+#include "ast.hpp"
+#include "matheval.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <utility>
+
+namespace matheval {
+
+namespace bytecode {
+
+namespace {
+
+// Compiler
+
+/// @brief Translates a tree into instructions
+///
+/// The nodes of a tree are in post-order, which is already the order
+/// of a stack machine.  A DAG is walked from the root in the same
+/// order; a node with several parents is computed at its first use
+/// and kept in a register for the later ones.  The operands of
+/// conditionals and logical operators are jumped over if they do not
+/// decide the result.
+class compiler {
+public:
+    explicit compiler(program &p) : prog(p) {}
+
+    void operator()(ast::tree const &t) {
+        if (t.empty()) {
+            throw matheval::invalid_argument("operator nil called");
+        }
+
+        std::vector<std::uint32_t> slots;
+        for (std::string const &var : t.variables) {
+            auto it = std::find(prog.variables.begin(), prog.variables.end(),
+                                var);
+            slots.push_back(static_cast<std::uint32_t>(
+                it - prog.variables.begin()));
+            if (it == prog.variables.end()) {
+                prog.variables.push_back(var);
+            }
+        }
+
+        std::vector<std::uint32_t> parents(t.nodes.size());
+        for (ast::node const &x : t.nodes) {
+            for (std::size_t k = 0; k < x.arity(); ++k) {
+                ++parents[x.args[k]];
+            }
+        }
+
+        // The register of every computed node with several parents.
+        // A register which is written in an operand of a conditional is
+        // only valid in that operand, because the operand may be skipped.
+        std::uint32_t const none = static_cast<std::uint32_t>(-1);
+        std::vector<std::uint32_t> reg(t.nodes.size(), none);
+        std::vector<std::uint32_t> written;
+        std::vector<std::size_t> scopes;
+
+        // Depth-first walk with an explicit stack of the nodes, the
+        // number of their children which have been emitted and the
+        // jump of a conditional whose target is not known yet
+        struct step {
+            std::uint32_t node;
+            std::size_t next;
+            std::size_t jump;
+        };
+        std::vector<step> walk;
+        walk.push_back(step{static_cast<std::uint32_t>(t.nodes.size() - 1),
+                            0, 0});
+        while (!walk.empty()) {
+            step &s = walk.back();
+            std::uint32_t const i = s.node;
+            ast::node const &x = t.nodes[i];
+            if (reg[i] != none) {
+                emit(instruction{opcode::load, reg[i]}, +1);
+                walk.pop_back();
+                continue;
+            }
+            ast::control const flow = ast::flow(x);
+            if (s.next < x.arity()) {
+                if (flow != ast::control::eager && s.next > 0) {
+                    // Leave the previous operand and enter the next one
+                    if (s.next == 2) {
+                        leave(reg, written, scopes);
+                        std::size_t const end = prog.code.size();
+                        emit(instruction{opcode::jump}, 0);
+                        patch(s.jump);
+                        s.jump = end;
+                    } else {
+                        s.jump = prog.code.size();
+                        emit(instruction{flow == ast::control::ifelse
+                                             ? opcode::jump_if_not
+                                         : flow == ast::control::logical_and
+                                             ? opcode::and_then
+                                             : opcode::or_else},
+                             -1);
+                    }
+                    scopes.push_back(written.size());
+                }
+                std::uint32_t const child = x.args[s.next++];
+                walk.push_back(step{child, 0, 0});
+                continue;
+            }
+            std::size_t const jump = s.jump;
+            walk.pop_back();
+            switch (x.type) {
+            case ast::kind::constant:
+                emit(instruction{x.value}, +1);
+                break;
+            case ast::kind::variable:
+                emit(instruction{slots[x.slot]}, +1);
+                break;
+            case ast::kind::unary:
+                unary(x.unary);
+                break;
+            case ast::kind::binary:
+                if (flow == ast::control::eager) {
+                    binary(x.binary);
+                    break;
+                }
+                leave(reg, written, scopes);
+                emit(instruction{opcode::boolean}, 0);
+                patch(jump);
+                break;
+            case ast::kind::ternary:
+                if (flow == ast::control::eager) {
+                    emit(instruction{x.ternary}, -2);
+                    break;
+                }
+                leave(reg, written, scopes);
+                patch(jump);
+                // The batch interpreter may keep the first operand on
+                // the stack while it computes the second one
+                --depth;
+                break;
+            }
+            // Leaves are cheaper to push again than to keep
+            if (parents[i] > 1 && x.arity() > 0) {
+                reg[i] = static_cast<std::uint32_t>(prog.registers++);
+                written.push_back(i);
+                emit(instruction{opcode::store, reg[i]}, 0);
+            }
+        }
+    }
+
+private:
+    void unary(double (*op)(double)) {
+        using unary_fn = double (*)(double);
+        if (op == static_cast<unary_fn>(&math::plus)) {
+            return;
+        }
+        if (op == static_cast<unary_fn>(&math::minus)) {
+            emit(instruction{opcode::negate}, 0);
+            return;
+        }
+        emit(instruction{op}, 0);
+    }
+
+    void binary(double (*op)(double, double)) {
+        using binary_fn = double (*)(double, double);
+        if (op == static_cast<binary_fn>(&math::plus)) {
+            emit(instruction{opcode::plus}, -1);
+        } else if (op == static_cast<binary_fn>(&math::minus)) {
+            emit(instruction{opcode::minus}, -1);
+        } else if (op == static_cast<binary_fn>(&math::multiplies)) {
+            emit(instruction{opcode::multiplies}, -1);
+        } else {
+            emit(instruction{op}, -1);
+        }
+    }
+
+    /// @brief Forget the registers written since the last scope began
+    static void leave(std::vector<std::uint32_t> &reg,
+                      std::vector<std::uint32_t> &written,
+                      std::vector<std::size_t> &scopes) {
+        while (written.size() > scopes.back()) {
+            reg[written.back()] = static_cast<std::uint32_t>(-1);
+            written.pop_back();
+        }
+        scopes.pop_back();
+    }
+
+    /// @brief Let the jump at @p at continue after the last instruction
+    void patch(std::size_t at) {
+        prog.code[at].slot = static_cast<std::uint32_t>(prog.code.size());
+    }
+
+    void emit(instruction const &i, int effect) {
+        prog.code.push_back(i);
+        depth += effect;
+        prog.stack_size = std::max(prog.stack_size, depth);
+    }
+
+    program &prog;
+    std::size_t depth = 0;
+};
+
+// Interpreter
+
+/// Programs which fit into this many stack entries do not allocate.
+constexpr std::size_t small_stack = 64;
+
+/// @brief Execute the program for a single row
+///
+/// If @p Throw is false, functions are called through their kernels
+/// with a single lane, which never throw and store the first error in
+/// @p err instead.
+template <bool Throw, typename Load>
+double execute(program const &p, Load const &load, math::error &err) {
+    double buffer[small_stack];
+    std::unique_ptr<double[]> heap;
+    double *sp = buffer;
+    if (p.stack_size + p.registers > small_stack) {
+        heap.reset(new double[p.stack_size + p.registers]);
+        sp = heap.get();
+    }
+    double *const regs = sp + p.stack_size;
+
+    // sp always points one past the top of the stack
+    std::size_t pc = 0;
+    while (pc < p.code.size()) {
+        std::size_t const at = pc++;
+        instruction const &i = p.code[at];
+        switch (i.code) {
+        case opcode::constant:
+            *sp++ = i.value;
+            break;
+        case opcode::variable:
+            *sp++ = load(i.slot);
+            break;
+        case opcode::plus:
+            --sp;
+            sp[-1] = sp[-1] + sp[0];
+            break;
+        case opcode::minus:
+            --sp;
+            sp[-1] = sp[-1] - sp[0];
+            break;
+        case opcode::multiplies:
+            --sp;
+            sp[-1] = sp[-1] * sp[0];
+            break;
+        case opcode::negate:
+            sp[-1] = -sp[-1];
+            break;
+        case opcode::call1:
+            if (!Throw && p.kernels[at].unary) {
+                p.kernels[at].unary(1, sp - 1, &err);
+            } else {
+                sp[-1] = i.unary(sp[-1]);
+            }
+            break;
+        case opcode::call2:
+            --sp;
+            if (!Throw && p.kernels[at].binary) {
+                p.kernels[at].binary(1, sp - 1, sp, &err);
+            } else {
+                sp[-1] = i.binary(sp[-1], sp[0]);
+            }
+            break;
+        case opcode::call3:
+            sp -= 2;
+            if (!Throw && p.kernels[at].ternary) {
+                p.kernels[at].ternary(1, sp - 1, sp, sp + 1, &err);
+            } else {
+                sp[-1] = i.ternary(sp[-1], sp[0], sp[1]);
+            }
+            break;
+        case opcode::store:
+            regs[i.slot] = sp[-1];
+            break;
+        case opcode::load:
+            *sp++ = regs[i.slot];
+            break;
+        case opcode::jump:
+            pc = i.slot;
+            break;
+        case opcode::jump_if_not:
+            if (*--sp == 0) {
+                pc = i.slot;
+            }
+            break;
+        case opcode::and_then:
+            if (sp[-1] == 0) {
+                sp[-1] = 0;
+                pc = i.slot;
+            } else {
+                --sp;
+            }
+            break;
+        case opcode::or_else:
+            if (sp[-1] != 0) {
+                sp[-1] = 1;
+                pc = i.slot;
+            } else {
+                --sp;
+            }
+            break;
+        case opcode::boolean:
+            sp[-1] = sp[-1] != 0;
+            break;
+        }
+    }
+    return sp[-1];
+}
+
+/// @brief A conditional on which the rows of a block disagree
+///
+/// Both operands are computed for all rows, one after the other, and
+/// merged where they meet.  The rows which skip an operand get back
+/// the errors they had before it.
+struct divergence {
+    /// The jump between the operands of ifelse, or none for the
+    /// single operand of && and ||
+    std::size_t middle;
+    /// Where the operands meet
+    std::size_t join;
+    /// Result of && and || for the rows which skip the operand
+    double otherwise;
+    /// Rows which take the first operand of ifelse or which need the
+    /// operand of && and ||
+    bool taken[block_size];
+    math::error before[block_size]; ///< errors before the first operand
+    math::error after[block_size];  ///< errors after the first operand
+};
+
+constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+/// @brief Combine the operands of a divergent conditional
+///
+/// @return the new top of the stack
+double *merge(divergence const &d, std::size_t n, double *sp,
+              math::error *err) {
+    if (d.middle == none) {
+        double *x = sp - block_size;
+        for (std::size_t r = 0; r < n; ++r) {
+            if (!d.taken[r]) {
+                x[r] = d.otherwise;
+                err[r] = d.before[r];
+            }
+        }
+        return sp;
+    }
+    sp -= block_size;
+    double *x = sp - block_size;
+    double const *y = sp;
+    for (std::size_t r = 0; r < n; ++r) {
+        if (!d.taken[r]) {
+            x[r] = y[r];
+        } else {
+            err[r] = d.after[r];
+        }
+    }
+    return sp;
+}
+
+/// @brief Execute the program for the rows [first, first + n)
+///
+/// The kernels never throw.  A failing row is NaN and its error is
+/// stored in @p err, which must be cleared by the caller.
+///
+/// @return the block of results
+double const *execute(program const &p, std::size_t first, std::size_t n,
+                      double const *const *columns, double *stack,
+                      math::error *err, std::vector<divergence> &frames) {
+    double *sp = stack;
+    double *const regs = stack + p.stack_size * block_size;
+    std::size_t pc = 0;
+    for (;;) {
+        while (!frames.empty() && frames.back().join == pc) {
+            sp = merge(frames.back(), n, sp, err);
+            frames.pop_back();
+        }
+        if (pc == p.code.size()) {
+            break;
+        }
+        std::size_t const at = pc++;
+        instruction const &i = p.code[at];
+        kernel const &k = p.kernels[at];
+        switch (i.code) {
+        case opcode::constant:
+            std::fill(sp, sp + n, i.value);
+            sp += block_size;
+            break;
+        case opcode::variable:
+            std::copy(columns[i.slot] + first, columns[i.slot] + first + n,
+                      sp);
+            sp += block_size;
+            break;
+        case opcode::negate:
+        case opcode::call1: {
+            double *x = sp - block_size;
+            if (k.unary) {
+                k.unary(n, x, err);
+            } else {
+                for (std::size_t r = 0; r < n; ++r) {
+                    x[r] = i.unary(x[r]);
+                }
+            }
+            break;
+        }
+        case opcode::plus:
+        case opcode::minus:
+        case opcode::multiplies:
+        case opcode::call2: {
+            sp -= block_size;
+            double *x = sp - block_size;
+            double const *y = sp;
+            if (k.binary) {
+                k.binary(n, x, y, err);
+            } else {
+                for (std::size_t r = 0; r < n; ++r) {
+                    x[r] = i.binary(x[r], y[r]);
+                }
+            }
+            break;
+        }
+        case opcode::call3: {
+            sp -= 2 * block_size;
+            double *x = sp - block_size;
+            double const *y = sp;
+            double const *z = sp + block_size;
+            if (k.ternary) {
+                k.ternary(n, x, y, z, err);
+            } else {
+                for (std::size_t r = 0; r < n; ++r) {
+                    x[r] = i.ternary(x[r], y[r], z[r]);
+                }
+            }
+            break;
+        }
+        case opcode::store:
+            std::copy(sp - block_size, sp - block_size + n,
+                      regs + i.slot * block_size);
+            break;
+        case opcode::load:
+            std::copy(regs + i.slot * block_size,
+                      regs + i.slot * block_size + n, sp);
+            sp += block_size;
+            break;
+        case opcode::jump:
+            if (!frames.empty() && frames.back().middle == at) {
+                // The second operand starts from the errors before the
+                // first one
+                divergence &d = frames.back();
+                std::copy(err, err + n, d.after);
+                std::copy(d.before, d.before + n, err);
+            } else {
+                pc = i.slot;
+            }
+            break;
+        case opcode::jump_if_not: {
+            sp -= block_size;
+            std::size_t const taken = static_cast<std::size_t>(std::count_if(
+                sp, sp + n, [](double c) { return c != 0; }));
+            if (taken == 0) {
+                pc = i.slot;
+            } else if (taken < n) {
+                frames.emplace_back();
+                divergence &d = frames.back();
+                d.middle = i.slot - 1;
+                d.join = p.code[d.middle].slot;
+                for (std::size_t r = 0; r < n; ++r) {
+                    d.taken[r] = sp[r] != 0;
+                }
+                std::copy(err, err + n, d.before);
+            }
+            break;
+        }
+        case opcode::and_then:
+        case opcode::or_else: {
+            // The operand is needed by the rows which do not decide
+            double *x = sp - block_size;
+            bool const conjunction = i.code == opcode::and_then;
+            std::size_t const needed = static_cast<std::size_t>(
+                std::count_if(x, x + n, [conjunction](double c) {
+                    return conjunction ? c != 0 : c == 0;
+                }));
+            if (needed == 0) {
+                std::fill(x, x + n, conjunction ? 0.0 : 1.0);
+                pc = i.slot;
+                break;
+            }
+            if (needed < n) {
+                frames.emplace_back();
+                divergence &d = frames.back();
+                d.middle = none;
+                d.join = i.slot;
+                d.otherwise = conjunction ? 0 : 1;
+                for (std::size_t r = 0; r < n; ++r) {
+                    d.taken[r] = conjunction ? x[r] != 0 : x[r] == 0;
+                }
+                std::copy(err, err + n, d.before);
+            }
+            sp -= block_size;
+            break;
+        }
+        case opcode::boolean: {
+            double *x = sp - block_size;
+            for (std::size_t r = 0; r < n; ++r) {
+                x[r] = x[r] != 0;
+            }
+            break;
+        }
+        }
+    }
+    return sp - block_size;
+}
+
+// Kernels
+
+// The opcodes of the inline operations always find their kernel.
+// Calls to functions which are not in the registry have none and
+// are executed one row at a time.
+
+using unary_fn = double (*)(double);
+using binary_fn = double (*)(double, double);
+
+kernel select(instruction const &i) {
+    kernel k;
+    k.unary = nullptr;
+    switch (i.code) {
+    case opcode::constant:
+    case opcode::variable:
+    case opcode::store:
+    case opcode::load:
+    case opcode::jump:
+    case opcode::jump_if_not:
+    case opcode::and_then:
+    case opcode::or_else:
+    case opcode::boolean:
+        break;
+    case opcode::plus:
+        k.binary = simd::find(static_cast<binary_fn>(&math::plus));
+        break;
+    case opcode::minus:
+        k.binary = simd::find(static_cast<binary_fn>(&math::minus));
+        break;
+    case opcode::multiplies:
+        k.binary = simd::find(static_cast<binary_fn>(&math::multiplies));
+        break;
+    case opcode::negate:
+        k.unary = simd::find(static_cast<unary_fn>(&math::minus));
+        break;
+    case opcode::call1:
+        k.unary = simd::find(i.unary);
+        break;
+    case opcode::call2:
+        k.binary = simd::find(i.binary);
+        break;
+    case opcode::call3:
+        k.ternary = simd::find(i.ternary);
+        break;
+    }
+    return k;
+}
+
+/// @brief Throw the exception of a failing row
+///
+/// The row is evaluated on its own by the scalar interpreter, which
+/// throws exactly the same exception as the row-wise evaluation.
+[[noreturn]] void raise_row(program const &p, double const *const *columns,
+                            std::size_t row) {
+    std::vector<double> values(p.variables.size());
+    for (std::size_t v = 0; v < values.size(); ++v) {
+        values[v] = columns[v][row];
+    }
+    p.run(values.data());
+    math::error err;
+    p.run(values.data(), err);
+    math::raise(err, std::numeric_limits<double>::quiet_NaN());
+}
+
+/// Bytes of input and output that one chunk of rows may occupy
+constexpr std::size_t chunk_bytes = 256 * 1024;
+
+} // namespace
+
+double program::run(variable_callback_fn const &fn) const {
+    math::error err = math::error::none;
+    return execute<true>(*this, [this, &fn](std::uint32_t slot) {
+        if (!fn) {
+            throw matheval::invalid_argument("Missing callback function to look up variable " + variables[slot]); // NOLINT
+        }
+        return fn(variables[slot]);
+    }, err);
+}
+
+double program::run(double const *values) const {
+    math::error err = math::error::none;
+    if (native) {
+        double res = (*native)(values, err);
+        if (err == math::error::none) {
+            return res;
+        }
+        // The interpreter throws the exception of the first error
+    }
+    return execute<true>(*this, [values](std::uint32_t slot) {
+        return values[slot];
+    }, err);
+}
+
+double program::run(double const *values, math::error &err) const {
+    err = math::error::none;
+    double res = native ? (*native)(values, err)
+                        : execute<false>(*this, [values](std::uint32_t slot) {
+                              return values[slot];
+                          }, err);
+    if (err != math::error::none) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return res;
+}
+
+void program::run(std::size_t rows, double const *const *columns,
+                  double *results) const {
+    // The stack and the registers hold one block per entry
+    std::vector<double> stack((stack_size + registers) * block_size);
+    math::error err[block_size];
+    std::vector<divergence> frames;
+
+    for (std::size_t first = 0; first < rows; first += block_size) {
+        std::size_t const n = std::min(block_size, rows - first);
+        std::fill(err, err + n, math::error::none);
+        double const *res =
+            execute(*this, first, n, columns, stack.data(), err, frames);
+
+        for (std::size_t r = 0; r < n; ++r) {
+            if (err[r] != math::error::none) {
+                raise_row(*this, columns, first + r);
+            }
+        }
+
+        std::copy(res, res + n, results + first);
+    }
+}
+
+void program::run(std::size_t rows, double const *const *columns,
+                  double *results, math::error *errors) const {
+    std::vector<double> stack((stack_size + registers) * block_size);
+    std::vector<divergence> frames;
+
+    for (std::size_t first = 0; first < rows; first += block_size) {
+        std::size_t const n = std::min(block_size, rows - first);
+        math::error *err = errors + first;
+        std::fill(err, err + n, math::error::none);
+        double const *res =
+            execute(*this, first, n, columns, stack.data(), err, frames);
+        for (std::size_t r = 0; r < n; ++r) {
+            results[first + r] = err[r] == math::error::none
+                                     ? res[r]
+                                     : std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+}
+
+std::size_t program::chunk_rows() const {
+    std::size_t const row_bytes =
+        (variables.size() + 1) * sizeof(double) + sizeof(math::error);
+    return std::max(block_size, chunk_bytes / row_bytes / block_size * block_size);
+}
+
+void program::run(Executor &executor, std::size_t rows,
+                  double const *const *columns, double *results) const {
+    std::size_t const chunk = chunk_rows();
+    std::size_t const tasks = (rows + chunk - 1) / chunk;
+
+    // The lowest failing row found so far, rows if there is none
+    std::atomic<std::size_t> failed{rows};
+
+    executor.parallel_for(tasks, [&](std::size_t t) {
+        std::size_t const first = t * chunk;
+        // Rows after a failing row need not be evaluated
+        if (first >= failed.load()) {
+            return;
+        }
+        std::size_t const n = std::min(chunk, rows - first);
+        std::vector<double const *> shifted(variables.size());
+        for (std::size_t v = 0; v < shifted.size(); ++v) {
+            shifted[v] = columns[v] + first;
+        }
+        std::vector<math::error> err(n);
+        run(n, shifted.data(), results + first, err.data());
+        auto it = std::find_if(err.begin(), err.end(), [](math::error e) {
+            return e != math::error::none;
+        });
+        if (it != err.end()) {
+            std::size_t row = first + (it - err.begin());
+            std::size_t current = failed.load();
+            while (row < current &&
+                   !failed.compare_exchange_weak(current, row)) {
+            }
+        }
+    });
+
+    if (failed < rows) {
+        raise_row(*this, columns, failed);
+    }
+}
+
+void program::run(Executor &executor, std::size_t rows,
+                  double const *const *columns, double *results,
+                  math::error *errors) const {
+    std::size_t const chunk = chunk_rows();
+    std::size_t const tasks = (rows + chunk - 1) / chunk;
+
+    executor.parallel_for(tasks, [&](std::size_t t) {
+        std::size_t const first = t * chunk;
+        std::size_t const n = std::min(chunk, rows - first);
+        std::vector<double const *> shifted(variables.size());
+        for (std::size_t v = 0; v < shifted.size(); ++v) {
+            shifted[v] = columns[v] + first;
+        }
+        run(n, shifted.data(), results + first, errors + first);
+    });
+}
+
+program compile(ast::tree const &ast,
+                std::vector<std::string> const &variables) {
+    program p;
+    p.variables = variables;
+    compiler{p}(ast);
+    p.kernels.reserve(p.code.size());
+    for (instruction const &i : p.code) {
+        p.kernels.push_back(select(i));
+    }
+    return p;
+}
+
+} // namespace bytecode
+
+} // namespace matheval
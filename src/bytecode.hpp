@@ -0,0 +1,188 @@
+#ifndef MATHEVAL_IMPLEMENTATION
+#error "Do not include bytecode.hpp directly!"
+#endif
+
+#pragma once
+
+#include "ast.hpp"
+#include "simd.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace matheval {
+
+namespace jit {
+class function;
+} // namespace jit
+
+namespace bytecode {
+
+/// @brief Operation codes of the stack machine
+///
+/// The most frequent arithmetic operations get their own opcode so
+/// that the interpreter can execute them inline instead of calling
+/// through a function pointer.
+enum class opcode : std::uint8_t {
+    constant,    ///< push an immediate value
+    variable,    ///< push the value of a variable
+    plus,        ///< x + y
+    minus,       ///< x - y
+    multiplies,  ///< x * y
+    negate,      ///< -x
+    call1,       ///< call a unary function
+    call2,       ///< call a binary function
+    call3,       ///< call a ternary function
+    store,       ///< copy the top of the stack into a register
+    load,        ///< push the value of a register
+    jump,        ///< continue at the instruction in the slot
+    jump_if_not, ///< pop the top and jump if it is false
+    and_then,    ///< jump with 0 if the top is false, else pop it
+    or_else,     ///< jump with 1 if the top is true, else pop it
+    boolean,     ///< replace the top by 1 if it is true, else by 0
+};
+
+/// @brief A single instruction of the stack machine
+///
+/// Instructions are 16 bytes wide so that a whole program is a
+/// contiguous array which can be streamed through the cache.
+struct instruction {
+    opcode code;
+    std::uint32_t slot; ///< of a variable, a register or a jump target
+    union {
+        double value;
+        double (*unary)(double);
+        double (*binary)(double, double);
+        double (*ternary)(double, double, double);
+    };
+
+    instruction(opcode c) : code(c), slot(0), value(0) {}
+    instruction(double v) : code(opcode::constant), slot(0), value(v) {}
+    instruction(std::uint32_t s) : code(opcode::variable), slot(s), value(0) {}
+    instruction(opcode c, std::uint32_t s) : code(c), slot(s), value(0) {}
+    instruction(double (*f)(double)) : code(opcode::call1), slot(0), unary(f) {}
+    instruction(double (*f)(double, double))
+        : code(opcode::call2), slot(0), binary(f) {}
+    instruction(double (*f)(double, double, double))
+        : code(opcode::call3), slot(0), ternary(f) {}
+};
+
+/// @brief The kernel which executes an instruction for a whole block
+///
+/// Which member is active follows from the opcode of the instruction.
+/// Constants and variables have no kernel.
+union kernel {
+    simd::unary_kernel unary;
+    simd::binary_kernel binary;
+    simd::ternary_kernel ternary;
+};
+
+/// @brief A flat program in reverse polish notation
+///
+/// Conditionals and logical operators jump over the operands which
+/// do not decide the result.  Jumps only go forward, and both ways
+/// to a target leave the same number of values on the stack.
+struct program {
+    using variable_callback_fn = std::function<double(std::string const &)>;
+
+    /// The instructions in execution order
+    std::vector<instruction> code;
+
+    /// Names of the variables, indexed by the slot of an instruction
+    std::vector<std::string> variables;
+
+    /// Maximum depth of the value stack
+    std::size_t stack_size = 0;
+
+    /// @brief Number of registers
+    ///
+    /// Subexpressions which are used more than once are computed once
+    /// and kept in a register for the later uses.
+    std::size_t registers = 0;
+
+    /// Kernels for the instructions, indexed like @c code and chosen
+    /// for the instruction set of the running CPU
+    std::vector<kernel> kernels;
+
+    /// Machine code for the program, if it has been translated by
+    /// jit::compile(), which is shared by all copies
+    std::shared_ptr<jit::function const> native;
+
+    /// @brief Execute the program
+    ///
+    /// Every variable reference calls @p fn, just like ast::eval does.
+    double run(variable_callback_fn const &fn) const;
+
+    /// @brief Execute the program
+    ///
+    /// The value of the variable in slot @c i is @c values[i].  If
+    /// there is machine code, it is executed instead of the
+    /// instructions.
+    double run(double const *values) const;
+
+    /// @brief Execute the program without throwing
+    ///
+    /// Domain errors do not throw but return NaN and store the first
+    /// error in @p err, which is error::none on success.
+    double run(double const *values, math::error &err) const;
+
+    /// @brief Execute the program for many rows at once
+    ///
+    /// The rows are processed in blocks and every instruction is
+    /// applied to the whole block before moving on to the next one.
+    /// If the rows of a block disagree on a condition, both operands
+    /// are computed and every row keeps the result and the errors of
+    /// its own.
+    /// The value of the variable in slot @c i for row @c r is
+    /// @c columns[i][r].  If any row fails, the exception for the
+    /// lowest failing row is thrown.
+    void run(std::size_t rows, double const *const *columns,
+             double *results) const;
+
+    /// @brief Execute the program for many rows without throwing
+    ///
+    /// Failing rows are NaN and their error is stored in the same row
+    /// of @p errors.  All other rows of @p errors are error::none.
+    void run(std::size_t rows, double const *const *columns,
+             double *results, math::error *errors) const;
+
+    /// @brief Execute the program for many rows on many threads
+    ///
+    /// The rows are split into chunks of chunk_rows() rows which are
+    /// executed by @p executor.  If any row fails, the exception for
+    /// the lowest failing row is thrown.
+    void run(Executor &executor, std::size_t rows,
+             double const *const *columns, double *results) const;
+
+    /// @brief Execute the program for many rows on many threads
+    /// without throwing
+    void run(Executor &executor, std::size_t rows,
+             double const *const *columns, double *results,
+             math::error *errors) const;
+
+    /// @brief Number of rows per task of the parallel execution
+    ///
+    /// The inputs and outputs of a chunk fit into the L2 cache of a
+    /// typical core, so that the blocks of a chunk stream through the
+    /// cache of the thread which executes it.
+    std::size_t chunk_rows() const;
+};
+
+/// Number of rows that are processed together by the batch interpreter
+constexpr std::size_t block_size = 128;
+
+/// @brief Lower an abstract syntax tree into a program
+///
+/// Variables are assigned the slots given by @p variables; names
+/// which are not in the table yet are appended.  The tree may be a
+/// DAG, see ast::CommonSubexpressionEliminator.
+program compile(ast::tree const &ast,
+                std::vector<std::string> const &variables = {});
+
+} // namespace bytecode
+
+} // namespace matheval
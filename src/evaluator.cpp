@@ -1,78 +1,1285 @@
 #define MATHEVAL_IMPLEMENTATION
 
-#include "../evaluator.hpp"
+#include "evaluator.hpp"
 #include "ast.hpp"
 #include "matheval.hpp"
+#include "math.hpp"
 
-#include <iostream>
+#include <boost/math/special_functions/digamma.hpp>
+
+#include <cmath>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace matheval {
 
 namespace ast {
 
-ConstantFolder::result_type ConstantFolder::operator()(nil) const {
-    return result_type{0};
+namespace {
+
+/// Trees of up to this many nodes without conditionals are evaluated
+/// without allocating
+constexpr std::size_t small_tree = 64;
+
+/// @brief The identity of a node, with its children already replaced
+///        by their first occurrence
+struct signature {
+    kind type;
+    std::uint32_t args[3];
+    std::uint64_t payload; ///< value, slot or function
+
+    explicit signature(node const &x)
+        : type(x.type), args{x.args[0], x.args[1], x.args[2]}, payload(0) {
+        switch (x.type) {
+        case kind::constant:
+            // Compare the bits, so that 0 and -0 stay apart
+            std::memcpy(&payload, &x.value, sizeof(payload));
+            break;
+        case kind::variable:
+            payload = x.slot;
+            break;
+        case kind::unary:
+            payload = reinterpret_cast<std::uintptr_t>(x.unary);
+            break;
+        case kind::binary:
+            payload = reinterpret_cast<std::uintptr_t>(x.binary);
+            break;
+        case kind::ternary:
+            payload = reinterpret_cast<std::uintptr_t>(x.ternary);
+            break;
+        }
+    }
+
+    bool operator==(signature const &other) const {
+        return type == other.type && payload == other.payload &&
+               args[0] == other.args[0] && args[1] == other.args[1] &&
+               args[2] == other.args[2];
+    }
+};
+
+struct signature_hash {
+    std::size_t operator()(signature const &s) const {
+        std::uint64_t h = std::hash<std::uint64_t>()(s.payload);
+        for (std::uint64_t v :
+             {static_cast<std::uint64_t>(s.type),
+              static_cast<std::uint64_t>(s.args[0]),
+              static_cast<std::uint64_t>(s.args[1]),
+              static_cast<std::uint64_t>(s.args[2])}) {
+            h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        }
+        return static_cast<std::size_t>(h);
+    }
+};
+
+/// @brief Whether a node is the constant @p v, telling 0 from -0
+bool equals(node const &x, double v) {
+    return x.type == kind::constant && x.value == v &&
+           std::signbit(x.value) == std::signbit(v);
+}
+
+/// @brief The reciprocal of a power of two, or 0 if @p c is not one
+///        or its reciprocal is not a normal number
+double exact_reciprocal(double c) {
+    int exp;
+    double const m = std::frexp(c, &exp);
+    double const r = 1 / c;
+    return (m == 0.5 || m == -0.5) && std::isnormal(r) ? r : 0;
+}
+
+/// @brief The function computing x**c, or nullptr if there is none
+unary_fn power(double c) {
+    if (c == -1) {
+        return static_cast<unary_fn>(&math::powi<-1>);
+    } else if (c == 1) {
+        // Not simply x, pow reports an underflow for subnormal x
+        return static_cast<unary_fn>(&math::powi<1>);
+    } else if (c == 2) {
+        return static_cast<unary_fn>(&math::powi<2>);
+    } else if (c == 3) {
+        return static_cast<unary_fn>(&math::powi<3>);
+    } else if (c == 4) {
+        return static_cast<unary_fn>(&math::powi<4>);
+    } else if (c == 0.5) {
+        return static_cast<unary_fn>(&math::pow_half);
+    }
+    return nullptr;
+}
+
+std::uint32_t push(tree &t, node const &x) {
+    t.nodes.push_back(x);
+    return static_cast<std::uint32_t>(t.nodes.size() - 1);
+}
+
+/// @brief Rewrite a node whose children are already in @p t
+///
+/// @return whether the node was rewritten, in which case @p to is the
+///         index of its replacement in @p t
+bool simplify(tree &t, node const &x, std::uint32_t &to) {
+    std::uint32_t const *a = x.args;
+    unary_fn const negate = static_cast<unary_fn>(&math::minus);
+    if (x.type == kind::unary) {
+        node const &arg = t.nodes[a[0]];
+        if (x.unary == static_cast<unary_fn>(&math::plus)) {
+            to = a[0];
+            return true;
+        }
+        if (x.unary == negate && arg.type == kind::unary &&
+            arg.unary == negate) {
+            to = arg.args[0];
+            return true;
+        }
+        return false;
+    }
+    if (x.type != kind::binary) {
+        return false;
+    }
+
+    // Copies, because pushing may move the nodes
+    node const lhs = t.nodes[a[0]];
+    node const rhs = t.nodes[a[1]];
+    if (x.binary == static_cast<binary_fn>(&math::multiplies)) {
+        if (equals(rhs, 1) || equals(lhs, 1)) {
+            to = equals(rhs, 1) ? a[0] : a[1];
+            return true;
+        }
+    } else if (x.binary == static_cast<binary_fn>(&math::plus)) {
+        // x + 0 is not x for x = -0, but x + -0 always is
+        if (equals(rhs, -0.0) || equals(lhs, -0.0)) {
+            to = equals(rhs, -0.0) ? a[0] : a[1];
+            return true;
+        }
+    } else if (x.binary == static_cast<binary_fn>(&math::minus)) {
+        if (equals(rhs, 0.0)) {
+            to = a[0];
+            return true;
+        }
+    } else if (x.binary == static_cast<binary_fn>(&math::divides)) {
+        if (equals(rhs, 1)) {
+            to = a[0];
+            return true;
+        }
+        double const r =
+            rhs.type == kind::constant ? exact_reciprocal(rhs.value) : 0;
+        if (r != 0) {
+            std::uint32_t const c = push(t, node{r});
+            to = push(t, node{static_cast<binary_fn>(&math::multiplies),
+                              a[0], c});
+            return true;
+        }
+    } else if (x.binary == static_cast<binary_fn>(&math::pow) &&
+               rhs.type == kind::constant) {
+        // pow(x, 0) is 1 even for NaN, but a function of x could fail
+        if (rhs.value == 0 && lhs.arity() == 0) {
+            to = push(t, node{1.0});
+            return true;
+        }
+        if (unary_fn const f = power(rhs.value)) {
+            to = push(t, node{f, a[0]});
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief Copy the nodes which @p root depends on, so that @p root
+///        becomes the last node
+tree prune(tree const &t, std::uint32_t root) {
+    std::size_t const n = t.nodes.size();
+    std::vector<bool> used(n);
+    if (n != 0) {
+        used[root] = true;
+    }
+    for (std::size_t i = n; i-- > 0;) {
+        if (used[i]) {
+            node const &x = t.nodes[i];
+            for (std::size_t k = 0; k < x.arity(); ++k) {
+                used[x.args[k]] = true;
+            }
+        }
+    }
+
+    // Variables which are no longer used keep their slots, see
+    // Parser::variables()
+    tree result;
+    result.variables = t.variables;
+    std::vector<std::uint32_t> index(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!used[i]) {
+            continue;
+        }
+        node x = t.nodes[i];
+        for (std::size_t k = 0; k < x.arity(); ++k) {
+            x.args[k] = index[x.args[k]];
+        }
+        index[i] = push(result, x);
+    }
+    return result;
+}
+
+/// @brief Replace every node by the first node which equals it
+///
+/// @param[out] index  the index in the result of every node of @p t
+tree merge_equal(tree const &t, std::vector<std::uint32_t> &index) {
+    std::size_t const n = t.nodes.size();
+
+    // The children of a node come before it, so they have already
+    // been replaced by their first occurrence when the node is seen
+    std::unordered_map<signature, std::uint32_t, signature_hash> first;
+    first.reserve(n);
+    tree result;
+    result.variables = t.variables;
+    index.assign(n, 0);
+    for (std::size_t i = 0; i < n; ++i) {
+        node x = t.nodes[i];
+        for (std::size_t k = 0; k < x.arity(); ++k) {
+            x.args[k] = index[x.args[k]];
+        }
+        auto const it = first.emplace(
+            signature{x}, static_cast<std::uint32_t>(result.nodes.size()));
+        index[i] = it.first->second;
+        if (it.second) {
+            result.nodes.push_back(x);
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+// Optimizer
+
+tree ConstantFolder::operator()(tree const &t) const {
+    std::size_t const n = t.nodes.size();
+
+    // Compute the value of every node whose arguments are all known,
+    // and find the conditionals whose condition is known
+    std::uint32_t const none = static_cast<std::uint32_t>(-1);
+    std::vector<bool> known(n);
+    std::vector<double> values(n);
+    std::vector<std::uint32_t> selected(n, none);
+    for (std::size_t i = 0; i < n; ++i) {
+        node const &x = t.nodes[i];
+        std::uint32_t const *a = x.args;
+        switch (x.type) {
+        case kind::constant:
+            known[i] = true;
+            values[i] = x.value;
+            break;
+        case kind::variable:
+            break;
+        case kind::unary:
+            known[i] = known[a[0]] && fold(values[i], x.unary, values[a[0]]);
+            break;
+        case kind::binary:
+            known[i] = known[a[0]] && known[a[1]] &&
+                       fold(values[i], x.binary, values[a[0]], values[a[1]]);
+            break;
+        case kind::ternary:
+            known[i] = known[a[0]] && known[a[1]] && known[a[2]] &&
+                       fold(values[i], x.ternary, values[a[0]], values[a[1]],
+                            values[a[2]]);
+            break;
+        }
+
+        // A constant condition selects one operand, even if the other
+        // one is unknown or fails
+        if (known[i] || x.arity() == 0 || !known[a[0]]) {
+            continue;
+        }
+        bool const condition = values[a[0]] != 0;
+        switch (flow(x)) {
+        case control::eager:
+            break;
+        case control::ifelse:
+            selected[i] = condition ? a[1] : a[2];
+            break;
+        case control::logical_and:
+            if (!condition) {
+                known[i] = true;
+                values[i] = 0;
+            }
+            break;
+        case control::logical_or:
+            if (condition) {
+                known[i] = true;
+                values[i] = 1;
+            }
+            break;
+        }
+        if (selected[i] != none) {
+            known[i] = known[selected[i]];
+            values[i] = values[selected[i]];
+        }
+    }
+
+    // Only the children of nodes which are kept as functions are used,
+    // and they all come before their parent
+    std::vector<bool> used(n);
+    if (n != 0) {
+        used[n - 1] = true;
+    }
+    for (std::size_t i = n; i-- > 0;) {
+        if (!used[i] || known[i]) {
+            continue;
+        }
+        node const &x = t.nodes[i];
+        if (selected[i] != none) {
+            used[selected[i]] = true;
+            continue;
+        }
+        for (std::size_t k = 0; k < x.arity(); ++k) {
+            used[x.args[k]] = true;
+        }
+    }
+
+    // Variables of pruned branches keep their slots, see
+    // Parser::variables()
+    tree result;
+    result.variables = t.variables;
+    std::vector<std::uint32_t> index(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!used[i]) {
+            continue;
+        }
+        if (selected[i] != none && !known[i]) {
+            index[i] = index[selected[i]];
+            continue;
+        }
+        index[i] = static_cast<std::uint32_t>(result.nodes.size());
+        node x = t.nodes[i];
+        if (known[i]) {
+            result.nodes.push_back(node{values[i]});
+            continue;
+        }
+        for (std::size_t k = 0; k < x.arity(); ++k) {
+            x.args[k] = index[x.args[k]];
+        }
+        result.nodes.push_back(x);
+    }
+    return result;
 }
 
-ConstantFolder::result_type ConstantFolder::operator()(double n) const {
-    return result_type{n};
+tree AlgebraicSimplifier::operator()(tree const &t,
+                                     std::size_t &rewritten) const {
+    std::size_t const n = t.nodes.size();
+    rewritten = 0;
+
+    // Rewritten nodes are replaced by one of their children or by
+    // new nodes, which leaves the constant arguments unused
+    tree result;
+    result.variables = t.variables;
+    std::vector<std::uint32_t> index(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        node x = t.nodes[i];
+        for (std::size_t k = 0; k < x.arity(); ++k) {
+            x.args[k] = index[x.args[k]];
+        }
+        if (simplify(result, x, index[i])) {
+            ++rewritten;
+        } else {
+            index[i] = push(result, x);
+        }
+    }
+    // The root itself may have been replaced by an earlier node
+    return prune(result, n == 0 ? 0 : index[n - 1]);
 }
 
-ConstantFolder::result_type ConstantFolder::
-operator()(expression const &x) const {
-    auto state = boost::apply_visitor(*this, x.lhs);
-    for (operation const &oper : x.rhs) {
-        state = (*this)(oper, state);
+tree CommonSubexpressionEliminator::operator()(tree const &t) const {
+    std::vector<std::uint32_t> index;
+    return merge_equal(t, index);
+}
+
+forest CommonSubexpressionEliminator::operator()(forest const &f) const {
+    std::vector<std::uint32_t> index;
+    forest result;
+    result.shared = merge_equal(f.shared, index);
+    for (std::uint32_t root : f.roots) {
+        result.roots.push_back(index[root]);
     }
-    return result_type{state};
+    return result;
 }
 
 // Evaluator
 
-double eval::operator()(nil) const {
-    throw matheval::invalid_argument("operator nil called");
-    BOOST_ASSERT(0);
+namespace {
+
+/// Stage of a node whose value has been computed
+constexpr std::uint8_t finished = 0xff;
+
+/// @brief Compute a node whose children have been computed
+///
+/// @tparam Lazy   whether conditionals are short-circuited
+/// @param[in] v    the values of the nodes, only those of the children
+///                 which flow() selects are valid if @p Lazy is true
+template <bool Lazy, typename Lookup>
+double compute(tree const &t, std::uint32_t i, double const *v,
+               Lookup const &lookup) {
+    node const &x = t.nodes[i];
+    std::uint32_t const *a = x.args;
+    switch (x.type) {
+    case kind::constant:
+        return x.value;
+    case kind::variable:
+        return lookup(x.slot);
+    case kind::unary:
+        return x.unary(v[a[0]]);
+    case kind::binary:
+        switch (Lazy ? flow(x) : control::eager) {
+        case control::logical_and:
+            return v[a[0]] != 0 && v[a[1]] != 0;
+        case control::logical_or:
+            return v[a[0]] != 0 || v[a[1]] != 0;
+        case control::eager:
+        case control::ifelse:
+            break;
+        }
+        return x.binary(v[a[0]], v[a[1]]);
+    case kind::ternary:
+        if (Lazy && flow(x) == control::ifelse) {
+            return v[a[0]] != 0 ? v[a[1]] : v[a[2]];
+        }
+        return x.ternary(v[a[0]], v[a[1]], v[a[2]]);
+    }
     return 0;
 }
 
-double eval::operator()(double n) const { return n; }
+/// @brief compute() with short-circuiting, as called by descend()
+template <typename Lookup>
+struct lazy_compute {
+    tree const &t;
+    Lookup const &lookup;
 
-double eval::operator()(std::string const &var) const {
-  if (! fn) {
-    throw matheval::invalid_argument("Missing callback function to look up variable " + var); // NOLINT
-  }
-  return fn(var);
+    double operator()(std::uint32_t i, double const *v) const {
+        return compute<true>(t, i, v, lookup);
+    }
+};
+
+template <typename Lookup>
+lazy_compute<Lookup> lazily(tree const &t, Lookup const &lookup) {
+    return {t, lookup};
+}
+
+/// @brief The next child of @p x which has to be computed
+///
+/// @param[in] k  number of children which have been considered
+/// @return the index of the child or -1 if @p x can be computed
+template <typename V>
+std::uint32_t next(node const &x, std::size_t k, V const *v) {
+    std::uint32_t const done = static_cast<std::uint32_t>(-1);
+    std::uint32_t const *a = x.args;
+    switch (flow(x)) {
+    case control::eager:
+        return k < x.arity() ? a[k] : done;
+    case control::ifelse:
+        return k == 0 ? a[0] : k == 1 ? (v[a[0]] != 0 ? a[1] : a[2]) : done;
+    case control::logical_and:
+        return k == 0 ? a[0] : k == 1 && v[a[0]] != 0 ? a[1] : done;
+    case control::logical_or:
+        return k == 0 ? a[0] : k == 1 && v[a[0]] == 0 ? a[1] : done;
+    }
+    return done;
 }
 
-double eval::operator()(operation const &x, double lhs) const {
-    double rhs = boost::apply_visitor(*this, x.rhs);
-    return x.op(lhs, rhs);
+/// @brief Compute @p root and the children which decide its value
+///
+/// Walk down from the root and compute only the children which are
+/// selected by flow().  The walk holds the path from the root, so it
+/// never gets longer than the tree has nodes.  Nodes which are
+/// already finished are not computed again, which computes shared
+/// nodes only once.  If a node throws, @p walk is left holding the
+/// unfinished nodes.
+///
+/// @param[in,out] considered  for every node the number of children
+///                            considered, or finished
+/// @param[in] compute  computes the value of a node from @p v, see
+///                     compute()
+/// @return the number of nodes computed
+template <typename V, typename Compute>
+std::size_t descend(tree const &t, std::uint32_t root, V *v,
+                    std::uint8_t *considered,
+                    std::vector<std::uint32_t> &walk, Compute const &compute) {
+    std::size_t count = 0;
+    if (considered[root] != finished) {
+        walk.push_back(root);
+    }
+    while (!walk.empty()) {
+        std::uint32_t const i = walk.back();
+        std::uint32_t const child = next(t.nodes[i], considered[i], v);
+        if (child == static_cast<std::uint32_t>(-1)) {
+            v[i] = compute(i, v);
+            considered[i] = finished;
+            ++count;
+            walk.pop_back();
+            continue;
+        }
+        ++considered[i];
+        if (considered[child] != finished) {
+            walk.push_back(child);
+        }
+    }
+    return count;
 }
 
-double eval::operator()(unary_op const &x) const {
-    double rhs = boost::apply_visitor(*this, x.rhs);
-    return x.op(rhs);
+} // namespace
+
+double eval::operator()(tree const &t) const {
+    std::size_t const n = t.nodes.size();
+    if (n == 0) {
+        throw matheval::invalid_argument("operator nil called");
+    }
+
+    auto const lookup = [this, &t](std::uint32_t slot) {
+        if (!fn) {
+            throw matheval::invalid_argument("Missing callback function to look up variable " + t.variables[slot]); // NOLINT
+        }
+        return fn(t.variables[slot]);
+    };
+
+    double buffer[small_tree];
+    std::unique_ptr<double[]> heap;
+    double *v = buffer;
+    if (n > small_tree) {
+        heap.reset(new double[n]);
+        v = heap.get();
+    }
+
+    bool const lazy = std::any_of(t.nodes.begin(), t.nodes.end(),
+                                  [](node const &x) {
+                                      return flow(x) != control::eager;
+                                  });
+    if (!lazy) {
+        for (std::size_t i = 0; i < n; ++i) {
+            v[i] = compute<false>(t, static_cast<std::uint32_t>(i), v, lookup);
+        }
+        return v[n - 1];
+    }
+
+    std::vector<std::uint8_t> considered(n);
+    std::vector<std::uint32_t> walk;
+    descend(t, static_cast<std::uint32_t>(n - 1), v, considered.data(), walk,
+            lazily(t, lookup));
+    return v[n - 1];
 }
 
-double eval::operator()(binary_op const &x) const {
-    double lhs = boost::apply_visitor(*this, x.lhs);
-    double rhs = boost::apply_visitor(*this, x.rhs);
-    return x.op(lhs, rhs);
+void forest_eval::operator()(forest const &f, double const *values,
+                             double *results) const {
+    tree const &t = f.shared;
+    std::size_t const n = t.nodes.size();
+    auto const lookup = [values](std::uint32_t slot) { return values[slot]; };
+
+    // The nodes of the earlier trees come first, so computing all
+    // nodes in order also finds the first error of the first tree
+    std::vector<double> v(n);
+    bool const lazy = std::any_of(t.nodes.begin(), t.nodes.end(),
+                                  [](node const &x) {
+                                      return flow(x) != control::eager;
+                                  });
+    if (!lazy) {
+        for (std::size_t i = 0; i < n; ++i) {
+            v[i] = compute<false>(t, static_cast<std::uint32_t>(i), v.data(),
+                                  lookup);
+        }
+        for (std::size_t r = 0; r < f.roots.size(); ++r) {
+            results[r] = v[f.roots[r]];
+        }
+        return;
+    }
+
+    // The trees share the stage of the nodes, so a node which has been
+    // computed for an earlier tree is not computed again
+    std::vector<std::uint8_t> considered(n);
+    std::vector<std::uint32_t> walk;
+    for (std::size_t r = 0; r < f.roots.size(); ++r) {
+        descend(t, f.roots[r], v.data(), considered.data(), walk,
+                lazily(t, lookup));
+        results[r] = v[f.roots[r]];
+    }
 }
 
-double eval::operator()(ternary_op const &x) const {
-    double p1 = boost::apply_visitor(*this, x.p1);
-    double p2 = boost::apply_visitor(*this, x.p2);
-    double p3 = boost::apply_visitor(*this, x.p3);
-    return x.op(p1, p2, p3);
+incremental_eval::incremental_eval(tree t)
+    : t(std::move(t)), v(this->t.nodes.size()),
+      considered(this->t.nodes.size()),
+      dependents(this->t.variables.size()),
+      inputs(this->t.variables.size()) {
+    std::size_t const n = this->t.nodes.size();
+    if (n == 0) {
+        throw matheval::invalid_argument("operator nil called");
+    }
+
+    std::vector<std::vector<std::uint32_t>> parents(n);
+    for (std::uint32_t i = 0; i < n; ++i) {
+        node const &x = this->t.nodes[i];
+        for (std::size_t k = 0; k < x.arity(); ++k) {
+            parents[x.args[k]].push_back(i);
+        }
+    }
+
+    // Walk up from the variable nodes of every slot.  A node which is
+    // reached twice through shared children is only recorded once.
+    std::uint32_t const none = static_cast<std::uint32_t>(-1);
+    std::vector<std::uint32_t> seen(n, none);
+    for (std::uint32_t i = 0; i < n; ++i) {
+        node const &x = this->t.nodes[i];
+        if (x.type != kind::variable) {
+            continue;
+        }
+        std::vector<std::uint32_t> &reached = dependents[x.slot];
+        walk.push_back(i);
+        while (!walk.empty()) {
+            std::uint32_t const j = walk.back();
+            walk.pop_back();
+            if (seen[j] == x.slot) {
+                continue;
+            }
+            seen[j] = x.slot;
+            reached.push_back(j);
+            walk.insert(walk.end(), parents[j].begin(), parents[j].end());
+        }
+    }
 }
 
-double eval::operator()(expression const &x) const {
-    double state = boost::apply_visitor(*this, x.lhs);
-    for (operation const &oper : x.rhs) {
-        state = (*this)(oper, state);
+double incremental_eval::operator()(double const *values) {
+    count = 0;
+    for (std::size_t slot = 0; slot < inputs.size(); ++slot) {
+        if (std::memcmp(&values[slot], &inputs[slot], sizeof(double)) != 0) {
+            inputs[slot] = values[slot];
+            for (std::uint32_t i : dependents[slot]) {
+                considered[i] = 0;
+            }
+        }
+    }
+
+    auto const lookup = [this](std::uint32_t slot) { return inputs[slot]; };
+
+    // The walk stops at the nodes whose values are still valid
+    std::uint32_t const root = static_cast<std::uint32_t>(t.nodes.size() - 1);
+    try {
+        count = descend(t, root, v.data(), considered.data(), walk,
+                        lazily(t, lookup));
+    } catch (...) {
+        // Start the unfinished nodes over next time
+        for (std::uint32_t i : walk) {
+            considered[i] = 0;
+        }
+        walk.clear();
+        throw;
+    }
+    return v[root];
+}
+
+// Evaluation in other number types
+
+namespace {
+
+/// Rows which typed_eval computes together
+constexpr std::size_t typed_block = 64;
+
+template <typename T>
+using typed_unary = T (*)(T);
+template <typename T>
+using typed_binary = T (*)(T, T);
+template <typename T>
+using typed_ternary = T (*)(T, T, T);
+
+template <typename F, typename G, std::size_t N>
+G retype(F f, std::pair<F, G> const (&table)[N]) {
+    for (std::pair<F, G> const &entry : table) {
+        if (entry.first == f) {
+            return entry.second;
+        }
+    }
+    throw matheval::invalid_argument( // NOLINT
+        "Function has no counterpart for this number type");
+}
+
+/// @brief The counterpart for @p T of the function @p f
+template <typename T>
+typed_unary<T> retype(unary_fn f) {
+    using U = typed_unary<T>;
+    // clang-format off
+    static std::pair<unary_fn, U> const table[] = {
+        {static_cast<unary_fn>(&std::abs)        , static_cast<U>(&std::abs)},
+        {static_cast<unary_fn>(&math::acos)      , static_cast<U>(&math::acos)},
+        {static_cast<unary_fn>(&math::acosh)     , static_cast<U>(&math::acosh)},
+        {static_cast<unary_fn>(&math::asin)      , static_cast<U>(&math::asin)},
+        {static_cast<unary_fn>(&std::asinh)      , static_cast<U>(&std::asinh)},
+        {static_cast<unary_fn>(&std::atan)       , static_cast<U>(&std::atan)},
+        {static_cast<unary_fn>(&math::atanh)     , static_cast<U>(&math::atanh)},
+        {static_cast<unary_fn>(&std::cbrt)       , static_cast<U>(&std::cbrt)},
+        {static_cast<unary_fn>(&std::ceil)       , static_cast<U>(&std::ceil)},
+        {static_cast<unary_fn>(&math::cos)       , static_cast<U>(&math::cos)},
+        {static_cast<unary_fn>(&std::cosh)       , static_cast<U>(&std::cosh)},
+        {static_cast<unary_fn>(&math::deg)       , static_cast<U>(&math::deg)},
+        {static_cast<unary_fn>(&std::erf)        , static_cast<U>(&std::erf)},
+        {static_cast<unary_fn>(&std::erfc)       , static_cast<U>(&std::erfc)},
+        {static_cast<unary_fn>(&std::exp)        , static_cast<U>(&std::exp)},
+        {static_cast<unary_fn>(&std::exp2)       , static_cast<U>(&std::exp2)},
+        {static_cast<unary_fn>(&std::floor)      , static_cast<U>(&std::floor)},
+        {static_cast<unary_fn>(&math::isinf)     , static_cast<U>(&math::isinf)},
+        {static_cast<unary_fn>(&math::isnan)     , static_cast<U>(&math::isnan)},
+        {static_cast<unary_fn>(&math::log)       , static_cast<U>(&math::log)},
+        {static_cast<unary_fn>(&math::log2)      , static_cast<U>(&math::log2)},
+        {static_cast<unary_fn>(&math::log10)     , static_cast<U>(&math::log10)},
+        {static_cast<unary_fn>(&math::rad)       , static_cast<U>(&math::rad)},
+        {static_cast<unary_fn>(&std::round)      , static_cast<U>(&std::round)},
+        {static_cast<unary_fn>(&math::sgn)       , static_cast<U>(&math::sgn)},
+        {static_cast<unary_fn>(&math::sin)       , static_cast<U>(&math::sin)},
+        {static_cast<unary_fn>(&std::sinh)       , static_cast<U>(&std::sinh)},
+        {static_cast<unary_fn>(&math::sqrt)      , static_cast<U>(&math::sqrt)},
+        {static_cast<unary_fn>(&math::tan)       , static_cast<U>(&math::tan)},
+        {static_cast<unary_fn>(&std::tanh)       , static_cast<U>(&std::tanh)},
+        {static_cast<unary_fn>(&math::tgamma)    , static_cast<U>(&math::tgamma)},
+        {static_cast<unary_fn>(&math::powi<-1>)  , static_cast<U>(&math::powi<-1>)},
+        {static_cast<unary_fn>(&math::powi<1>)   , static_cast<U>(&math::powi<1>)},
+        {static_cast<unary_fn>(&math::powi<2>)   , static_cast<U>(&math::powi<2>)},
+        {static_cast<unary_fn>(&math::powi<3>)   , static_cast<U>(&math::powi<3>)},
+        {static_cast<unary_fn>(&math::powi<4>)   , static_cast<U>(&math::powi<4>)},
+        {static_cast<unary_fn>(&math::pow_half)  , static_cast<U>(&math::pow_half)},
+        {static_cast<unary_fn>(&math::plus)      , static_cast<U>(&math::plus)},
+        {static_cast<unary_fn>(&math::minus)     , static_cast<U>(&math::minus)},
+        {static_cast<unary_fn>(&math::unary_not) , static_cast<U>(&math::unary_not)},
+    };
+    // clang-format on
+    return retype(f, table);
+}
+
+template <typename T>
+typed_binary<T> retype(binary_fn f) {
+    using B = typed_binary<T>;
+    // clang-format off
+    static std::pair<binary_fn, B> const table[] = {
+        {static_cast<binary_fn>(&std::atan2)           , static_cast<B>(&std::atan2)},
+        {static_cast<binary_fn>(&std::fmax)            , static_cast<B>(&std::fmax)},
+        {static_cast<binary_fn>(&std::fmin)            , static_cast<B>(&std::fmin)},
+        {static_cast<binary_fn>(&math::pow)            , static_cast<B>(&math::pow)},
+        {static_cast<binary_fn>(&math::plus)           , static_cast<B>(&math::plus)},
+        {static_cast<binary_fn>(&math::minus)          , static_cast<B>(&math::minus)},
+        {static_cast<binary_fn>(&math::multiplies)     , static_cast<B>(&math::multiplies)},
+        {static_cast<binary_fn>(&math::divides)        , static_cast<B>(&math::divides)},
+        {static_cast<binary_fn>(&math::fmod)           , static_cast<B>(&math::fmod)},
+        {static_cast<binary_fn>(&math::logical_and)    , static_cast<B>(&math::logical_and)},
+        {static_cast<binary_fn>(&math::logical_or)     , static_cast<B>(&math::logical_or)},
+        {static_cast<binary_fn>(&math::less)           , static_cast<B>(&math::less)},
+        {static_cast<binary_fn>(&math::less_equals)    , static_cast<B>(&math::less_equals)},
+        {static_cast<binary_fn>(&math::greater)        , static_cast<B>(&math::greater)},
+        {static_cast<binary_fn>(&math::greater_equals) , static_cast<B>(&math::greater_equals)},
+        {static_cast<binary_fn>(&math::equals)         , static_cast<B>(&math::equals)},
+        {static_cast<binary_fn>(&math::not_equals)     , static_cast<B>(&math::not_equals)},
+    };
+    // clang-format on
+    return retype(f, table);
+}
+
+template <typename T>
+typed_ternary<T> retype(ternary_fn f) {
+    using F = typed_ternary<T>;
+    static std::pair<ternary_fn, F> const table[] = {
+        {static_cast<ternary_fn>(&math::ifelse), static_cast<F>(&math::ifelse)},
+    };
+    return retype(f, table);
+}
+
+} // namespace
+
+template <typename T>
+typed_eval<T>::typed_eval(tree t) : t(std::move(t)), lazy(false) {
+    if (this->t.nodes.empty()) {
+        throw matheval::invalid_argument("operator nil called");
+    }
+    ops.reserve(this->t.nodes.size());
+    for (node const &x : this->t.nodes) {
+        op o;
+        o.what = code::call;
+        o.value = 0;
+        switch (x.type) {
+        case kind::constant:
+            o.value = static_cast<T>(x.value);
+            break;
+        case kind::variable:
+            break;
+        case kind::unary:
+            o.unary = retype<T>(x.unary);
+            if (x.unary == static_cast<unary_fn>(&math::minus)) {
+                o.what = code::negate;
+            }
+            break;
+        case kind::binary:
+            o.binary = retype<T>(x.binary);
+            if (x.binary == static_cast<binary_fn>(&math::plus)) {
+                o.what = code::plus;
+            } else if (x.binary == static_cast<binary_fn>(&math::minus)) {
+                o.what = code::minus;
+            } else if (x.binary == static_cast<binary_fn>(&math::multiplies)) {
+                o.what = code::multiplies;
+            }
+            break;
+        case kind::ternary:
+            o.ternary = retype<T>(x.ternary);
+            break;
+        }
+        lazy = lazy || flow(x) != control::eager;
+        ops.push_back(o);
+    }
+}
+
+template <typename T>
+T typed_eval<T>::compute(std::uint32_t i, T const *v, T const *values,
+                         bool short_circuit) const {
+    node const &x = t.nodes[i];
+    op const &o = ops[i];
+    std::uint32_t const *a = x.args;
+    switch (x.type) {
+    case kind::constant:
+        return o.value;
+    case kind::variable:
+        return values[x.slot];
+    case kind::unary:
+        return o.unary(v[a[0]]);
+    case kind::binary:
+        switch (short_circuit ? flow(x) : control::eager) {
+        case control::logical_and:
+            return v[a[0]] != 0 && v[a[1]] != 0;
+        case control::logical_or:
+            return v[a[0]] != 0 || v[a[1]] != 0;
+        case control::eager:
+        case control::ifelse:
+            break;
+        }
+        return o.binary(v[a[0]], v[a[1]]);
+    case kind::ternary:
+        if (short_circuit && flow(x) == control::ifelse) {
+            return v[a[0]] != 0 ? v[a[1]] : v[a[2]];
+        }
+        return o.ternary(v[a[0]], v[a[1]], v[a[2]]);
+    }
+    return 0;
+}
+
+template <typename T>
+T typed_eval<T>::row(T const *values, T *v, std::uint8_t *considered,
+                     std::vector<std::uint32_t> &walk) const {
+    std::size_t const n = t.nodes.size();
+    if (!lazy) {
+        for (std::size_t i = 0; i < n; ++i) {
+            v[i] = compute(static_cast<std::uint32_t>(i), v, values, false);
+        }
+        return v[n - 1];
+    }
+
+    std::fill(considered, considered + n, 0);
+    walk.clear();
+    descend(t, static_cast<std::uint32_t>(n - 1), v, considered, walk,
+            [&](std::uint32_t i, T const *w) {
+                return compute(i, w, values, true);
+            });
+    return v[n - 1];
+}
+
+template <typename T>
+T typed_eval<T>::operator()(T const *values) const {
+    std::size_t const n = t.nodes.size();
+    T buffer[small_tree];
+    std::unique_ptr<T[]> heap;
+    T *v = buffer;
+    if (n > small_tree) {
+        heap.reset(new T[n]);
+        v = heap.get();
+    }
+    std::vector<std::uint8_t> considered(lazy ? n : 0);
+    std::vector<std::uint32_t> walk;
+    return row(values, v, considered.data(), walk);
+}
+
+template <typename T>
+void typed_eval<T>::block(std::size_t rows, T const *const *columns,
+                          std::size_t first, T *v) const {
+    // The value of node i in row first + r is v[i * typed_block + r]
+    for (std::size_t i = 0; i < t.nodes.size(); ++i) {
+        node const &x = t.nodes[i];
+        op const &o = ops[i];
+        T *out = v + i * typed_block;
+        T const *a = v + x.args[0] * typed_block;
+        T const *b = v + x.args[1] * typed_block;
+        T const *c = v + x.args[2] * typed_block;
+        switch (x.type) {
+        case kind::constant:
+            std::fill(out, out + rows, o.value);
+            continue;
+        case kind::variable:
+            std::copy(columns[x.slot] + first, columns[x.slot] + first + rows,
+                      out);
+            continue;
+        case kind::unary:
+        case kind::binary:
+        case kind::ternary:
+            break;
+        }
+        switch (o.what) {
+        case code::plus:
+            for (std::size_t r = 0; r < rows; ++r) {
+                out[r] = a[r] + b[r];
+            }
+            break;
+        case code::minus:
+            for (std::size_t r = 0; r < rows; ++r) {
+                out[r] = a[r] - b[r];
+            }
+            break;
+        case code::multiplies:
+            for (std::size_t r = 0; r < rows; ++r) {
+                out[r] = a[r] * b[r];
+            }
+            break;
+        case code::negate:
+            for (std::size_t r = 0; r < rows; ++r) {
+                out[r] = -a[r];
+            }
+            break;
+        case code::call:
+            if (x.type == kind::unary) {
+                for (std::size_t r = 0; r < rows; ++r) {
+                    out[r] = o.unary(a[r]);
+                }
+            } else if (x.type == kind::binary) {
+                for (std::size_t r = 0; r < rows; ++r) {
+                    out[r] = o.binary(a[r], b[r]);
+                }
+            } else {
+                for (std::size_t r = 0; r < rows; ++r) {
+                    out[r] = o.ternary(a[r], b[r], c[r]);
+                }
+            }
+            break;
+        }
+    }
+}
+
+template <typename T>
+void typed_eval<T>::operator()(std::size_t rows, T const *const *columns,
+                               T *results) const {
+    std::size_t const n = t.nodes.size();
+    std::vector<T> values(t.variables.size());
+    std::vector<T> v(n * typed_block);
+    std::vector<std::uint8_t> considered(lazy ? n : 0);
+    std::vector<std::uint32_t> walk;
+    auto const each_row = [&](std::size_t first, std::size_t last) {
+        for (std::size_t r = first; r < last; ++r) {
+            for (std::size_t slot = 0; slot < values.size(); ++slot) {
+                values[slot] = columns[slot][r];
+            }
+            results[r] = row(values.data(), v.data(), considered.data(), walk);
+        }
+    };
+
+    if (lazy) {
+        each_row(0, rows);
+        return;
+    }
+
+    for (std::size_t first = 0; first < rows; first += typed_block) {
+        std::size_t const size = std::min(typed_block, rows - first);
+        try {
+            block(size, columns, first, v.data());
+        } catch (matheval::exception const &) {
+            // The block computes node by node, so the row which failed
+            // need not be the lowest failing one
+            each_row(first, first + size);
+            throw;
+        }
+        T const *root = v.data() + (n - 1) * typed_block;
+        std::copy(root, root + size, results + first);
+    }
+}
+
+template class typed_eval<float>;
+template class typed_eval<double>;
+
+// Differentiation
+
+namespace {
+
+template <typename F, typename G, std::size_t N>
+G derivative(F f, std::pair<F, G> const (&table)[N]) {
+    for (std::pair<F, G> const &entry : table) {
+        if (entry.first == f) {
+            return entry.second;
+        }
+    }
+    throw matheval::invalid_argument( // NOLINT
+        "Function has no derivative");
+}
+
+/// Let Boost.Math return inf or NaN instead of throwing, like the
+/// functions of the C library, because the value of the function
+/// itself has already been checked
+using quiet = boost::math::policies::policy<
+    boost::math::policies::domain_error<boost::math::policies::ignore_error>,
+    boost::math::policies::pole_error<boost::math::policies::ignore_error>,
+    boost::math::policies::overflow_error<boost::math::policies::ignore_error>,
+    boost::math::policies::evaluation_error<
+        boost::math::policies::ignore_error>>;
+
+/// @brief Whether none of the @p k derivatives at @p d is nonzero
+bool constant(double const *d, std::size_t k) {
+    return std::all_of(d, d + k, [](double x) { return x == 0; });
+}
+
+double zero(double /*x*/, double /*f*/) { return 0; }
+
+void flat(double /*x*/, double /*y*/, double /*f*/, double &dx, double &dy) {
+    dx = 0;
+    dy = 0;
+}
+
+/// @brief The derivative of the unary function @p f
+///
+/// Step functions like floor have the derivative 0 where it exists,
+/// and abs has the derivative 0 at 0.
+unary_derivative derivative(unary_fn f) {
+    using boost::math::constants::ln_ten;
+    using boost::math::constants::ln_two;
+    using boost::math::constants::two_div_root_pi;
+    // clang-format off
+    static std::pair<unary_fn, unary_derivative> const table[] = {
+        {static_cast<unary_fn>(&std::abs)        , [](double x, double) { return x > 0 ? 1.0 : x < 0 ? -1.0 : 0.0; }},
+        {static_cast<unary_fn>(&math::acos)      , [](double x, double) { return -1 / std::sqrt(1 - x * x); }},
+        {static_cast<unary_fn>(&math::acosh)     , [](double x, double) { return 1 / std::sqrt(x * x - 1); }},
+        {static_cast<unary_fn>(&math::asin)      , [](double x, double) { return 1 / std::sqrt(1 - x * x); }},
+        {static_cast<unary_fn>(&std::asinh)      , [](double x, double) { return 1 / std::sqrt(x * x + 1); }},
+        {static_cast<unary_fn>(&std::atan)       , [](double x, double) { return 1 / (1 + x * x); }},
+        {static_cast<unary_fn>(&math::atanh)     , [](double x, double) { return 1 / (1 - x * x); }},
+        {static_cast<unary_fn>(&std::cbrt)       , [](double, double f) { return 1 / (3 * f * f); }},
+        {static_cast<unary_fn>(&std::ceil)       , &zero},
+        {static_cast<unary_fn>(&math::cos)       , [](double x, double) { return -std::sin(x); }},
+        {static_cast<unary_fn>(&std::cosh)       , [](double x, double) { return std::sinh(x); }},
+        {static_cast<unary_fn>(&math::deg)       , [](double, double) { return math::deg(1.0); }},
+        {static_cast<unary_fn>(&std::erf)        , [](double x, double) { return two_div_root_pi<double>() * std::exp(-x * x); }},
+        {static_cast<unary_fn>(&std::erfc)       , [](double x, double) { return -two_div_root_pi<double>() * std::exp(-x * x); }},
+        {static_cast<unary_fn>(&std::exp)        , [](double, double f) { return f; }},
+        {static_cast<unary_fn>(&std::exp2)       , [](double, double f) { return f * ln_two<double>(); }},
+        {static_cast<unary_fn>(&std::floor)      , &zero},
+        {static_cast<unary_fn>(&math::isinf)     , &zero},
+        {static_cast<unary_fn>(&math::isnan)     , &zero},
+        {static_cast<unary_fn>(&math::log)       , [](double x, double) { return 1 / x; }},
+        {static_cast<unary_fn>(&math::log2)      , [](double x, double) { return 1 / (x * ln_two<double>()); }},
+        {static_cast<unary_fn>(&math::log10)     , [](double x, double) { return 1 / (x * ln_ten<double>()); }},
+        {static_cast<unary_fn>(&math::rad)       , [](double, double) { return math::rad(1.0); }},
+        {static_cast<unary_fn>(&std::round)      , &zero},
+        {static_cast<unary_fn>(&math::sgn)       , &zero},
+        {static_cast<unary_fn>(&math::sin)       , [](double x, double) { return std::cos(x); }},
+        {static_cast<unary_fn>(&std::sinh)       , [](double x, double) { return std::cosh(x); }},
+        {static_cast<unary_fn>(&math::sqrt)      , [](double, double f) { return 0.5 / f; }},
+        {static_cast<unary_fn>(&math::tan)       , [](double, double f) { return 1 + f * f; }},
+        {static_cast<unary_fn>(&std::tanh)       , [](double, double f) { return 1 - f * f; }},
+        {static_cast<unary_fn>(&math::tgamma)    , [](double x, double f) { return f * boost::math::digamma(x, quiet()); }},
+        {static_cast<unary_fn>(&math::powi<-1>)  , [](double, double f) { return -f * f; }},
+        {static_cast<unary_fn>(&math::powi<1>)   , [](double, double) { return 1.0; }},
+        {static_cast<unary_fn>(&math::powi<2>)   , [](double x, double) { return 2 * x; }},
+        {static_cast<unary_fn>(&math::powi<3>)   , [](double x, double) { return 3 * x * x; }},
+        {static_cast<unary_fn>(&math::powi<4>)   , [](double x, double) { return 4 * x * x * x; }},
+        {static_cast<unary_fn>(&math::pow_half)  , [](double, double f) { return 0.5 / f; }},
+        {static_cast<unary_fn>(&math::plus)      , [](double, double) { return 1.0; }},
+        {static_cast<unary_fn>(&math::minus)     , [](double, double) { return -1.0; }},
+        {static_cast<unary_fn>(&math::unary_not) , &zero},
+    };
+    // clang-format on
+    return derivative(f, table);
+}
+
+/// @brief The partial derivatives of the binary function @p f
+///
+/// max and min have the partial derivatives of the argument they
+/// select, x if both are equal.  The partial derivative of x**y with
+/// respect to y only exists for positive x, and for x = 0 with y > 0.
+binary_partials derivative(binary_fn f) {
+    // clang-format off
+    static std::pair<binary_fn, binary_partials> const table[] = {
+        {static_cast<binary_fn>(&std::atan2)           , [](double x, double y, double, double &dx, double &dy) {
+            double const r = x * x + y * y;
+            dx = y / r;
+            dy = -x / r;
+        }},
+        {static_cast<binary_fn>(&std::fmax)            , [](double x, double y, double, double &dx, double &dy) {
+            bool const first = x >= y || std::isnan(y);
+            dx = first ? 1 : 0;
+            dy = first ? 0 : 1;
+        }},
+        {static_cast<binary_fn>(&std::fmin)            , [](double x, double y, double, double &dx, double &dy) {
+            bool const first = x <= y || std::isnan(y);
+            dx = first ? 1 : 0;
+            dy = first ? 0 : 1;
+        }},
+        {static_cast<binary_fn>(&math::pow)            , [](double x, double y, double f, double &dx, double &dy) {
+            dx = y == 0 ? 0 : y * std::pow(x, y - 1);
+            dy = x > 0 ? f * std::log(x)
+                       : x == 0 && y > 0 ? 0 : std::numeric_limits<double>::quiet_NaN();
+        }},
+        {static_cast<binary_fn>(&math::plus)           , [](double, double, double, double &dx, double &dy) {
+            dx = 1;
+            dy = 1;
+        }},
+        {static_cast<binary_fn>(&math::minus)          , [](double, double, double, double &dx, double &dy) {
+            dx = 1;
+            dy = -1;
+        }},
+        {static_cast<binary_fn>(&math::multiplies)     , [](double x, double y, double, double &dx, double &dy) {
+            dx = y;
+            dy = x;
+        }},
+        {static_cast<binary_fn>(&math::divides)        , [](double, double y, double f, double &dx, double &dy) {
+            dx = 1 / y;
+            dy = -f / y;
+        }},
+        {static_cast<binary_fn>(&math::fmod)           , [](double x, double y, double, double &dx, double &dy) {
+            dx = 1;
+            dy = -std::trunc(x / y);
+        }},
+        {static_cast<binary_fn>(&math::logical_and)    , &flat},
+        {static_cast<binary_fn>(&math::logical_or)     , &flat},
+        {static_cast<binary_fn>(&math::less)           , &flat},
+        {static_cast<binary_fn>(&math::less_equals)    , &flat},
+        {static_cast<binary_fn>(&math::greater)        , &flat},
+        {static_cast<binary_fn>(&math::greater_equals) , &flat},
+        {static_cast<binary_fn>(&math::equals)         , &flat},
+        {static_cast<binary_fn>(&math::not_equals)     , &flat},
+    };
+    // clang-format on
+    return derivative(f, table);
+}
+
+} // namespace
+
+gradient_eval::gradient_eval(tree t, std::vector<std::string> wrt)
+    : t(std::move(t)), wrt(std::move(wrt)), seeds(this->t.variables.size()),
+      lazy(false) {
+    if (this->t.nodes.empty()) {
+        throw matheval::invalid_argument("operator nil called");
+    }
+    std::vector<std::string> const &names = this->t.variables;
+    for (std::size_t j = 0; j < this->wrt.size(); ++j) {
+        auto const it = std::find(names.begin(), names.end(), this->wrt[j]);
+        if (it != names.end()) {
+            seeds[static_cast<std::size_t>(it - names.begin())].push_back(j);
+        }
+    }
+    rules.reserve(this->t.nodes.size());
+    for (node const &x : this->t.nodes) {
+        rule r{nullptr, nullptr};
+        if (x.type == kind::unary) {
+            r.unary = derivative(x.unary);
+        } else if (x.type == kind::binary) {
+            r.binary = derivative(x.binary);
+        }
+        lazy = lazy || flow(x) != control::eager;
+        rules.push_back(r);
+    }
+}
+
+void gradient_eval::chain(std::uint32_t i, double const *v, double f,
+                          double *d) const {
+    node const &x = t.nodes[i];
+    std::size_t const k = wrt.size();
+    std::uint32_t const *a = x.args;
+    double *out = d + i * k;
+    // A partial derivative is not computed for arguments which do not
+    // depend on the chosen variables, so that one which does not exist
+    // neither turns 0 into NaN nor fails
+    switch (x.type) {
+    case kind::constant:
+        std::fill(out, out + k, 0.0);
+        return;
+    case kind::variable:
+        std::fill(out, out + k, 0.0);
+        for (std::size_t j : seeds[x.slot]) {
+            out[j] = 1;
+        }
+        return;
+    case kind::unary: {
+        double const *da = d + a[0] * k;
+        if (constant(da, k)) {
+            std::fill(out, out + k, 0.0);
+            return;
+        }
+        double const dx = rules[i].unary(v[a[0]], f);
+        for (std::size_t j = 0; j < k; ++j) {
+            out[j] = da[j] == 0 ? 0 : dx * da[j];
+        }
+        return;
+    }
+    case kind::binary: {
+        if (flow(x) != control::eager) {
+            // The logical operators are step functions, and their
+            // second argument may not have been computed
+            std::fill(out, out + k, 0.0);
+            return;
+        }
+        double const *da = d + a[0] * k;
+        double const *db = d + a[1] * k;
+        if (constant(da, k) && constant(db, k)) {
+            std::fill(out, out + k, 0.0);
+            return;
+        }
+        double dx;
+        double dy;
+        rules[i].binary(v[a[0]], v[a[1]], f, dx, dy);
+        for (std::size_t j = 0; j < k; ++j) {
+            out[j] = (da[j] == 0 ? 0 : dx * da[j]) + (db[j] == 0 ? 0 : dy * db[j]);
+        }
+        return;
+    }
+    case kind::ternary: {
+        // ifelse, of which only the selected branch has been computed
+        double const *src = d + (v[a[0]] != 0 ? a[1] : a[2]) * k;
+        std::copy(src, src + k, out);
+        return;
+    }
+    }
+}
+
+double gradient_eval::operator()(double const *values,
+                                 double *gradient) const {
+    std::size_t const n = t.nodes.size();
+    std::size_t const k = wrt.size();
+    // The values of the nodes followed by their derivatives.  Nodes
+    // which are not computed are never read, so nothing is cleared.
+    double buffer[4 * small_tree];
+    std::unique_ptr<double[]> heap;
+    double *v = buffer;
+    if (n * (k + 1) > 4 * small_tree) {
+        heap.reset(new double[n * (k + 1)]);
+        v = heap.get();
+    }
+    double *const d = v + n;
+
+    auto const lookup = [values](std::uint32_t slot) { return values[slot]; };
+    auto const differentiate = [&](std::uint32_t i, double const *w) {
+        double const f = compute<true>(t, i, w, lookup);
+        chain(i, w, f, d);
+        return f;
+    };
+
+    if (!lazy) {
+        for (std::uint32_t i = 0; i < n; ++i) {
+            v[i] = differentiate(i, v);
+        }
+    } else {
+        std::vector<std::uint8_t> considered(n);
+        std::vector<std::uint32_t> walk;
+        descend(t, static_cast<std::uint32_t>(n - 1), v, considered.data(),
+                walk, differentiate);
     }
-    return state;
+    std::copy(d + (n - 1) * k, d + n * k, gradient);
+    return v[n - 1];
 }
 
 } // namespace ast
@@ -5,58 +5,256 @@
 #pragma once
 
 #include "ast.hpp"
+#include "matheval.hpp"
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <string>
+#include <vector>
 
 namespace matheval {
 
 namespace ast {
 
+/// @brief Evaluate a function whose arguments are all constant
+///
+/// @return false if the function fails, in which case the node has to
+///         be kept, so that the error is reported by the evaluation
+///         and not by the optimizer
+template <typename F, typename... Args>
+bool fold(double &res, F f, Args... args) {
+    try {
+        res = f(args...);
+        return true;
+    } catch (matheval::exception const &) {
+        return false;
+    }
+}
+
+/// @brief Replace every function whose arguments are all constant by
+///        its value
 struct ConstantFolder {
-    using result_type = operand;
+    tree operator()(tree const &t) const;
+};
 
-    result_type operator()(nil) const;
+/// @brief Replace operations with a constant argument by cheaper ones
+///
+/// Identities like @c x*1 are removed, small integer powers become
+/// products and divisions by a power of two become multiplications.
+/// Only rewrites which give the same result and report the same
+/// errors are made, except that products of powers are rounded after
+/// every factor, see math::powi.  Hence @c x+0 stays, because it turns
+/// -0 into 0.
+struct AlgebraicSimplifier {
+    tree operator()(tree const &t, std::size_t &rewritten) const;
+};
 
-    result_type operator()(double n) const;
+/// @brief Compute structurally identical subtrees only once
+///
+/// Every node which equals an earlier node, i.e. has the same
+/// function or value and the same children, is replaced by the
+/// earlier one.  The result is a DAG in which a node can be the child
+/// of several nodes.  All functions are pure, and the earlier node is
+/// evaluated first, so the result and the first error of an
+/// evaluation do not change.
+struct CommonSubexpressionEliminator {
+    tree operator()(tree const &t) const;
 
-    result_type operator()(std::string const &c) const;
+    /// @brief Merge equal subtrees within and across the trees
+    forest operator()(forest const &f) const;
+};
 
-    result_type operator()(operation const &x, operand const &lhs) const;
+struct eval {
+    using variable_callback_fn = std::function<double(std::string const&)>;
 
-    result_type operator()(unary_op const &x) const;
+    explicit eval(variable_callback_fn f) : fn(f) {}
 
-    result_type operator()(binary_op const &x) const;
+    double operator()(tree const &t) const;
 
-    result_type operator()(ternary_op const &x) const;
+private:
+    variable_callback_fn fn;
+};
 
-    result_type operator()(expression const &x) const;
+/// @brief Evaluate all trees of a forest for variables given by slot
+///
+/// Every node is computed at most once, no matter how many trees it
+/// belongs to.  The trees are evaluated in order, so if any of them
+/// fails, the exception is that of the first failing tree.
+struct forest_eval {
+    /// @param[out] results  the value of every tree, indexed like
+    ///                      forest::roots
+    void operator()(forest const &f, double const *values,
+                    double *results) const;
 };
 
-struct eval {
-    using result_type = double;
-    using variable_callback_fn = std::function<double(std::string const&)>;
+/// @brief Evaluate a tree again after some of its variables changed
+///
+/// The value of every node is kept from one call to the next.  A node
+/// is only computed again if it depends on a variable whose value
+/// changed, or if a conditional skipped it so far.  Which nodes depend
+/// on which variable is found once, when the tree is given.
+class incremental_eval {
+public:
+    /// @throw matheval::invalid_argument if @p t is empty
+    explicit incremental_eval(tree t);
 
-    explicit eval(variable_callback_fn f) : fn(f) {}
+    tree const &ast() const { return t; }
+
+    /// @brief Evaluate for the variables given by slot
+    ///
+    /// The values are compared bitwise with those of the previous
+    /// call, so that a change from 0 to -0 counts as well.  If the
+    /// evaluation throws, the nodes which were computed keep their
+    /// values and the others are computed by the next call.
+    double operator()(double const *values);
+
+    /// @brief Number of nodes computed by the last call
+    std::size_t recomputed() const { return count; }
+
+private:
+    tree t;
+    /// Values of the nodes from the previous calls
+    std::vector<double> v;
+    /// Number of children considered, or finished if the value is valid
+    std::vector<std::uint8_t> considered;
+    /// For every variable the nodes whose value depends on it
+    std::vector<std::vector<std::uint32_t>> dependents;
+    /// Values of the variables from the previous call
+    std::vector<double> inputs;
+    std::vector<std::uint32_t> walk;
+    std::size_t count = 0;
+};
+
+/// @brief Evaluate a tree in the number type @p T
+///
+/// The constants and functions of the tree are replaced by their
+/// counterparts for @p T once, when the tree is given.  Explicitly
+/// instantiated for float and double.
+template <typename T>
+class typed_eval {
+public:
+    /// @throw matheval::invalid_argument if @p t is empty
+    explicit typed_eval(tree t);
+
+    tree const &ast() const { return t; }
+
+    /// @brief Evaluate for the variables given by slot
+    T operator()(T const *values) const;
+
+    /// @brief Evaluate every row of the variables given as columns
+    ///
+    /// Trees without conditionals are computed one node after the
+    /// other for a block of rows.  If a row of a block fails, the block
+    /// is computed again row by row, so that the exception is that of
+    /// the lowest failing row.
+    void operator()(std::size_t rows, T const *const *columns,
+                    T *results) const;
+
+private:
+    /// @brief How a node is computed for a block of rows
+    enum class code : std::uint8_t {
+        call, ///< by calling its function for every row
+        plus,
+        minus,
+        multiplies,
+        negate,
+    };
 
-    double operator()(nil) const;
+    /// @brief The constant or function of a node in @p T
+    struct op {
+        code what;
+        union {
+            T value;
+            T (*unary)(T);
+            T (*binary)(T, T);
+            T (*ternary)(T, T, T);
+        };
+    };
 
-    double operator()(double n) const;
+    T compute(std::uint32_t i, T const *v, T const *values,
+              bool short_circuit) const;
 
-    double operator()(std::string const &var) const;
+    /// @brief Evaluate one row in the scratch memory @p v, @p considered
+    ///        and @p walk, see descend()
+    T row(T const *values, T *v, std::uint8_t *considered,
+          std::vector<std::uint32_t> &walk) const;
 
-    double operator()(operation const &x, double lhs) const;
+    void block(std::size_t rows, T const *const *columns, std::size_t first,
+               T *v) const;
 
-    double operator()(unary_op const &x) const;
+    tree t;
+    std::vector<op> ops;
+    /// Whether any node is short-circuited
+    bool lazy;
+};
+
+extern template class typed_eval<float>;
+extern template class typed_eval<double>;
+
+/// @brief The derivative of a unary function at @p x, where its value
+///        is @p f
+using unary_derivative = double (*)(double x, double f);
+
+/// @brief The partial derivatives @p dx and @p dy of a binary function
+///        at (@p x, @p y), where its value is @p f
+using binary_partials = void (*)(double x, double y, double f, double &dx,
+                                 double &dy);
 
-    double operator()(binary_op const &x) const;
+/// @brief Evaluate a tree and its derivatives in forward mode
+///
+/// Every node carries its value and its partial derivatives with
+/// respect to the chosen variables, like a dual number with several
+/// infinitesimal parts.  The values are computed by the functions of
+/// the tree, so they and their errors are those of ast::eval.  The
+/// derivatives follow from the chain rule with the derivative of every
+/// function, which is looked up once, when the tree is given.
+///
+/// The derivative of a function is only computed if that of an
+/// argument is not zero, and a partial derivative is only used if
+/// that of its argument is not zero.  Hence partial derivatives which
+/// do not exist, like that of x**y with respect to y for negative x,
+/// only make the gradient NaN if the argument depends on a chosen
+/// variable.  They never throw.
+class gradient_eval {
+public:
+    /// @param[in] t    the tree
+    /// @param[in] wrt  the variables to differentiate with respect to,
+    ///                 which need not occur in @p t
+    /// @throw matheval::invalid_argument if @p t is empty
+    gradient_eval(tree t, std::vector<std::string> wrt);
 
-    double operator()(ternary_op const &x) const;
+    tree const &ast() const { return t; }
 
-    double operator()(expression const &x) const;
+    std::vector<std::string> const &with_respect_to() const { return wrt; }
+
+    /// @brief Evaluate for the variables given by slot
+    ///
+    /// @param[out] gradient  the derivative with respect to every
+    ///                       variable of with_respect_to()
+    double operator()(double const *values, double *gradient) const;
 
 private:
-    variable_callback_fn fn;
+    /// @brief The derivative of the function of a node
+    struct rule {
+        unary_derivative unary;
+        binary_partials binary;
+    };
+
+    /// @brief Compute the derivatives of node @p i, whose value is @p f,
+    ///        from those of its children
+    ///
+    /// @param[in]     v  the values of the nodes
+    /// @param[in,out] d  the derivatives of the nodes, wrt.size() each
+    void chain(std::uint32_t i, double const *v, double f, double *d) const;
+
+    tree t;
+    std::vector<std::string> wrt;
+    std::vector<rule> rules;
+    /// For every slot of a variable the indices in wrt which name it
+    std::vector<std::vector<std::size_t>> seeds;
+    /// Whether any node is short-circuited
+    bool lazy;
 };
 
 } // namespace ast
@@ -0,0 +1,187 @@
+#define MATHEVAL_IMPLEMENTATION
+
+#include "matheval.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace matheval {
+
+namespace {
+
+/// Expressions which every used shard can hold at least
+constexpr std::size_t min_shard_capacity = 8;
+
+} // namespace
+
+class ExpressionCache::impl {
+public:
+    impl(std::size_t capacity, std::size_t shards)
+        : capacity(capacity), shards(std::max<std::size_t>(shards, 1)),
+          table(new shard[this->shards]) {}
+
+    CompiledExpression get(std::string const &expr);
+
+    void set_capacity(std::size_t n);
+
+    void clear();
+
+    statistics stats() const;
+
+    std::atomic<std::size_t> capacity;
+
+private:
+    struct entry {
+        std::string expr;
+        CompiledExpression compiled;
+    };
+
+    /// @brief Expressions ordered from most to least recently used
+    struct shard {
+        mutable std::mutex mutex;
+        std::list<entry> lru;
+        std::unordered_map<std::string, std::list<entry>::iterator> index;
+    };
+
+    /// @brief How the capacity is divided among the shards
+    ///
+    /// Small caches use fewer shards, because a shard which holds only
+    /// one or two expressions evicts them on every collision.
+    struct layout {
+        std::size_t shards;
+        std::size_t capacity;
+    };
+
+    layout current() const {
+        std::size_t const n = capacity.load();
+        std::size_t const active =
+            std::min(shards, std::max<std::size_t>(n / min_shard_capacity, 1));
+        return {active, (n + active - 1) / active};
+    }
+
+    shard &shard_of(std::string const &expr, layout const &l) {
+        return table[std::hash<std::string>()(expr) % l.shards];
+    }
+
+    /// Evict the least recently used entries beyond the capacity
+    static void trim(shard &s, std::size_t n) {
+        while (s.lru.size() > n) {
+            s.index.erase(s.lru.back().expr);
+            s.lru.pop_back();
+        }
+    }
+
+    static CompiledExpression compile(std::string const &expr) {
+        // Reusing the parser also reuses the memory of its tree
+        static thread_local Parser parser;
+        parser.parse(expr);
+        return CompiledExpression(parser);
+    }
+
+    std::size_t const shards;
+    std::unique_ptr<shard[]> table;
+
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+};
+
+CompiledExpression ExpressionCache::impl::get(std::string const &expr) {
+    layout const l = current();
+    if (l.capacity == 0) {
+        ++misses;
+        return compile(expr);
+    }
+
+    shard &s = shard_of(expr, l);
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.index.find(expr);
+        if (it != s.index.end()) {
+            s.lru.splice(s.lru.begin(), s.lru, it->second);
+            ++hits;
+            return it->second->compiled;
+        }
+    }
+
+    // Parse without holding the lock; if another thread stored the
+    // same expression in the meantime, its result is used.
+    ++misses;
+    CompiledExpression compiled = compile(expr);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.index.find(expr);
+    if (it != s.index.end()) {
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+        return it->second->compiled;
+    }
+    s.lru.push_front(entry{expr, compiled});
+    s.index.emplace(expr, s.lru.begin());
+    trim(s, l.capacity);
+    return compiled;
+}
+
+void ExpressionCache::impl::set_capacity(std::size_t n) {
+    capacity = n;
+    // Expressions which now belong to another shard stay where they
+    // are until they are evicted; they are still valid, only no
+    // longer found.
+    layout const l = current();
+    for (std::size_t i = 0; i < shards; ++i) {
+        std::lock_guard<std::mutex> lock(table[i].mutex);
+        trim(table[i], i < l.shards ? l.capacity : 0);
+    }
+}
+
+void ExpressionCache::impl::clear() {
+    for (std::size_t i = 0; i < shards; ++i) {
+        std::lock_guard<std::mutex> lock(table[i].mutex);
+        table[i].index.clear();
+        table[i].lru.clear();
+    }
+    hits = 0;
+    misses = 0;
+}
+
+ExpressionCache::statistics ExpressionCache::impl::stats() const {
+    statistics result{hits.load(), misses.load(), 0};
+    for (std::size_t i = 0; i < shards; ++i) {
+        std::lock_guard<std::mutex> lock(table[i].mutex);
+        result.size += table[i].lru.size();
+    }
+    return result;
+}
+
+ExpressionCache::ExpressionCache(std::size_t capacity, std::size_t shards)
+    : pimpl(new impl(capacity, shards)) {}
+
+ExpressionCache::~ExpressionCache() {}
+
+CompiledExpression ExpressionCache::get(std::string const &expr) {
+    return pimpl->get(expr);
+}
+
+std::size_t ExpressionCache::capacity() const {
+    return pimpl->capacity.load(std::memory_order_relaxed);
+}
+
+void ExpressionCache::set_capacity(std::size_t capacity) {
+    pimpl->set_capacity(capacity);
+}
+
+void ExpressionCache::clear() { pimpl->clear(); }
+
+ExpressionCache::statistics ExpressionCache::stats() const {
+    return pimpl->stats();
+}
+
+ExpressionCache &ExpressionCache::shared() {
+    static ExpressionCache cache(0);
+    return cache;
+}
+
+} // namespace matheval
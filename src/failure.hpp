@@ -0,0 +1,96 @@
+#ifndef MATHEVAL_IMPLEMENTATION
+#error "Do not include failure.hpp directly!"
+#endif
+
+#pragma once
+
+#include "matheval.hpp"
+
+#include <cstddef>
+
+namespace matheval {
+
+namespace parser {
+
+/// @brief The name of the punctuation @p c in a diagnostic
+inline char const *punctuation(char c) {
+    switch (c) {
+    case '(':
+        return "'('";
+    case ')':
+        return "')'";
+    case ',':
+        return "','";
+    default:
+        return "punctuation";
+    }
+}
+
+/// @brief The first failed expectation of a parse
+///
+/// An expectation is a part of the grammar which has to follow once
+/// the part before it matched, like the ')' after '(' and an
+/// expression.  The parsers record a failed expectation here and fail
+/// without throwing.  The Spirit parsers then still try the remaining
+/// alternatives, which may even match, but only the first failure
+/// counts and any failure makes the whole parse fail.
+class failure {
+public:
+    /// @brief A parse of [@p first, @p last)
+    failure(char const *first, char const *last) : first(first), last(last) {}
+
+    /// @brief Record that @p expected was not found at @p where, in
+    ///        the grammar rule @p rule
+    ///
+    /// Both names have to be string literals.
+    void record(char const *where, char const *expected, char const *rule) {
+        if (this->expected == nullptr) {
+            this->where = skip(where);
+            this->expected = expected;
+            this->rule = rule;
+        }
+    }
+
+    /// @brief Whether an expectation failed
+    explicit operator bool() const { return expected != nullptr; }
+
+    /// @brief The diagnostic of a failed parse
+    ///
+    /// Without a failed expectation either no expression was found at
+    /// all or text is left after it, and @p rest is where the parser
+    /// stopped.  That is the start of the input in the first case.
+    parse_diagnostic diagnose(char const *rest) const {
+        parse_diagnostic d;
+        if (expected != nullptr) {
+            d.offset = static_cast<std::size_t>(where - first);
+            d.expected = expected;
+            d.rule = rule;
+            return d;
+        }
+        rest = skip(rest);
+        d.offset = static_cast<std::size_t>(rest - first);
+        d.expected = rest == skip(first) ? "expression" : "end of input";
+        d.rule = "expression";
+        return d;
+    }
+
+private:
+    /// @brief The position of the next token, like the skipper of the
+    ///        Spirit parsers
+    char const *skip(char const *p) const {
+        while (p != last && (*p == ' ' || (*p >= '\t' && *p <= '\r'))) {
+            ++p;
+        }
+        return p;
+    }
+
+    char const *first;
+    char const *last;
+    char const *where = nullptr;
+    char const *expected = nullptr;
+    char const *rule = nullptr;
+};
+
+} // namespace parser
+
+} // namespace matheval
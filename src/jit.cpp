@@ -0,0 +1,466 @@
+#define MATHEVAL_IMPLEMENTATION
+
+#include "jit.hpp"
+#include "bytecode.hpp"
+#include "math.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define MATHEVAL_JIT 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace matheval {
+
+namespace jit {
+
+#ifdef MATHEVAL_JIT
+
+namespace {
+
+/// Programs which need a larger frame are left to the interpreter
+constexpr std::size_t max_stack = 4096;
+
+/// The frame is extended by at most this many bytes before it is
+/// touched, so that it cannot skip over the guard page of the stack
+constexpr std::uint32_t page = 4096;
+
+/// @brief Emits the few x86-64 instructions the code generator needs
+///
+/// The value stack lives in the frame, entry @c k at [rsp + 8k].  The
+/// top of the stack is kept in xmm0 and only stored when something is
+/// pushed on top of it or a kernel is called.  rbx holds the values of
+/// the variables and r12 the pointer to the error code, both are
+/// preserved across calls.  A frame larger than a page is allocated
+/// one page at a time, touching every page in order like the stack
+/// probes of a C compiler.
+class assembler {
+public:
+    std::vector<std::uint8_t> code;
+
+    void prologue(std::uint32_t frame) {
+        bytes({0x53});                   // push rbx
+        bytes({0x41, 0x54});             // push r12
+        for (std::uint32_t left = frame; left > page; left -= page) {
+            bytes({0x48, 0x81, 0xec});   // sub rsp, page
+            imm32(page);
+            bytes({0x48, 0x83, 0x0c, 0x24, 0x00}); // or qword [rsp], 0
+        }
+        bytes({0x48, 0x81, 0xec});       // sub rsp, rest of frame
+        imm32((frame - 1) % page + 1);
+        bytes({0x48, 0x89, 0xfb});       // mov rbx, rdi
+        bytes({0x49, 0x89, 0xf4});       // mov r12, rsi
+    }
+
+    void epilogue(std::uint32_t frame) {
+        bytes({0x48, 0x81, 0xc4});       // add rsp, frame
+        imm32(frame);
+        bytes({0x41, 0x5c});             // pop r12
+        bytes({0x5b});                   // pop rbx
+        bytes({0xc3});                   // ret
+    }
+
+    /// movsd xmm<r>, [rsp + 8k]
+    void load(int r, std::size_t k) { stack(0x10, r, k); }
+
+    /// movsd [rsp + 8k], xmm<r>
+    void store(std::size_t k, int r) { stack(0x11, r, k); }
+
+    /// movsd xmm0, [rbx + 8 slot]
+    void variable(std::uint32_t slot) {
+        bytes({0xf2, 0x0f, 0x10, 0x83});
+        imm32(8 * slot);
+    }
+
+    /// xmm<r> = value, through rax
+    void constant(int r, double value) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        bytes({0x48, 0xb8});             // mov rax, imm64
+        imm64(bits);
+        // movq xmm<r>, rax
+        bytes({0x66, 0x48, 0x0f, 0x6e, modrm(3, r, 0)});
+    }
+
+    /// movapd xmm1, xmm0
+    void save_top() { bytes({0x66, 0x0f, 0x28, 0xc8}); }
+
+    /// <op>sd xmm0, xmm1 for addsd, subsd and mulsd
+    void arithmetic(std::uint8_t op) { bytes({0xf2, 0x0f, op, 0xc1}); }
+
+    /// cmpsd xmm0, xmm1, predicate
+    void compare(std::uint8_t predicate) {
+        bytes({0xf2, 0x0f, 0xc2, 0xc1, predicate});
+    }
+
+    /// andpd xmm0, xmm<r>
+    void mask(int r) { bytes({0x66, 0x0f, 0x54, modrm(3, 0, r)}); }
+
+    /// xorpd xmm0, xmm<r>
+    void flip(int r) { bytes({0x66, 0x0f, 0x57, modrm(3, 0, r)}); }
+
+    /// xorpd xmm<r>, xmm<r>
+    void zero(int r) { bytes({0x66, 0x0f, 0x57, modrm(3, r, r)}); }
+
+    /// Compare xmm0 with zero, NaN is unordered and sets PF
+    void test_top() {
+        zero(1);
+        bytes({0x66, 0x0f, 0x2e, 0xc1}); // ucomisd xmm0, xmm1
+    }
+
+    /// j<cc> rel8 over the next @p n bytes
+    void skip(std::uint8_t cc, std::uint8_t n) {
+        bytes({static_cast<std::uint8_t>(0x70 | cc), n});
+    }
+
+    /// j<cc> rel32, or jmp rel32 if @p cc is always
+    ///
+    /// @return the position of the displacement, see resolve()
+    std::size_t jump(std::uint8_t cc) {
+        if (cc == always) {
+            bytes({0xe9});
+        } else {
+            bytes({0x0f, static_cast<std::uint8_t>(0x80 | cc)});
+        }
+        imm32(0);
+        return code.size() - 4;
+    }
+
+    /// Let the jump whose displacement is at @p at go to @p target
+    void resolve(std::size_t at, std::size_t target) {
+        std::uint32_t const rel = static_cast<std::uint32_t>(target - (at + 4));
+        for (int i = 0; i < 4; ++i) {
+            code[at + i] = static_cast<std::uint8_t>(rel >> 8 * i);
+        }
+    }
+
+    // Condition codes
+    static constexpr std::uint8_t equal = 0x4;
+    static constexpr std::uint8_t not_equal = 0x5;
+    static constexpr std::uint8_t parity = 0xa;
+    static constexpr std::uint8_t always = 0xff;
+
+    /// mov edi, n
+    void lanes(std::uint32_t n) {
+        bytes({0xbf});
+        imm32(n);
+    }
+
+    /// lea <reg>, [rsp + 8k] for rsi, rdx and rcx
+    void address(int reg, std::size_t k) {
+        bytes({0x48, 0x8d, modrm(2, reg, 4), 0x24});
+        imm32(static_cast<std::uint32_t>(8 * k));
+    }
+
+    /// mov <reg>, r12 for rdx, rcx and r8
+    void error(int reg) {
+        bytes({static_cast<std::uint8_t>(reg < 8 ? 0x4c : 0x4d), 0x89,
+               modrm(3, 4, reg & 7)});
+    }
+
+    /// mov rax, f; call rax
+    void call(void const *f) {
+        bytes({0x48, 0xb8});
+        imm64(reinterpret_cast<std::uintptr_t>(f));
+        bytes({0xff, 0xd0});
+    }
+
+private:
+    static std::uint8_t modrm(int mod, int reg, int rm) {
+        return static_cast<std::uint8_t>(mod << 6 | (reg & 7) << 3 | rm);
+    }
+
+    void stack(std::uint8_t op, int r, std::size_t k) {
+        bytes({0xf2, 0x0f, op, modrm(2, r, 4), 0x24});
+        imm32(static_cast<std::uint32_t>(8 * k));
+    }
+
+    void bytes(std::initializer_list<std::uint8_t> b) {
+        code.insert(code.end(), b.begin(), b.end());
+    }
+
+    void imm32(std::uint32_t v) {
+        for (int i = 0; i < 4; ++i) {
+            code.push_back(static_cast<std::uint8_t>(v >> 8 * i));
+        }
+    }
+
+    void imm64(std::uint64_t v) {
+        for (int i = 0; i < 8; ++i) {
+            code.push_back(static_cast<std::uint8_t>(v >> 8 * i));
+        }
+    }
+};
+
+// Registers in the encoding of the ModRM byte
+constexpr int rcx = 1;
+constexpr int rdx = 2;
+constexpr int rsi = 6;
+constexpr int r8 = 8;
+
+// Predicates of cmpsd, which are all false for NaN except neq
+constexpr std::uint8_t cmp_eq = 0;
+constexpr std::uint8_t cmp_lt = 1;
+constexpr std::uint8_t cmp_le = 2;
+constexpr std::uint8_t cmp_neq = 4;
+
+using binary_fn = double (*)(double, double);
+
+/// @brief Emit a comparison if @p f is one
+///
+/// The mask which cmpsd leaves in xmm0 is turned into 0 or 1 by
+/// masking it with 1.  Greater and greater equals swap the operands,
+/// so that NaN compares false just like in C++.
+bool comparison(assembler &a, binary_fn f, std::size_t lhs) {
+    bool swap = false;
+    std::uint8_t predicate;
+    if (f == static_cast<binary_fn>(&math::less)) {
+        predicate = cmp_lt;
+    } else if (f == static_cast<binary_fn>(&math::less_equals)) {
+        predicate = cmp_le;
+    } else if (f == static_cast<binary_fn>(&math::greater)) {
+        predicate = cmp_lt;
+        swap = true;
+    } else if (f == static_cast<binary_fn>(&math::greater_equals)) {
+        predicate = cmp_le;
+        swap = true;
+    } else if (f == static_cast<binary_fn>(&math::equals)) {
+        predicate = cmp_eq;
+    } else if (f == static_cast<binary_fn>(&math::not_equals)) {
+        predicate = cmp_neq;
+    } else {
+        return false;
+    }
+    if (swap) {
+        a.load(1, lhs);
+    } else {
+        a.save_top();
+        a.load(0, lhs);
+    }
+    a.compare(predicate);
+    a.constant(2, 1.0);
+    a.mask(2);
+    return true;
+}
+
+} // namespace
+
+function::function(void *memory, std::size_t size)
+    : memory(memory), size(size),
+      entry(reinterpret_cast<entry_fn>(memory)) {}
+
+function::~function() { munmap(memory, size); }
+
+bool available() { return true; }
+
+std::unique_ptr<function> compile(bytecode::program const &p) {
+    using bytecode::opcode;
+
+    if (p.code.empty() || p.stack_size + p.registers > max_stack) {
+        return nullptr;
+    }
+
+    // The registers of the program follow the value stack in the
+    // frame.  Together with the return address and the two saved
+    // registers the frame keeps the stack aligned to 16 bytes for calls
+    std::uint32_t frame =
+        static_cast<std::uint32_t>(8 * (p.stack_size + p.registers));
+    if (frame % 16 == 0) {
+        frame += 8;
+    }
+
+    assembler a;
+    a.prologue(frame);
+
+    // Jumps go forward, so the displacements are filled in at the end
+    // from the position of every instruction.  Both ways to a target
+    // leave the same number of values, the top one in xmm0.
+    std::size_t const unknown = static_cast<std::size_t>(-1);
+    std::vector<std::size_t> position(p.code.size() + 1);
+    std::vector<std::size_t> depth_at(p.code.size() + 1, unknown);
+    std::vector<std::pair<std::size_t, std::uint32_t>> jumps;
+    auto const jump = [&](std::uint8_t cc, std::uint32_t target,
+                          std::size_t depth) {
+        jumps.emplace_back(a.jump(cc), target);
+        depth_at[target] = depth;
+    };
+
+    // Number of values on the stack, the top one is in xmm0
+    std::size_t depth = 0;
+    for (std::size_t pc = 0; pc < p.code.size(); ++pc) {
+        bytecode::instruction const &i = p.code[pc];
+        bytecode::kernel const &k = p.kernels[pc];
+        position[pc] = a.code.size();
+        if (depth_at[pc] != unknown) {
+            depth = depth_at[pc];
+        }
+        switch (i.code) {
+        case opcode::constant:
+        case opcode::variable:
+            if (depth > 0) {
+                a.store(depth - 1, 0);
+            }
+            if (i.code == opcode::constant) {
+                a.constant(0, i.value);
+            } else {
+                a.variable(i.slot);
+            }
+            ++depth;
+            break;
+        case opcode::plus:
+        case opcode::minus:
+        case opcode::multiplies:
+            a.save_top();
+            a.load(0, depth - 2);
+            a.arithmetic(i.code == opcode::plus    ? 0x58
+                         : i.code == opcode::minus ? 0x5c
+                                                   : 0x59);
+            --depth;
+            break;
+        case opcode::negate:
+            a.constant(1, -0.0);
+            a.flip(1);
+            break;
+        case opcode::call1:
+            if (!k.unary) {
+                return nullptr;
+            }
+            a.store(depth - 1, 0);
+            a.lanes(1);
+            a.address(rsi, depth - 1);
+            a.error(rdx);
+            a.call(reinterpret_cast<void const *>(k.unary));
+            a.load(0, depth - 1);
+            break;
+        case opcode::call2:
+            if (comparison(a, i.binary, depth - 2)) {
+                --depth;
+                break;
+            }
+            if (!k.binary) {
+                return nullptr;
+            }
+            a.store(depth - 1, 0);
+            a.lanes(1);
+            a.address(rsi, depth - 2);
+            a.address(rdx, depth - 1);
+            a.error(rcx);
+            a.call(reinterpret_cast<void const *>(k.binary));
+            --depth;
+            a.load(0, depth - 1);
+            break;
+        case opcode::call3:
+            if (!k.ternary) {
+                return nullptr;
+            }
+            a.store(depth - 1, 0);
+            a.lanes(1);
+            a.address(rsi, depth - 3);
+            a.address(rdx, depth - 2);
+            a.address(rcx, depth - 1);
+            a.error(r8);
+            a.call(reinterpret_cast<void const *>(k.ternary));
+            depth -= 2;
+            a.load(0, depth - 1);
+            break;
+        case opcode::store:
+            a.store(p.stack_size + i.slot, 0);
+            break;
+        case opcode::load:
+            if (depth > 0) {
+                a.store(depth - 1, 0);
+            }
+            a.load(0, p.stack_size + i.slot);
+            ++depth;
+            break;
+        case opcode::jump:
+            jump(a.always, i.slot, depth);
+            break;
+        case opcode::jump_if_not:
+            // Loading the next value keeps the flags of the condition
+            a.test_top();
+            --depth;
+            if (depth > 0) {
+                a.load(0, depth - 1);
+            }
+            a.skip(a.parity, 6);
+            jump(a.equal, i.slot, depth);
+            break;
+        case opcode::and_then:
+            // NaN and anything but zero continue with the operand
+            a.test_top();
+            a.skip(a.parity, 2 + 4 + 5);
+            a.skip(a.not_equal, 4 + 5);
+            a.zero(0);
+            jump(a.always, i.slot, depth);
+            --depth;
+            if (depth > 0) {
+                a.load(0, depth - 1);
+            }
+            break;
+        case opcode::or_else:
+            a.test_top();
+            a.skip(a.parity, 2);
+            a.skip(a.equal, 15 + 5);
+            a.constant(0, 1.0);
+            jump(a.always, i.slot, depth);
+            --depth;
+            if (depth > 0) {
+                a.load(0, depth - 1);
+            }
+            break;
+        case opcode::boolean:
+            a.zero(1);
+            a.compare(cmp_neq);
+            a.constant(2, 1.0);
+            a.mask(2);
+            break;
+        }
+    }
+
+    position[p.code.size()] = a.code.size();
+    for (auto const &j : jumps) {
+        a.resolve(j.first, position[j.second]);
+    }
+    a.epilogue(frame);
+
+    std::size_t const page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    std::size_t const size = (a.code.size() + page - 1) / page * page;
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+    std::memcpy(memory, a.code.data(), a.code.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return nullptr;
+    }
+    return std::unique_ptr<function>(new function(memory, size));
+}
+
+#else
+
+function::function(void *memory, std::size_t size)
+    : memory(memory), size(size), entry(nullptr) {}
+
+function::~function() {}
+
+bool available() { return false; }
+
+std::unique_ptr<function> compile(bytecode::program const &) {
+    return nullptr;
+}
+
+#endif
+
+} // namespace jit
+
+} // namespace matheval
@@ -0,0 +1,66 @@
+#ifndef MATHEVAL_IMPLEMENTATION
+#error "Do not include jit.hpp directly!"
+#endif
+
+#pragma once
+
+#include "bytecode.hpp"
+#include "math.hpp"
+
+#include <cstddef>
+#include <memory>
+
+namespace matheval {
+
+namespace jit {
+
+/// @brief Native machine code for a program
+///
+/// The code lives in pages of its own which are writable while the
+/// code is emitted and executable afterwards, never both at once.
+class function {
+public:
+    using entry_fn = double (*)(double const *values, math::error *err);
+
+    function(void *memory, std::size_t size);
+    ~function();
+
+    function(function const &) = delete;
+    function &operator=(function const &) = delete;
+
+    /// @brief Execute the program without throwing
+    ///
+    /// Like bytecode::program::run(double const *, math::error &), but
+    /// @p err must be cleared by the caller and the result of a failing
+    /// program is unspecified.
+    double operator()(double const *values, math::error &err) const {
+        return entry(values, &err);
+    }
+
+private:
+    void *memory;
+    std::size_t size;
+    entry_fn entry;
+};
+
+/// @brief Whether native code can be generated on this platform
+///
+/// Code is only generated for x86-64 with the System V calling
+/// convention.
+bool available();
+
+/// @brief Translate a program into machine code
+///
+/// Additions, subtractions, multiplications, negations and
+/// comparisons are inlined, conditionals become branches, and all
+/// other functions call the kernel of the instruction with a single
+/// lane.  The kernels never throw, so
+/// no exception has to unwind through the generated code.
+///
+/// @return nullptr if the platform is not supported, if a function
+///         has no kernel or if the program needs too deep a stack
+std::unique_ptr<function> compile(bytecode::program const &p);
+
+} // namespace jit
+
+} // namespace matheval
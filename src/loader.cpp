@@ -0,0 +1,192 @@
+#define MATHEVAL_IMPLEMENTATION
+
+#include "matheval.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MATHEVAL_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace matheval {
+
+namespace {
+
+/// Entries which one task parses, so that the executor is not called
+/// for every single entry
+constexpr std::size_t entries_per_task = 64;
+
+/// @brief An entry which is not blank
+struct slice {
+    std::size_t entry;
+    std::size_t offset;
+    std::size_t size;
+};
+
+bool blank(char const *first, char const *last) {
+    for (; first != last; ++first) {
+        if (*first != ' ' && (*first < '\t' || *first > '\r')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<slice> split(char const *data, std::size_t size, char delimiter) {
+    std::vector<slice> slices;
+    char const *const last = data + size;
+    char const *first = data;
+    for (std::size_t entry = 0; first != last; ++entry) {
+        auto end = static_cast<char const *>(
+            std::memchr(first, delimiter, static_cast<std::size_t>(last - first)));
+        if (end == nullptr) {
+            end = last;
+        }
+        if (!blank(first, end)) {
+            slices.push_back(
+                {entry, static_cast<std::size_t>(first - data),
+                 static_cast<std::size_t>(end - first)});
+        }
+        first = end == last ? last : end + 1;
+    }
+    return slices;
+}
+
+/// @brief Parse and compile the entries of one task
+void load(char const *data, slice const *first, slice const *last,
+          LoadedExpressions &result) {
+    // Reusing the parser also reuses the memory of its tree
+    static thread_local Parser parser;
+    for (; first != last; ++first) {
+        try {
+            parser.parse(data + first->offset, first->size);
+        } catch (parse_error const &e) {
+            result.errors.push_back({first->entry, first->offset, e.diagnostic()});
+            continue;
+        }
+        parser.optimize();
+        result.expressions.emplace_back(parser);
+        result.entries.push_back(first->entry);
+    }
+}
+
+/// @brief The contents of a file, mapped into memory if possible
+class file {
+public:
+    explicit file(std::string const &path) {
+#ifdef MATHEVAL_MMAP
+        int const fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            fail(path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            int const error = errno;
+            ::close(fd);
+            errno = error;
+            fail(path);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        if (size_ != 0) {
+            void *memory = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (memory == MAP_FAILED) {
+                int const error = errno;
+                ::close(fd);
+                errno = error;
+                fail(path);
+            }
+            // All of the file is read right away, by many threads
+            ::posix_madvise(memory, size_, POSIX_MADV_WILLNEED);
+            data_ = static_cast<char const *>(memory);
+        }
+        ::close(fd);
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            fail(path);
+        }
+        contents.assign(std::istreambuf_iterator<char>(in),
+                        std::istreambuf_iterator<char>());
+        data_ = contents.data();
+        size_ = contents.size();
+#endif
+    }
+
+    file(file const &) = delete;
+    file &operator=(file const &) = delete;
+
+    ~file() {
+#ifdef MATHEVAL_MMAP
+        if (data_ != nullptr) {
+            ::munmap(const_cast<char *>(data_), size_);
+        }
+#endif
+    }
+
+    char const *data() const { return data_; }
+
+    std::size_t size() const { return size_; }
+
+private:
+    [[noreturn]] static void fail(std::string const &path) {
+        throw matheval::exception("Cannot read " + path + ": " + // NOLINT
+                                  std::strerror(errno));
+    }
+
+    char const *data_ = nullptr;
+    std::size_t size_ = 0;
+#ifndef MATHEVAL_MMAP
+    std::string contents;
+#endif
+};
+
+} // namespace
+
+LoadedExpressions load_expressions(char const *data, std::size_t size,
+                                   char delimiter, Executor &executor) {
+    std::vector<slice> const slices = split(data, size, delimiter);
+    std::size_t const tasks =
+        (slices.size() + entries_per_task - 1) / entries_per_task;
+
+    // Every task fills its own part, and the parts are joined in the
+    // order of the input
+    std::vector<LoadedExpressions> parts(tasks);
+    executor.parallel_for(tasks, [&](std::size_t t) {
+        slice const *first = slices.data() + t * entries_per_task;
+        slice const *last = t + 1 == tasks ? slices.data() + slices.size()
+                                           : first + entries_per_task;
+        load(data, first, last, parts[t]);
+    });
+
+    LoadedExpressions result;
+    result.expressions.reserve(slices.size());
+    result.entries.reserve(slices.size());
+    for (LoadedExpressions &part : parts) {
+        std::move(part.expressions.begin(), part.expressions.end(),
+                  std::back_inserter(result.expressions));
+        result.entries.insert(result.entries.end(), part.entries.begin(),
+                              part.entries.end());
+        result.errors.insert(result.errors.end(), part.errors.begin(),
+                             part.errors.end());
+    }
+    return result;
+}
+
+LoadedExpressions load_expression_file(std::string const &path,
+                                       char delimiter, Executor &executor) {
+    file const f(path);
+    return load_expressions(f.data(), f.size(), delimiter, executor);
+}
+
+} // namespace matheval
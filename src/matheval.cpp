@@ -0,0 +1,362 @@
+#define MATHEVAL_IMPLEMENTATION
+
+#include "parser_impl.hpp"
+#include "evaluator.hpp"
+#include "jit.hpp"
+#include "serialize.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace matheval {
+
+parse_error::parse_error(parse_diagnostic const &d)
+    : exception(std::string("Expected ") + d.expected + " in " + d.rule +
+                " at offset " + std::to_string(d.offset)),
+      diag(d) {}
+
+void Parser::impl::reset() {
+    std::swap(ast, spare);
+    compiled = false;
+    native = false;
+}
+
+Parser::optimization Parser::impl::optimize() {
+    Parser::optimization stats;
+    std::size_t const size = ast.nodes.size();
+    ast = ast::ConstantFolder()(ast);
+    stats.folded = size - ast.nodes.size();
+    ast = ast::AlgebraicSimplifier()(ast, stats.simplified);
+    std::size_t const simplified = ast.nodes.size();
+    ast = ast::CommonSubexpressionEliminator()(ast);
+    stats.eliminated = simplified - ast.nodes.size();
+    if (compiled) {
+        compile();
+    }
+    return stats;
+}
+
+void Parser::impl::compile() {
+    program = bytecode::compile(ast, ast.variables);
+    if (native) {
+        program.native = jit::compile(program);
+    }
+    compiled = true;
+}
+
+bool Parser::impl::compile_native() {
+    native = true;
+    compile();
+    return program.native != nullptr;
+}
+
+double Parser::impl::evaluate(Parser::variable_callback_fn fn) {
+    if (compiled) {
+        return program.run(fn);
+    }
+    return ast::eval(fn)(ast);
+}
+
+double Parser::impl::evaluate(double const *values) {
+    if (!compiled) {
+        compile();
+    }
+    return program.run(values);
+}
+
+void Parser::impl::evaluate(std::size_t rows, double const *const *columns,
+                            double *results) {
+    if (!compiled) {
+        compile();
+    }
+    program.run(rows, columns, results);
+}
+
+double Parser::impl::evaluate(double const *values, errc &error) {
+    if (!compiled) {
+        compile();
+    }
+    return program.run(values, error);
+}
+
+void Parser::impl::evaluate(std::size_t rows, double const *const *columns,
+                            double *results, errc *errors) {
+    if (!compiled) {
+        compile();
+    }
+    program.run(rows, columns, results, errors);
+}
+
+void Parser::impl::evaluate_parallel(std::size_t rows,
+                                     double const *const *columns,
+                                     double *results, Executor &executor) {
+    if (!compiled) {
+        compile();
+    }
+    program.run(executor, rows, columns, results);
+}
+
+void Parser::impl::evaluate_parallel(std::size_t rows,
+                                     double const *const *columns,
+                                     double *results, errc *errors,
+                                     Executor &executor) {
+    if (!compiled) {
+        compile();
+    }
+    program.run(executor, rows, columns, results, errors);
+}
+
+Parser::Parser() : pimpl(new Parser::impl()) {}
+
+Parser::~Parser() {}
+
+void Parser::parse(std::string const &expr) {
+    pimpl->parse(expr.data(), expr.data() + expr.size());
+}
+
+void Parser::parse(char const *expr, std::size_t size) {
+    pimpl->parse(expr, expr + size);
+}
+
+Parser::optimization Parser::optimize() { return pimpl->optimize(); }
+
+void Parser::compile() { pimpl->compile(); }
+
+bool Parser::compile_native() { return pimpl->compile_native(); }
+
+std::string Parser::serialize() const {
+    std::string bytes;
+    serial::write(pimpl->ast, bytes);
+    return bytes;
+}
+
+std::size_t Parser::deserialize(char const *data, std::size_t size) {
+    std::size_t const read = serial::read(data, size, pimpl->spare);
+    pimpl->reset();
+    return read;
+}
+
+std::vector<std::string> const &Parser::variables() const {
+    return pimpl->ast.variables;
+}
+
+double Parser::evaluate(Parser::variable_callback_fn fn) {
+    return pimpl->evaluate(fn);
+}
+
+double Parser::evaluate(double const *values) {
+    return pimpl->evaluate(values);
+}
+
+void Parser::evaluate(std::size_t rows, double const *const *columns,
+                      double *results) {
+    pimpl->evaluate(rows, columns, results);
+}
+
+double Parser::evaluate(double const *values, errc &error) {
+    return pimpl->evaluate(values, error);
+}
+
+void Parser::evaluate(std::size_t rows, double const *const *columns,
+                      double *results, errc *errors) {
+    pimpl->evaluate(rows, columns, results, errors);
+}
+
+void Parser::evaluate_parallel(std::size_t rows, double const *const *columns,
+                               double *results, Executor &executor) {
+    pimpl->evaluate_parallel(rows, columns, results, executor);
+}
+
+void Parser::evaluate_parallel(std::size_t rows, double const *const *columns,
+                               double *results, errc *errors,
+                               Executor &executor) {
+    pimpl->evaluate_parallel(rows, columns, results, errors, executor);
+}
+
+double Parser::evaluate(std::vector<double> const &values) {
+    if (values.size() < pimpl->ast.variables.size()) {
+        throw matheval::invalid_argument("Expected " + std::to_string(pimpl->ast.variables.size()) + " variables but got " + std::to_string(values.size())); // NOLINT
+    }
+    return pimpl->evaluate(values.data());
+}
+
+CompiledExpression::CompiledExpression(Parser const &parser)
+    : pimpl(std::make_shared<impl const>(
+          parser.pimpl->compiled
+              ? parser.pimpl->program
+              : bytecode::compile(parser.pimpl->ast, parser.pimpl->ast.variables))) {}
+
+std::vector<std::string> const &CompiledExpression::variables() const {
+    return pimpl->program.variables;
+}
+
+double CompiledExpression::evaluate(variable_callback_fn fn) const {
+    return pimpl->program.run(fn);
+}
+
+double CompiledExpression::evaluate(double const *values) const {
+    return pimpl->program.run(values);
+}
+
+double CompiledExpression::evaluate(std::vector<double> const &values) const {
+    if (values.size() < pimpl->program.variables.size()) {
+        throw matheval::invalid_argument("Expected " + std::to_string(pimpl->program.variables.size()) + " variables but got " + std::to_string(values.size())); // NOLINT
+    }
+    return pimpl->program.run(values.data());
+}
+
+void CompiledExpression::evaluate(std::size_t rows,
+                                  double const *const *columns,
+                                  double *results) const {
+    pimpl->program.run(rows, columns, results);
+}
+
+double CompiledExpression::evaluate(double const *values, errc &error) const {
+    return pimpl->program.run(values, error);
+}
+
+void CompiledExpression::evaluate(std::size_t rows,
+                                  double const *const *columns,
+                                  double *results, errc *errors) const {
+    pimpl->program.run(rows, columns, results, errors);
+}
+
+void CompiledExpression::evaluate_parallel(std::size_t rows,
+                                           double const *const *columns,
+                                           double *results,
+                                           Executor &executor) const {
+    pimpl->program.run(executor, rows, columns, results);
+}
+
+void CompiledExpression::evaluate_parallel(std::size_t rows,
+                                           double const *const *columns,
+                                           double *results, errc *errors,
+                                           Executor &executor) const {
+    pimpl->program.run(executor, rows, columns, results, errors);
+}
+
+IncrementalExpression::IncrementalExpression(Parser const &parser)
+    : pimpl(new impl(parser.pimpl->ast)) {}
+
+IncrementalExpression::~IncrementalExpression() = default;
+
+IncrementalExpression::IncrementalExpression(
+    IncrementalExpression &&) noexcept = default;
+
+IncrementalExpression &
+IncrementalExpression::operator=(IncrementalExpression &&) noexcept = default;
+
+std::vector<std::string> const &IncrementalExpression::variables() const {
+    return pimpl->eval.ast().variables;
+}
+
+double IncrementalExpression::evaluate(double const *values) {
+    return pimpl->eval(values);
+}
+
+double IncrementalExpression::evaluate(std::vector<double> const &values) {
+    if (values.size() < variables().size()) {
+        throw matheval::invalid_argument("Expected " + std::to_string(variables().size()) + " variables but got " + std::to_string(values.size())); // NOLINT
+    }
+    return pimpl->eval(values.data());
+}
+
+std::size_t IncrementalExpression::recomputed() const {
+    return pimpl->eval.recomputed();
+}
+
+template <typename T>
+TypedExpression<T>::TypedExpression(Parser const &parser)
+    : pimpl(std::make_shared<impl const>(parser.pimpl->ast)) {}
+
+template <typename T>
+std::vector<std::string> const &TypedExpression<T>::variables() const {
+    return pimpl->eval.ast().variables;
+}
+
+template <typename T>
+T TypedExpression<T>::evaluate(T const *values) const {
+    return pimpl->eval(values);
+}
+
+template <typename T>
+T TypedExpression<T>::evaluate(std::vector<T> const &values) const {
+    if (values.size() < variables().size()) {
+        throw matheval::invalid_argument("Expected " + std::to_string(variables().size()) + " variables but got " + std::to_string(values.size())); // NOLINT
+    }
+    return pimpl->eval(values.data());
+}
+
+template <typename T>
+void TypedExpression<T>::evaluate(std::size_t rows, T const *const *columns,
+                                  T *results) const {
+    pimpl->eval(rows, columns, results);
+}
+
+template class TypedExpression<float>;
+template class TypedExpression<double>;
+
+GradientExpression::GradientExpression(Parser const &parser,
+                                       std::vector<std::string> const &wrt)
+    : pimpl(std::make_shared<impl const>(parser.pimpl->ast, wrt)) {}
+
+std::vector<std::string> const &GradientExpression::variables() const {
+    return pimpl->eval.ast().variables;
+}
+
+std::vector<std::string> const &GradientExpression::with_respect_to() const {
+    return pimpl->eval.with_respect_to();
+}
+
+double GradientExpression::evaluate(double const *values,
+                                    double *gradient) const {
+    return pimpl->eval(values, gradient);
+}
+
+double GradientExpression::evaluate(std::vector<double> const &values,
+                                    std::vector<double> &gradient) const {
+    if (values.size() < variables().size()) {
+        throw matheval::invalid_argument("Expected " + std::to_string(variables().size()) + " variables but got " + std::to_string(values.size())); // NOLINT
+    }
+    gradient.resize(with_respect_to().size());
+    return pimpl->eval(values.data(), gradient.data());
+}
+
+ExpressionSet::ExpressionSet(std::vector<std::string> const &exprs) {
+    ast::forest forest;
+    Parser parser;
+    for (std::string const &expr : exprs) {
+        parser.parse(expr);
+        parser.optimize();
+        forest.add(parser.pimpl->ast);
+    }
+    pimpl = std::make_shared<impl const>(
+        ast::CommonSubexpressionEliminator()(forest));
+}
+
+std::size_t ExpressionSet::size() const { return pimpl->forest.roots.size(); }
+
+std::vector<std::string> const &ExpressionSet::variables() const {
+    return pimpl->forest.shared.variables;
+}
+
+std::size_t ExpressionSet::nodes() const {
+    return pimpl->forest.shared.nodes.size();
+}
+
+void ExpressionSet::evaluate(double const *values, double *results) const {
+    ast::forest_eval()(pimpl->forest, values, results);
+}
+
+std::vector<double>
+ExpressionSet::evaluate(std::vector<double> const &values) const {
+    if (values.size() < variables().size()) {
+        throw matheval::invalid_argument("Expected " + std::to_string(variables().size()) + " variables but got " + std::to_string(values.size())); // NOLINT
+    }
+    std::vector<double> results(size());
+    evaluate(values.data(), results.data());
+    return results;
+}
+
+} // namespace matheval
@@ -0,0 +1,106 @@
+#ifndef MATHEVAL_IMPLEMENTATION
+#error "Do not include parser_impl.hpp directly!"
+#endif
+
+#pragma once
+
+#include "matheval.hpp"
+#include "ast.hpp"
+#include "bytecode.hpp"
+#include "evaluator.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace matheval {
+
+class Parser::impl {
+public:
+    ast::tree ast;
+    /// The tree which is being parsed, kept to reuse its memory
+    ast::tree spare;
+    bytecode::program program;
+    bool compiled = false;
+    /// Whether the program is translated into machine code
+    bool native = false;
+
+    /// @brief Parse the expression [@p first, @p last) into the
+    ///        abstract syntax tree
+    ///
+    /// This is the only part that depends on the Spirit backend, so
+    /// it is defined in the matheval.cpp of each backend.  The tree is
+    /// built in @c spare, so that the previous tree survives a parse
+    /// error.
+    void parse(char const *first, char const *last);
+
+    /// @brief Replace the tree by the spare one and discard everything
+    ///        derived from the previous tree
+    ///
+    /// Must be called by parse() after the new tree has been built.
+    void reset();
+
+    Parser::optimization optimize();
+
+    void compile();
+
+    bool compile_native();
+
+    double evaluate(Parser::variable_callback_fn fn);
+
+    double evaluate(double const *values);
+
+    void evaluate(std::size_t rows, double const *const *columns,
+                  double *results);
+
+    double evaluate(double const *values, errc &error);
+
+    void evaluate(std::size_t rows, double const *const *columns,
+                  double *results, errc *errors);
+
+    void evaluate_parallel(std::size_t rows, double const *const *columns,
+                           double *results, Executor &executor);
+
+    void evaluate_parallel(std::size_t rows, double const *const *columns,
+                           double *results, errc *errors,
+                           Executor &executor);
+};
+
+class CompiledExpression::impl {
+public:
+    bytecode::program program;
+
+    explicit impl(bytecode::program p) : program(std::move(p)) {}
+};
+
+class IncrementalExpression::impl {
+public:
+    ast::incremental_eval eval;
+
+    explicit impl(ast::tree t) : eval(std::move(t)) {}
+};
+
+template <typename T>
+class TypedExpression<T>::impl {
+public:
+    ast::typed_eval<T> eval;
+
+    explicit impl(ast::tree t) : eval(std::move(t)) {}
+};
+
+class GradientExpression::impl {
+public:
+    ast::gradient_eval eval;
+
+    impl(ast::tree t, std::vector<std::string> wrt)
+        : eval(std::move(t), std::move(wrt)) {}
+};
+
+class ExpressionSet::impl {
+public:
+    ast::forest forest;
+
+    explicit impl(ast::forest f) : forest(std::move(f)) {}
+};
+
+} // namespace matheval
@@ -0,0 +1,21 @@
+#define MATHEVAL_IMPLEMENTATION
+
+#include "../parser_impl.hpp"
+#include "parser.hpp"
+
+namespace matheval {
+
+void Parser::impl::parse(char const *first, char const *last) {
+    ast::builder builder(spare);
+
+    parser::failure failure(first, last);
+
+    parser::precedence_parser p(first, last, builder, failure);
+    if (!p()) {
+        throw matheval::parse_error(failure.diagnose(p.rest())); // NOLINT
+    }
+
+    reset();
+}
+
+} // namespace matheval
@@ -0,0 +1,254 @@
+#define MATHEVAL_IMPLEMENTATION
+
+#include "parser.hpp"
+#include "../ast.hpp"
+#include "builtins.hpp"
+
+#include <boost/spirit/include/qi_parse.hpp>
+#include <boost/spirit/include/qi_real.hpp>
+
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+
+namespace matheval {
+
+namespace parser {
+
+namespace {
+
+// Binding powers of the binary operators, from the loosest
+constexpr int logical_power = 1;
+constexpr int equality_power = 2;
+constexpr int relational_power = 3;
+constexpr int additive_power = 4;
+constexpr int multiplicative_power = 5;
+constexpr int power_power = 6;
+
+/// @brief The operand of the binary operators of a binding power and
+///        the operator's rule, as named in the Spirit grammars
+struct level {
+    char const *operand;
+    char const *rule;
+};
+
+constexpr level levels[] = {
+    {"", ""},
+    {"equality", "logical"},
+    {"relational", "equality"},
+    {"additive", "relational"},
+    {"multiplicative", "additive"},
+    {"factor", "multiplicative"},
+    {"factor", "factor"},
+};
+
+/// The rules of the functions by their arity
+constexpr char const *calls[] = {"", "unary", "binary", "ternary"};
+
+bool space(char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; }
+
+bool alpha(char c) { return std::isalpha(static_cast<unsigned char>(c)) != 0; }
+
+bool alnum(char c) { return std::isalnum(static_cast<unsigned char>(c)) != 0; }
+
+} // namespace
+
+bool precedence_parser::operator()() {
+    if (!expression(0)) {
+        pos = first;
+        return false;
+    }
+    skip();
+    return pos == last;
+}
+
+bool precedence_parser::expression(int power) {
+    if (!primary()) {
+        return false;
+    }
+    for (;;) {
+        skip();
+        infix_operator const op = infix();
+        if (op.power <= power) {
+            return true;
+        }
+        pos += op.length;
+        // The right operand of a left-associative operator stops at
+        // the next operator of the same level
+        int const right = op.power == power_power ? op.power - 1 : op.power;
+        char const *const start = pos;
+        if (!expression(right)) {
+            return fail(start, levels[op.power].operand, levels[op.power].rule);
+        }
+        builder.binary(op.f);
+    }
+}
+
+bool precedence_parser::primary() {
+    skip();
+    if (number()) {
+        return true;
+    }
+    if (pos != last && *pos == '(') {
+        ++pos;
+        char const *const start = pos;
+        if (!expression(0)) {
+            return fail(start, "expression", "primary");
+        }
+        return expect(')', "primary");
+    }
+    builtins::unary_fn u = nullptr;
+    if (match(builtins::unary_operators, u)) {
+        char const *const start = pos;
+        if (!primary()) {
+            return fail(start, "primary", "primary");
+        }
+        builder.unary(u);
+        return true;
+    }
+    builtins::ternary_fn t = nullptr;
+    if (match(builtins::ternary_functions, t)) {
+        if (!call(3)) {
+            return false;
+        }
+        builder.ternary(t);
+        return true;
+    }
+    builtins::binary_fn b = nullptr;
+    if (match(builtins::binary_functions, b)) {
+        if (!call(2)) {
+            return false;
+        }
+        builder.binary(b);
+        return true;
+    }
+    if (match(builtins::unary_functions, u)) {
+        if (!call(1)) {
+            return false;
+        }
+        builder.unary(u);
+        return true;
+    }
+    double c = 0;
+    if (match(builtins::constants, c)) {
+        builder.constant(c);
+        return true;
+    }
+    return variable();
+}
+
+bool precedence_parser::number() {
+    namespace qi = boost::spirit::qi;
+    double value = 0;
+    char const *it = pos;
+    if (!qi::parse(it, last, qi::double_, value)) {
+        return false;
+    }
+    pos = it;
+    builder.constant(value);
+    return true;
+}
+
+bool precedence_parser::variable() {
+    if (pos == last || !alpha(*pos)) {
+        return false;
+    }
+    char const *const begin = pos;
+    while (pos != last && (alnum(*pos) || *pos == '_')) {
+        ++pos;
+    }
+    builder.variable(begin, pos);
+    return true;
+}
+
+bool precedence_parser::call(std::size_t arity) {
+    char const *const rule = calls[arity];
+    if (!expect('(', rule)) {
+        return false;
+    }
+    for (std::size_t k = 0; k < arity; ++k) {
+        if (k > 0 && !expect(',', rule)) {
+            return false;
+        }
+        char const *const start = pos;
+        if (!expression(0)) {
+            return fail(start, "expression", rule);
+        }
+    }
+    return expect(')', rule);
+}
+
+precedence_parser::infix_operator precedence_parser::infix() const {
+    // The operators of different levels never start alike, except for
+    // * and **, so the longest operator of all levels is the one which
+    // the Spirit grammars find
+    infix_operator op{nullptr, 0, 0};
+    prefer(builtins::logical_operators, logical_power, op);
+    prefer(builtins::equality_operators, equality_power, op);
+    prefer(builtins::relational_operators, relational_power, op);
+    prefer(builtins::additive_operators, additive_power, op);
+    prefer(builtins::multiplicative_operators, multiplicative_power, op);
+    prefer(builtins::power_operators, power_power, op);
+    return op;
+}
+
+template <std::size_t N>
+void precedence_parser::prefer(
+    builtins::symbol<builtins::binary_fn> const (&table)[N], int power,
+    infix_operator &op) const {
+    builtins::binary_fn f = nullptr;
+    std::size_t const length = longest(table, f);
+    if (length > op.length) {
+        op = infix_operator{f, length, power};
+    }
+}
+
+template <typename T, std::size_t N>
+bool precedence_parser::match(builtins::symbol<T> const (&table)[N],
+                              T &value) {
+    std::size_t const n = longest(table, value);
+    pos += n;
+    return n != 0;
+}
+
+template <typename T, std::size_t N>
+std::size_t
+precedence_parser::longest(builtins::symbol<T> const (&table)[N],
+                           T &value) const {
+    std::size_t const available = static_cast<std::size_t>(last - pos);
+    std::size_t result = 0;
+    for (builtins::symbol<T> const &entry : table) {
+        std::size_t const n = std::strlen(entry.name);
+        if (n > result && n <= available &&
+            std::memcmp(pos, entry.name, n) == 0) {
+            result = n;
+            value = entry.value;
+        }
+    }
+    return result;
+}
+
+void precedence_parser::skip() {
+    while (pos != last && space(*pos)) {
+        ++pos;
+    }
+}
+
+bool precedence_parser::expect(char c, char const *rule) {
+    skip();
+    if (pos == last || *pos != c) {
+        return fail(pos, punctuation(c), rule);
+    }
+    ++pos;
+    return true;
+}
+
+bool precedence_parser::fail(char const *where, char const *expected,
+                             char const *rule) {
+    failure.record(where, expected, rule);
+    return false;
+}
+
+} // namespace parser
+
+} // namespace matheval
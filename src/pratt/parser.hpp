@@ -0,0 +1,116 @@
+#ifndef MATHEVAL_IMPLEMENTATION
+#error "Do not include parser.hpp directly!"
+#endif
+
+#pragma once
+
+#include "../ast.hpp"
+#include "../failure.hpp"
+#include "builtins.hpp"
+
+#include <cstddef>
+
+namespace matheval {
+
+namespace parser {
+
+/// @brief A hand-written operator precedence parser
+///
+/// The parser reads the input once from left to right and never
+/// backtracks.  Binary operators are parsed by precedence climbing
+/// instead of one rule per level, so an operand costs one call
+/// regardless of the number of precedence levels.  It accepts the
+/// same language as the Spirit grammars and reports the same
+/// operands in the same order to @c builder, which therefore builds
+/// the same tree:
+///
+/// - The precedence levels, from the loosest, are the logical,
+///   equality, relational, additive and multiplicative operators, and
+///   the power operator.  All of them are left-associative except for
+///   the power, which is right-associative.
+/// - A unary operator applies to the primary which follows it, so
+///   @c -x**2 is @c (-x)**2.
+/// - Numbers are read by Spirit's @c double_, so a sign in front of
+///   the digits belongs to the number and the values are the same
+///   bits as those of the other parsers.
+/// - Names are looked up in the tables of builtins.hpp in the order
+///   of the alternatives of @c primary_def, and the longest entry
+///   which is a prefix of the input wins, like in @c x3::symbols.
+/// - A failed expectation is recorded in @c failure with the names of
+///   the rules of the Spirit grammars.
+class precedence_parser {
+public:
+    /// @brief Parse [@p first, @p last) into @p builder
+    precedence_parser(char const *first, char const *last,
+                      ast::builder &builder, parser::failure &failure)
+        : first(first), last(last), pos(first), builder(builder),
+          failure(failure) {}
+
+    /// @brief Parse the whole input
+    ///
+    /// @return false if the input is not an expression, or if text is
+    ///         left after the expression
+    bool operator()();
+
+    /// @brief Where the unparsed rest of the input starts
+    ///
+    /// Like the Spirit parsers this is the start of the input if the
+    /// expression failed, and the text after the expression if that
+    /// was not the whole input.
+    char const *rest() const { return pos; }
+
+private:
+    bool expression(int power);
+    bool primary();
+    bool number();
+    bool variable();
+    bool call(std::size_t arity);
+
+    /// @brief A binary operator in the input
+    struct infix_operator {
+        builtins::binary_fn f;
+        std::size_t length; ///< number of characters
+        int power;          ///< binding power, 0 if there is no operator
+    };
+
+    /// @brief The binary operator at the current position
+    infix_operator infix() const;
+
+    /// @brief Replace @p op by the longest operator of @p table at the
+    ///        current position if that is longer
+    template <std::size_t N>
+    void prefer(builtins::symbol<builtins::binary_fn> const (&table)[N],
+                int power, infix_operator &op) const;
+
+    /// @brief Consume the longest entry of @p table at the current
+    ///        position
+    template <typename T, std::size_t N>
+    bool match(builtins::symbol<T> const (&table)[N], T &value);
+
+    /// @brief Length of the longest entry of @p table at the current
+    ///        position, which is 0 if there is none
+    template <typename T, std::size_t N>
+    std::size_t longest(builtins::symbol<T> const (&table)[N],
+                        T &value) const;
+
+    void skip();
+
+    /// @brief Consume @p c, which the rule @p rule expects
+    bool expect(char c, char const *rule);
+
+    /// @brief Record that @p expected was not found at @p where in the
+    ///        rule @p rule
+    ///
+    /// @return false
+    bool fail(char const *where, char const *expected, char const *rule);
+
+    char const *const first;
+    char const *const last;
+    char const *pos;
+    ast::builder &builder;
+    parser::failure &failure;
+};
+
+} // namespace parser
+
+} // namespace matheval
@@ -1,56 +1,26 @@
 #define MATHEVAL_IMPLEMENTATION
 
-#include "matheval.hpp"
-#include "ast.hpp"
-#include "../evaluator.hpp"
+#include "../parser_impl.hpp"
 #include "parser.hpp"
 
-#include <memory>
-#include <stdexcept>
-#include <string>
-
 namespace matheval {
 
-class Parser::impl {
-    ast::operand ast;
-
-public:
-    void parse(std::string const &expr) {
-        ast::expression ast_;
-
-        std::string::const_iterator first = expr.begin();
-        std::string::const_iterator last = expr.end();
-
-        boost::spirit::ascii::space_type space;
-        bool r = qi::phrase_parse(
-            first, last, grammar(), space,
-            ast_);
-
-        if (!r || first != last) {
-            std::string rest(first, last);
-            throw matheval::parse_error("Parsing failed at " + rest); // NOLINT
-        }
+void Parser::impl::parse(char const *first, char const *last) {
+    ast::builder builder(spare);
 
-        ast = ast_;
-    }
+    parser::failure failure(first, last);
+    char const *const begin = first;
 
-    void optimize() { ast = boost::apply_visitor(ast::ConstantFolder(), ast); }
+    boost::spirit::ascii::space_type space;
+    bool r = qi::phrase_parse(
+        first, last, grammar(builder, failure), space);
 
-    double evaluate(Parser::variable_callback_fn fn) {
-        return boost::apply_visitor(ast::eval(fn), ast);
+    if (!r || first != last || failure) {
+        throw matheval::parse_error( // NOLINT
+            failure.diagnose(r ? first : begin));
     }
-};
-
-Parser::Parser() : pimpl(new Parser::impl()) {}
-
-Parser::~Parser() {}
-
-void Parser::parse(std::string const &expr) { pimpl->parse(expr); }
-
-void Parser::optimize() { pimpl->optimize(); }
 
-double Parser::evaluate(Parser::variable_callback_fn fn) {
-    return pimpl->evaluate(fn);
+    reset();
 }
 
 } // namespace matheval
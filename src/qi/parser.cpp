@@ -4,6 +4,6 @@
 
 namespace matheval {
 
-template struct parser::grammar<std::string::const_iterator>;
+template struct parser::grammar<char const *>;
 
 } // namespace matheval
@@ -4,13 +4,13 @@
 
 #pragma once
 
-#include "ast.hpp"
+#include "../ast.hpp"
+#include "../failure.hpp"
 
 #define BOOST_SPIRIT_NO_PREDEFINED_TERMINALS
+#include <boost/range/iterator_range.hpp>
 #include <boost/spirit/include/qi.hpp>
 
-#include <sstream>
-
 namespace matheval {
 
 namespace qi = boost::spirit::qi;
@@ -18,31 +18,36 @@ namespace ascii = boost::spirit::ascii;
 
 namespace parser {
 
+/// @brief Records a failed expectation in a parser::failure
 struct expectation_handler {
     template <typename>
     struct result {
         typedef void type;
     };
 
-    template <typename Iterator>
-    void operator()(Iterator first, Iterator last,
-                    boost::spirit::info const &info) const {
-        std::ostringstream msg;
-        msg << "Expected " << info << " at \"" << std::string(first, last) << '"';
-        throw matheval::parse_error(msg.str()); // NOLINT
+    template <typename Range>
+    void operator()(Range const &where, char const *expected,
+                    char const *rule) const {
+        failure.record(where.begin(), expected, rule);
     }
+
+    parser::failure &failure;
 };
 
+/// @brief The grammar reports every finished operand to @c builder
+///        and the first failed expectation to @c failure
 template <typename Iterator>
-struct grammar : qi::grammar<Iterator, ast::expression(), ascii::space_type> {
+struct grammar : qi::grammar<Iterator, ascii::space_type> {
     expectation_handler err_handler;
-    qi::rule<Iterator, ast::expression(), ascii::space_type> expression,
-        logical, equality, relational, additive, multiplicative, factor;
-    qi::rule<Iterator, ast::operand(), ascii::space_type> primary;
-    qi::rule<Iterator, ast::unary_op(), ascii::space_type> unary;
-    qi::rule<Iterator, ast::binary_op(), ascii::space_type> binary;
-    qi::rule<Iterator, ast::ternary_op(), ascii::space_type> ternary;
-    qi::rule<Iterator, std::string()> variable;
+    ast::builder &builder;
+    qi::rule<Iterator, ascii::space_type> expression, logical, equality,
+        relational, additive, multiplicative, factor, primary, unary, binary,
+        ternary;
+    qi::rule<Iterator, boost::iterator_range<Iterator>()> variable;
+    /// Records that the first argument was expected in the rule named
+    /// by the second one, and fails
+    qi::rule<Iterator, ascii::space_type, void(char const *, char const *)>
+        expected;
 
     qi::symbols<typename std::iterator_traits<Iterator>::value_type, double>
         constant;
@@ -56,11 +61,11 @@ struct grammar : qi::grammar<Iterator, ast::expression(), ascii::space_type> {
                 double (*)(double, double, double)>
         tfunc;
 
-    grammar();
+    grammar(ast::builder &builder, parser::failure &failure);
 };
 
 } // namespace parser
 
-typedef parser::grammar<std::string::const_iterator> grammar;
+typedef parser::grammar<char const *> grammar;
 
 } // namespace matheval
@@ -4,20 +4,16 @@
 
 #pragma once
 
-#include "ast.hpp"
-#include "ast_adapted.hpp"
-#include "../math.hpp"
+#include "../ast.hpp"
+#include "builtins.hpp"
 #include "parser.hpp"
 
 #include <boost/spirit/include/phoenix.hpp>
 #define BOOST_SPIRIT_NO_PREDEFINED_TERMINALS
 #include <boost/spirit/include/qi.hpp>
 
-#include <cmath>
-#include <iostream>
+#include <cstddef>
 #include <limits>
-#include <sstream>
-#include <string>
 
 namespace matheval {
 
@@ -25,108 +21,65 @@ namespace qi = boost::spirit::qi;
 
 namespace parser {
 
+template <typename Symbols, typename T, std::size_t N>
+void lookup(Symbols &symbols, builtins::symbol<T> const (&table)[N]) {
+    for (builtins::symbol<T> const &entry : table) {
+        symbols.add(entry.name, entry.value);
+    }
+}
+
 template <typename Iterator>
-grammar<Iterator>::grammar() : grammar::base_type(expression) {
-    qi::_2_type _2;
-    qi::_3_type _3;
-    qi::_4_type _4;
+grammar<Iterator>::grammar(ast::builder &builder, parser::failure &failure)
+    : grammar::base_type(expression), err_handler{failure}, builder(builder) {
+    qi::_1_type _1;
 
     qi::alnum_type alnum;
     qi::alpha_type alpha;
     qi::double_type double_;
+    qi::eps_type eps;
     qi::lexeme_type lexeme;
+    qi::omit_type omit;
     qi::raw_type raw;
+    qi::_r1_type _r1;
+    qi::_r2_type _r2;
+
+    // The symbols are filled from the tables in builtins.hpp, which
+    // are shared by all parsers
+    lookup(constant, builtins::constants);
+    lookup(ufunc, builtins::unary_functions);
+    lookup(bfunc, builtins::binary_functions);
+    lookup(tfunc, builtins::ternary_functions);
+    lookup(unary_op, builtins::unary_operators);
+    lookup(additive_op, builtins::additive_operators);
+    lookup(multiplicative_op, builtins::multiplicative_operators);
+    lookup(logical_op, builtins::logical_operators);
+    lookup(relational_op, builtins::relational_operators);
+    lookup(equality_op, builtins::equality_operators);
+    lookup(power, builtins::power_operators);
+
+    namespace phx = boost::phoenix;
+    auto const push_constant =
+        phx::bind(&ast::builder::constant, phx::ref(builder), _1);
+    auto const push_variable = phx::bind(&ast::builder::variable,
+                                         phx::ref(builder), phx::begin(_1),
+                                         phx::end(_1));
+    auto const push_unary =
+        phx::bind(&ast::builder::unary, phx::ref(builder), _1);
+    auto const push_binary =
+        phx::bind(&ast::builder::binary, phx::ref(builder), _1);
+    auto const push_ternary =
+        phx::bind(&ast::builder::ternary, phx::ref(builder), _1);
+
+    // Instead of throwing like the expectation operator, a failed
+    // expectation is recorded and fails like any other parser
+    auto const missing = [this](char const *what, char const *rule) {
+        return expected(what, rule);
+    };
 
     // clang-format off
 
-    constant.add
-        ("e"      , boost::math::constants::e<double>())
-        ("epsilon", std::numeric_limits<double>::epsilon())
-        ("phi"    , boost::math::constants::phi<double>())
-        ("pi"     , boost::math::constants::pi<double>())
-        ;
-
-    ufunc.add
-            ("abs"   , static_cast<double (*)(double)>(&std::abs))
-            ("acos"  , static_cast<double (*)(double)>(&math::acos))
-            ("acosh" , static_cast<double (*)(double)>(&math::acosh))
-            ("asin"  , static_cast<double (*)(double)>(&math::asin))
-            ("asinh" , static_cast<double (*)(double)>(&std::asinh))
-            ("atan"  , static_cast<double (*)(double)>(&std::atan))
-            ("atanh" , static_cast<double (*)(double)>(&math::atanh))
-            ("cbrt"  , static_cast<double (*)(double)>(&std::cbrt))
-            ("ceil"  , static_cast<double (*)(double)>(&std::ceil))
-            ("cos"   , static_cast<double (*)(double)>(&math::cos))
-            ("cosh"  , static_cast<double (*)(double)>(&std::cosh))
-            ("deg"   , static_cast<double (*)(double)>(&math::deg))
-            ("erf"   , static_cast<double (*)(double)>(&std::erf))
-            ("erfc"  , static_cast<double (*)(double)>(&std::erfc))
-            ("exp"   , static_cast<double (*)(double)>(&std::exp))
-            ("exp2"  , static_cast<double (*)(double)>(&std::exp2))
-            ("floor" , static_cast<double (*)(double)>(&std::floor))
-            ("isinf" , static_cast<double (*)(double)>(&math::isinf))
-            ("isnan" , static_cast<double (*)(double)>(&math::isnan))
-            ("log"   , static_cast<double (*)(double)>(&math::log))
-            ("log2"  , static_cast<double (*)(double)>(&math::log2))
-            ("log10" , static_cast<double (*)(double)>(&math::log10))
-            ("rad"   , static_cast<double (*)(double)>(&math::rad))
-            ("round" , static_cast<double (*)(double)>(&std::round))
-            ("sgn"   , static_cast<double (*)(double)>(&math::sgn))
-            ("sin"   , static_cast<double (*)(double)>(&math::sin))
-            ("sinh"  , static_cast<double (*)(double)>(&std::sinh))
-            ("sqrt"  , static_cast<double (*)(double)>(&math::sqrt))
-            ("tan"   , static_cast<double (*)(double)>(&math::tan))
-            ("tanh"  , static_cast<double (*)(double)>(&std::tanh))
-            ("tgamma", static_cast<double (*)(double)>(&math::tgamma))
-        ;
-
-    bfunc.add
-        ("atan2", static_cast<double (*)(double, double)>(&std::atan2))
-        ("max"  , static_cast<double (*)(double, double)>(&std::fmax))
-        ("min"  , static_cast<double (*)(double, double)>(&std::fmin))
-        ("pow"  , static_cast<double (*)(double, double)>(&math::pow))
-        ;
-
-    tfunc.add
-        ("ifelse", static_cast<double (*)(double, double, double)>(&math::ifelse))
-        ;
-
-    unary_op.add
-        ("+", static_cast<double (*)(double)>(&math::plus))
-        ("-", static_cast<double (*)(double)>(&math::minus))
-        ("!", static_cast<double (*)(double)>(&math::unary_not))
-        ;
-
-    additive_op.add
-        ("+", static_cast<double (*)(double, double)>(&math::plus))
-        ("-", static_cast<double (*)(double, double)>(&math::minus))
-        ;
-
-    multiplicative_op.add
-        ("*", static_cast<double (*)(double, double)>(&math::multiplies))
-        ("/", static_cast<double (*)(double, double)>(&math::divides))
-        ("%", static_cast<double (*)(double, double)>(&math::fmod))
-        ;
-
-    logical_op.add
-        ("&&", static_cast<double (*)(double, double)>(&math::logical_and))
-        ("||", static_cast<double (*)(double, double)>(&math::logical_or))
-        ;
-
-    relational_op.add
-        ("<" , static_cast<double (*)(double, double)>(&math::less))
-        ("<=", static_cast<double (*)(double, double)>(&math::less_equals))
-        (">" , static_cast<double (*)(double, double)>(&math::greater))
-        (">=", static_cast<double (*)(double, double)>(&math::greater_equals))
-        ;
-
-    equality_op.add
-        ("==", static_cast<double (*)(double, double)>(&math::equals))
-        ("!=", static_cast<double (*)(double, double)>(&math::not_equals))
-        ;
-
-    power.add
-        ("**", static_cast<double (*)(double, double)>(&math::pow))
+    expected =
+        omit[raw[eps][phx::bind(phx::ref(err_handler), _1, _r1, _r2)]] >> eps(false)
         ;
 
     expression =
@@ -134,39 +87,51 @@ grammar<Iterator>::grammar() : grammar::base_type(expression) {
         ;
 
     logical =
-        equality >> *(logical_op > equality)
+        equality >> *(logical_op >> (equality | missing("equality", "logical")))[push_binary]
         ;
 
     equality =
-        relational >> *(equality_op > relational)
+        relational >> *(equality_op >> (relational | missing("relational", "equality")))[push_binary]
         ;
 
     relational =
-        additive >> *(relational_op > additive)
+        additive >> *(relational_op >> (additive | missing("additive", "relational")))[push_binary]
         ;
 
     additive =
-        multiplicative >> *(additive_op > multiplicative)
+        multiplicative >> *(additive_op >> (multiplicative | missing("multiplicative", "additive")))[push_binary]
         ;
 
     multiplicative =
-        factor >> *(multiplicative_op > factor)
+        factor >> *(multiplicative_op >> (factor | missing("factor", "multiplicative")))[push_binary]
         ;
 
     factor =
-        primary >> *( power > factor )
+        primary >> *( power >> (factor | missing("factor", "factor")) )[push_binary]
         ;
 
     unary =
-        ufunc > '(' > expression > ')'
+        (ufunc >> ('(' | missing("'('", "unary"))
+               >> (expression | missing("expression", "unary"))
+               >> (')' | missing("')'", "unary")))[push_unary]
         ;
 
     binary =
-        bfunc > '(' > expression > ',' > expression > ')'
+        (bfunc >> ('(' | missing("'('", "binary"))
+               >> (expression | missing("expression", "binary"))
+               >> (',' | missing("','", "binary"))
+               >> (expression | missing("expression", "binary"))
+               >> (')' | missing("')'", "binary")))[push_binary]
         ;
 
     ternary =
-        tfunc > '(' > expression > ',' > expression > ',' > expression > ')'
+        (tfunc >> ('(' | missing("'('", "ternary"))
+               >> (expression | missing("expression", "ternary"))
+               >> (',' | missing("','", "ternary"))
+               >> (expression | missing("expression", "ternary"))
+               >> (',' | missing("','", "ternary"))
+               >> (expression | missing("expression", "ternary"))
+               >> (')' | missing("')'", "ternary")))[push_ternary]
         ;
 
     variable =
@@ -174,14 +139,15 @@ grammar<Iterator>::grammar() : grammar::base_type(expression) {
         ;
 
     primary =
-          double_
-        | ('(' > expression > ')')
-        | (unary_op > primary)
+          double_[push_constant]
+        | ('(' >> (expression | missing("expression", "primary"))
+               >> (')' | missing("')'", "primary")))
+        | (unary_op >> (primary | missing("primary", "primary")))[push_unary]
         | ternary
         | binary
         | unary
-        | constant
-        | variable
+        | constant[push_constant]
+        | variable[push_variable]
         ;
 
     // clang-format on
@@ -199,13 +165,6 @@ grammar<Iterator>::grammar() : grammar::base_type(expression) {
     binary.name("binary");
     ternary.name("ternary");
 
-    // typedef boost::phoenix::function<error_handler<Iterator> >
-    // error_handler_function; qi::on_error<qi::fail>(expression,
-    //        error_handler_function(error_handler<Iterator>())(
-    //            "Error! Expecting ", qi::_4, qi::_3));
-    qi::on_error<qi::fail>(
-        expression,
-        boost::phoenix::bind(boost::phoenix::ref(err_handler), _3, _2, _4));
 }
 
 } // namespace parser
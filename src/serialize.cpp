@@ -0,0 +1,316 @@
+#define MATHEVAL_IMPLEMENTATION
+
+#include "serialize.hpp"
+
+#include "builtins.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace matheval {
+
+namespace serial {
+
+namespace {
+
+using ast::binary_fn;
+using ast::ternary_fn;
+using ast::unary_fn;
+
+// The identifier of a function is its position in one of these
+// tables.  Identifiers are stored in serialized trees, so functions
+// must only ever be appended, never removed or moved.
+
+// clang-format off
+
+unary_fn const unary_ids[] = {
+    static_cast<unary_fn>(&std::abs),
+    static_cast<unary_fn>(&math::acos),
+    static_cast<unary_fn>(&math::acosh),
+    static_cast<unary_fn>(&math::asin),
+    static_cast<unary_fn>(&std::asinh),
+    static_cast<unary_fn>(&std::atan),
+    static_cast<unary_fn>(&math::atanh),
+    static_cast<unary_fn>(&std::cbrt),
+    static_cast<unary_fn>(&std::ceil),
+    static_cast<unary_fn>(&math::cos),
+    static_cast<unary_fn>(&std::cosh),
+    static_cast<unary_fn>(&math::deg),
+    static_cast<unary_fn>(&std::erf),
+    static_cast<unary_fn>(&std::erfc),
+    static_cast<unary_fn>(&std::exp),
+    static_cast<unary_fn>(&std::exp2),
+    static_cast<unary_fn>(&std::floor),
+    static_cast<unary_fn>(&math::isinf),
+    static_cast<unary_fn>(&math::isnan),
+    static_cast<unary_fn>(&math::log),
+    static_cast<unary_fn>(&math::log2),
+    static_cast<unary_fn>(&math::log10),
+    static_cast<unary_fn>(&math::rad),
+    static_cast<unary_fn>(&std::round),
+    static_cast<unary_fn>(&math::sgn),
+    static_cast<unary_fn>(&math::sin),
+    static_cast<unary_fn>(&std::sinh),
+    static_cast<unary_fn>(&math::sqrt),
+    static_cast<unary_fn>(&math::tan),
+    static_cast<unary_fn>(&std::tanh),
+    static_cast<unary_fn>(&math::tgamma),
+    static_cast<unary_fn>(&math::plus),
+    static_cast<unary_fn>(&math::minus),
+    static_cast<unary_fn>(&math::unary_not),
+    static_cast<unary_fn>(&math::powi<-1>),
+    static_cast<unary_fn>(&math::powi<1>),
+    static_cast<unary_fn>(&math::powi<2>),
+    static_cast<unary_fn>(&math::powi<3>),
+    static_cast<unary_fn>(&math::powi<4>),
+    static_cast<unary_fn>(&math::pow_half),
+};
+
+binary_fn const binary_ids[] = {
+    static_cast<binary_fn>(&std::atan2),
+    static_cast<binary_fn>(&std::fmax),
+    static_cast<binary_fn>(&std::fmin),
+    static_cast<binary_fn>(&math::pow),
+    static_cast<binary_fn>(&math::plus),
+    static_cast<binary_fn>(&math::minus),
+    static_cast<binary_fn>(&math::multiplies),
+    static_cast<binary_fn>(&math::divides),
+    static_cast<binary_fn>(&math::fmod),
+    static_cast<binary_fn>(&math::logical_and),
+    static_cast<binary_fn>(&math::logical_or),
+    static_cast<binary_fn>(&math::less),
+    static_cast<binary_fn>(&math::less_equals),
+    static_cast<binary_fn>(&math::greater),
+    static_cast<binary_fn>(&math::greater_equals),
+    static_cast<binary_fn>(&math::equals),
+    static_cast<binary_fn>(&math::not_equals),
+};
+
+ternary_fn const ternary_ids[] = {
+    static_cast<ternary_fn>(&math::ifelse),
+};
+
+// clang-format on
+
+char const magic[4] = {'m', 'e', 'v', 'b'};
+
+struct header {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t size; ///< of the whole serialized tree in bytes
+    std::uint32_t nodes;
+    std::uint32_t variables;
+    std::uint32_t reserved;
+};
+
+/// @brief A node whose function is replaced by its identifier
+struct record {
+    std::uint8_t type;
+    std::uint8_t reserved[3];
+    std::uint32_t args[3];
+    union {
+        double value;
+        std::uint32_t id; ///< of the variable slot or the function
+    };
+};
+
+static_assert(sizeof(header) == 24, "the header must not be padded");
+static_assert(sizeof(record) == 24, "a record must not be padded");
+
+template <typename F, std::size_t N>
+std::uint32_t identify(F f, F const (&ids)[N]) {
+    for (std::size_t i = 0; i < N; ++i) {
+        if (ids[i] == f) {
+            return static_cast<std::uint32_t>(i);
+        }
+    }
+    throw matheval::invalid_argument( // NOLINT
+        "Cannot serialize a function without an identifier");
+}
+
+template <typename F, std::size_t N>
+F resolve(std::uint32_t id, F const (&ids)[N]) {
+    if (id >= N) {
+        throw matheval::invalid_argument( // NOLINT
+            "Unknown function " + std::to_string(id) + " in serialized tree");
+    }
+    return ids[id];
+}
+
+std::uint32_t swap_bytes(std::uint32_t x) {
+    return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) |
+           (x << 24);
+}
+
+[[noreturn]] void truncated() {
+    throw matheval::invalid_argument("Serialized tree is truncated"); // NOLINT
+}
+
+} // namespace
+
+void write(ast::tree const &t, std::string &out) {
+    std::size_t size = sizeof(header) + t.nodes.size() * sizeof(record);
+    for (std::string const &name : t.variables) {
+        size += sizeof(std::uint32_t) + name.size();
+    }
+    if (size > std::numeric_limits<std::uint32_t>::max()) {
+        throw matheval::invalid_argument( // NOLINT
+            "Cannot serialize a tree larger than 4 GiB");
+    }
+
+    header h;
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.size = static_cast<std::uint32_t>(size);
+    h.nodes = static_cast<std::uint32_t>(t.nodes.size());
+    h.variables = static_cast<std::uint32_t>(t.variables.size());
+    h.reserved = 0;
+
+    std::size_t pos = out.size();
+    out.resize(pos + size);
+    std::memcpy(&out[pos], &h, sizeof(h));
+    pos += sizeof(h);
+
+    for (ast::node const &x : t.nodes) {
+        record r;
+        // Zero the padding as well, so that equal trees have equal bytes
+        std::memset(&r, 0, sizeof(r));
+        r.type = static_cast<std::uint8_t>(x.type);
+        for (std::size_t k = 0; k < x.arity(); ++k) {
+            r.args[k] = x.args[k];
+        }
+        switch (x.type) {
+        case ast::kind::constant:
+            r.value = x.value;
+            break;
+        case ast::kind::variable:
+            r.id = x.slot;
+            break;
+        case ast::kind::unary:
+            r.id = identify(x.unary, unary_ids);
+            break;
+        case ast::kind::binary:
+            r.id = identify(x.binary, binary_ids);
+            break;
+        case ast::kind::ternary:
+            r.id = identify(x.ternary, ternary_ids);
+            break;
+        }
+        std::memcpy(&out[pos], &r, sizeof(r));
+        pos += sizeof(r);
+    }
+
+    for (std::string const &name : t.variables) {
+        std::uint32_t const length = static_cast<std::uint32_t>(name.size());
+        std::memcpy(&out[pos], &length, sizeof(length));
+        pos += sizeof(length);
+        std::memcpy(&out[pos], name.data(), name.size());
+        pos += name.size();
+    }
+}
+
+std::size_t read(char const *data, std::size_t size, ast::tree &t) {
+    t.clear();
+
+    header h;
+    if (size < sizeof(h)) {
+        truncated();
+    }
+    std::memcpy(&h, data, sizeof(h));
+    if (std::memcmp(h.magic, magic, sizeof(magic)) != 0) {
+        throw matheval::invalid_argument( // NOLINT
+            "Not a serialized tree");
+    }
+    if (h.version != version) {
+        throw matheval::invalid_argument( // NOLINT
+            swap_bytes(h.version) == version
+                ? "Serialized tree has the wrong byte order"
+                : "Unsupported version " + std::to_string(h.version) +
+                      " of serialized tree");
+    }
+    if (h.size > size) {
+        truncated();
+    }
+    std::uint64_t const fixed =
+        sizeof(h) + std::uint64_t(h.nodes) * sizeof(record) +
+        std::uint64_t(h.variables) * sizeof(std::uint32_t);
+    if (fixed > h.size) {
+        truncated();
+    }
+
+    char const *pos = data + sizeof(h);
+    char const *const last = data + h.size;
+
+    t.nodes.reserve(h.nodes);
+    for (std::uint32_t i = 0; i < h.nodes; ++i) {
+        record r;
+        std::memcpy(&r, pos, sizeof(r));
+        pos += sizeof(r);
+
+        if (r.type > static_cast<std::uint8_t>(ast::kind::ternary)) {
+            throw matheval::invalid_argument( // NOLINT
+                "Unknown node " + std::to_string(r.type) +
+                " in serialized tree");
+        }
+        // Children must come before their parents, like in every tree
+        std::size_t const arity =
+            r.type < static_cast<std::uint8_t>(ast::kind::unary)
+                ? 0
+                : r.type - 1u;
+        for (std::size_t k = 0; k < arity; ++k) {
+            if (r.args[k] >= i) {
+                throw matheval::invalid_argument( // NOLINT
+                    "Invalid child of node " + std::to_string(i) +
+                    " in serialized tree");
+            }
+        }
+
+        switch (static_cast<ast::kind>(r.type)) {
+        case ast::kind::constant:
+            t.nodes.push_back(ast::node{r.value});
+            break;
+        case ast::kind::variable:
+            if (r.id >= h.variables) {
+                throw matheval::invalid_argument( // NOLINT
+                    "Invalid variable of node " + std::to_string(i) +
+                    " in serialized tree");
+            }
+            t.nodes.push_back(ast::node{r.id});
+            break;
+        case ast::kind::unary:
+            t.nodes.push_back(ast::node{resolve(r.id, unary_ids), r.args[0]});
+            break;
+        case ast::kind::binary:
+            t.nodes.push_back(
+                ast::node{resolve(r.id, binary_ids), r.args[0], r.args[1]});
+            break;
+        case ast::kind::ternary:
+            t.nodes.push_back(ast::node{resolve(r.id, ternary_ids), r.args[0],
+                                        r.args[1], r.args[2]});
+            break;
+        }
+    }
+
+    t.variables.reserve(h.variables);
+    for (std::uint32_t i = 0; i < h.variables; ++i) {
+        std::uint32_t length;
+        if (static_cast<std::size_t>(last - pos) < sizeof(length)) {
+            truncated();
+        }
+        std::memcpy(&length, pos, sizeof(length));
+        pos += sizeof(length);
+        if (static_cast<std::size_t>(last - pos) < length) {
+            truncated();
+        }
+        t.variables.emplace_back(pos, length);
+        pos += length;
+    }
+
+    return h.size;
+}
+
+} // namespace serial
+
+} // namespace matheval
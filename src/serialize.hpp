@@ -0,0 +1,55 @@
+#ifndef MATHEVAL_IMPLEMENTATION
+#error "Do not include serialize.hpp directly!"
+#endif
+
+#pragma once
+
+#include "ast.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace matheval {
+
+/// @brief A versioned binary format of the abstract syntax tree
+///
+/// A serialized tree starts with a header of 24 bytes: the four
+/// characters @c mevb, the version of the format, the size of the
+/// whole serialized tree in bytes and the numbers of nodes and of
+/// variables, followed by four zero bytes.  Then come the nodes in
+/// the order of the tree, 24 bytes each, and finally the names of the
+/// variables, each one as its length followed by its characters.  All
+/// numbers are in the byte order of the machine which wrote them.
+///
+/// A node is stored like ast::node, except that a function is
+/// replaced by its identifier, which is the same for every build of
+/// the library.  Reading a tree therefore only has to copy the nodes
+/// and look up the functions.
+namespace serial {
+
+/// Version of the format, to be incremented on every incompatible
+/// change
+constexpr std::uint32_t version = 1;
+
+/// @brief Append the binary form of @p t to @p out
+///
+/// @throw matheval::invalid_argument if the tree has a function
+///        without an identifier or is larger than 4 GiB
+void write(ast::tree const &t, std::string &out);
+
+/// @brief Read a tree written by write() from the beginning of the
+///        @p size bytes at @p data
+///
+/// The bytes need not be aligned.  Every node is checked, so that
+/// corrupted input cannot create a tree which evaluates out of
+/// bounds.
+///
+/// @return number of bytes read
+/// @throw matheval::invalid_argument if the bytes are not a valid
+///        tree of this version; @p t is unspecified in that case
+std::size_t read(char const *data, std::size_t size, ast::tree &t);
+
+} // namespace serial
+
+} // namespace matheval
@@ -0,0 +1,260 @@
+#define MATHEVAL_IMPLEMENTATION
+
+#include "simd.hpp"
+#include "simd_kernels.hpp"
+#include "math.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace matheval {
+
+namespace simd {
+
+namespace {
+
+// Loops over the lanes for functions without a vectorized kernel
+
+template <double (*F)(double, math::error &)>
+void checked1(std::size_t n, double *x, math::error *err) {
+    for (std::size_t i = 0; i < n; ++i) {
+        math::error e = math::error::none;
+        x[i] = F(x[i], e);
+        if (e != math::error::none && err[i] == math::error::none) {
+            err[i] = e;
+        }
+    }
+}
+
+template <double (*F)(double, double, math::error &)>
+void checked2(std::size_t n, double *x, double const *y, math::error *err) {
+    for (std::size_t i = 0; i < n; ++i) {
+        math::error e = math::error::none;
+        x[i] = F(x[i], y[i], e);
+        if (e != math::error::none && err[i] == math::error::none) {
+            err[i] = e;
+        }
+    }
+}
+
+// The compiler expands some functions of the C library inline, e.g.
+// fmax, and the expansion may differ from the library function in the
+// sign of a zero.  Calling through an opaque pointer keeps the results
+// identical to the scalar interpreter, which calls the same pointer.
+
+template <double (*F)(double)>
+void unchecked1(std::size_t n, double *x, math::error *) {
+    double (*volatile fp)(double) = F;
+    double (*f)(double) = fp;
+    for (std::size_t i = 0; i < n; ++i) {
+        x[i] = f(x[i]);
+    }
+}
+
+template <double (*F)(double, double)>
+void unchecked2(std::size_t n, double *x, double const *y, math::error *) {
+    double (*volatile fp)(double, double) = F;
+    double (*f)(double, double) = fp;
+    for (std::size_t i = 0; i < n; ++i) {
+        x[i] = f(x[i], y[i]);
+    }
+}
+
+void identity(std::size_t, double *, math::error *) {}
+
+using unary_fn = double (*)(double);
+using binary_fn = double (*)(double, double);
+using ternary_fn = double (*)(double, double, double);
+
+std::vector<unary_entry> make_unary(vector_kernels const &k) {
+    // clang-format off
+    return {
+        {static_cast<unary_fn>(&std::abs)         , k.abs},
+        {static_cast<unary_fn>(&math::acos)       , &checked1<&math::acos<double>>},
+        {static_cast<unary_fn>(&math::acosh)      , &checked1<&math::acosh<double>>},
+        {static_cast<unary_fn>(&math::asin)       , &checked1<&math::asin<double>>},
+        {static_cast<unary_fn>(&std::asinh)       , &unchecked1<&std::asinh>},
+        {static_cast<unary_fn>(&std::atan)        , &unchecked1<&std::atan>},
+        {static_cast<unary_fn>(&math::atanh)      , &checked1<&math::atanh<double>>},
+        {static_cast<unary_fn>(&std::cbrt)        , &unchecked1<&std::cbrt>},
+        {static_cast<unary_fn>(&std::ceil)        , &unchecked1<&std::ceil>},
+        {static_cast<unary_fn>(&math::cos)        , &checked1<&math::cos<double>>},
+        {static_cast<unary_fn>(&std::cosh)        , &unchecked1<&std::cosh>},
+        {static_cast<unary_fn>(&math::deg)        , &unchecked1<&math::deg<double>>},
+        {static_cast<unary_fn>(&std::erf)         , &unchecked1<&std::erf>},
+        {static_cast<unary_fn>(&std::erfc)        , &unchecked1<&std::erfc>},
+        {static_cast<unary_fn>(&std::exp)         , &unchecked1<&std::exp>},
+        {static_cast<unary_fn>(&std::exp2)        , &unchecked1<&std::exp2>},
+        {static_cast<unary_fn>(&std::floor)       , &unchecked1<&std::floor>},
+        {static_cast<unary_fn>(&math::isinf)      , &unchecked1<&math::isinf<double>>},
+        {static_cast<unary_fn>(&math::isnan)      , &unchecked1<&math::isnan<double>>},
+        {static_cast<unary_fn>(&math::log)        , &checked1<&math::log<double>>},
+        {static_cast<unary_fn>(&math::log2)       , &checked1<&math::log2<double>>},
+        {static_cast<unary_fn>(&math::log10)      , &checked1<&math::log10<double>>},
+        {static_cast<unary_fn>(&math::rad)        , &unchecked1<&math::rad<double>>},
+        {static_cast<unary_fn>(&std::round)       , &unchecked1<&std::round>},
+        {static_cast<unary_fn>(&math::sgn)        , &unchecked1<&math::sgn<double>>},
+        {static_cast<unary_fn>(&math::sin)        , &checked1<&math::sin<double>>},
+        {static_cast<unary_fn>(&std::sinh)        , &unchecked1<&std::sinh>},
+        {static_cast<unary_fn>(&math::sqrt)       , k.sqrt},
+        {static_cast<unary_fn>(&math::tan)        , &checked1<&math::tan<double>>},
+        {static_cast<unary_fn>(&std::tanh)        , &unchecked1<&std::tanh>},
+        {static_cast<unary_fn>(&math::tgamma)     , &checked1<&math::tgamma<double>>},
+        {static_cast<unary_fn>(&math::powi<-1>)   , &checked1<&math::powi<-1, double>>},
+        {static_cast<unary_fn>(&math::powi<1>)    , &checked1<&math::powi<1, double>>},
+        {static_cast<unary_fn>(&math::powi<2>)    , &checked1<&math::powi<2, double>>},
+        {static_cast<unary_fn>(&math::powi<3>)    , &checked1<&math::powi<3, double>>},
+        {static_cast<unary_fn>(&math::powi<4>)    , &checked1<&math::powi<4, double>>},
+        {static_cast<unary_fn>(&math::pow_half)   , &checked1<&math::pow_half<double>>},
+        {static_cast<unary_fn>(&math::plus)       , &identity},
+        {static_cast<unary_fn>(&math::minus)      , k.negate},
+        {static_cast<unary_fn>(&math::unary_not)  , k.unary_not},
+    };
+    // clang-format on
+}
+
+std::vector<binary_entry> make_binary(vector_kernels const &k) {
+    // clang-format off
+    return {
+        {static_cast<binary_fn>(&std::atan2)            , &unchecked2<&std::atan2>},
+        {static_cast<binary_fn>(&std::fmax)             , &unchecked2<&std::fmax>},
+        {static_cast<binary_fn>(&std::fmin)             , &unchecked2<&std::fmin>},
+        {static_cast<binary_fn>(&math::pow)             , &checked2<&math::pow<double>>},
+        {static_cast<binary_fn>(&math::plus)            , k.plus},
+        {static_cast<binary_fn>(&math::minus)           , k.minus},
+        {static_cast<binary_fn>(&math::multiplies)      , k.multiplies},
+        {static_cast<binary_fn>(&math::divides)         , k.divides},
+        {static_cast<binary_fn>(&math::fmod)            , &checked2<&math::fmod<double>>},
+        {static_cast<binary_fn>(&math::logical_and)     , k.logical_and},
+        {static_cast<binary_fn>(&math::logical_or)      , k.logical_or},
+        {static_cast<binary_fn>(&math::less)            , k.less},
+        {static_cast<binary_fn>(&math::less_equals)     , k.less_equals},
+        {static_cast<binary_fn>(&math::greater)         , k.greater},
+        {static_cast<binary_fn>(&math::greater_equals)  , k.greater_equals},
+        {static_cast<binary_fn>(&math::equals)          , k.equals},
+        {static_cast<binary_fn>(&math::not_equals)      , k.not_equals},
+    };
+    // clang-format on
+}
+
+std::vector<ternary_entry> make_ternary(vector_kernels const &k) {
+    return {
+        {static_cast<ternary_fn>(&math::ifelse), k.ifelse},
+    };
+}
+
+vector_kernels const &kernels(isa level) {
+    switch (level) {
+    case isa::sse2:
+        return sse2_kernels();
+    case isa::avx2:
+        return avx2_kernels();
+    case isa::avx512:
+        return avx512_kernels();
+    case isa::scalar:
+        break;
+    }
+    return scalar_kernels();
+}
+
+/// @brief The tables of all four instruction sets, built on first use
+template <typename Entry>
+struct registry {
+    std::vector<Entry> tables[4];
+
+    template <typename Make>
+    explicit registry(Make make) {
+        for (isa level : {isa::scalar, isa::sse2, isa::avx2, isa::avx512}) {
+            if (supported(level)) {
+                tables[static_cast<int>(level)] = make(kernels(level));
+            }
+        }
+    }
+
+    std::vector<Entry> const &operator[](isa level) const {
+        return tables[static_cast<int>(level)];
+    }
+};
+
+template <typename K, typename Entry, typename F>
+K lookup(std::vector<Entry> const &table, F f) {
+    auto it = std::find_if(table.begin(), table.end(),
+                           [f](Entry const &e) { return e.function == f; });
+    return it == table.end() ? nullptr : it->kernel;
+}
+
+} // namespace
+
+vector_kernels const &scalar_kernels() {
+    static vector_kernels const k = make_kernels<scalar>();
+    return k;
+}
+
+bool supported(isa level) {
+    switch (level) {
+    case isa::scalar:
+        return true;
+    case isa::sse2:
+#if defined(__SSE2__) || defined(_M_X64)
+        return true;
+#else
+        return false;
+#endif
+    case isa::avx2:
+#if defined(MATHEVAL_HAVE_AVX2)
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    case isa::avx512:
+#if defined(MATHEVAL_HAVE_AVX512)
+        return __builtin_cpu_supports("avx512f");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+isa detect() {
+    static isa const best = [] {
+        for (isa level : {isa::avx512, isa::avx2, isa::sse2}) {
+            if (supported(level)) {
+                return level;
+            }
+        }
+        return isa::scalar;
+    }();
+    return best;
+}
+
+std::vector<unary_entry> const &unary_kernels(isa level) {
+    static registry<unary_entry> const r(&make_unary);
+    return r[level];
+}
+
+std::vector<binary_entry> const &binary_kernels(isa level) {
+    static registry<binary_entry> const r(&make_binary);
+    return r[level];
+}
+
+std::vector<ternary_entry> const &ternary_kernels(isa level) {
+    static registry<ternary_entry> const r(&make_ternary);
+    return r[level];
+}
+
+unary_kernel find(double (*f)(double)) {
+    return lookup<unary_kernel>(unary_kernels(detect()), f);
+}
+
+binary_kernel find(double (*f)(double, double)) {
+    return lookup<binary_kernel>(binary_kernels(detect()), f);
+}
+
+ternary_kernel find(double (*f)(double, double, double)) {
+    return lookup<ternary_kernel>(ternary_kernels(detect()), f);
+}
+
+} // namespace simd
+
+} // namespace matheval
@@ -0,0 +1,97 @@
+#ifndef MATHEVAL_IMPLEMENTATION
+#error "Do not include simd.hpp directly!"
+#endif
+
+#pragma once
+
+#include "math.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace matheval {
+
+namespace simd {
+
+/// @brief Instruction sets for which kernels are available
+enum class isa { scalar, sse2, avx2, avx512 };
+
+/// @brief Kernel applying a unary function in place, x = f(x)
+using unary_kernel = void (*)(std::size_t n, double *x, math::error *err);
+
+/// @brief Kernel applying a binary function in place, x = f(x, y)
+using binary_kernel = void (*)(std::size_t n, double *x, double const *y,
+                               math::error *err);
+
+/// @brief Kernel applying a ternary function in place, x = f(x, y, z)
+using ternary_kernel = void (*)(std::size_t n, double *x, double const *y,
+                                double const *z, math::error *err);
+
+// All kernels process @c n lanes and never throw.  If a function fails
+// for a lane, the result of that lane is NaN and the error is stored
+// in @c err for that lane, unless an earlier error is already stored
+// there.
+
+/// @brief The kernels which are implemented with vector instructions
+struct vector_kernels {
+    unary_kernel negate;
+    unary_kernel abs;
+    unary_kernel sqrt;
+    unary_kernel unary_not;
+    binary_kernel plus;
+    binary_kernel minus;
+    binary_kernel multiplies;
+    binary_kernel divides;
+    binary_kernel logical_and;
+    binary_kernel logical_or;
+    binary_kernel less;
+    binary_kernel less_equals;
+    binary_kernel greater;
+    binary_kernel greater_equals;
+    binary_kernel equals;
+    binary_kernel not_equals;
+    ternary_kernel ifelse;
+};
+
+vector_kernels const &scalar_kernels();
+vector_kernels const &sse2_kernels();
+vector_kernels const &avx2_kernels();
+vector_kernels const &avx512_kernels();
+
+/// @brief A scalar function together with its kernel
+template <typename F, typename K>
+struct entry {
+    F function;
+    K kernel;
+};
+
+using unary_entry = entry<double (*)(double), unary_kernel>;
+using binary_entry = entry<double (*)(double, double), binary_kernel>;
+using ternary_entry =
+    entry<double (*)(double, double, double), ternary_kernel>;
+
+/// @brief Check whether the running CPU supports an instruction set
+bool supported(isa level);
+
+/// @brief The best instruction set supported by the running CPU
+isa detect();
+
+/// @brief Kernels for every function of the grammar
+///
+/// Functions without a vectorized kernel for @p level get a kernel
+/// which loops over the lanes and calls the non-throwing overload from
+/// math.hpp.
+std::vector<unary_entry> const &unary_kernels(isa level);
+std::vector<binary_entry> const &binary_kernels(isa level);
+std::vector<ternary_entry> const &ternary_kernels(isa level);
+
+/// @brief Look up the kernel of a function for the detected instruction set
+///
+/// @return the kernel or nullptr if the function is unknown
+unary_kernel find(double (*f)(double));
+binary_kernel find(double (*f)(double, double));
+ternary_kernel find(double (*f)(double, double, double));
+
+} // namespace simd
+
+} // namespace matheval
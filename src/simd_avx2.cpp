@@ -0,0 +1,65 @@
+#define MATHEVAL_IMPLEMENTATION
+
+#include "simd_kernels.hpp"
+
+#if defined(MATHEVAL_HAVE_AVX2)
+#include <immintrin.h>
+#endif
+
+namespace matheval {
+
+namespace simd {
+
+#if defined(MATHEVAL_HAVE_AVX2)
+
+namespace {
+
+struct avx2 {
+    using reg = __m256d;
+    using mask = __m256d;
+    static constexpr std::size_t width = 4;
+
+    static reg load(double const *p) { return _mm256_loadu_pd(p); }
+    static void store(double *p, reg x) { _mm256_storeu_pd(p, x); }
+    static reg set1(double v) { return _mm256_set1_pd(v); }
+
+    static reg add(reg x, reg y) { return _mm256_add_pd(x, y); }
+    static reg sub(reg x, reg y) { return _mm256_sub_pd(x, y); }
+    static reg mul(reg x, reg y) { return _mm256_mul_pd(x, y); }
+    static reg div(reg x, reg y) { return _mm256_div_pd(x, y); }
+    static reg sqrt(reg x) { return _mm256_sqrt_pd(x); }
+    static reg neg(reg x) { return _mm256_xor_pd(x, _mm256_set1_pd(-0.0)); }
+    static reg abs(reg x) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x); }
+
+    static mask lt(reg x, reg y) { return _mm256_cmp_pd(x, y, _CMP_LT_OQ); }
+    static mask le(reg x, reg y) { return _mm256_cmp_pd(x, y, _CMP_LE_OQ); }
+    static mask gt(reg x, reg y) { return _mm256_cmp_pd(x, y, _CMP_GT_OQ); }
+    static mask ge(reg x, reg y) { return _mm256_cmp_pd(x, y, _CMP_GE_OQ); }
+    static mask eq(reg x, reg y) { return _mm256_cmp_pd(x, y, _CMP_EQ_OQ); }
+    static mask neq(reg x, reg y) { return _mm256_cmp_pd(x, y, _CMP_NEQ_UQ); }
+
+    static mask none() { return _mm256_setzero_pd(); }
+    static mask both(mask a, mask b) { return _mm256_and_pd(a, b); }
+    static mask either(mask a, mask b) { return _mm256_or_pd(a, b); }
+    static bool any(mask m) { return _mm256_movemask_pd(m) != 0; }
+    static reg select(mask m, reg x, reg y) {
+        return _mm256_blendv_pd(y, x, m);
+    }
+};
+
+} // namespace
+
+vector_kernels const &avx2_kernels() {
+    static vector_kernels const k = make_kernels<avx2>();
+    return k;
+}
+
+#else
+
+vector_kernels const &avx2_kernels() { return sse2_kernels(); }
+
+#endif
+
+} // namespace simd
+
+} // namespace matheval
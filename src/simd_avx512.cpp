@@ -0,0 +1,70 @@
+#define MATHEVAL_IMPLEMENTATION
+
+#include "simd_kernels.hpp"
+
+#if defined(MATHEVAL_HAVE_AVX512)
+#include <immintrin.h>
+#endif
+
+namespace matheval {
+
+namespace simd {
+
+#if defined(MATHEVAL_HAVE_AVX512)
+
+namespace {
+
+struct avx512 {
+    using reg = __m512d;
+    using mask = __mmask8;
+    static constexpr std::size_t width = 8;
+
+    static reg load(double const *p) { return _mm512_loadu_pd(p); }
+    static void store(double *p, reg x) { _mm512_storeu_pd(p, x); }
+    static reg set1(double v) { return _mm512_set1_pd(v); }
+
+    static reg add(reg x, reg y) { return _mm512_add_pd(x, y); }
+    static reg sub(reg x, reg y) { return _mm512_sub_pd(x, y); }
+    static reg mul(reg x, reg y) { return _mm512_mul_pd(x, y); }
+    static reg div(reg x, reg y) { return _mm512_div_pd(x, y); }
+    static reg sqrt(reg x) { return _mm512_sqrt_pd(x); }
+    // AVX-512F has no floating point xor, so flip the sign bit as integer
+    static reg neg(reg x) {
+        return _mm512_castsi512_pd(_mm512_xor_si512(
+            _mm512_castpd_si512(x),
+            _mm512_set1_epi64(static_cast<long long>(0x8000000000000000ULL))));
+    }
+    static reg abs(reg x) { return _mm512_abs_pd(x); }
+
+    static mask lt(reg x, reg y) { return _mm512_cmp_pd_mask(x, y, _CMP_LT_OQ); }
+    static mask le(reg x, reg y) { return _mm512_cmp_pd_mask(x, y, _CMP_LE_OQ); }
+    static mask gt(reg x, reg y) { return _mm512_cmp_pd_mask(x, y, _CMP_GT_OQ); }
+    static mask ge(reg x, reg y) { return _mm512_cmp_pd_mask(x, y, _CMP_GE_OQ); }
+    static mask eq(reg x, reg y) { return _mm512_cmp_pd_mask(x, y, _CMP_EQ_OQ); }
+    static mask neq(reg x, reg y) { return _mm512_cmp_pd_mask(x, y, _CMP_NEQ_UQ); }
+
+    static mask none() { return 0; }
+    static mask both(mask a, mask b) { return a & b; }
+    static mask either(mask a, mask b) { return a | b; }
+    static bool any(mask m) { return m != 0; }
+    static reg select(mask m, reg x, reg y) {
+        return _mm512_mask_blend_pd(m, y, x);
+    }
+};
+
+} // namespace
+
+vector_kernels const &avx512_kernels() {
+    static vector_kernels const k = make_kernels<avx512>();
+    return k;
+}
+
+#else
+
+vector_kernels const &avx512_kernels() { return avx2_kernels(); }
+
+#endif
+
+} // namespace simd
+
+} // namespace matheval
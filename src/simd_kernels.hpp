@@ -0,0 +1,232 @@
+#ifndef MATHEVAL_IMPLEMENTATION
+#error "Do not include simd_kernels.hpp directly!"
+#endif
+
+#pragma once
+
+#include "simd.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace matheval {
+
+namespace simd {
+
+// Everything in here is instantiated once per instruction set and
+// compiled with different code generation flags.  The anonymous
+// namespace gives all of it internal linkage, so that no function
+// compiled for a wider instruction set can be picked by the linker
+// for a caller which runs on a CPU without it.
+
+namespace {
+
+/// @brief Traits for one lane, used for the remainder of a block
+struct scalar {
+    using reg = double;
+    using mask = bool;
+    static constexpr std::size_t width = 1;
+
+    static reg load(double const *p) { return *p; }
+    static void store(double *p, reg x) { *p = x; }
+    static reg set1(double v) { return v; }
+
+    static reg add(reg x, reg y) { return x + y; }
+    static reg sub(reg x, reg y) { return x - y; }
+    static reg mul(reg x, reg y) { return x * y; }
+    static reg div(reg x, reg y) { return x / y; }
+    static reg sqrt(reg x) { return std::sqrt(x); }
+    static reg neg(reg x) { return -x; }
+    static reg abs(reg x) { return std::fabs(x); }
+
+    static mask lt(reg x, reg y) { return x < y; }
+    static mask le(reg x, reg y) { return x <= y; }
+    static mask gt(reg x, reg y) { return x > y; }
+    static mask ge(reg x, reg y) { return x >= y; }
+    static mask eq(reg x, reg y) { return x == y; }
+    static mask neq(reg x, reg y) { return x != y; }
+
+    static mask none() { return false; }
+    static mask both(mask a, mask b) { return a && b; }
+    static mask either(mask a, mask b) { return a || b; }
+    static bool any(mask m) { return m; }
+    static reg select(mask m, reg x, reg y) { return m ? x : y; }
+};
+
+/// @brief Convert a mask into the 1.0 and 0.0 of the scalar operators
+template <typename V>
+typename V::reg boolean(typename V::mask m) {
+    return V::select(m, V::set1(1.0), V::set1(0.0));
+}
+
+// Operations
+
+struct op_negate {
+    template <typename V>
+    static typename V::reg apply(typename V::reg x) { return V::neg(x); }
+    template <typename V>
+    static typename V::mask invalid(typename V::reg) { return V::none(); }
+    static constexpr math::error error = math::error::none;
+};
+
+struct op_abs {
+    template <typename V>
+    static typename V::reg apply(typename V::reg x) { return V::abs(x); }
+    template <typename V>
+    static typename V::mask invalid(typename V::reg) { return V::none(); }
+    static constexpr math::error error = math::error::none;
+};
+
+struct op_sqrt {
+    template <typename V>
+    static typename V::reg apply(typename V::reg x) { return V::sqrt(x); }
+    template <typename V>
+    static typename V::mask invalid(typename V::reg x) {
+        return V::lt(x, V::set1(0.0));
+    }
+    static constexpr math::error error = math::error::sqrtInvalid;
+};
+
+struct op_not {
+    template <typename V>
+    static typename V::reg apply(typename V::reg x) {
+        return boolean<V>(V::eq(x, V::set1(0.0)));
+    }
+    template <typename V>
+    static typename V::mask invalid(typename V::reg) { return V::none(); }
+    static constexpr math::error error = math::error::none;
+};
+
+#define MATHEVAL_SIMD_BINARY(name, expr)                                     \
+    struct name {                                                            \
+        template <typename V>                                                \
+        static typename V::reg apply(typename V::reg x, typename V::reg y) { \
+            return expr;                                                     \
+        }                                                                    \
+        template <typename V>                                                \
+        static typename V::mask invalid(typename V::reg, typename V::reg) {  \
+            return V::none();                                                \
+        }                                                                    \
+        static constexpr math::error error = math::error::none;              \
+    };
+
+MATHEVAL_SIMD_BINARY(op_plus, V::add(x, y))
+MATHEVAL_SIMD_BINARY(op_minus, V::sub(x, y))
+MATHEVAL_SIMD_BINARY(op_multiplies, V::mul(x, y))
+MATHEVAL_SIMD_BINARY(op_logical_and, boolean<V>(V::both(V::neq(x, V::set1(0.0)), V::neq(y, V::set1(0.0)))))
+MATHEVAL_SIMD_BINARY(op_logical_or, boolean<V>(V::either(V::neq(x, V::set1(0.0)), V::neq(y, V::set1(0.0)))))
+MATHEVAL_SIMD_BINARY(op_less, boolean<V>(V::lt(x, y)))
+MATHEVAL_SIMD_BINARY(op_less_equals, boolean<V>(V::le(x, y)))
+MATHEVAL_SIMD_BINARY(op_greater, boolean<V>(V::gt(x, y)))
+MATHEVAL_SIMD_BINARY(op_greater_equals, boolean<V>(V::ge(x, y)))
+MATHEVAL_SIMD_BINARY(op_equals, boolean<V>(V::eq(x, y)))
+MATHEVAL_SIMD_BINARY(op_not_equals, boolean<V>(V::neq(x, y)))
+
+#undef MATHEVAL_SIMD_BINARY
+
+struct op_divides {
+    template <typename V>
+    static typename V::reg apply(typename V::reg x, typename V::reg y) {
+        return V::div(x, y);
+    }
+    template <typename V>
+    static typename V::mask invalid(typename V::reg, typename V::reg y) {
+        return V::eq(y, V::set1(0.0));
+    }
+    static constexpr math::error error = math::error::divideByZero;
+};
+
+// Loops
+
+// A constant rather than a call, which might be emitted out of line
+constexpr double quiet_nan = std::numeric_limits<double>::quiet_NaN();
+
+inline void mark(double &x, math::error &err, math::error what) {
+    x = quiet_nan;
+    if (err == math::error::none) {
+        err = what;
+    }
+}
+
+template <typename V, typename Op>
+void unary(std::size_t n, double *x, math::error *err) {
+    std::size_t i = 0;
+    for (; i + V::width <= n; i += V::width) {
+        typename V::reg a = V::load(x + i);
+        if (V::any(Op::template invalid<V>(a))) {
+            break;
+        }
+        V::store(x + i, Op::template apply<V>(a));
+    }
+    // Remainder and everything after the first failing lane
+    for (; i < n; ++i) {
+        if (Op::template invalid<scalar>(x[i])) {
+            mark(x[i], err[i], Op::error);
+        } else {
+            x[i] = Op::template apply<scalar>(x[i]);
+        }
+    }
+}
+
+template <typename V, typename Op>
+void binary(std::size_t n, double *x, double const *y, math::error *err) {
+    std::size_t i = 0;
+    for (; i + V::width <= n; i += V::width) {
+        typename V::reg a = V::load(x + i);
+        typename V::reg b = V::load(y + i);
+        if (V::any(Op::template invalid<V>(a, b))) {
+            break;
+        }
+        V::store(x + i, Op::template apply<V>(a, b));
+    }
+    for (; i < n; ++i) {
+        if (Op::template invalid<scalar>(x[i], y[i])) {
+            mark(x[i], err[i], Op::error);
+        } else {
+            x[i] = Op::template apply<scalar>(x[i], y[i]);
+        }
+    }
+}
+
+template <typename V>
+void ifelse(std::size_t n, double *x, double const *y, double const *z,
+            math::error *) {
+    std::size_t i = 0;
+    for (; i + V::width <= n; i += V::width) {
+        typename V::mask c = V::neq(V::load(x + i), V::set1(0.0));
+        V::store(x + i, V::select(c, V::load(y + i), V::load(z + i)));
+    }
+    for (; i < n; ++i) {
+        x[i] = x[i] != 0.0 ? y[i] : z[i];
+    }
+}
+
+template <typename V>
+vector_kernels make_kernels() {
+    vector_kernels k;
+    k.negate = &unary<V, op_negate>;
+    k.abs = &unary<V, op_abs>;
+    k.sqrt = &unary<V, op_sqrt>;
+    k.unary_not = &unary<V, op_not>;
+    k.plus = &binary<V, op_plus>;
+    k.minus = &binary<V, op_minus>;
+    k.multiplies = &binary<V, op_multiplies>;
+    k.divides = &binary<V, op_divides>;
+    k.logical_and = &binary<V, op_logical_and>;
+    k.logical_or = &binary<V, op_logical_or>;
+    k.less = &binary<V, op_less>;
+    k.less_equals = &binary<V, op_less_equals>;
+    k.greater = &binary<V, op_greater>;
+    k.greater_equals = &binary<V, op_greater_equals>;
+    k.equals = &binary<V, op_equals>;
+    k.not_equals = &binary<V, op_not_equals>;
+    k.ifelse = &ifelse<V>;
+    return k;
+}
+
+} // namespace
+
+} // namespace simd
+
+} // namespace matheval
@@ -0,0 +1,65 @@
+#define MATHEVAL_IMPLEMENTATION
+
+#include "simd_kernels.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace matheval {
+
+namespace simd {
+
+#if defined(__SSE2__) || defined(_M_X64)
+
+namespace {
+
+struct sse2 {
+    using reg = __m128d;
+    using mask = __m128d;
+    static constexpr std::size_t width = 2;
+
+    static reg load(double const *p) { return _mm_loadu_pd(p); }
+    static void store(double *p, reg x) { _mm_storeu_pd(p, x); }
+    static reg set1(double v) { return _mm_set1_pd(v); }
+
+    static reg add(reg x, reg y) { return _mm_add_pd(x, y); }
+    static reg sub(reg x, reg y) { return _mm_sub_pd(x, y); }
+    static reg mul(reg x, reg y) { return _mm_mul_pd(x, y); }
+    static reg div(reg x, reg y) { return _mm_div_pd(x, y); }
+    static reg sqrt(reg x) { return _mm_sqrt_pd(x); }
+    static reg neg(reg x) { return _mm_xor_pd(x, _mm_set1_pd(-0.0)); }
+    static reg abs(reg x) { return _mm_andnot_pd(_mm_set1_pd(-0.0), x); }
+
+    static mask lt(reg x, reg y) { return _mm_cmplt_pd(x, y); }
+    static mask le(reg x, reg y) { return _mm_cmple_pd(x, y); }
+    static mask gt(reg x, reg y) { return _mm_cmpgt_pd(x, y); }
+    static mask ge(reg x, reg y) { return _mm_cmpge_pd(x, y); }
+    static mask eq(reg x, reg y) { return _mm_cmpeq_pd(x, y); }
+    static mask neq(reg x, reg y) { return _mm_cmpneq_pd(x, y); }
+
+    static mask none() { return _mm_setzero_pd(); }
+    static mask both(mask a, mask b) { return _mm_and_pd(a, b); }
+    static mask either(mask a, mask b) { return _mm_or_pd(a, b); }
+    static bool any(mask m) { return _mm_movemask_pd(m) != 0; }
+    static reg select(mask m, reg x, reg y) {
+        return _mm_or_pd(_mm_and_pd(m, x), _mm_andnot_pd(m, y));
+    }
+};
+
+} // namespace
+
+vector_kernels const &sse2_kernels() {
+    static vector_kernels const k = make_kernels<sse2>();
+    return k;
+}
+
+#else
+
+vector_kernels const &sse2_kernels() { return scalar_kernels(); }
+
+#endif
+
+} // namespace simd
+
+} // namespace matheval
@@ -0,0 +1,247 @@
+#define MATHEVAL_IMPLEMENTATION
+
+#include "matheval.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace matheval {
+
+namespace {
+
+/// The pool whose task the current thread is executing, if any
+thread_local void const *current_pool = nullptr;
+
+} // namespace
+
+class ThreadPool::impl {
+public:
+    explicit impl(std::size_t threads);
+
+    ~impl();
+
+    std::size_t size() const { return workers.size() + 1; }
+
+    void parallel_for(std::size_t n,
+                      std::function<void(std::size_t)> const &task);
+
+private:
+    using task_fn = std::function<void(std::size_t)>;
+
+    /// @brief The indices which are left to a thread
+    ///
+    /// The owner takes indices from the front, thieves from the back.
+    struct range {
+        std::mutex mutex;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+    };
+
+    bool pop(std::size_t self, std::size_t &index);
+
+    bool steal(std::size_t self, std::size_t &index);
+
+    void work(std::size_t self, task_fn const &task);
+
+    void loop(std::size_t self);
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<range[]> ranges;
+
+    /// Serializes calls to parallel_for
+    std::mutex submit;
+
+    // The current job, protected by mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::uint64_t generation = 0;
+    task_fn const *job = nullptr;
+    std::size_t active = 0;
+    bool stop = false;
+    std::exception_ptr error;
+
+    std::atomic<std::size_t> remaining{0};
+};
+
+ThreadPool::impl::impl(std::size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    ranges.reset(new range[threads]);
+    // The thread calling parallel_for is the last participant
+    for (std::size_t i = 0; i + 1 < threads; ++i) {
+        workers.emplace_back([this, i] { loop(i); });
+    }
+}
+
+ThreadPool::impl::~impl() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wake.notify_all();
+    for (std::thread &t : workers) {
+        t.join();
+    }
+}
+
+bool ThreadPool::impl::pop(std::size_t self, std::size_t &index) {
+    range &r = ranges[self];
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.begin == r.end) {
+        return false;
+    }
+    index = r.begin++;
+    return true;
+}
+
+bool ThreadPool::impl::steal(std::size_t self, std::size_t &index) {
+    std::size_t const n = size();
+    for (std::size_t k = 1; k < n; ++k) {
+        range &victim = ranges[(self + k) % n];
+        std::size_t begin;
+        std::size_t end;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.begin == victim.end) {
+                continue;
+            }
+            // Take the back half, rounded up
+            begin = victim.begin + (victim.end - victim.begin) / 2;
+            end = victim.end;
+            victim.end = begin;
+        }
+        index = begin;
+        range &own = ranges[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.begin = begin + 1;
+        own.end = end;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::impl::work(std::size_t self, task_fn const &task) {
+    void const *outer = current_pool;
+    current_pool = this;
+    std::size_t index;
+    while (pop(self, index) || steal(self, index)) {
+        try {
+            task(index);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        if (--remaining == 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.notify_all();
+        }
+    }
+    current_pool = outer;
+}
+
+void ThreadPool::impl::loop(std::size_t self) {
+    std::uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [&] { return stop || generation != seen; });
+        if (stop) {
+            return;
+        }
+        seen = generation;
+        if (!job) {
+            // The job was already finished by the other threads
+            continue;
+        }
+        task_fn const &task = *job;
+        ++active;
+        lock.unlock();
+        work(self, task);
+        lock.lock();
+        if (--active == 0) {
+            done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::impl::parallel_for(std::size_t n, task_fn const &task) {
+    if (n == 0) {
+        return;
+    }
+    if (current_pool == this || workers.empty() || n == 1) {
+        // Like the workers, run the remaining tasks if one throws
+        std::exception_ptr e;
+        for (std::size_t i = 0; i < n; ++i) {
+            try {
+                task(i);
+            } catch (...) {
+                if (!e) {
+                    e = std::current_exception();
+                }
+            }
+        }
+        if (e) {
+            std::rethrow_exception(e);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> serialize(submit);
+
+    // Split the indices evenly, the caller gets the last range
+    std::size_t const threads = size();
+    for (std::size_t t = 0; t < threads; ++t) {
+        std::lock_guard<std::mutex> lock(ranges[t].mutex);
+        ranges[t].begin = n * t / threads;
+        ranges[t].end = n * (t + 1) / threads;
+    }
+    remaining = n;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &task;
+        error = nullptr;
+        ++generation;
+    }
+    wake.notify_all();
+
+    work(threads - 1, task);
+
+    std::exception_ptr e;
+    {
+        // No worker may still hold the task when we return
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return remaining == 0 && active == 0; });
+        job = nullptr;
+        std::swap(e, error);
+    }
+    if (e) {
+        std::rethrow_exception(e);
+    }
+}
+
+ThreadPool::ThreadPool(std::size_t threads) : pimpl(new impl(threads)) {}
+
+ThreadPool::~ThreadPool() {}
+
+std::size_t ThreadPool::size() const { return pimpl->size(); }
+
+void ThreadPool::parallel_for(std::size_t n,
+                              std::function<void(std::size_t)> const &task) {
+    pimpl->parallel_for(n, task);
+}
+
+ThreadPool &ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+} // namespace matheval
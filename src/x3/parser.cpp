@@ -4,16 +4,17 @@
 
 #include <boost/spirit/home/x3.hpp>
 
-#include <string>
-
 namespace matheval {
 
 namespace x3 = boost::spirit::x3;
 
 namespace parser {
 
-using iterator_type = std::string::const_iterator;
-using context_type = x3::phrase_parse_context<x3::ascii::space_type>::type;
+using iterator_type = char const *;
+using context_type = x3::context<
+    failure_tag, failure,
+    x3::context<builder_tag, ast::builder,
+                x3::phrase_parse_context<x3::ascii::space_type>::type>>;
 
 BOOST_SPIRIT_INSTANTIATE(expression_type, iterator_type, context_type)
 
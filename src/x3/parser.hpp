@@ -4,7 +4,8 @@
 
 #pragma once
 
-#include "ast.hpp"
+#include "../ast.hpp"
+#include "../failure.hpp"
 
 #include <boost/spirit/home/x3.hpp>
 
@@ -16,7 +17,13 @@ namespace parser {
 
 struct expression_class;
 
-using expression_type = x3::rule<expression_class, ast::expression>;
+/// Key of the ast::builder in the parser context
+struct builder_tag;
+
+/// Key of the parser::failure in the parser context
+struct failure_tag;
+
+using expression_type = x3::rule<expression_class>;
 
 BOOST_SPIRIT_DECLARE(expression_type)
 
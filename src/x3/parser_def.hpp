@@ -4,18 +4,15 @@
 
 #pragma once
 
-#include "ast.hpp"
-#include "ast_adapted.hpp"
-#include "../math.hpp"
+#include "../ast.hpp"
+#include "builtins.hpp"
 #include "parser.hpp"
 
-#include <boost/math/constants/constants.hpp>
+#include <boost/range/iterator_range.hpp>
 #include <boost/spirit/home/x3.hpp>
 
-#include <cmath>
-#include <iostream>
+#include <cstddef>
 #include <limits>
-#include <string>
 
 namespace matheval {
 
@@ -25,161 +22,115 @@ namespace parser {
 
 // LOOKUP
 
-struct constant_ : x3::symbols<double> {
-    constant_() {
-        // clang-format off
-        add
-            ("e"      , boost::math::constants::e<double>())
-            ("epsilon", std::numeric_limits<double>::epsilon())
-            ("phi"    , boost::math::constants::phi<double>())
-            ("pi"     , boost::math::constants::pi<double>())
-            ;
-        // clang-format on
-    }
-} constant;
-
-struct ufunc_ : x3::symbols<double (*)(double)> {
-    ufunc_() {
-        // clang-format off
-        add
-            ("abs"   , static_cast<double (*)(double)>(&std::abs))
-            ("acos"  , static_cast<double (*)(double)>(&math::acos))
-            ("acosh" , static_cast<double (*)(double)>(&math::acosh))
-            ("asin"  , static_cast<double (*)(double)>(&math::asin))
-            ("asinh" , static_cast<double (*)(double)>(&std::asinh))
-            ("atan"  , static_cast<double (*)(double)>(&std::atan))
-            ("atanh" , static_cast<double (*)(double)>(&math::atanh))
-            ("cbrt"  , static_cast<double (*)(double)>(&std::cbrt))
-            ("ceil"  , static_cast<double (*)(double)>(&std::ceil))
-            ("cos"   , static_cast<double (*)(double)>(&math::cos))
-            ("cosh"  , static_cast<double (*)(double)>(&std::cosh))
-            ("deg"   , static_cast<double (*)(double)>(&math::deg))
-            ("erf"   , static_cast<double (*)(double)>(&std::erf))
-            ("erfc"  , static_cast<double (*)(double)>(&std::erfc))
-            ("exp"   , static_cast<double (*)(double)>(&std::exp))
-            ("exp2"  , static_cast<double (*)(double)>(&std::exp2))
-            ("floor" , static_cast<double (*)(double)>(&std::floor))
-            ("isinf" , static_cast<double (*)(double)>(&math::isinf))
-            ("isnan" , static_cast<double (*)(double)>(&math::isnan))
-            ("log"   , static_cast<double (*)(double)>(&math::log))
-            ("log2"  , static_cast<double (*)(double)>(&math::log2))
-            ("log10" , static_cast<double (*)(double)>(&math::log10))
-            ("rad"   , static_cast<double (*)(double)>(&math::rad))
-            ("round" , static_cast<double (*)(double)>(&std::round))
-            ("sgn"   , static_cast<double (*)(double)>(&math::sgn))
-            ("sin"   , static_cast<double (*)(double)>(&math::sin))
-            ("sinh"  , static_cast<double (*)(double)>(&std::sinh))
-            ("sqrt"  , static_cast<double (*)(double)>(&math::sqrt))
-            ("tan"   , static_cast<double (*)(double)>(&math::tan))
-            ("tanh"  , static_cast<double (*)(double)>(&std::tanh))
-            ("tgamma", static_cast<double (*)(double)>(&math::tgamma))
-            ;
-        // clang-format on
-    }
-} ufunc;
-
-struct tfunc_ : x3::symbols<double (*)(double, double, double)> {
-    tfunc_() {
-        // clang-format off
-        add
-	  ("ifelse", static_cast<double (*)(double, double, double)>(&math::ifelse))
-            ;
-        // clang-format on
-    }
-} tfunc;
-
-struct bfunc_ : x3::symbols<double (*)(double, double)> {
-    bfunc_() {
-        // clang-format off
-        add
-            ("atan2", static_cast<double (*)(double, double)>(&std::atan2))
-            ("max"  , static_cast<double (*)(double, double)>(&std::fmax))
-            ("min"  , static_cast<double (*)(double, double)>(&std::fmin))
-            ("pow"  , static_cast<double (*)(double, double)>(&math::pow))
-            ;
-        // clang-format on
-    }
-} bfunc;
-
-struct unary_op_ : x3::symbols<double (*)(double)> {
-    unary_op_() {
-        // clang-format off
-        add
-            ("+", static_cast<double (*)(double)>(&math::plus))
-            ("-", static_cast<double (*)(double)>(&math::minus))
-            ("!", static_cast<double (*)(double)>(&math::unary_not))
-            ;
-        // clang-format on
-    }
-} unary_op;
-
-struct additive_op_ : x3::symbols<double (*)(double, double)> {
-    additive_op_() {
-        // clang-format off
-        add
-            ("+", static_cast<double (*)(double, double)>(&math::plus))
-            ("-", static_cast<double (*)(double, double)>(&math::minus))
-            ;
-        // clang-format on
-    }
-} additive_op;
-
-struct multiplicative_op_ : x3::symbols<double (*)(double, double)> {
-    multiplicative_op_() {
-        // clang-format off
-        add
-            ("*", static_cast<double (*)(double, double)>(&math::multiplies))
-            ("/", static_cast<double (*)(double, double)>(&math::divides))
-            ("%", static_cast<double (*)(double, double)>(&math::fmod))
-            ;
-        // clang-format on
-    }
-} multiplicative_op;
-
-struct logical_op_ : x3::symbols<double (*)(double, double)> {
-    logical_op_() {
-        // clang-format off
-        add
-            ("&&", static_cast<double (*)(double, double)>(&math::logical_and))
-            ("||", static_cast<double (*)(double, double)>(&math::logical_or))
-            ;
-        // clang-format on
+// The symbols are filled from the tables in builtins.hpp, which are
+// shared by all parsers.
+
+template <typename T, std::size_t N>
+x3::symbols<T> lookup(builtins::symbol<T> const (&table)[N]) {
+    x3::symbols<T> symbols;
+    for (builtins::symbol<T> const &entry : table) {
+        symbols.add(entry.name, entry.value);
     }
-} logical_op;
-
-struct relational_op_ : x3::symbols<double (*)(double, double)> {
-    relational_op_() {
-        // clang-format off
-        add
-            ("<" , static_cast<double (*)(double, double)>(&math::less))
-            ("<=", static_cast<double (*)(double, double)>(&math::less_equals))
-            (">" , static_cast<double (*)(double, double)>(&math::greater))
-            (">=", static_cast<double (*)(double, double)>(&math::greater_equals))
-            ;
-        // clang-format on
+    return symbols;
+}
+
+x3::symbols<double> constant = lookup(builtins::constants);
+x3::symbols<double (*)(double)> ufunc = lookup(builtins::unary_functions);
+x3::symbols<double (*)(double, double)> bfunc =
+    lookup(builtins::binary_functions);
+x3::symbols<double (*)(double, double, double)> tfunc =
+    lookup(builtins::ternary_functions);
+x3::symbols<double (*)(double)> unary_op = lookup(builtins::unary_operators);
+x3::symbols<double (*)(double, double)> additive_op =
+    lookup(builtins::additive_operators);
+x3::symbols<double (*)(double, double)> multiplicative_op =
+    lookup(builtins::multiplicative_operators);
+x3::symbols<double (*)(double, double)> logical_op =
+    lookup(builtins::logical_operators);
+x3::symbols<double (*)(double, double)> relational_op =
+    lookup(builtins::relational_operators);
+x3::symbols<double (*)(double, double)> equality_op =
+    lookup(builtins::equality_operators);
+x3::symbols<double (*)(double, double)> power =
+    lookup(builtins::power_operators);
+
+// ACTIONS
+
+// Every action reports a finished operand to the tree builder, after
+// the actions of all its operands have run.
+
+template <typename Context>
+ast::builder &builder(Context const &ctx) {
+    return x3::get<builder_tag>(ctx);
+}
+
+auto const push_constant = [](auto &ctx) {
+    builder(ctx).constant(x3::_attr(ctx));
+};
+
+auto const push_variable = [](auto &ctx) {
+    auto const &name = x3::_attr(ctx);
+    builder(ctx).variable(name.begin(), name.end());
+};
+
+auto const push_unary = [](auto &ctx) { builder(ctx).unary(x3::_attr(ctx)); };
+
+auto const push_binary = [](auto &ctx) {
+    builder(ctx).binary(x3::_attr(ctx));
+};
+
+auto const push_ternary = [](auto &ctx) {
+    builder(ctx).ternary(x3::_attr(ctx));
+};
+
+// EXPECTATIONS
+
+// Like x3::expect, but a failure is recorded in the parser::failure of
+// the context instead of throwing x3::expectation_failure.
+
+template <typename Subject>
+struct expect_directive : x3::unary_parser<Subject, expect_directive<Subject>> {
+    using base_type = x3::unary_parser<Subject, expect_directive<Subject>>;
+    static bool const is_pass_through_unary = true;
+
+    constexpr expect_directive(Subject const &subject, char const *expected,
+                               char const *rule)
+        : base_type(subject), expected(expected), rule(rule) {}
+
+    template <typename Iterator, typename Context, typename RContext,
+              typename Attribute>
+    bool parse(Iterator &first, Iterator const &last, Context const &context,
+               RContext &rcontext, Attribute &attr) const {
+        if (this->subject.parse(first, last, context, rcontext, attr)) {
+            return true;
+        }
+        x3::get<failure_tag>(context).record(first, expected, rule);
+        return false;
     }
-} relational_op;
-
-struct equality_op_ : x3::symbols<double (*)(double, double)> {
-    equality_op_() {
-        // clang-format off
-        add
-            ("==", static_cast<double (*)(double, double)>(&math::equals))
-            ("!=", static_cast<double (*)(double, double)>(&math::not_equals))
-            ;
-        // clang-format on
+
+    char const *expected;
+    char const *rule;
+};
+
+/// @brief Generates the expectations within the rule named @c rule
+struct expect_gen {
+    template <typename ID, typename Attribute, bool Force>
+    constexpr expect_directive<x3::rule<ID, Attribute, Force>>
+    operator[](x3::rule<ID, Attribute, Force> const &subject) const {
+        return {subject, subject.name, rule};
     }
-} equality_op;
-
-struct power_ : x3::symbols<double (*)(double, double)> {
-    power_() {
-        // clang-format off
-        add
-            ("**", static_cast<double (*)(double, double)>(&math::pow))
-            ;
-        // clang-format on
+
+    expect_directive<decltype(x3::lit('('))> operator[](char c) const {
+        return {x3::lit(c), punctuation(c), rule};
     }
-} power;
+
+    char const *rule;
+};
+
+template <typename ID, typename Attribute, bool Force>
+constexpr expect_gen expect_in(x3::rule<ID, Attribute, Force> const &rule) {
+    return {rule.name};
+}
 
 // ADL markers
 
@@ -200,18 +151,31 @@ struct variable_class;
 
 // Rule declarations
 
-auto const expression     = x3::rule<expression_class    , ast::expression>{"expression"};
-auto const logical        = x3::rule<logical_class       , ast::expression>{"logical"};
-auto const equality       = x3::rule<equality_class      , ast::expression>{"equality"};
-auto const relational     = x3::rule<relational_class    , ast::expression>{"relational"};
-auto const additive       = x3::rule<additive_class      , ast::expression>{"additive"};
-auto const multiplicative = x3::rule<multiplicative_class, ast::expression>{"multiplicative"};
-auto const factor         = x3::rule<factor_class        , ast::expression>{"factor"};
-auto const primary        = x3::rule<primary_class       , ast::operand   >{"primary"};
-auto const unary          = x3::rule<unary_class         , ast::unary_op  >{"unary"};
-auto const binary         = x3::rule<binary_class        , ast::binary_op >{"binary"};
-auto const ternary        = x3::rule<ternary_class       , ast::ternary_op>{"ternary"};
-auto const variable       = x3::rule<variable_class      , std::string    >{"variable"};
+auto const expression     = x3::rule<expression_class    >{"expression"};
+auto const logical        = x3::rule<logical_class       >{"logical"};
+auto const equality       = x3::rule<equality_class      >{"equality"};
+auto const relational     = x3::rule<relational_class    >{"relational"};
+auto const additive       = x3::rule<additive_class      >{"additive"};
+auto const multiplicative = x3::rule<multiplicative_class>{"multiplicative"};
+auto const factor         = x3::rule<factor_class        >{"factor"};
+auto const primary        = x3::rule<primary_class       >{"primary"};
+auto const unary          = x3::rule<unary_class         >{"unary"};
+auto const binary         = x3::rule<binary_class        >{"binary"};
+auto const ternary        = x3::rule<ternary_class       >{"ternary"};
+auto const variable       = x3::rule<variable_class, boost::iterator_range<char const *>>{"variable"};
+
+// Expectation generators
+
+auto const in_logical        = expect_in(logical);
+auto const in_equality       = expect_in(equality);
+auto const in_relational     = expect_in(relational);
+auto const in_additive       = expect_in(additive);
+auto const in_multiplicative = expect_in(multiplicative);
+auto const in_factor         = expect_in(factor);
+auto const in_primary        = expect_in(primary);
+auto const in_unary          = expect_in(unary);
+auto const in_binary         = expect_in(binary);
+auto const in_ternary        = expect_in(ternary);
 
 // Rule defintions
 
@@ -220,39 +184,42 @@ auto const expression_def =
     ;
 
 auto const logical_def =
-    equality >> *(logical_op > equality)
+    equality >> *(logical_op >> in_logical[equality])[push_binary]
     ;
 
 auto const equality_def =
-    relational >> *(equality_op > relational)
+    relational >> *(equality_op >> in_equality[relational])[push_binary]
     ;
 
 auto const relational_def =
-    additive >> *(relational_op > additive)
+    additive >> *(relational_op >> in_relational[additive])[push_binary]
     ;
 
 auto const additive_def =
-    multiplicative >> *(additive_op > multiplicative)
+    multiplicative >> *(additive_op >> in_additive[multiplicative])[push_binary]
     ;
 
 auto const multiplicative_def =
-    factor >> *(multiplicative_op > factor)
+    factor >> *(multiplicative_op >> in_multiplicative[factor])[push_binary]
     ;
 
 auto const factor_def =
-    primary >> *( power > factor )
+    primary >> *( power >> in_factor[factor] )[push_binary]
     ;
 
 auto const unary_def =
-    ufunc > '(' > expression > ')'
+    (ufunc >> in_unary['('] >> in_unary[expression] >> in_unary[')'])[push_unary]
     ;
 
 auto const binary_def =
-    bfunc > '(' > expression > ',' > expression > ')'
+    (bfunc >> in_binary['('] >> in_binary[expression] >> in_binary[',']
+           >> in_binary[expression] >> in_binary[')'])[push_binary]
     ;
 
 auto const ternary_def =
-    tfunc > '(' > expression > ',' > expression > ',' > expression > ')'
+    (tfunc >> in_ternary['('] >> in_ternary[expression] >> in_ternary[',']
+           >> in_ternary[expression] >> in_ternary[',']
+           >> in_ternary[expression] >> in_ternary[')'])[push_ternary]
     ;
 
 auto const variable_def =
@@ -260,14 +227,14 @@ auto const variable_def =
     ;
 
 auto const primary_def =
-      x3::double_
-    | ('(' > expression > ')')
-    | (unary_op > primary)
+      x3::double_[push_constant]
+    | ('(' >> in_primary[expression] >> in_primary[')'])
+    | (unary_op >> in_primary[primary])[push_unary]
     | ternary
     | binary
     | unary
-    | constant
-    | variable
+    | constant[push_constant]
+    | variable[push_variable]
     ;
 
 BOOST_SPIRIT_DEFINE(
@@ -287,16 +254,6 @@ BOOST_SPIRIT_DEFINE(
 
 // clang-format on
 
-struct expression_class {
-    template <typename Iterator, typename Exception, typename Context>
-    x3::error_handler_result on_error(Iterator &, Iterator const &last,
-                                      Exception const &x, Context const &) {
-        std::cout << "Expected " << x.which() << " at \""
-                  << std::string{x.where(), last} << "\"" << std::endl;
-        return x3::error_handler_result::fail;
-    }
-};
-
 } // namespace parser
 
 parser::expression_type grammar() { return parser::expression; }
@@ -0,0 +1,85 @@
+#define BOOST_TEST_MODULE batch
+#include "exprtest.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+// Evaluate all rows at once and row by row and require identical bits
+void check_rows(std::string const &expr, std::size_t rows) {
+    matheval::Parser parser;
+    parser.parse(expr);
+
+    std::vector<std::vector<double>> data(parser.variables().size());
+    std::vector<double const *> columns;
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        for (std::size_t r = 0; r < rows; ++r) {
+            data[i].push_back(1.5 + std::sin(1.0 + i + 0.37 * r));
+        }
+        columns.push_back(data[i].data());
+    }
+
+    std::vector<double> results(rows);
+    parser.evaluate(rows, columns.data(), results.data());
+
+    std::vector<double> row(data.size());
+    for (std::size_t r = 0; r < rows; ++r) {
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            row[i] = data[i][r];
+        }
+        double expected = parser.evaluate(row);
+        BOOST_CHECK_EQUAL(std::memcmp(&results[r], &expected, sizeof(double)), 0);
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(arithmetic) {
+    check_rows("x*x*x + 2*x*y - 3/y + 4 - -x", 1000);
+}
+
+BOOST_AUTO_TEST_CASE(functions) {
+    check_rows("sin(x)**2 + cos(y)**2 + atan2(x, y) + max(x, y) % 0.3", 300);
+}
+
+BOOST_AUTO_TEST_CASE(conditionals) {
+    check_rows("ifelse(x > y, sqrt(x), log(y)) + (x <= 0.7 && y != 1)", 129);
+}
+
+BOOST_AUTO_TEST_CASE(constant) {
+    check_rows("1 + 2 * pi", 5);
+}
+
+BOOST_AUTO_TEST_CASE(empty) {
+    check_rows("x + y", 0);
+}
+
+BOOST_AUTO_TEST_CASE(error) {
+    matheval::Parser parser;
+    parser.parse("log(x)");
+    std::vector<double> x(300, 1.0);
+    x[200] = -1.0;
+    double const *columns[] = {x.data()};
+    std::vector<double> results(x.size());
+    BOOST_CHECK_THROW(parser.evaluate(x.size(), columns, results.data()),
+                      matheval::logInvalid);
+}
+
+BOOST_AUTO_TEST_CASE(lowest_failing_row) {
+    // The logarithm is executed first but fails in a higher row
+    matheval::Parser parser;
+    parser.parse("log(x) + 1 / y");
+    std::vector<double> x(100, 1.0);
+    std::vector<double> y(100, 1.0);
+    x[40] = -1.0;
+    y[10] = 0.0;
+    double const *columns[] = {x.data(), y.data()};
+    std::vector<double> results(x.size());
+    BOOST_CHECK_THROW(parser.evaluate(x.size(), columns, results.data()),
+                      matheval::divideByZero);
+}
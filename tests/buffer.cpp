@@ -0,0 +1,76 @@
+#define BOOST_TEST_MODULE buffer
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+// Expressions which are not a std::string are parsed where they are
+
+BOOST_AUTO_TEST_CASE(slice_of_buffer) {
+    // Only the first expression of the buffer is parsed, and nothing
+    // after it is read
+    char const buffer[] = {'x', ' ', '+', ' ', 'y', ';', '#'};
+    matheval::Parser parser;
+    parser.parse(buffer, 5);
+    BOOST_CHECK(parser.variables() == (std::vector<std::string>{"x", "y"}));
+    BOOST_CHECK_EQUAL(parser.evaluate({{"x", 1}, {"y", 2}}), 3);
+
+    BOOST_CHECK_THROW(parser.parse(buffer, 6), matheval::parse_error);
+    BOOST_CHECK_THROW(parser.parse(buffer, 0), matheval::parse_error);
+}
+
+BOOST_AUTO_TEST_CASE(null_terminated) {
+    char const *const expr = "2 * x";
+    matheval::Parser parser;
+    parser.parse(expr);
+    BOOST_CHECK_EQUAL(parser.evaluate({{"x", 4}}), 8);
+}
+
+BOOST_AUTO_TEST_CASE(diagnostic_within_slice) {
+    char const buffer[] = "1 + (2 * ) and more";
+    matheval::Parser parser;
+    try {
+        parser.parse(buffer, 10);
+        BOOST_ERROR("no parse_error");
+    } catch (matheval::parse_error const &e) {
+        BOOST_CHECK_EQUAL(e.diagnostic().offset, 9u);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(repeated_names) {
+    std::string const name = "a_variable_with_a_long_name";
+    std::string const expr = name + " * " + name + " + b + " + name;
+    matheval::Parser parser;
+    parser.parse(expr.data(), expr.size());
+    BOOST_CHECK(parser.variables() ==
+                (std::vector<std::string>{name, "b"}));
+    BOOST_CHECK_EQUAL(parser.evaluate({{name, 3}, {"b", 1}}), 13);
+}
+
+BOOST_AUTO_TEST_CASE(convenience) {
+    char const buffer[] = "x * 3 garbage";
+    std::map<std::string, double> const st = {{"x", 2}};
+    BOOST_CHECK_EQUAL(matheval::parse(buffer, 5, st), 6);
+    BOOST_CHECK_EQUAL(matheval::parse(buffer, 1, [](std::string const &) {
+                          return 7.;
+                      }),
+                      7);
+}
+
+#ifdef MATHEVAL_HAS_STRING_VIEW
+BOOST_AUTO_TEST_CASE(string_view) {
+    std::string_view const line = "x + 1, y + 2";
+    matheval::Parser parser;
+    parser.parse(line.substr(0, 5));
+    BOOST_CHECK_EQUAL(parser.evaluate({{"x", 1}}), 2);
+    parser.parse(line.substr(7));
+    BOOST_CHECK_EQUAL(parser.evaluate({{"y", 1}}), 3);
+    // A literal still picks an overload
+    parser.parse("x");
+    BOOST_CHECK_EQUAL(parser.evaluate({{"x", 5}}), 5);
+}
+#endif
@@ -0,0 +1,96 @@
+#define BOOST_TEST_MODULE builtins
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "builtins.hpp"
+#include "matheval.hpp"
+
+// The evaluators for other number types, the derivatives and the
+// binary format keep their own tables of the functions.  These tests
+// make sure that every function which can be parsed is in them.
+
+namespace {
+
+/// @brief An expression using the entry of @p table, for every entry
+template <typename T, std::size_t N>
+void add(std::vector<std::string> &exprs,
+         matheval::builtins::symbol<T> const (&table)[N],
+         std::string const &prefix, std::string const &suffix) {
+    for (matheval::builtins::symbol<T> const &entry : table) {
+        exprs.push_back(prefix + entry.name + suffix);
+    }
+}
+
+/// @brief An expression for every function of builtins.hpp
+std::vector<std::string> parsed() {
+    namespace builtins = matheval::builtins;
+    std::vector<std::string> exprs;
+    add(exprs, builtins::unary_functions, "", "(x)");
+    add(exprs, builtins::binary_functions, "", "(x, y)");
+    add(exprs, builtins::ternary_functions, "", "(x, y, z)");
+    add(exprs, builtins::unary_operators, "", "x");
+    add(exprs, builtins::additive_operators, "x ", " y");
+    add(exprs, builtins::multiplicative_operators, "x ", " y");
+    add(exprs, builtins::logical_operators, "x ", " y");
+    add(exprs, builtins::relational_operators, "x ", " y");
+    add(exprs, builtins::equality_operators, "x ", " y");
+    add(exprs, builtins::power_operators, "x ", " y");
+    return exprs;
+}
+
+/// @brief An expression for every function which only
+///        Parser::optimize() introduces
+std::vector<std::string> const optimized = {
+    "x ** -1", "x ** 1", "x ** 2", "x ** 3", "x ** 4", "x ** 0.5",
+};
+
+/// @brief Call @p check with a parser for every expression
+template <typename Check>
+void for_every_function(Check const &check) {
+    for (std::string const &expr : parsed()) {
+        matheval::Parser parser;
+        parser.parse(expr);
+        check(expr, parser);
+    }
+    for (std::string const &expr : optimized) {
+        matheval::Parser parser;
+        parser.parse(expr);
+        parser.optimize();
+        check(expr, parser);
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(serialize) {
+    for_every_function([](std::string const &expr,
+                          matheval::Parser const &parser) {
+        std::string bytes;
+        BOOST_CHECK_NO_THROW(bytes = parser.serialize());
+        matheval::Parser loaded;
+        BOOST_CHECK_NO_THROW(loaded.deserialize(bytes.data(), bytes.size()));
+        BOOST_CHECK_MESSAGE(loaded.serialize() == bytes, expr);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(float_expression) {
+    for_every_function([](std::string const &expr,
+                          matheval::Parser const &parser) {
+        BOOST_TEST_CONTEXT(expr) {
+            BOOST_CHECK_NO_THROW(matheval::FloatExpression{parser});
+        }
+    });
+}
+
+BOOST_AUTO_TEST_CASE(gradient_expression) {
+    for_every_function([](std::string const &expr,
+                          matheval::Parser const &parser) {
+        BOOST_TEST_CONTEXT(expr) {
+            BOOST_CHECK_NO_THROW(
+                matheval::GradientExpression(parser, parser.variables()));
+        }
+    });
+}
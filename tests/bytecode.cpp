@@ -0,0 +1,64 @@
+#define BOOST_TEST_MODULE bytecode
+#include "exprtest.hpp"
+#include <cmath>
+#include <limits>
+#include <map>
+#include <string>
+
+#include "matheval.hpp"
+
+BOOST_AUTO_TEST_CASE(compile_after_optimize) {
+    matheval::Parser parser;
+    parser.parse("x + 1 * ( 2 + 3 * 4)");
+    parser.optimize();
+    parser.compile();
+    BOOST_CHECK_EQUAL(parser.evaluate({std::make_pair("x", 1.)}), 15.);
+}
+
+BOOST_AUTO_TEST_CASE(optimize_after_compile) {
+    matheval::Parser parser;
+    parser.parse("-x - 2 ** 3");
+    parser.compile();
+    BOOST_CHECK_EQUAL(parser.evaluate({std::make_pair("x", 1.)}), -9.);
+    parser.optimize();
+    BOOST_CHECK_EQUAL(parser.evaluate({std::make_pair("x", 2.)}), -10.);
+}
+
+BOOST_AUTO_TEST_CASE(reparse_discards_program) {
+    matheval::Parser parser;
+    parser.parse("1 + 1");
+    parser.compile();
+    BOOST_CHECK_EQUAL(parser.evaluate(), 2.);
+    parser.parse("2 * 3");
+    BOOST_CHECK_EQUAL(parser.evaluate(), 6.);
+}
+
+BOOST_AUTO_TEST_CASE(variable_callback) {
+    matheval::Parser parser;
+    parser.parse("x * y + x");
+    parser.compile();
+    int calls = 0;
+    double result = parser.evaluate([&calls](std::string const &var) {
+        ++calls;
+        return var == "x" ? 2. : 3.;
+    });
+    BOOST_CHECK_EQUAL(result, 8.);
+    BOOST_CHECK_EQUAL(calls, 3);
+    BOOST_CHECK_THROW(parser.evaluate(), matheval::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(deep_stack) {
+    std::string expr = "1";
+    for (int i = 0; i < 200; ++i) {
+        expr = "1+(" + expr + ")";
+    }
+    matheval::Parser parser;
+    parser.parse(expr);
+    parser.compile();
+    BOOST_CHECK_EQUAL(parser.evaluate(), 201.);
+}
+
+BOOST_AUTO_TEST_CASE(compile_nothing) {
+    matheval::Parser parser;
+    BOOST_CHECK_THROW(parser.compile(), matheval::invalid_argument);
+}
@@ -0,0 +1,97 @@
+#define BOOST_TEST_MODULE cache
+#include "exprtest.hpp"
+#include <cstddef>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "matheval.hpp"
+
+BOOST_AUTO_TEST_CASE(disabled_by_default) {
+    matheval::ExpressionCache &cache = matheval::ExpressionCache::shared();
+    BOOST_CHECK_EQUAL(cache.capacity(), 0);
+    BOOST_CHECK_EQUAL(matheval::parse("1 + 2"), 3.);
+    BOOST_CHECK_EQUAL(cache.stats().size, 0);
+    BOOST_CHECK_EQUAL(cache.stats().hits, 0);
+}
+
+BOOST_AUTO_TEST_CASE(convenience_functions) {
+    matheval::ExpressionCache &cache = matheval::ExpressionCache::shared();
+    cache.set_capacity(64);
+    std::map<std::string, double> st = {std::make_pair("x", 2.)};
+    for (int i = 0; i < 3; ++i) {
+        BOOST_CHECK_EQUAL(matheval::parse("x * x + 1", st), 5.);
+    }
+    BOOST_CHECK_EQUAL(
+        matheval::parse("x * x + 1", [](std::string const &) { return 3.; }),
+        10.);
+    BOOST_CHECK_THROW(matheval::parse("x * x + 1"), matheval::invalid_argument);
+    BOOST_CHECK_THROW(matheval::parse("1/0"), matheval::divideByZero);
+    BOOST_CHECK_THROW(matheval::parse("1 +"), matheval::parse_error);
+
+    auto stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.hits, 4);
+    BOOST_CHECK_EQUAL(stats.misses, 3);
+    BOOST_CHECK_EQUAL(stats.size, 2);
+
+    cache.set_capacity(0);
+    cache.clear();
+    BOOST_CHECK_EQUAL(cache.stats().size, 0);
+    BOOST_CHECK_EQUAL(cache.stats().hits, 0);
+}
+
+BOOST_AUTO_TEST_CASE(least_recently_used) {
+    matheval::ExpressionCache cache(2, 1);
+    cache.get("1");
+    cache.get("2");
+    cache.get("1"); // hit, "2" is now the least recently used
+    cache.get("3"); // evicts "2"
+    BOOST_CHECK_EQUAL(cache.stats().size, 2);
+    BOOST_CHECK_EQUAL(cache.get("1").evaluate(), 1.);
+    BOOST_CHECK_EQUAL(cache.get("3").evaluate(), 3.);
+    BOOST_CHECK_EQUAL(cache.stats().hits, 3);
+    BOOST_CHECK_EQUAL(cache.get("2").evaluate(), 2.);
+    BOOST_CHECK_EQUAL(cache.stats().misses, 4);
+
+    cache.set_capacity(1);
+    BOOST_CHECK_EQUAL(cache.stats().size, 1);
+    BOOST_CHECK_EQUAL(cache.get("2").evaluate(), 2.);
+    BOOST_CHECK_EQUAL(cache.stats().hits, 4);
+}
+
+BOOST_AUTO_TEST_CASE(bounded) {
+    matheval::ExpressionCache cache(32, 4);
+    for (int i = 0; i < 1000; ++i) {
+        cache.get(std::to_string(i) + " + x");
+    }
+    BOOST_CHECK_LE(cache.stats().size, 32);
+    BOOST_CHECK_EQUAL(cache.stats().misses, 1000);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent) {
+    matheval::ExpressionCache cache(64);
+    std::vector<std::thread> threads;
+    std::vector<int> wrong(8, 0);
+    for (std::size_t t = 0; t < 8; ++t) {
+        threads.emplace_back([&cache, &wrong, t] {
+            for (int i = 0; i < 2000; ++i) {
+                int k = i % 10;
+                double x = t;
+                if (cache.get(std::to_string(k) + " * x").evaluate(&x) !=
+                    k * x) {
+                    ++wrong[t];
+                }
+            }
+        });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    for (int w : wrong) {
+        BOOST_CHECK_EQUAL(w, 0);
+    }
+    auto stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.hits + stats.misses, 16000);
+    BOOST_CHECK_EQUAL(stats.size, 10);
+}
@@ -0,0 +1,108 @@
+#define BOOST_TEST_MODULE compiled_expression
+#include "exprtest.hpp"
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "matheval.hpp"
+
+BOOST_AUTO_TEST_CASE(evaluate) {
+    matheval::Parser parser;
+    parser.parse("x * y + sin(x) / 2");
+    matheval::CompiledExpression const expr(parser);
+
+    std::map<std::string, double> st = {std::make_pair("x", 1.5),
+                                        std::make_pair("y", -2.)};
+    double const values[] = {1.5, -2.};
+    BOOST_CHECK_EQUAL(expr.evaluate(st), parser.evaluate(st));
+    BOOST_CHECK_EQUAL(expr.evaluate(values), parser.evaluate(st));
+    BOOST_CHECK_EQUAL(expr.evaluate(std::vector<double>{1.5, -2.}),
+                      parser.evaluate(st));
+    BOOST_REQUIRE_EQUAL(expr.variables().size(), 2);
+    BOOST_CHECK_EQUAL(expr.variables()[0], "x");
+    BOOST_CHECK_EQUAL(expr.variables()[1], "y");
+    BOOST_CHECK_THROW(expr.evaluate(std::vector<double>{1.}),
+                      matheval::invalid_argument);
+    BOOST_CHECK_THROW(expr.evaluate(), matheval::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(independent_of_parser) {
+    matheval::Parser parser;
+    parser.parse("x + 1");
+    matheval::CompiledExpression const first(parser);
+    parser.parse("2 * x");
+    parser.compile();
+    matheval::CompiledExpression const second(parser);
+    matheval::CompiledExpression const copy = first;
+
+    double const x = 3;
+    BOOST_CHECK_EQUAL(first.evaluate(&x), 4.);
+    BOOST_CHECK_EQUAL(copy.evaluate(&x), 4.);
+    BOOST_CHECK_EQUAL(second.evaluate(&x), 6.);
+}
+
+BOOST_AUTO_TEST_CASE(optimized) {
+    matheval::Parser parser;
+    parser.parse("x + 1 * (2 + 3 * 4)");
+    parser.optimize();
+    matheval::CompiledExpression const expr(parser);
+    double const x = 1;
+    BOOST_CHECK_EQUAL(expr.evaluate(&x), 15.);
+}
+
+BOOST_AUTO_TEST_CASE(errors) {
+    matheval::Parser parser;
+    BOOST_CHECK_THROW(matheval::CompiledExpression{parser},
+                      matheval::invalid_argument);
+
+    parser.parse("log(x)");
+    matheval::CompiledExpression const expr(parser);
+    double const x = -1;
+    BOOST_CHECK_THROW(expr.evaluate(&x), matheval::logInvalid);
+    matheval::errc error;
+    BOOST_CHECK(std::isnan(expr.evaluate(&x, error)));
+    BOOST_CHECK(error == matheval::errc::logInvalid);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent) {
+    matheval::Parser parser;
+    parser.parse("ifelse(x > 0, sqrt(abs(x)), -x) + pow(x, 2) / 3");
+    matheval::CompiledExpression const expr(parser);
+
+    std::size_t const rows = 1000;
+    std::vector<double> x(rows);
+    std::vector<double> expected(rows);
+    for (std::size_t r = 0; r < rows; ++r) {
+        x[r] = std::sin(0.1 * r);
+        expected[r] = parser.evaluate(&x[r]);
+    }
+
+    // All threads share one object, some through copies
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&, t] {
+            matheval::CompiledExpression const copy = expr;
+            matheval::CompiledExpression const &e = t % 2 ? copy : expr;
+            for (int repeat = 0; repeat < 20; ++repeat) {
+                std::vector<double> results(rows);
+                double const *columns[] = {x.data()};
+                e.evaluate(rows, columns, results.data());
+                for (std::size_t r = 0; r < rows; ++r) {
+                    if (results[r] != expected[r] ||
+                        e.evaluate(&x[r]) != expected[r]) {
+                        ++mismatches;
+                    }
+                }
+            }
+        });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    BOOST_CHECK_EQUAL(mismatches.load(), 0);
+}
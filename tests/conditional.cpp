@@ -0,0 +1,219 @@
+#define BOOST_TEST_MODULE conditional
+#include <boost/test/included/unit_test.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include "exprtest.hpp"
+#include "matheval.hpp"
+
+namespace {
+
+bool same_bits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+double const not_a_number = std::numeric_limits<double>::quiet_NaN();
+
+std::vector<double> const samples = {0.0, -0.0, 1.0, -2.5, 0.5, 3.0, -1.0,
+                                     not_a_number};
+
+/// @brief The ways to evaluate a parsed expression
+enum class mode { tree, optimized, compiled, native };
+
+/// @brief Evaluate for x and y, remembering the type of a thrown
+///        exception
+double evaluate(std::string const &expr, mode m, double x, double y,
+                std::type_info const *&thrown) {
+    matheval::Parser parser;
+    parser.parse(expr);
+    if (m == mode::optimized) {
+        parser.optimize();
+    } else if (m == mode::compiled) {
+        parser.compile();
+    } else if (m == mode::native) {
+        parser.compile_native();
+    }
+    std::map<std::string, double> const st = {{"x", x}, {"y", y}};
+    return evaluate_catching([&] { return parser.evaluate(st); }, thrown);
+}
+
+/// @brief Check that every way of evaluating gives the same result
+///        or throws the same exception as the tree
+void same_everywhere(std::string const &expr) {
+    for (double x : samples) {
+        for (double y : samples) {
+            std::type_info const *expected_error;
+            double const expected =
+                evaluate(expr, mode::tree, x, y, expected_error);
+            for (mode m : {mode::optimized, mode::compiled, mode::native}) {
+                std::type_info const *error;
+                double const result = evaluate(expr, m, x, y, error);
+                if (expected_error) {
+                    BOOST_CHECK_MESSAGE(error && *error == *expected_error,
+                                        expr << " for " << x << ", " << y
+                                             << " should throw "
+                                             << expected_error->name());
+                    continue;
+                }
+                BOOST_CHECK_MESSAGE(!error &&
+                                        (same_bits(result, expected) ||
+                                         (std::isnan(result) &&
+                                          std::isnan(expected))),
+                                    expr << " for " << x << ", " << y
+                                         << ": " << result
+                                         << " != " << expected);
+            }
+        }
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(untaken_branch_does_not_throw) {
+    double const x = -1;
+    for (char const *expr :
+         {"ifelse(x > 0, log(x), 0)", "ifelse(x <= 0, 0, log(x))",
+          "x > 0 && log(x) > 1", "x <= 0 || log(x) > 1"}) {
+        matheval::Parser parser;
+        parser.parse(expr);
+        std::map<std::string, double> const st = {{"x", x}};
+        BOOST_CHECK_NO_THROW(parser.evaluate(st));
+        parser.compile_native();
+        BOOST_CHECK_NO_THROW(parser.evaluate(&x));
+        parser.compile();
+        BOOST_CHECK_NO_THROW(parser.evaluate(&x));
+        matheval::errc error;
+        parser.evaluate(&x, error);
+        BOOST_CHECK(error == matheval::errc::none);
+        matheval::CompiledExpression const compiled(parser);
+        BOOST_CHECK_NO_THROW(compiled.evaluate(&x));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(taken_branch_throws) {
+    matheval::Parser parser;
+    parser.parse("ifelse(x > 0, 0, log(x))");
+    double const x = -1;
+    std::map<std::string, double> const st = {{"x", x}};
+    BOOST_CHECK_THROW(parser.evaluate(st), matheval::logInvalid);
+    BOOST_CHECK_THROW(parser.evaluate(&x), matheval::logInvalid);
+    parser.compile_native();
+    BOOST_CHECK_THROW(parser.evaluate(&x), matheval::logInvalid);
+}
+
+BOOST_AUTO_TEST_CASE(same_results) {
+    same_everywhere("ifelse(x > 0, log(x), sqrt(y))");
+    same_everywhere("ifelse(x, y, -y)");
+    same_everywhere("x && 1 / y");
+    same_everywhere("x || 1 / y");
+    same_everywhere("(x > 0 && log(x) < 1) + (y < 0 || sqrt(y) > 1)");
+    same_everywhere("ifelse(x > 0, ifelse(y > 0, log(x * y), 1 / y), "
+                    "ifelse(y && x, sqrt(x), -1)) * 2");
+    same_everywhere("ifelse(x > 0, sqrt(x) * 2, 1) + sqrt(x)");
+    same_everywhere("ifelse(y > 0, log(x) + 1, log(x) - 1) * log(x)");
+    same_everywhere("1 + (x && (y || 1 / x)) * 3");
+}
+
+BOOST_AUTO_TEST_CASE(native_code) {
+    matheval::Parser parser;
+    parser.parse("ifelse(x > 0, x, -x) + (x && y) + (x || y)");
+#if defined(__x86_64__) && !defined(_WIN32)
+    BOOST_CHECK(parser.compile_native());
+#else
+    BOOST_CHECK(!parser.compile_native());
+#endif
+    double const values[] = {-2, 0};
+    BOOST_CHECK_EQUAL(parser.evaluate(values), 3);
+}
+
+BOOST_AUTO_TEST_CASE(truth) {
+    matheval::Parser parser;
+    parser.parse("ifelse(x, 1, 2) * 10 + (x && 1) + (x || 1 / 0)");
+    double const x = not_a_number;
+    // NaN is true, like in C++
+    BOOST_CHECK_EQUAL(parser.evaluate(&x), 12);
+
+    parser.parse("x && y");
+    double const values[] = {-0.0, 1};
+    BOOST_CHECK(!std::signbit(parser.evaluate(values)));
+    parser.compile_native();
+    BOOST_CHECK(!std::signbit(parser.evaluate(values)));
+}
+
+BOOST_AUTO_TEST_CASE(constant_condition) {
+    matheval::Parser parser;
+    parser.parse("ifelse(1 > 0, x, log(-1))");
+    BOOST_CHECK(parser.optimize().folded > 0);
+    BOOST_CHECK_EQUAL(parser.variables().size(), 1);
+    double const x = 3;
+    BOOST_CHECK_EQUAL(parser.evaluate(&x), 3);
+
+    // The variables of the pruned branch keep their slots
+    parser.parse("ifelse(0, x, 2 * 4)");
+    parser.optimize();
+    BOOST_CHECK_EQUAL(parser.variables().size(), 1);
+    BOOST_CHECK_EQUAL(parser.evaluate(&x), 8);
+
+    parser.parse("0 && log(x)");
+    parser.optimize();
+    BOOST_CHECK_EQUAL(parser.variables().size(), 1);
+    BOOST_CHECK_EQUAL(parser.evaluate(&x), 0);
+
+    parser.parse("2 || log(x)");
+    parser.optimize();
+    BOOST_CHECK_EQUAL(parser.evaluate(), 1);
+
+    // The other operand still decides
+    parser.parse("1 && x");
+    parser.optimize();
+    double const half = 0.5;
+    BOOST_CHECK_EQUAL(parser.evaluate(&half), 1);
+}
+
+// Rows of a block which disagree on a condition keep their own result
+// and error
+BOOST_AUTO_TEST_CASE(batch) {
+    std::vector<std::string> const exprs = {
+        "ifelse(x > 0, log(x), sqrt(-x)) + y",
+        "ifelse(x > 0, ifelse(y > 1, log(y), 1 / (x - 2)), sqrt(y))",
+        "(x > 0 && log(x) > 0) + (x > 1 || 1 / (x - 0.5) > 0)",
+        "ifelse(x > 0, sqrt(x) * 2, 1) + sqrt(abs(x)) * y",
+    };
+    std::vector<double> xs;
+    std::vector<double> ys;
+    for (int r = 0; r < 1000; ++r) {
+        // Mostly mixed blocks, some uniform ones
+        double const x = r < 300 ? (r % 7) - 3.0 : r < 700 ? 1 + r : -r;
+        xs.push_back(x);
+        ys.push_back((r % 5) - 1.0);
+    }
+    xs[500] = not_a_number;
+    double const *columns[] = {xs.data(), ys.data()};
+    for (std::string const &expr : exprs) {
+        matheval::Parser parser;
+        parser.parse(expr);
+        parser.optimize();
+        BOOST_REQUIRE_EQUAL(parser.variables().front(), "x");
+        std::vector<double> results(xs.size());
+        std::vector<matheval::errc> errors(xs.size());
+        parser.evaluate(xs.size(), columns, results.data(), errors.data());
+        for (std::size_t r = 0; r < xs.size(); ++r) {
+            double const values[] = {xs[r], ys[r]};
+            matheval::errc error;
+            double const expected = parser.evaluate(values, error);
+            BOOST_CHECK_MESSAGE(errors[r] == error,
+                                expr << " row " << r << " error differs");
+            BOOST_CHECK_MESSAGE(same_bits(results[r], expected) ||
+                                    (std::isnan(results[r]) &&
+                                     std::isnan(expected)),
+                                expr << " row " << r << ": " << results[r]
+                                     << " != " << expected);
+        }
+    }
+}
@@ -0,0 +1,155 @@
+#define BOOST_TEST_MODULE expression_set
+#include <boost/test/included/unit_test.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+bool same_bits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+std::vector<double> const samples = {
+    0.0, -0.0, 1.0, -2.5, 0.5, 3.0, -1.0,
+    std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN()};
+
+/// @brief Compare every result of the set with an optimized parser
+///        of the expression on its own
+void same_as_parser(std::vector<std::string> const &exprs) {
+    matheval::ExpressionSet const set(exprs);
+    BOOST_REQUIRE_EQUAL(set.size(), exprs.size());
+
+    std::mt19937 engine(42);
+    std::vector<double> values(set.variables().size());
+    for (int round = 0; round < 100; ++round) {
+        for (double &value : values) {
+            value = samples[engine() % samples.size()];
+        }
+        std::map<std::string, double> st;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            st[set.variables()[i]] = values[i];
+        }
+
+        // The first failing expression decides the exception
+        std::vector<double> expected;
+        std::type_info const *expected_error = nullptr;
+        for (std::string const &expr : exprs) {
+            matheval::Parser parser;
+            parser.parse(expr);
+            parser.optimize();
+            try {
+                expected.push_back(parser.evaluate(st));
+            } catch (matheval::exception const &e) {
+                expected_error = &typeid(e);
+                break;
+            }
+        }
+
+        std::vector<double> results;
+        std::type_info const *error = nullptr;
+        try {
+            results = set.evaluate(values);
+        } catch (matheval::exception const &e) {
+            error = &typeid(e);
+        }
+        if (expected_error) {
+            BOOST_CHECK_MESSAGE(error && *error == *expected_error,
+                                "round " << round << " should throw "
+                                         << expected_error->name());
+            continue;
+        }
+        BOOST_REQUIRE_MESSAGE(!error, "round " << round << " threw");
+        for (std::size_t i = 0; i < exprs.size(); ++i) {
+            BOOST_CHECK_MESSAGE(same_bits(results[i], expected[i]),
+                                exprs[i] << " in round " << round << ": "
+                                         << results[i]
+                                         << " != " << expected[i]);
+        }
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(shared_nodes) {
+    matheval::ExpressionSet const set(
+        {"sqrt(x**2 + y**2)", "1 + sqrt(x**2 + y**2)", "z * sqrt(x**2+y**2)"});
+    BOOST_CHECK_EQUAL(set.size(), 3);
+    BOOST_CHECK(set.variables() ==
+                (std::vector<std::string>{"x", "y", "z"}));
+    // The square root and everything below it are kept once
+    BOOST_CHECK_EQUAL(set.nodes(), 10);
+
+    double const values[] = {3, 4, 2};
+    double results[3];
+    set.evaluate(values, results);
+    BOOST_CHECK_EQUAL(results[0], 5);
+    BOOST_CHECK_EQUAL(results[1], 6);
+    BOOST_CHECK_EQUAL(results[2], 10);
+}
+
+BOOST_AUTO_TEST_CASE(constant_folding) {
+    matheval::ExpressionSet const set({"x * (1 + 2)", "3 * 4", "x * 3 + 12"});
+    // x, 3, the product, 12 and the sum
+    BOOST_CHECK_EQUAL(set.nodes(), 5);
+    std::vector<double> const results = set.evaluate(std::vector<double>{2});
+    BOOST_CHECK(results == (std::vector<double>{6, 12, 18}));
+}
+
+BOOST_AUTO_TEST_CASE(first_error) {
+    matheval::ExpressionSet const set({"x + 1", "log(x)", "1 / x"});
+    BOOST_CHECK_THROW(set.evaluate(std::vector<double>{0}),
+                      matheval::logDivideByZero);
+    BOOST_CHECK_THROW(set.evaluate(std::vector<double>{-1}),
+                      matheval::logInvalid);
+
+    // Skipped branches do not fail
+    matheval::ExpressionSet const guarded(
+        {"ifelse(x > 0, log(x), 0)", "x != 0 && 1 / x > 1", "log(x)"});
+    BOOST_CHECK_THROW(guarded.evaluate(std::vector<double>{0}),
+                      matheval::logDivideByZero);
+    std::vector<double> const results =
+        guarded.evaluate(std::vector<double>{0.5});
+    BOOST_CHECK_CLOSE(results[0], std::log(0.5), 1e-12);
+    BOOST_CHECK_EQUAL(results[1], 1);
+    BOOST_CHECK_CLOSE(results[2], std::log(0.5), 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(same_results) {
+    same_as_parser({"x*x + 2*x + 1", "sin(x) * cos(y) + sqrt(x**2 + y**2)",
+                    "sqrt(x**2 + y**2) / (1 + z)", "x*x - y", "-(x*x)"});
+    same_as_parser({"ifelse(x > y, log(y), sqrt(z))", "log(y) + x",
+                    "(x != 0 && 1 / x > 1) + sqrt(z)",
+                    "(y == 0 || 1 / y > 0) * ifelse(z, x, y)"});
+}
+
+BOOST_AUTO_TEST_CASE(interface) {
+    BOOST_CHECK_THROW(matheval::ExpressionSet({"x +", "y"}),
+                      matheval::parse_error);
+
+    matheval::ExpressionSet const empty({});
+    BOOST_CHECK_EQUAL(empty.size(), 0);
+    BOOST_CHECK(empty.evaluate(std::vector<double>{}).empty());
+
+    matheval::ExpressionSet const set({"x + y", "y - x"});
+    BOOST_CHECK_THROW(set.evaluate(std::vector<double>{1}),
+                      matheval::invalid_argument);
+    BOOST_CHECK_THROW(
+        set.evaluate(std::map<std::string, double>{{"x", 1}}),
+        matheval::invalid_argument);
+
+    // Copies share the expressions
+    matheval::ExpressionSet const copy = set;
+    std::vector<double> const results =
+        copy.evaluate(std::map<std::string, double>{{"x", 1}, {"y", 3}});
+    BOOST_CHECK(results == (std::vector<double>{4, 2}));
+}
@@ -7,7 +7,52 @@
 #include "matheval.hpp"
 #include <boost/test/included/unit_test.hpp>
 #include <boost/math/constants/constants.hpp>
+#include <map>
 #include <string>
+#include <typeinfo>
+#include <vector>
+
+/// Parse, compile to bytecode and evaluate
+inline double compiled(std::string const &expr,
+                       std::map<std::string, double> const &st)
+{
+    matheval::Parser parser;
+    parser.parse(expr);
+    parser.compile();
+    return parser.evaluate(st);
+}
+
+/// Parse, translate to machine code and evaluate
+inline double native(std::string const &expr,
+                     std::map<std::string, double> const &st)
+{
+    matheval::Parser parser;
+    parser.parse(expr);
+    parser.compile_native();
+    std::vector<double> values;
+    for (std::string const &var : parser.variables()) {
+        auto it = st.find(var);
+        if (it == st.end()) {
+            throw matheval::invalid_argument("Unknown variable " + var); // NOLINT
+        }
+        values.push_back(it->second);
+    }
+    return parser.evaluate(values);
+}
+
+/// Evaluate by calling @p f, remembering the type of a thrown
+/// matheval::exception in @p thrown, or nullptr if there was none
+template <typename F>
+double evaluate_catching(F const &f, std::type_info const *&thrown)
+{
+    thrown = nullptr;
+    try {
+        return f();
+    } catch (matheval::exception const &e) {
+        thrown = &typeid(e);
+        return 0;
+    }
+}
 
 #define EXPRTEST(casename, expr, expected)                             \
 BOOST_AUTO_TEST_CASE( casename )                                       \
@@ -18,6 +63,12 @@ BOOST_AUTO_TEST_CASE( casename )                                       \
     BOOST_CHECK_NO_THROW(result = matheval::parse(s, st));     \
     BOOST_CHECK_CLOSE(result, (expected),                              \
                       std::numeric_limits<double>::epsilon());         \
+    BOOST_CHECK_NO_THROW(result = compiled(s, st));                    \
+    BOOST_CHECK_CLOSE(result, (expected),                              \
+                      std::numeric_limits<double>::epsilon());         \
+    BOOST_CHECK_NO_THROW(result = native(s, st));                      \
+    BOOST_CHECK_CLOSE(result, (expected),                              \
+                      std::numeric_limits<double>::epsilon());         \
 }
 
 #define SYMEXPRTEST(casename, expr, st, expected)                      \
@@ -28,6 +79,12 @@ BOOST_AUTO_TEST_CASE( casename )                                       \
     BOOST_CHECK_NO_THROW(result = matheval::parse(s, st));     \
     BOOST_CHECK_CLOSE(result, (expected),                              \
                       std::numeric_limits<double>::epsilon());         \
+    BOOST_CHECK_NO_THROW(result = compiled(s, st));                    \
+    BOOST_CHECK_CLOSE(result, (expected),                              \
+                      std::numeric_limits<double>::epsilon());         \
+    BOOST_CHECK_NO_THROW(result = native(s, st));                      \
+    BOOST_CHECK_CLOSE(result, (expected),                              \
+                      std::numeric_limits<double>::epsilon());         \
 }
 
 #define THROWTEST(casename, expr, expected)			       \
@@ -36,4 +93,6 @@ BOOST_AUTO_TEST_CASE( casename )				       \
     std::string const s = expr;					       \
     std::map<std::string, double> st;				       \
     BOOST_REQUIRE_THROW(matheval::parse(s, st), expected);	       \
+    BOOST_REQUIRE_THROW(compiled(s, st), expected);		       \
+    BOOST_REQUIRE_THROW(native(s, st), expected);		       \
 }
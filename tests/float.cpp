@@ -0,0 +1,187 @@
+#define BOOST_TEST_MODULE float
+#include <boost/test/included/unit_test.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+/// @brief Distance of @p x from @p y in units in the last place of
+///        @p y, or of 1 if @p y is smaller
+///
+/// Results close to 0 which are differences of larger numbers cannot
+/// be more accurate than these numbers, so their error is measured
+/// relative to 1.
+double ulps(float x, float y) {
+    if (x == y || (std::isnan(x) && std::isnan(y))) {
+        return 0;
+    }
+    float const scale = std::max(std::fabs(y), 1.0f);
+    float const spacing =
+        std::nextafter(scale, std::numeric_limits<float>::infinity()) - scale;
+    return std::fabs(static_cast<double>(x) - static_cast<double>(y)) /
+           spacing;
+}
+
+/// @brief Largest difference of the float and the double evaluation of
+///        @p expr over a grid of values of x and y in [@p lo, @p hi]
+///
+/// The double evaluation gets the same values as the float one, so
+/// that only the rounding of the operations is compared and not that
+/// of the inputs.
+double max_ulps(std::string const &expr, float lo, float hi) {
+    matheval::Parser parser;
+    parser.parse(expr);
+    parser.optimize();
+    matheval::FloatExpression const single(parser);
+    matheval::CompiledExpression const reference(parser);
+
+    double worst = 0;
+    int const steps = 40;
+    for (int i = 0; i <= steps; ++i) {
+        for (int j = 0; j <= steps; ++j) {
+            std::vector<float> v(parser.variables().size());
+            std::vector<double> w(v.size());
+            for (std::size_t s = 0; s < v.size(); ++s) {
+                v[s] = lo + (hi - lo) * static_cast<float>(s == 0 ? i : j) /
+                                static_cast<float>(steps);
+                w[s] = v[s];
+            }
+            float const expected = static_cast<float>(reference.evaluate(w));
+            worst = std::max(worst, ulps(single.evaluate(v), expected));
+        }
+    }
+    return worst;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(double_is_compiled_expression) {
+    std::vector<std::string> const exprs = {
+        "x + y * 3 - 2 / x",
+        "sqrt(x**2 + y**2) / (1 + sqrt(x**2 + y**2))",
+        "ifelse(x > y, sin(x), cos(y)) + atan2(y, x) ** 3",
+        "x > 0 && y > 0 || x < -1",
+        "tgamma(x + 1) % 7 + max(x, y) - min(x, y) + -x",
+    };
+    std::vector<double> const values = {0.75, 1.5};
+    for (std::string const &expr : exprs) {
+        matheval::Parser parser;
+        parser.parse(expr);
+        parser.optimize();
+        matheval::TypedExpression<double> const typed(parser);
+        matheval::CompiledExpression const compiled(parser);
+        BOOST_CHECK(typed.variables() == compiled.variables());
+        BOOST_CHECK_EQUAL(typed.evaluate(values), compiled.evaluate(values));
+    }
+}
+
+// The accuracy of single precision, measured against double precision
+// and printed with --log_level=message.  Every operation of float
+// rounds to 24 bits, so arithmetic is within half an ulp of the double
+// result rounded to float and the functions of the C library within
+// one.  The error grows with the number of operations, by a few ulps
+// for typical formulas.
+BOOST_AUTO_TEST_CASE(accuracy) {
+    struct {
+        char const *expr;
+        float lo, hi;
+        double bound; ///< in ulps of float
+    } const cases[] = {
+        {"x + y", -10, 10, 0.5},
+        {"x * y", -10, 10, 0.5},
+        {"x / y", 1, 10, 0.5},
+        {"sqrt(x)", 0, 100, 0.5},
+        {"sin(x)", -3, 3, 1},
+        {"cos(x)", -3, 3, 1},
+        {"exp(x)", -10, 10, 1},
+        {"log(x)", 0.1f, 100, 1},
+        {"atan2(y, x)", -5, 5, 1},
+        {"x ** y", 0.5f, 4, 1},
+        {"tanh(x) * 0.5 + 0.5 * erf(y)", -2, 2, 1},
+        {"sqrt(x*x + y*y) / (1 + exp(-x)) - log(1 + y*y)", -3, 3, 4},
+        {"(x + 1) * (y - 2) * (x + 3) / (1 + abs(x * y))", -3, 3, 4},
+    };
+    for (auto const &c : cases) {
+        double const worst = max_ulps(c.expr, c.lo, c.hi);
+        BOOST_TEST_MESSAGE(c.expr << ": " << worst << " ulps");
+        BOOST_CHECK_MESSAGE(worst <= c.bound,
+                            c.expr << ": " << worst << " ulps");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(range) {
+    matheval::Parser parser;
+
+    // Constants are rounded to the nearest float
+    parser.parse("0.1");
+    BOOST_CHECK_EQUAL(matheval::FloatExpression(parser).evaluate(nullptr),
+                      0.1f);
+
+    // The same errors are reported
+    parser.parse("sqrt(x)");
+    BOOST_CHECK_THROW(matheval::FloatExpression(parser).evaluate({-1.0f}),
+                      matheval::sqrtInvalid);
+    parser.parse("x / 0");
+    BOOST_CHECK_THROW(matheval::FloatExpression(parser).evaluate({1.0f}),
+                      matheval::divideByZero);
+
+    // but float overflows much earlier than double
+    parser.parse("10 ** x");
+    BOOST_CHECK_EQUAL(matheval::CompiledExpression(parser).evaluate({50.0}),
+                      1e50);
+    BOOST_CHECK_THROW(matheval::FloatExpression(parser).evaluate({50.0f}),
+                      matheval::powOverflow);
+    parser.parse("exp(x)");
+    BOOST_CHECK(std::isinf(matheval::FloatExpression(parser).evaluate({100.0f})));
+}
+
+BOOST_AUTO_TEST_CASE(batch) {
+    std::size_t const rows = 1000;
+    std::vector<float> x(rows);
+    std::vector<float> y(rows);
+    for (std::size_t r = 0; r < rows; ++r) {
+        x[r] = static_cast<float>(r) * 0.01f - 5;
+        y[r] = static_cast<float>(r % 17) * 0.5f;
+    }
+    float const *const columns[] = {x.data(), y.data()};
+
+    for (char const *expr :
+         {"x * y - 3 * x + sin(y) / (1 + x*x)", "ifelse(x > 0, sqrt(x), -x) + y",
+          "x < y || y == 0"}) {
+        matheval::Parser parser;
+        parser.parse(expr);
+        parser.optimize();
+        matheval::FloatExpression const f(parser);
+        std::vector<float> results(rows);
+        f.evaluate(rows, columns, results.data());
+        for (std::size_t r = 0; r < rows; ++r) {
+            BOOST_CHECK_EQUAL(results[r], f.evaluate({x[r], y[r]}));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(batch_errors) {
+    // Row 5 fails in sqrt, row 3 fails later in the division, and the
+    // division of row 3 is the error of the lowest failing row
+    std::vector<float> x = {1, 2, 3, 0, 4, -1, 5};
+    std::vector<float> y = {1, 1, 1, 0, 1, 1, 1};
+    float const *const columns[] = {x.data(), y.data()};
+    matheval::Parser parser;
+    parser.parse("sqrt(x) + 1 / y");
+    matheval::FloatExpression const f(parser);
+    std::vector<float> results(x.size());
+    BOOST_CHECK_THROW(f.evaluate(x.size(), columns, results.data()),
+                      matheval::divideByZero);
+
+    x[3] = 1;
+    y[3] = 1;
+    BOOST_CHECK_THROW(f.evaluate(x.size(), columns, results.data()),
+                      matheval::sqrtInvalid);
+}
@@ -0,0 +1,187 @@
+#define BOOST_TEST_MODULE gradient
+#include <boost/test/included/unit_test.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+/// @brief The derivative by central differences
+double numeric(matheval::CompiledExpression const &f,
+               std::vector<double> values, std::size_t slot) {
+    double const x = values[slot];
+    double const h = 1e-6 * std::max(1.0, std::fabs(x));
+    values[slot] = x + h;
+    double const up = f.evaluate(values);
+    values[slot] = x - h;
+    double const down = f.evaluate(values);
+    return (up - down) / (2 * h);
+}
+
+/// @brief Check the gradient of @p expr with respect to all of its
+///        variables against central differences
+void check(std::string const &expr, std::vector<double> const &values) {
+    for (bool optimized : {false, true}) {
+        matheval::Parser parser;
+        parser.parse(expr);
+        if (optimized) {
+            parser.optimize();
+        }
+        matheval::CompiledExpression const f(parser);
+        matheval::GradientExpression const g(parser, parser.variables());
+
+        std::vector<double> const v(
+            values.begin(),
+            values.begin() +
+                static_cast<std::ptrdiff_t>(parser.variables().size()));
+        std::vector<double> gradient;
+        BOOST_CHECK_EQUAL(g.evaluate(v, gradient), f.evaluate(v));
+        BOOST_REQUIRE_EQUAL(gradient.size(), v.size());
+        for (std::size_t slot = 0; slot < v.size(); ++slot) {
+            double const expected = numeric(f, v, slot);
+            BOOST_CHECK_MESSAGE(
+                std::fabs(gradient[slot] - expected) <=
+                    1e-6 * std::max(1.0, std::fabs(expected)),
+                expr << " d/d" << parser.variables()[slot] << ": "
+                     << gradient[slot] << " != " << expected);
+        }
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(unary_functions) {
+    char const *const exprs[] = {
+        "abs(x)",   "acos(x)",  "acosh(x + 1.5)", "asin(x)",  "asinh(x)",
+        "atan(x)",  "atanh(x)", "cbrt(x)",        "ceil(x)",  "cos(x)",
+        "cosh(x)",  "deg(x)",   "erf(x)",         "erfc(x)",  "exp(x)",
+        "exp2(x)",  "floor(x)", "log(x)",         "log2(x)",  "log10(x)",
+        "rad(x)",   "round(x)", "sgn(x)",         "sin(x)",   "sinh(x)",
+        "sqrt(x)",  "tan(x)",   "tanh(x)",        "tgamma(x)", "-x",
+        "+x",       "!x",       "isnan(x)",       "isinf(x)",
+    };
+    for (char const *expr : exprs) {
+        check(expr, {0.3});
+        check(expr, {0.7});
+    }
+    check("abs(x)", {-0.7});
+    check("tgamma(x)", {2.5});
+    check("cbrt(x)", {-2});
+}
+
+BOOST_AUTO_TEST_CASE(powers) {
+    // The optimizer turns these into products and roots
+    for (char const *expr : {"x**2", "x**3", "x**4", "x**-1", "x**0.5",
+                             "x**1.7", "x**1", "pow(x, 2.5)"}) {
+        check(expr, {0.3});
+        check(expr, {2.1});
+    }
+    // A negative base with an integer exponent
+    check("x**2 + x**3", {-3});
+    check("x**y", {2.5, 1.5});
+    check("x**y", {0.5, -2});
+}
+
+BOOST_AUTO_TEST_CASE(binary_functions) {
+    for (char const *expr : {"x + y", "x - y", "x * y", "x / y", "x % y",
+                             "atan2(x, y)", "atan2(y, x)", "max(x, y)",
+                             "min(x, y)", "pow(x, y)"}) {
+        check(expr, {1.3, 0.4});
+        check(expr, {0.4, 1.3});
+    }
+    for (char const *expr : {"x < y", "x <= y", "x > y", "x >= y",
+                             "x == y", "x != y", "x && y", "x || y"}) {
+        check(expr, {1.3, 0.4});
+    }
+}
+
+BOOST_AUTO_TEST_CASE(conditionals) {
+    char const *const expr = "ifelse(x > 1, x*x*y, 3*x + y) + x";
+    check(expr, {2, 5});
+    check(expr, {0.5, 5});
+
+    // The branch which is not taken is neither computed nor differentiated
+    matheval::Parser parser;
+    parser.parse("ifelse(x > 0, sqrt(x), -x)");
+    matheval::GradientExpression const g(parser, {"x"});
+    std::vector<double> gradient;
+    BOOST_CHECK_EQUAL(g.evaluate({-2.0}, gradient), 2);
+    BOOST_CHECK_EQUAL(gradient[0], -1);
+}
+
+BOOST_AUTO_TEST_CASE(formulas) {
+    check("sqrt(x*x + y*y) / (1 + exp(-x)) - log(1 + y*y)", {0.3, 0.7});
+    check("(x + 1) * (y - 2) * (z + 3) / (1 + abs(x * y * z))",
+          {0.3, 0.7, -1.1});
+    // Shared subexpressions after optimize()
+    check("sqrt(x**2 + y**2) / (1 + sqrt(x**2 + y**2))", {0.3, 0.7});
+    check("tanh(x) * 0.5 + 0.5 * erf(y / sqrt(2)) - cbrt(z)", {0.3, 0.7, 2});
+}
+
+BOOST_AUTO_TEST_CASE(chosen_variables) {
+    matheval::Parser parser;
+    parser.parse("x * y + sin(z)");
+    // Any subset in any order, and names which do not occur
+    matheval::GradientExpression const g(parser, {"z", "w", "x"});
+    BOOST_CHECK(g.with_respect_to() ==
+                (std::vector<std::string>{"z", "w", "x"}));
+    std::vector<double> gradient;
+    double const value = g.evaluate({2.0, 3.0, 0.0}, gradient);
+    BOOST_CHECK_EQUAL(value, 6);
+    BOOST_CHECK(gradient == (std::vector<double>{1, 0, 3}));
+
+    double raw[3];
+    std::vector<double> const values = {2.0, 3.0, 0.0};
+    BOOST_CHECK_EQUAL(g.evaluate(values.data(), raw), 6);
+    BOOST_CHECK_EQUAL(raw[2], 3);
+}
+
+BOOST_AUTO_TEST_CASE(overflow) {
+    // tgamma overflows to inf, and its derivative must not fail
+    // instead, whether it is used or not
+    matheval::Parser parser;
+    parser.parse("tgamma(1e308 * 10) + x");
+    matheval::GradientExpression const c(parser, {"x"});
+    std::vector<double> gradient;
+    BOOST_CHECK(std::isinf(c.evaluate({1.0}, gradient)));
+    BOOST_CHECK_EQUAL(gradient[0], 1);
+
+    parser.parse("tgamma(y) + x");
+    matheval::GradientExpression const u(parser, {"x"});
+    std::vector<double> const infinite = {INFINITY, 1.0};
+    BOOST_CHECK_EQUAL(u.evaluate(infinite, gradient), parser.evaluate(infinite));
+    BOOST_CHECK_EQUAL(gradient[0], 1);
+
+    parser.parse("tgamma(1e308 * x)");
+    matheval::GradientExpression const g(parser, {"x"});
+    BOOST_CHECK(std::isinf(g.evaluate({10.0}, gradient)));
+    BOOST_CHECK(std::isinf(gradient[0]));
+}
+
+BOOST_AUTO_TEST_CASE(errors) {
+    matheval::Parser parser;
+    parser.parse("sqrt(x) + log(y)");
+    matheval::GradientExpression const g(parser, {"x", "y"});
+    std::vector<double> gradient;
+    BOOST_CHECK_THROW(g.evaluate({-1.0, 1.0}, gradient), matheval::sqrtInvalid);
+    BOOST_CHECK_THROW(g.evaluate({1.0, 0.0}, gradient),
+                      matheval::logDivideByZero);
+    BOOST_CHECK_THROW(g.evaluate({1.0}, gradient), matheval::invalid_argument);
+
+    // The derivative of a power with a negative base with respect to
+    // the exponent does not exist
+    parser.parse("x**y");
+    matheval::GradientExpression const p(parser, {"x", "y"});
+    BOOST_CHECK_EQUAL(p.evaluate({-2.0, 3.0}, gradient), -8);
+    BOOST_CHECK_EQUAL(gradient[0], 12);
+    BOOST_CHECK(std::isnan(gradient[1]));
+
+    matheval::Parser const empty;
+    BOOST_CHECK_THROW(matheval::GradientExpression(empty, {"x"}),
+                      matheval::invalid_argument);
+}
@@ -0,0 +1,157 @@
+#define BOOST_TEST_MODULE grammar
+#include <boost/test/included/unit_test.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+// Every backend is built with this test, so the parsers have to
+// agree on all the corners of the grammar
+
+namespace {
+
+bool same_bits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+double value(std::string const &expr) {
+    std::map<std::string, double> const st = {{"x", 2}, {"y", 3}};
+    matheval::Parser parser;
+    parser.parse(expr);
+    return parser.evaluate(st);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(associativity) {
+    BOOST_CHECK_EQUAL(value("2**3**2"), 512);
+    BOOST_CHECK_EQUAL(value("2-3-4"), -5);
+    BOOST_CHECK_EQUAL(value("16/4/2"), 2);
+    BOOST_CHECK_EQUAL(value("7%4%2"), 1);
+    // Both logical operators are on the same level
+    BOOST_CHECK_EQUAL(value("1 || 0 && 0"), 0);
+    BOOST_CHECK_EQUAL(value("0 && 0 || 1"), 1);
+}
+
+BOOST_AUTO_TEST_CASE(precedence) {
+    BOOST_CHECK_EQUAL(value("1 + 2 * 3 ** 2"), 19);
+    BOOST_CHECK_EQUAL(value("2 ** 3 * 4"), 32);
+    BOOST_CHECK_EQUAL(value("1 + 2 < 4 - 0.5"), 1);
+    BOOST_CHECK_EQUAL(value("1 < 2 == 1"), 1);
+    BOOST_CHECK_EQUAL(value("0 == 1 < 2"), 0);
+    BOOST_CHECK_EQUAL(value("1 == 1 && 2 != 2"), 0);
+}
+
+BOOST_AUTO_TEST_CASE(signs) {
+    // A sign in front of digits belongs to the number
+    BOOST_CHECK_EQUAL(value("-2**2"), 4);
+    // A unary operator applies to the primary after it
+    BOOST_CHECK_EQUAL(value("-x**2"), 4);
+    BOOST_CHECK_EQUAL(value("-(x)**2"), 4);
+    BOOST_CHECK_EQUAL(value("2 * -3"), -6);
+    BOOST_CHECK_EQUAL(value("2--3"), 5);
+    BOOST_CHECK_EQUAL(value("x - -x"), 4);
+    BOOST_CHECK_EQUAL(value("- - x"), 2);
+    BOOST_CHECK_EQUAL(value("!0 + 1"), 2);
+    BOOST_CHECK_EQUAL(value("!x == 0"), 1);
+}
+
+BOOST_AUTO_TEST_CASE(numbers) {
+    BOOST_CHECK_EQUAL(value(".5 + 5."), 5.5);
+    BOOST_CHECK_EQUAL(value("1e3"), 1000);
+    BOOST_CHECK(same_bits(value("1E-2"), 1e-2));
+    BOOST_CHECK(same_bits(value("0.1"), 0.1));
+    BOOST_CHECK(same_bits(value("-0"), -0.0));
+    BOOST_CHECK_EQUAL(value("inf"), std::numeric_limits<double>::infinity());
+    BOOST_CHECK_EQUAL(value("-Infinity"),
+                      -std::numeric_limits<double>::infinity());
+    BOOST_CHECK(std::isnan(value("nan")));
+}
+
+BOOST_AUTO_TEST_CASE(names) {
+    BOOST_CHECK_EQUAL(value("atan2(1, 1)"), value("atan(1)"));
+    BOOST_CHECK_EQUAL(value("exp2(3)"), 8);
+    BOOST_CHECK_EQUAL(value("log10(100)"), 2);
+    BOOST_CHECK_EQUAL(value("epsilon"), std::numeric_limits<double>::epsilon());
+    BOOST_CHECK_EQUAL(value("ifelse(x > y, x, y)"), 3);
+
+    matheval::Parser parser;
+    parser.parse("x_1 + Y2 * x_1");
+    BOOST_CHECK(parser.variables() ==
+                (std::vector<std::string>{"x_1", "Y2"}));
+}
+
+BOOST_AUTO_TEST_CASE(spaces) {
+    BOOST_CHECK_EQUAL(value(" ( 1 +\t2 ) *\n3 "), 9);
+    BOOST_CHECK_EQUAL(value("max ( 1 , 2 )"), 2);
+    BOOST_CHECK_EQUAL(value("x<=y"), 1);
+}
+
+BOOST_AUTO_TEST_CASE(rejected) {
+    // Names are matched as prefixes, so a function or constant name
+    // cannot start a variable
+    for (std::string const expr :
+         {"", " ", "1 +", "(1", "1)", "2 3", "sinx", "pix", "e1", "info",
+          "x +* y", "max(1)", "ifelse(1,2)", "1 = 2", "1 & 2", "abs 1",
+          "_x", "1 <> 2", "x * * y", "#"}) {
+        matheval::Parser parser;
+        BOOST_CHECK_THROW(parser.parse(expr), matheval::parse_error);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(diagnostics) {
+    struct {
+        char const *expr;
+        std::size_t offset;
+        std::string expected;
+        std::string rule;
+    } const cases[] = {
+        {"", 0, "expression", "expression"},
+        {"  #", 2, "expression", "expression"},
+        {"2 3", 2, "end of input", "expression"},
+        {"f(x)", 1, "end of input", "expression"},
+        {"1 +", 3, "multiplicative", "additive"},
+        {"x && ", 5, "equality", "logical"},
+        {"x == #", 5, "relational", "equality"},
+        {"x <", 3, "additive", "relational"},
+        {"x * * y", 4, "factor", "multiplicative"},
+        {"2 ** ", 5, "factor", "factor"},
+        {"-", 1, "primary", "primary"},
+        {"(1", 2, "')'", "primary"},
+        {"()", 1, "expression", "primary"},
+        {"(1 + (2 * ))", 10, "factor", "multiplicative"},
+        {"sinx", 3, "'('", "unary"},
+        {"sin(", 4, "expression", "unary"},
+        {"max(1)", 5, "','", "binary"},
+        {"atan2(1, 2", 10, "')'", "binary"},
+        {"ifelse(1,2)", 10, "','", "ternary"},
+    };
+    for (auto const &c : cases) {
+        BOOST_TEST_CONTEXT(c.expr) {
+            matheval::Parser parser;
+            try {
+                parser.parse(c.expr);
+                BOOST_ERROR("no parse_error");
+            } catch (matheval::parse_error const &e) {
+                matheval::parse_diagnostic const &d = e.diagnostic();
+                BOOST_CHECK_EQUAL(d.offset, c.offset);
+                BOOST_CHECK_EQUAL(d.expected, c.expected);
+                BOOST_CHECK_EQUAL(d.rule, c.rule);
+            }
+        }
+    }
+
+    matheval::Parser parser;
+    try {
+        parser.parse("(1");
+    } catch (matheval::parse_error const &e) {
+        BOOST_CHECK_EQUAL(e.what(),
+                          std::string("Expected ')' in primary at offset 2"));
+    }
+}
@@ -0,0 +1,171 @@
+#define BOOST_TEST_MODULE incremental
+#include <boost/test/included/unit_test.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include "exprtest.hpp"
+#include "matheval.hpp"
+
+namespace {
+
+bool same_bits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+std::vector<double> const samples = {
+    0.0, -0.0, 1.0, -2.5, 0.5, 3.0, -1.0,
+    std::numeric_limits<double>::quiet_NaN()};
+
+/// @brief Change random variables of the expression many times and
+///        compare every result with a full evaluation
+void same_as_parser(std::string const &expr, bool optimize) {
+    matheval::Parser parser;
+    parser.parse(expr);
+    if (optimize) {
+        parser.optimize();
+    }
+    matheval::IncrementalExpression incremental(parser);
+    BOOST_REQUIRE(incremental.variables() == parser.variables());
+
+    std::mt19937 engine(42);
+    std::vector<double> values(parser.variables().size(), 1.0);
+    for (int round = 0; round < 200; ++round) {
+        values[engine() % values.size()] = samples[engine() % samples.size()];
+        std::type_info const *expected_error;
+        std::type_info const *error;
+        double const expected = evaluate_catching(
+            [&] { return parser.evaluate(values); }, expected_error);
+        double const result = evaluate_catching(
+            [&] { return incremental.evaluate(values); }, error);
+        if (expected_error) {
+            BOOST_CHECK_MESSAGE(error && *error == *expected_error,
+                                expr << " should throw "
+                                     << expected_error->name());
+            continue;
+        }
+        BOOST_CHECK_MESSAGE(!error && same_bits(result, expected),
+                            expr << " in round " << round << ": " << result
+                                 << " != " << expected);
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(recomputed_nodes) {
+    matheval::Parser parser;
+    parser.parse("sin(x) * 2 + cos(y) * 3");
+    matheval::IncrementalExpression incremental(parser);
+
+    std::map<std::string, double> st = {{"x", 1}, {"y", 2}};
+    BOOST_CHECK_EQUAL(incremental.evaluate(st), parser.evaluate(st));
+    BOOST_CHECK_EQUAL(incremental.recomputed(), 9);
+
+    BOOST_CHECK_EQUAL(incremental.evaluate(st), parser.evaluate(st));
+    BOOST_CHECK_EQUAL(incremental.recomputed(), 0);
+
+    // x, sin, * and +
+    st["x"] = 3;
+    BOOST_CHECK_EQUAL(incremental.evaluate(st), parser.evaluate(st));
+    BOOST_CHECK_EQUAL(incremental.recomputed(), 4);
+
+    st["y"] = 4;
+    BOOST_CHECK_EQUAL(incremental.evaluate(st), parser.evaluate(st));
+    BOOST_CHECK_EQUAL(incremental.recomputed(), 4);
+
+    st["x"] = 5;
+    st["y"] = 6;
+    BOOST_CHECK_EQUAL(incremental.evaluate(st), parser.evaluate(st));
+    BOOST_CHECK_EQUAL(incremental.recomputed(), 7);
+}
+
+BOOST_AUTO_TEST_CASE(shared_subexpressions) {
+    matheval::Parser parser;
+    parser.parse("sqrt(x**2 + y**2) / (1 + sqrt(x**2 + y**2)) + z");
+    parser.optimize();
+    matheval::IncrementalExpression incremental(parser);
+
+    std::vector<double> values = {3, 4, 1};
+    BOOST_CHECK_CLOSE(incremental.evaluate(values), 5. / 6 + 1, 1e-12);
+
+    // Only z and the sum at the root
+    values[2] = 2;
+    BOOST_CHECK_CLOSE(incremental.evaluate(values), 5. / 6 + 2, 1e-12);
+    BOOST_CHECK_EQUAL(incremental.recomputed(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(signed_zero) {
+    matheval::Parser parser;
+    parser.parse("atan2(x, -1)");
+    matheval::IncrementalExpression incremental(parser);
+
+    std::vector<double> values = {0.0};
+    double const positive = incremental.evaluate(values);
+    values[0] = -0.0;
+    BOOST_CHECK_EQUAL(incremental.evaluate(values), -positive);
+    BOOST_CHECK_EQUAL(incremental.recomputed(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(skipped_branches) {
+    matheval::Parser parser;
+    parser.parse("ifelse(x > 0, log(x) + y, 1 / y)");
+    matheval::IncrementalExpression incremental(parser);
+
+    // The false branch fails, but is not taken
+    std::vector<double> values = {1, 0};
+    BOOST_CHECK_EQUAL(incremental.evaluate(values), 0);
+
+    values[0] = -1;
+    BOOST_CHECK_THROW(incremental.evaluate(values), matheval::divideByZero);
+    BOOST_CHECK_THROW(incremental.evaluate(values), matheval::divideByZero);
+
+    values[1] = 2;
+    BOOST_CHECK_EQUAL(incremental.evaluate(values), 0.5);
+
+    // The true branch was computed for y = 0 and is computed again
+    values[0] = 1;
+    BOOST_CHECK_EQUAL(incremental.evaluate(values), 2);
+}
+
+BOOST_AUTO_TEST_CASE(same_results) {
+    for (std::string const &expr :
+         {"x*x + 2*x + 1", "sin(x) * cos(y) + sqrt(x**2 + y**2) * z",
+          "log(x) + 1 / y - acos(z)",
+          "ifelse(x > y, log(y), sqrt(z)) + (x != 0 && 1 / x > 1)",
+          "(y == 0 || 1 / y > 0) * ifelse(z, x, y) + x * x * x"}) {
+        same_as_parser(expr, false);
+        same_as_parser(expr, true);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(interface) {
+    matheval::Parser parser;
+    BOOST_CHECK_THROW(matheval::IncrementalExpression{parser},
+                      matheval::invalid_argument);
+
+    parser.parse("x + y");
+    matheval::IncrementalExpression incremental(parser);
+    BOOST_CHECK_THROW(incremental.evaluate(std::vector<double>{1}),
+                      matheval::invalid_argument);
+    BOOST_CHECK_THROW(
+        incremental.evaluate(std::map<std::string, double>{{"x", 1}}),
+        matheval::invalid_argument);
+
+    // Later changes to the parser do not matter
+    parser.parse("x - y");
+    matheval::IncrementalExpression moved(std::move(incremental));
+    BOOST_CHECK_EQUAL(moved.evaluate(std::vector<double>{1, 2}), 3);
+
+    parser.parse("2");
+    moved = matheval::IncrementalExpression(parser);
+    BOOST_CHECK(moved.variables().empty());
+    BOOST_CHECK_EQUAL(moved.evaluate(nullptr), 2);
+    BOOST_CHECK_EQUAL(moved.evaluate(nullptr), 2);
+    BOOST_CHECK_EQUAL(moved.recomputed(), 0);
+}
@@ -0,0 +1,180 @@
+#define BOOST_TEST_MODULE jit
+#include <boost/test/included/unit_test.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+bool same_bits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+double const not_a_number = std::numeric_limits<double>::quiet_NaN();
+double const infinity = std::numeric_limits<double>::infinity();
+
+/// Values which exercise signed zeros, infinities and NaN
+std::vector<double> const samples = {
+    0.0, -0.0, 1.0, -2.5, 0.5, 3.0, 1e300, -1e-300, infinity, -infinity,
+    not_a_number};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(available) {
+    matheval::Parser parser;
+    parser.parse("x + 1");
+#if defined(__x86_64__) && !defined(_WIN32)
+    BOOST_CHECK(parser.compile_native());
+#else
+    BOOST_CHECK(!parser.compile_native());
+#endif
+    double const x = 2;
+    BOOST_CHECK_EQUAL(parser.evaluate(&x), 3);
+}
+
+// Every result must be bit for bit that of walking the tree
+BOOST_AUTO_TEST_CASE(same_as_tree) {
+    std::vector<std::string> const exprs = {
+        "x + y",
+        "x - y",
+        "x * y",
+        "-x",
+        "-(x * y) - -y",
+        "x < y",
+        "x <= y",
+        "x > y",
+        "x >= y",
+        "x == y",
+        "x != y",
+        "!(x < y)",
+        "x && y || !x",
+        "ifelse(x < y, x, y)",
+        "ifelse(x > 0, ifelse(y > 0, 1, 2), 3 * x)",
+        "abs(x) + sqrt(abs(y)) + atan2(x, y)",
+        "max(x, y) - min(x, y)",
+        "isnan(x) + isinf(y)",
+        "x * (y + x * (y - x * (y + x * (y - x))))",
+        "((((x + 1) * (y + 2)) - ((x + 3) * (y + 4))) * (x + y))",
+        "floor(x) + ceil(y) + round(x * y)",
+        "2 * pi * x + e",
+    };
+    for (std::string const &expr : exprs) {
+        matheval::Parser tree;
+        tree.parse(expr);
+        matheval::Parser jit;
+        jit.parse(expr);
+        jit.compile_native();
+        std::vector<std::string> const vars = jit.variables();
+        for (double x : samples) {
+            for (double y : samples) {
+                std::map<std::string, double> st = {{"x", x}, {"y", y}};
+                std::vector<double> values;
+                for (std::string const &v : vars) {
+                    values.push_back(st[v]);
+                }
+                double expected = not_a_number;
+                bool threw = false;
+                try {
+                    expected = tree.evaluate(st);
+                } catch (matheval::exception const &) {
+                    threw = true;
+                }
+                if (threw) {
+                    BOOST_CHECK_THROW(jit.evaluate(values),
+                                      matheval::exception);
+                    continue;
+                }
+                double const result = jit.evaluate(values);
+                BOOST_CHECK_MESSAGE(same_bits(result, expected),
+                                    expr << " for x = " << x << ", y = "
+                                         << y << ": " << result
+                                         << " != " << expected);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(errors) {
+    matheval::Parser parser;
+    parser.parse("log(x) + 1 / y");
+    parser.compile_native();
+
+    double values[] = {-1, 0};
+    BOOST_CHECK_THROW(parser.evaluate(values), matheval::logInvalid);
+    matheval::errc error = matheval::errc::none;
+    BOOST_CHECK(std::isnan(parser.evaluate(values, error)));
+    BOOST_CHECK(error == matheval::errc::logInvalid);
+
+    values[0] = 1;
+    BOOST_CHECK_THROW(parser.evaluate(values), matheval::divideByZero);
+    BOOST_CHECK(std::isnan(parser.evaluate(values, error)));
+    BOOST_CHECK(error == matheval::errc::divideByZero);
+
+    values[1] = 4;
+    BOOST_CHECK_EQUAL(parser.evaluate(values, error), 0.25);
+    BOOST_CHECK(error == matheval::errc::none);
+}
+
+BOOST_AUTO_TEST_CASE(deep_stack) {
+    // Right-nested sums need a stack entry per term, so the frame of
+    // the generated code spans more than a page
+    std::string expr = "x";
+    for (int i = 0; i < 600; ++i) {
+        expr = "x + (" + expr + ")";
+    }
+    matheval::Parser parser;
+    parser.parse(expr);
+    parser.compile_native();
+    double const x = 0.5;
+    BOOST_CHECK_EQUAL(parser.evaluate(&x), 300.5);
+}
+
+BOOST_AUTO_TEST_CASE(frame_spans_pages) {
+    // The frame of more than a page is probed page by page, so that it
+    // reaches the guard page of a new thread instead of skipping it
+    std::string expr = "x";
+    for (int i = 0; i < 700; ++i) {
+        expr = "x + (" + expr + ")";
+    }
+    matheval::Parser parser;
+    parser.parse(expr);
+#if defined(__x86_64__) && !defined(_WIN32)
+    BOOST_CHECK(parser.compile_native());
+#endif
+    double const x = 0.5;
+    double result = 0;
+    std::thread([&] { result = parser.evaluate(&x); }).join();
+    BOOST_CHECK_EQUAL(result, 350.5);
+}
+
+BOOST_AUTO_TEST_CASE(optimize_regenerates) {
+    matheval::Parser parser;
+    parser.parse("x * (2 + 3)");
+    parser.compile_native();
+    parser.optimize();
+    double const x = 2;
+    BOOST_CHECK_EQUAL(parser.evaluate(&x), 10);
+
+    parser.parse("x - 1");
+    BOOST_CHECK_EQUAL(parser.evaluate(&x), 1);
+}
+
+BOOST_AUTO_TEST_CASE(compiled_expression) {
+    matheval::CompiledExpression expr = [] {
+        matheval::Parser parser;
+        parser.parse("x * x - y");
+        parser.compile_native();
+        return matheval::CompiledExpression(parser);
+    }();
+    matheval::CompiledExpression copy = expr;
+    double const values[] = {3, 1};
+    BOOST_CHECK_EQUAL(expr.evaluate(values), 8);
+    BOOST_CHECK_EQUAL(copy.evaluate(values), 8);
+}
@@ -0,0 +1,88 @@
+#define BOOST_TEST_MODULE loader
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+BOOST_AUTO_TEST_CASE(lines) {
+    std::string const text = "x + 1\n"
+                             "\n"
+                             "2 * (x\n"
+                             "  \t\r\n"
+                             "sin(x) * 0\r\n"
+                             "max(x)";
+    matheval::LoadedExpressions const loaded =
+        matheval::load_expressions(text.data(), text.size());
+
+    BOOST_REQUIRE_EQUAL(loaded.expressions.size(), 2u);
+    BOOST_CHECK(loaded.entries == (std::vector<std::size_t>{0, 4}));
+    BOOST_CHECK_EQUAL(loaded.expressions[0].evaluate({{"x", 2}}), 3);
+    BOOST_CHECK_EQUAL(loaded.expressions[1].evaluate({{"x", 2}}), 0);
+
+    BOOST_REQUIRE_EQUAL(loaded.errors.size(), 2u);
+    BOOST_CHECK_EQUAL(loaded.errors[0].entry, 2u);
+    BOOST_CHECK_EQUAL(loaded.errors[0].offset, 7u);
+    BOOST_CHECK_EQUAL(loaded.errors[0].diagnostic.offset, 6u);
+    BOOST_CHECK_EQUAL(loaded.errors[0].diagnostic.expected, std::string("')'"));
+    BOOST_CHECK_EQUAL(loaded.errors[1].entry, 5u);
+    BOOST_CHECK_EQUAL(loaded.errors[1].diagnostic.rule, std::string("binary"));
+}
+
+BOOST_AUTO_TEST_CASE(records) {
+    std::string const text = "1;2 + 3;;4 *";
+    matheval::LoadedExpressions const loaded =
+        matheval::load_expressions(text.data(), text.size(), ';');
+    BOOST_REQUIRE_EQUAL(loaded.expressions.size(), 2u);
+    BOOST_CHECK_EQUAL(loaded.expressions[1].evaluate(), 5);
+    BOOST_REQUIRE_EQUAL(loaded.errors.size(), 1u);
+    BOOST_CHECK_EQUAL(loaded.errors[0].entry, 3u);
+
+    BOOST_CHECK(matheval::load_expressions(text.data(), 0).expressions.empty());
+}
+
+BOOST_AUTO_TEST_CASE(order_is_kept) {
+    // Enough entries for many tasks on several threads
+    std::string text;
+    for (int i = 0; i < 5000; ++i) {
+        text += i % 97 == 0 ? "x +\n" : "x * " + std::to_string(i) + "\n";
+    }
+    matheval::ThreadPool pool(4);
+    matheval::LoadedExpressions const loaded =
+        matheval::load_expressions(text.data(), text.size(), '\n', pool);
+
+    BOOST_REQUIRE_EQUAL(loaded.expressions.size() + loaded.errors.size(),
+                        5000u);
+    for (std::size_t k = 0; k < loaded.expressions.size(); ++k) {
+        std::size_t const entry = loaded.entries[k];
+        BOOST_REQUIRE_NE(entry % 97, 0u);
+        double const x = 1;
+        BOOST_REQUIRE_EQUAL(loaded.expressions[k].evaluate(&x), entry);
+    }
+    for (std::size_t k = 0; k < loaded.errors.size(); ++k) {
+        BOOST_REQUIRE_EQUAL(loaded.errors[k].entry, 97 * k);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(file) {
+    std::string const path = "matheval.loader.test.txt";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "x + y\n\nx - y\n";
+    }
+    matheval::LoadedExpressions const loaded =
+        matheval::load_expression_file(path);
+    std::remove(path.c_str());
+
+    BOOST_REQUIRE_EQUAL(loaded.expressions.size(), 2u);
+    BOOST_CHECK(loaded.entries == (std::vector<std::size_t>{0, 2}));
+    double const values[] = {3, 1};
+    BOOST_CHECK_EQUAL(loaded.expressions[1].evaluate(values), 2);
+    BOOST_CHECK(loaded.errors.empty());
+
+    BOOST_CHECK_THROW(matheval::load_expression_file("does/not/exist"),
+                      matheval::exception);
+}
@@ -0,0 +1,109 @@
+#define BOOST_TEST_MODULE nothrow
+#include "exprtest.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+/// Evaluate without variables and without throwing
+double nothrow(std::string const &expr, matheval::errc &error,
+               bool optimize = false) {
+    matheval::Parser parser;
+    parser.parse(expr);
+    if (optimize) {
+        parser.optimize();
+    }
+    return parser.evaluate(static_cast<double const *>(nullptr), error);
+}
+
+} // namespace
+
+#define ERRCTEST(casename, expr, code, thrown)                         \
+BOOST_AUTO_TEST_CASE( casename )                                       \
+{                                                                      \
+    for (bool optimize : {false, true}) {                              \
+        matheval::errc error = matheval::errc::none;                   \
+        double result = 0;                                             \
+        BOOST_REQUIRE_NO_THROW(result = nothrow(expr, error, optimize)); \
+        BOOST_CHECK(std::isnan(result));                               \
+        BOOST_CHECK(error == matheval::errc::code);                    \
+    }                                                                  \
+    BOOST_REQUIRE_THROW(matheval::parse(expr), matheval::exception);   \
+    BOOST_REQUIRE_THROW(matheval::parse(expr), thrown);                \
+}
+
+ERRCTEST(divideByZero, "1/0", divideByZero, matheval::divideByZero)
+ERRCTEST(moduloByZero, "10 % 0", moduloByZero, matheval::moduloByZero)
+ERRCTEST(moduloWithInfinity, "inf % 3", moduloWithInfinity, matheval::moduloWithInfinity)
+ERRCTEST(powInvalid, "pow(-2, 2.2)", powInvalid, matheval::powInvalid)
+ERRCTEST(powDivideByZero, "pow(0, -3)", powDivideByZero, matheval::powDivideByZero)
+ERRCTEST(powOverflow, "pow(10, 400)", powOverflow, matheval::powOverflow)
+ERRCTEST(powUnderflow, "pow(10, -400)", powUnderflow, matheval::powUnderflow)
+ERRCTEST(acosInvalid, "acos(1.1)", acosInvalid, matheval::acosInvalid)
+ERRCTEST(acoshInvalid, "acosh(-0.9)", acoshInvalid, matheval::acoshInvalid)
+ERRCTEST(asinInvalid, "asin(-1.1)", asinInvalid, matheval::asinInvalid)
+ERRCTEST(atanhInvalid, "atanh(1.1)", atanhInvalid, matheval::atanhInvalid)
+ERRCTEST(atanhDivideByZero, "atanh(1)", atanhDivideByZero, matheval::atanhDivideByZero)
+ERRCTEST(cosInvalid, "cos(inf)", cosInvalid, matheval::cosInvalid)
+ERRCTEST(logInvalid, "log10(-3.14)", logInvalid, matheval::logInvalid)
+ERRCTEST(logDivideByZero, "log(0)", logDivideByZero, matheval::logDivideByZero)
+ERRCTEST(sinInvalid, "sin(-inf)", sinInvalid, matheval::sinInvalid)
+ERRCTEST(sqrtInvalid, "sqrt(-3.14)", sqrtInvalid, matheval::sqrtInvalid)
+ERRCTEST(tanInvalid, "tan(inf)", tanInvalid, matheval::tanInvalid)
+ERRCTEST(tgammaDivideByZero, "tgamma(0)", tgammaDivideByZero, matheval::tgammaDivideByZero)
+ERRCTEST(tgammaInvalid, "tgamma(-2)", tgammaInvalid, matheval::tgammaInvalid)
+
+// The first error in evaluation order is reported, like the exception
+ERRCTEST(first_error, "log(-1) + 1/0", logInvalid, matheval::logInvalid)
+
+// A failed function taints the result even if it is discarded later
+ERRCTEST(discarded, "ifelse(isnan(sqrt(-1)), 1, 2)", sqrtInvalid, matheval::sqrtInvalid)
+
+BOOST_AUTO_TEST_CASE(success) {
+    matheval::Parser parser;
+    parser.parse("x * log(y) + pow(x, 2) % 3");
+    double const values[] = {1.5, 2.5};
+    matheval::errc error = matheval::errc::divideByZero;
+    double result = parser.evaluate(values, error);
+    double expected = parser.evaluate(values);
+    BOOST_CHECK(error == matheval::errc::none);
+    BOOST_CHECK_EQUAL(std::memcmp(&result, &expected, sizeof(double)), 0);
+}
+
+BOOST_AUTO_TEST_CASE(batch) {
+    matheval::Parser parser;
+    parser.parse("log(x) + 1 / y");
+    std::size_t const rows = 300;
+    std::vector<double> x(rows);
+    std::vector<double> y(rows);
+    for (std::size_t r = 0; r < rows; ++r) {
+        x[r] = r % 7 == 0 ? -1.0 : 0.5 + r;
+        y[r] = r % 11 == 0 ? 0.0 : 0.25 * r;
+    }
+    double const *columns[] = {x.data(), y.data()};
+    std::vector<double> results(rows);
+    std::vector<matheval::errc> errors(rows, matheval::errc::tanInvalid);
+    BOOST_REQUIRE_NO_THROW(
+        parser.evaluate(rows, columns, results.data(), errors.data()));
+
+    for (std::size_t r = 0; r < rows; ++r) {
+        double const values[] = {x[r], y[r]};
+        matheval::errc error;
+        double expected = parser.evaluate(values, error);
+        BOOST_CHECK(errors[r] == error);
+        if (error == matheval::errc::none) {
+            BOOST_CHECK_EQUAL(
+                std::memcmp(&results[r], &expected, sizeof(double)), 0);
+        } else {
+            BOOST_CHECK(std::isnan(results[r]));
+        }
+    }
+    BOOST_CHECK(errors[0] == matheval::errc::logInvalid);
+    BOOST_CHECK(errors[11] == matheval::errc::divideByZero);
+    BOOST_CHECK(errors[1] == matheval::errc::none);
+}
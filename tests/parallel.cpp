@@ -0,0 +1,202 @@
+#define BOOST_TEST_MODULE parallel
+#include <boost/test/included/unit_test.hpp>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+/// Runs all tasks on the calling thread, in reverse order
+class ReverseExecutor : public matheval::Executor {
+public:
+    void parallel_for(std::size_t n,
+                      std::function<void(std::size_t)> const &task) override {
+        ++calls;
+        for (std::size_t i = n; i-- > 0;) {
+            task(i);
+        }
+    }
+
+    int calls = 0;
+};
+
+struct data {
+    explicit data(std::size_t rows) : x(rows), y(rows) {
+        for (std::size_t r = 0; r < rows; ++r) {
+            x[r] = 1.5 + std::sin(0.001 * r);
+            y[r] = 2.0 + std::cos(0.003 * r);
+        }
+    }
+
+    std::vector<double const *> columns() const {
+        return {x.data(), y.data()};
+    }
+
+    std::vector<double> x;
+    std::vector<double> y;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(every_index_once) {
+    matheval::ThreadPool pool(4);
+    BOOST_CHECK_EQUAL(pool.size(), 4);
+    for (std::size_t n : {0, 1, 2, 3, 7, 100, 10000}) {
+        std::vector<std::atomic<int>> count(n);
+        pool.parallel_for(n, [&](std::size_t i) { ++count[i]; });
+        for (std::size_t i = 0; i < n; ++i) {
+            BOOST_CHECK_EQUAL(count[i].load(), 1);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(nested) {
+    matheval::ThreadPool pool(3);
+    std::atomic<int> sum{0};
+    pool.parallel_for(10, [&](std::size_t) {
+        pool.parallel_for(10, [&](std::size_t j) { sum += j; });
+    });
+    BOOST_CHECK_EQUAL(sum.load(), 450);
+}
+
+BOOST_AUTO_TEST_CASE(task_throws) {
+    matheval::ThreadPool pool(4);
+    std::atomic<int> count{0};
+    BOOST_CHECK_THROW(pool.parallel_for(100,
+                                        [&](std::size_t i) {
+                                            ++count;
+                                            if (i == 42) {
+                                                throw std::runtime_error("42");
+                                            }
+                                        }),
+                      std::runtime_error);
+    BOOST_CHECK_EQUAL(count.load(), 100);
+    // The pool is still usable
+    pool.parallel_for(10, [&](std::size_t) { ++count; });
+    BOOST_CHECK_EQUAL(count.load(), 110);
+}
+
+BOOST_AUTO_TEST_CASE(task_throws_serial) {
+    // Without workers the tasks run on the caller, one after another
+    matheval::ThreadPool pool(1);
+    std::vector<int> count(10);
+    BOOST_CHECK_THROW(pool.parallel_for(10,
+                                        [&](std::size_t i) {
+                                            ++count[i];
+                                            if (i == 3 || i == 7) {
+                                                throw std::runtime_error(
+                                                    std::to_string(i));
+                                            }
+                                        }),
+                      std::runtime_error);
+    BOOST_CHECK(count == std::vector<int>(10, 1));
+
+    // The first exception is rethrown
+    BOOST_CHECK_EXCEPTION(pool.parallel_for(10,
+                                            [&](std::size_t i) {
+                                                if (i == 3 || i == 7) {
+                                                    throw std::runtime_error(
+                                                        std::to_string(i));
+                                                }
+                                            }),
+                          std::runtime_error,
+                          [](std::runtime_error const &e) {
+                              return std::string(e.what()) == "3";
+                          });
+}
+
+BOOST_AUTO_TEST_CASE(same_as_serial) {
+    matheval::Parser parser;
+    parser.parse("x * y + sqrt(x) / y - ifelse(x > y, x, y)");
+    std::size_t const rows = 300007;
+    data d(rows);
+    auto columns = d.columns();
+
+    std::vector<double> serial(rows);
+    parser.evaluate(rows, columns.data(), serial.data());
+
+    matheval::ThreadPool pool(4);
+    std::vector<double> parallel(rows);
+    parser.evaluate_parallel(rows, columns.data(), parallel.data(), pool);
+    BOOST_CHECK_EQUAL(
+        std::memcmp(serial.data(), parallel.data(), rows * sizeof(double)), 0);
+
+    matheval::CompiledExpression const expr(parser);
+    std::vector<double> shared(rows);
+    expr.evaluate_parallel(rows, columns.data(), shared.data());
+    BOOST_CHECK_EQUAL(
+        std::memcmp(serial.data(), shared.data(), rows * sizeof(double)), 0);
+}
+
+BOOST_AUTO_TEST_CASE(own_executor) {
+    matheval::Parser parser;
+    parser.parse("x - y");
+    std::size_t const rows = 100000;
+    data d(rows);
+    auto columns = d.columns();
+
+    ReverseExecutor executor;
+    std::vector<double> results(rows);
+    parser.evaluate_parallel(rows, columns.data(), results.data(), executor);
+    BOOST_CHECK_EQUAL(executor.calls, 1);
+    for (std::size_t r = 0; r < rows; ++r) {
+        BOOST_REQUIRE_EQUAL(results[r], d.x[r] - d.y[r]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(lowest_failing_row) {
+    matheval::Parser parser;
+    parser.parse("log(x) + 1 / y");
+    std::size_t const rows = 500000;
+    data d(rows);
+    d.x[400000] = -1;
+    d.y[250001] = 0;
+    d.x[90000] = -1;
+    auto columns = d.columns();
+    std::vector<double> results(rows);
+
+    // The last chunks are executed first by this executor
+    ReverseExecutor reverse;
+    BOOST_CHECK_THROW(parser.evaluate_parallel(rows, columns.data(),
+                                               results.data(), reverse),
+                      matheval::logInvalid);
+
+    d.x[90000] = 1;
+    matheval::ThreadPool pool(4);
+    for (int repeat = 0; repeat < 20; ++repeat) {
+        BOOST_CHECK_THROW(parser.evaluate_parallel(rows, columns.data(),
+                                                   results.data(), pool),
+                          matheval::divideByZero);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(error_mask) {
+    matheval::Parser parser;
+    parser.parse("log(x) + 1 / y");
+    std::size_t const rows = 200000;
+    data d(rows);
+    for (std::size_t r = 0; r < rows; r += 997) {
+        d.x[r] = -1;
+    }
+    auto columns = d.columns();
+
+    std::vector<double> serial(rows);
+    std::vector<matheval::errc> serial_errors(rows);
+    parser.evaluate(rows, columns.data(), serial.data(), serial_errors.data());
+
+    matheval::ThreadPool pool(4);
+    std::vector<double> parallel(rows);
+    std::vector<matheval::errc> parallel_errors(rows);
+    parser.evaluate_parallel(rows, columns.data(), parallel.data(),
+                             parallel_errors.data(), pool);
+    BOOST_CHECK(serial_errors == parallel_errors);
+    BOOST_CHECK_EQUAL(
+        std::memcmp(serial.data(), parallel.data(), rows * sizeof(double)), 0);
+}
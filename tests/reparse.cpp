@@ -0,0 +1,82 @@
+#define BOOST_TEST_MODULE reparse
+#include <boost/test/included/unit_test.hpp>
+#include <map>
+#include <string>
+
+#include "matheval.hpp"
+
+namespace {
+
+std::string formula(int i) {
+    std::string expr = "x";
+    for (int t = 0; t < 1 + i % 9; ++t) {
+        expr += t % 2 ? " - " : " + ";
+        expr += "max(x, " + std::to_string(i + t) + ") * sin(x / 2)";
+    }
+    return expr;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(same_as_fresh_parser) {
+    std::map<std::string, double> st = {std::make_pair("x", 1.25)};
+    matheval::Parser reused;
+    for (int i = 0; i < 500; ++i) {
+        matheval::Parser fresh;
+        fresh.parse(formula(i));
+        reused.parse(formula(i));
+        BOOST_REQUIRE_EQUAL(reused.evaluate(st), fresh.evaluate(st));
+        if (i % 3 == 0) {
+            reused.optimize();
+            BOOST_REQUIRE_EQUAL(reused.evaluate(st), fresh.evaluate(st));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(error_keeps_previous_tree) {
+    std::map<std::string, double> st = {std::make_pair("x", 2.)};
+    matheval::Parser parser;
+    parser.parse("x * (x + 1)");
+    for (int i = 0; i < 3; ++i) {
+        BOOST_CHECK_THROW(parser.parse("x * (x + "), matheval::parse_error);
+        BOOST_CHECK_EQUAL(parser.evaluate(st), 6.);
+    }
+    parser.optimize();
+    BOOST_CHECK_EQUAL(parser.evaluate(st), 6.);
+    parser.parse("ifelse(x > 1, 2 ** 3, 0)");
+    parser.optimize();
+    BOOST_CHECK_EQUAL(parser.evaluate(st), 8.);
+}
+
+BOOST_AUTO_TEST_CASE(compiled_outlives_tree) {
+    matheval::Parser parser;
+    parser.parse("x + 1");
+    matheval::CompiledExpression const first(parser);
+    for (int i = 0; i < 10; ++i) {
+        parser.parse(formula(i));
+    }
+    double const x = 3;
+    BOOST_CHECK_EQUAL(first.evaluate(&x), 4.);
+}
+
+BOOST_AUTO_TEST_CASE(long_expression) {
+    // Long chains of operations are neither copied term by term when
+    // optimized nor walked recursively when evaluated
+    std::string expr = "x";
+    for (int t = 1; t < 20000; ++t) {
+        expr += t % 2 ? " + " : " - ";
+        expr += t % 3 ? "2 * 3" : "y";
+    }
+    std::map<std::string, double> st = {std::make_pair("x", 1.),
+                                        std::make_pair("y", 0.5)};
+    matheval::Parser parser;
+    parser.parse(expr);
+    double const expected = parser.evaluate(st);
+    parser.optimize();
+    BOOST_CHECK_EQUAL(parser.evaluate(st), expected);
+    BOOST_REQUIRE_EQUAL(parser.variables().size(), 2);
+    BOOST_CHECK_EQUAL(parser.variables()[0], "x");
+    BOOST_CHECK_EQUAL(parser.variables()[1], "y");
+    parser.compile();
+    BOOST_CHECK_EQUAL(parser.evaluate(st), expected);
+}
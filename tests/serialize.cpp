@@ -0,0 +1,120 @@
+#define BOOST_TEST_MODULE serialize
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+std::vector<std::string> const exprs = {
+    "1 + 2",
+    "x",
+    "-x + !y",
+    "sqrt(x**2 + y**2) / (1 + sqrt(x**2 + y**2))",
+    "x**-1 + x**0.5 + x**3 + x**4 + x / 4",
+    "ifelse(x > y, sin(x) * cos(y), atan2(y, x)) % 3",
+    "max(x, y) - min(y, z) + pow(abs(z), 1.5) + tgamma(3)",
+    "x >= 0 && y <= 1 || x == y || x != z && x < z",
+    "log(x) + log2(x) + log10(x) + exp(y) + exp2(y) + erf(z) + erfc(z)",
+    "floor(x) + ceil(y) + round(z) + sgn(x) + deg(x) + rad(y) + cbrt(z)",
+    "acos(0.5) + asin(x / 10) + atan(y) + cosh(z) + sinh(x) + tanh(y)",
+    "acosh(2 + x) + asinh(y) + atanh(z / 10) + tan(x) + isnan(y) + isinf(z)",
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(round_trip) {
+    std::vector<double> const values = {0.75, 0.5, 0.25};
+    for (std::string const &expr : exprs) {
+        for (bool optimized : {false, true}) {
+            matheval::Parser original;
+            original.parse(expr);
+            if (optimized) {
+                original.optimize();
+            }
+            std::string const bytes = original.serialize();
+
+            matheval::Parser loaded;
+            BOOST_CHECK_EQUAL(loaded.deserialize(bytes.data(), bytes.size()),
+                              bytes.size());
+            BOOST_CHECK(loaded.variables() == original.variables());
+            BOOST_CHECK_EQUAL(loaded.serialize(), bytes);
+
+            std::vector<double> v(values.begin(),
+                                  values.begin() +
+                                      static_cast<std::ptrdiff_t>(
+                                          original.variables().size()));
+            BOOST_CHECK_EQUAL(loaded.evaluate(v), original.evaluate(v));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(many_in_one_buffer) {
+    std::string bytes;
+    matheval::Parser parser;
+    for (std::string const &expr : exprs) {
+        parser.parse(expr);
+        parser.optimize();
+        bytes += parser.serialize();
+    }
+    // Misaligned on purpose
+    bytes.insert(0, 1, '\0');
+
+    std::size_t pos = 1;
+    for (std::string const &expr : exprs) {
+        pos += parser.deserialize(bytes.data() + pos, bytes.size() - pos);
+        matheval::Parser expected;
+        expected.parse(expr);
+        BOOST_CHECK(parser.variables() == expected.variables());
+    }
+    BOOST_CHECK_EQUAL(pos, bytes.size());
+}
+
+BOOST_AUTO_TEST_CASE(empty) {
+    matheval::Parser parser;
+    std::string const bytes = parser.serialize();
+    parser.parse("x");
+    parser.deserialize(bytes.data(), bytes.size());
+    BOOST_CHECK(parser.variables().empty());
+    BOOST_CHECK_THROW(parser.evaluate(), matheval::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(invalid) {
+    matheval::Parser parser;
+    parser.parse("x * sin(y)");
+    std::string const bytes = parser.serialize();
+    parser.parse("z");
+
+    auto rejects = [&](std::string const &b) {
+        BOOST_CHECK_THROW(parser.deserialize(b.data(), b.size()),
+                          matheval::invalid_argument);
+        // The previous expression is kept
+        BOOST_CHECK(parser.variables() == std::vector<std::string>{"z"});
+    };
+
+    rejects("");
+    rejects(std::string("MEVB") + bytes.substr(4));
+    for (std::size_t size = 0; size < bytes.size(); size += 7) {
+        rejects(bytes.substr(0, size));
+    }
+
+    // The version, a node type, a child, a variable slot and a function
+    std::string b = bytes;
+    b[4] = 99;
+    rejects(b);
+    b = bytes;
+    b[24] = 7;
+    rejects(b);
+    b = bytes;
+    b[24 + 3 * 24 + 4] = 3; // first child of the root
+    rejects(b);
+    b = bytes;
+    b[24 + 16] = 5; // slot of x
+    rejects(b);
+    b = bytes;
+    b[24 + 2 * 24 + 16] = 120; // sin
+    rejects(b);
+}
@@ -0,0 +1,179 @@
+#define BOOST_TEST_MODULE simd
+#include <boost/test/included/unit_test.hpp>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <typeinfo>
+#include <vector>
+
+#define MATHEVAL_IMPLEMENTATION
+#include "../src/simd.hpp"
+
+using matheval::math::error;
+using matheval::simd::isa;
+
+namespace {
+
+std::vector<isa> levels() {
+    std::vector<isa> result;
+    for (isa level : {isa::scalar, isa::sse2, isa::avx2, isa::avx512}) {
+        if (matheval::simd::supported(level)) {
+            result.push_back(level);
+        }
+    }
+    return result;
+}
+
+// Arguments which hit the special cases of the checked functions
+std::vector<double> const inputs = {
+    std::numeric_limits<double>::quiet_NaN(),
+    std::numeric_limits<double>::infinity(),
+    -std::numeric_limits<double>::infinity(),
+    0.0, -0.0, 1.0, -1.0, 0.5, -0.5, 2.0, -2.5, 3.0, 1e300, -1e-300, 171.7,
+};
+
+/// The outcome of calling a throwing function from math.hpp
+struct outcome {
+    double value;
+    std::type_info const *exception;
+};
+
+template <typename F>
+outcome call(F f) {
+    try {
+        return {f(), nullptr};
+    } catch (matheval::exception const &e) {
+        return {0.0, &typeid(e)};
+    }
+}
+
+std::type_info const *raised(error e, double arg) {
+    try {
+        matheval::math::raise(e, arg);
+    } catch (matheval::exception const &ex) {
+        return &typeid(ex);
+    }
+    return nullptr;
+}
+
+// The kernel must return the bits of the scalar function or fail
+// with the error that matches the exception of the scalar function.
+void compare(outcome const &expected, double actual, error e, double arg) {
+    if (expected.exception) {
+        BOOST_CHECK(std::isnan(actual));
+        BOOST_REQUIRE(e != error::none);
+        BOOST_CHECK(*raised(e, arg) == *expected.exception);
+    } else {
+        BOOST_CHECK(e == error::none);
+        if (std::isnan(expected.value)) {
+            BOOST_CHECK(std::isnan(actual));
+        } else {
+            BOOST_CHECK_EQUAL(
+                std::memcmp(&expected.value, &actual, sizeof(double)), 0);
+        }
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(detect) {
+    BOOST_CHECK(matheval::simd::supported(isa::scalar));
+    BOOST_CHECK(matheval::simd::supported(matheval::simd::detect()));
+}
+
+BOOST_AUTO_TEST_CASE(same_functions) {
+    auto const &unary = matheval::simd::unary_kernels(isa::scalar);
+    auto const &binary = matheval::simd::binary_kernels(isa::scalar);
+    for (isa level : levels()) {
+        auto const &u = matheval::simd::unary_kernels(level);
+        BOOST_REQUIRE_EQUAL(u.size(), unary.size());
+        for (std::size_t i = 0; i < u.size(); ++i) {
+            BOOST_CHECK(u[i].function == unary[i].function);
+            BOOST_CHECK(u[i].kernel != nullptr);
+        }
+        auto const &b = matheval::simd::binary_kernels(level);
+        BOOST_REQUIRE_EQUAL(b.size(), binary.size());
+        for (std::size_t i = 0; i < b.size(); ++i) {
+            BOOST_CHECK(b[i].function == binary[i].function);
+            BOOST_CHECK(b[i].kernel != nullptr);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(unary) {
+    for (isa level : levels()) {
+        for (auto const &entry : matheval::simd::unary_kernels(level)) {
+            std::vector<double> x = inputs;
+            std::vector<error> err(x.size(), error::none);
+            entry.kernel(x.size(), x.data(), err.data());
+            for (std::size_t i = 0; i < x.size(); ++i) {
+                double arg = inputs[i];
+                compare(call([&] { return entry.function(arg); }), x[i],
+                        err[i], arg);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(binary) {
+    for (isa level : levels()) {
+        for (auto const &entry : matheval::simd::binary_kernels(level)) {
+            std::vector<double> x;
+            std::vector<double> y;
+            for (double a : inputs) {
+                for (double b : inputs) {
+                    x.push_back(a);
+                    y.push_back(b);
+                }
+            }
+            std::vector<double> const lhs = x;
+            std::vector<error> err(x.size(), error::none);
+            entry.kernel(x.size(), x.data(), y.data(), err.data());
+            for (std::size_t i = 0; i < x.size(); ++i) {
+                double a = lhs[i];
+                double b = y[i];
+                compare(call([&] { return entry.function(a, b); }), x[i],
+                        err[i], a);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ternary) {
+    for (isa level : levels()) {
+        for (auto const &entry : matheval::simd::ternary_kernels(level)) {
+            std::vector<double> x;
+            std::vector<double> y;
+            std::vector<double> z;
+            for (double a : inputs) {
+                for (double b : {1.0, -0.0}) {
+                    x.push_back(a);
+                    y.push_back(b);
+                    z.push_back(-b);
+                }
+            }
+            std::vector<double> const cond = x;
+            std::vector<error> err(x.size(), error::none);
+            entry.kernel(x.size(), x.data(), y.data(), z.data(), err.data());
+            for (std::size_t i = 0; i < x.size(); ++i) {
+                double a = cond[i];
+                compare(call([&] { return entry.function(a, y[i], z[i]); }),
+                        x[i], err[i], a);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(first_error_wins) {
+    for (isa level : levels()) {
+        for (auto const &entry : matheval::simd::unary_kernels(level)) {
+            std::vector<double> x = inputs;
+            std::vector<error> err(x.size(), error::tanInvalid);
+            entry.kernel(x.size(), x.data(), err.data());
+            for (error e : err) {
+                BOOST_CHECK(e == error::tanInvalid);
+            }
+        }
+    }
+}
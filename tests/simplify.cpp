@@ -0,0 +1,184 @@
+#define BOOST_TEST_MODULE simplify
+#include <boost/test/included/unit_test.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include "exprtest.hpp"
+#include "matheval.hpp"
+
+namespace {
+
+bool same_bits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+double const infinity = std::numeric_limits<double>::infinity();
+
+/// Values which exercise signed zeros, subnormals, infinities, NaN and
+/// the limits of overflow and underflow
+std::vector<double> const samples = {
+    0.0,   -0.0,  1.0,     -2.5,    0.5,     3.0,    1e-310, -1e-310,
+    1e100, 1e200, -1e200,  1e-100,  1e-200,  1e-160, 1e160,  1e300,
+    -1e300, infinity, -infinity, std::numeric_limits<double>::quiet_NaN()};
+
+/// @brief Compare the optimized with the plain expression for every
+///        way of evaluating it
+///
+/// @param[in] exact whether the results have to be identical bit for
+///            bit, otherwise they may differ in the last bit
+void same_as_plain(std::string const &expr, bool exact = true) {
+    for (int mode = 0; mode < 3; ++mode) {
+        matheval::Parser plain;
+        plain.parse(expr);
+        matheval::Parser simplified;
+        simplified.parse(expr);
+        simplified.optimize();
+        if (mode == 1) {
+            plain.compile();
+            simplified.compile();
+        } else if (mode == 2) {
+            plain.compile_native();
+            simplified.compile_native();
+        }
+        for (double x : samples) {
+            std::type_info const *expected_error;
+            std::type_info const *error;
+            double const expected = evaluate_catching(
+                [&] { return plain.evaluate(&x); }, expected_error);
+            double const result = evaluate_catching(
+                [&] { return simplified.evaluate(&x); }, error);
+            if (expected_error) {
+                BOOST_CHECK_MESSAGE(error && *error == *expected_error,
+                                    expr << " for " << x << " should throw "
+                                         << expected_error->name());
+                continue;
+            }
+            BOOST_CHECK_MESSAGE(!error, expr << " for " << x << " threw");
+            bool const same =
+                same_bits(result, expected) ||
+                (!exact && std::fabs(result - expected) <=
+                               std::fabs(expected) * 1e-15);
+            BOOST_CHECK_MESSAGE(same, expr << " for " << x << ": "
+                                           << result << " != " << expected);
+        }
+    }
+}
+
+std::size_t simplified(std::string const &expr) {
+    matheval::Parser parser;
+    parser.parse(expr);
+    return parser.optimize().simplified;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(identities) {
+    same_as_plain("x * 1");
+    same_as_plain("1 * x");
+    same_as_plain("x + -0");
+    same_as_plain("x - 0");
+    same_as_plain("x / 1");
+    same_as_plain("+x");
+    same_as_plain("-(-x)");
+    BOOST_CHECK_EQUAL(simplified("x * 1 + 1 * x - 0"), 3);
+    BOOST_CHECK_EQUAL(simplified("-(-x) + +x"), 2);
+}
+
+// x + 0 turns -0 into 0
+BOOST_AUTO_TEST_CASE(signed_zero) {
+    BOOST_CHECK_EQUAL(simplified("x + 0"), 0);
+    BOOST_CHECK_EQUAL(simplified("x - -0"), 0);
+    same_as_plain("x + 0");
+}
+
+BOOST_AUTO_TEST_CASE(division) {
+    same_as_plain("x / 4");
+    same_as_plain("x / -0.5");
+    same_as_plain("x / 2**-1022");
+    BOOST_CHECK_EQUAL(simplified("x / 4"), 1);
+    // Not exact or the reciprocal would overflow
+    BOOST_CHECK_EQUAL(simplified("x / 3"), 0);
+    BOOST_CHECK_EQUAL(simplified("x / 2**-1074"), 0);
+    BOOST_CHECK_EQUAL(simplified("x / 0"), 0);
+    same_as_plain("x / 0");
+}
+
+BOOST_AUTO_TEST_CASE(powers) {
+    same_as_plain("x ** 2");
+    same_as_plain("pow(x, 2)");
+    same_as_plain("x ** -1");
+    same_as_plain("x ** 1");
+    same_as_plain("x ** 0.5");
+    same_as_plain("x ** 3", false);
+    same_as_plain("x ** 4", false);
+    same_as_plain("x ** 0");
+    BOOST_CHECK_EQUAL(simplified("x**2 + pow(x, 3) + x**0.5"), 3);
+    BOOST_CHECK_EQUAL(simplified("x ** 5"), 0);
+    BOOST_CHECK_EQUAL(simplified("x ** 2.5"), 0);
+}
+
+BOOST_AUTO_TEST_CASE(power_errors) {
+    matheval::Parser parser;
+    parser.parse("x ** 2");
+    parser.optimize();
+    double x = 1e200;
+    BOOST_CHECK_THROW(parser.evaluate(&x), matheval::powOverflow);
+    x = 1e-200;
+    BOOST_CHECK_THROW(parser.evaluate(&x), matheval::powUnderflow);
+
+    parser.parse("x ** -1");
+    parser.optimize();
+    x = 0;
+    BOOST_CHECK_THROW(parser.evaluate(&x), matheval::powDivideByZero);
+
+    parser.parse("x ** 0.5");
+    parser.optimize();
+    x = -1;
+    BOOST_CHECK_THROW(parser.evaluate(&x), matheval::powInvalid);
+    x = -0.0;
+    BOOST_CHECK(!std::signbit(parser.evaluate(&x)));
+}
+
+// The argument of x**0 is only dropped if it cannot fail
+BOOST_AUTO_TEST_CASE(zero_power) {
+    matheval::Parser parser;
+    parser.parse("x ** 0 + y");
+    BOOST_CHECK_EQUAL(parser.optimize().simplified, 1);
+    // x keeps its slot although it is no longer used
+    BOOST_REQUIRE_EQUAL(parser.variables().size(), 2);
+    BOOST_CHECK_EQUAL(parser.variables()[0], "x");
+    BOOST_CHECK_EQUAL(parser.variables()[1], "y");
+    double const values[] = {2, 5};
+    BOOST_CHECK_EQUAL(parser.evaluate(values), 6);
+
+    BOOST_CHECK_EQUAL(simplified("log(x) ** 0"), 0);
+    same_as_plain("log(x) ** 0");
+}
+
+BOOST_AUTO_TEST_CASE(batch) {
+    matheval::Parser plain;
+    plain.parse("x**2 + x**-1 + x/8 + x**0.5");
+    matheval::Parser simplified;
+    simplified.parse("x**2 + x**-1 + x/8 + x**0.5");
+    simplified.optimize();
+    simplified.compile();
+    plain.compile();
+    double const *columns[] = {samples.data()};
+    std::vector<double> expected(samples.size());
+    std::vector<double> results(samples.size());
+    std::vector<matheval::errc> expected_errors(samples.size());
+    std::vector<matheval::errc> errors(samples.size());
+    plain.evaluate(samples.size(), columns, expected.data(),
+                   expected_errors.data());
+    simplified.evaluate(samples.size(), columns, results.data(),
+                        errors.data());
+    for (std::size_t r = 0; r < samples.size(); ++r) {
+        BOOST_CHECK(errors[r] == expected_errors[r]);
+        BOOST_CHECK(same_bits(results[r], expected[r]));
+    }
+}
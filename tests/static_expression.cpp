@@ -0,0 +1,131 @@
+#define BOOST_TEST_MODULE static_expression
+#include <boost/test/included/unit_test.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include "exprtest.hpp"
+#include "matheval.hpp"
+#include "static_expression.hpp"
+
+namespace sp = matheval::static_parser;
+
+namespace {
+
+bool same_bits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+std::vector<double> const samples = {
+    0.0, -0.0, 1.0, -2.5, 0.5, 3.0, 1e300,
+    std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN()};
+
+/// @brief Compare a static expression with the parsed one for all
+///        combinations of the samples
+template <typename Expression>
+void same_as_parser(Expression const &expr, std::string const &text) {
+    matheval::Parser parser;
+    parser.parse(text);
+    BOOST_REQUIRE(parser.variables() == expr.variables());
+    for (double x : samples) {
+        for (double y : samples) {
+            std::map<std::string, double> st;
+            for (std::string const &var : parser.variables()) {
+                st[var] = var == parser.variables().front() ? x : y;
+            }
+            std::type_info const *expected_error;
+            std::type_info const *error;
+            double const expected = evaluate_catching(
+                [&] { return parser.evaluate(st); }, expected_error);
+            double const result =
+                evaluate_catching([&] { return expr.evaluate(st); }, error);
+            if (expected_error) {
+                BOOST_CHECK_MESSAGE(error && *error == *expected_error,
+                                    text << " should throw "
+                                         << expected_error->name());
+                continue;
+            }
+            BOOST_CHECK_MESSAGE(!error && same_bits(result, expected),
+                                text << " for " << x << ", " << y << ": "
+                                     << result << " != " << expected);
+        }
+    }
+}
+
+} // namespace
+
+#define SAMETEST(casename, expr)                                       \
+BOOST_AUTO_TEST_CASE( casename )                                       \
+{                                                                      \
+    same_as_parser(MATHEVAL_STATIC_EXPRESSION(expr), expr);            \
+}
+
+SAMETEST(polynomial, "x*x + 2*x + 1")
+SAMETEST(precedence, "1 + x * 2 ** 3 ** y - 4 / x % 3")
+SAMETEST(relational, "x < y || x >= y && !(x == y) != (x <= 1)")
+SAMETEST(unary_ops, "-x + +y - !x - -(x)")
+SAMETEST(functions, "abs(x) + exp2(y) + atan2(x, y) + atan(x) + log10(abs(y) + 1)")
+SAMETEST(checked, "log(x) + sqrt(y) + 1 / x + acos(y)")
+SAMETEST(ternary, "ifelse(x > y, min(x, y), max(x, y) ** 2)")
+SAMETEST(lazy, "ifelse(x > 0, log(x), sqrt(y)) + (x != 0 && 1 / x > 1) + (y == 0 || 1 / y > 0)")
+SAMETEST(constants, "pi * x + e - phi * epsilon")
+SAMETEST(literals, "1.5e3 * x + .25 - 5. + 2E-2 + -3 + inf * 0 + -nan")
+SAMETEST(whitespace, " \t( x\n+y ) ")
+SAMETEST(names, "x_1 + X2 * x_1")
+
+BOOST_AUTO_TEST_CASE(call) {
+    auto const f = MATHEVAL_STATIC_EXPRESSION("x*x + 2*x + 1");
+    BOOST_CHECK_EQUAL(f.arity, 1);
+    BOOST_CHECK_EQUAL(f(3), 16);
+
+    auto const g = MATHEVAL_STATIC_EXPRESSION("y - x");
+    BOOST_CHECK_EQUAL(g.arity, 2);
+    BOOST_CHECK_EQUAL(g(1, 3), -2);
+    double const values[] = {1, 3};
+    BOOST_CHECK_EQUAL(g.evaluate(values), -2);
+    BOOST_CHECK_THROW(g.evaluate(std::map<std::string, double>{{"y", 1}}),
+                      matheval::invalid_argument);
+
+    BOOST_CHECK_EQUAL(MATHEVAL_STATIC_EXPRESSION("2 ** 10")(), 1024);
+}
+
+BOOST_AUTO_TEST_CASE(errors) {
+    BOOST_CHECK_THROW(MATHEVAL_STATIC_EXPRESSION("1 / x")(0),
+                      matheval::divideByZero);
+    BOOST_CHECK_THROW(MATHEVAL_STATIC_EXPRESSION("log(-1) + 1 / 0")(),
+                      matheval::logInvalid);
+}
+
+// Syntax errors fail the compilation through a static assertion in
+// StaticExpression, so they are checked on the parser directly
+
+static_assert(sp::parse<8>("1 +").status == sp::error::expected_operand, "");
+static_assert(sp::parse<8>("").status == sp::error::expected_operand, "");
+static_assert(sp::parse<8>("sin x").status == sp::error::expected_open, "");
+static_assert(sp::parse<8>("sinx").status == sp::error::expected_open, "");
+static_assert(sp::parse<8>("max(x)").status == sp::error::expected_comma, "");
+static_assert(sp::parse<8>("(x").status == sp::error::expected_close, "");
+static_assert(sp::parse<8>("x y").status == sp::error::unexpected, "");
+static_assert(sp::parse<8>("x y").position == 2, "");
+static_assert(sp::parse<8>("ex").status == sp::error::unexpected, "");
+static_assert(sp::parse<8>("1e400").status == sp::error::expected_operand,
+              "");
+
+static_assert(sp::parse<8>("0.1").nodes[0].value == 0.1, "");
+static_assert(sp::parse<8>("-2.5e2").nodes[0].value == -250, "");
+static_assert(sp::parse<8>("x + y").variable_count == 2, "");
+static_assert(sp::parse<8>("x * x").variable_count == 1, "");
+
+BOOST_AUTO_TEST_CASE(syntax_errors_match_parser) {
+    for (char const *text :
+         {"1 +", "", "sin x", "sinx", "max(x)", "(x", "x y", "ex", "1e400"}) {
+        matheval::Parser parser;
+        BOOST_CHECK_THROW(parser.parse(text), matheval::parse_error);
+    }
+}
@@ -0,0 +1,140 @@
+#define BOOST_TEST_MODULE subexpression
+#include <boost/test/included/unit_test.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "matheval.hpp"
+
+namespace {
+
+bool same_bits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+std::vector<double> const samples = {
+    0.0, -0.0, 1.0, -2.5, 0.5, 3.0,
+    std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN()};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(report) {
+    matheval::Parser parser;
+    parser.parse("sqrt(x**2+y**2) / (1 + sqrt(x**2+y**2))");
+    matheval::Parser::optimization stats = parser.optimize();
+    BOOST_CHECK_EQUAL(stats.folded, 0);
+    BOOST_CHECK_EQUAL(stats.simplified, 4);
+    // The second square root with everything below it
+    BOOST_CHECK_EQUAL(stats.eliminated, 6);
+
+    stats = parser.optimize();
+    BOOST_CHECK_EQUAL(stats.folded, 0);
+    BOOST_CHECK_EQUAL(stats.simplified, 0);
+    BOOST_CHECK_EQUAL(stats.eliminated, 0);
+
+    double const values[] = {3, 4};
+    BOOST_CHECK_CLOSE(parser.evaluate(values), 5. / 6., 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(folded_then_shared) {
+    matheval::Parser parser;
+    parser.parse("x * (1 + 2) + x * 3");
+    matheval::Parser::optimization const stats = parser.optimize();
+    BOOST_CHECK_EQUAL(stats.folded, 2);
+    BOOST_CHECK_EQUAL(stats.eliminated, 3);
+    double const x = 2;
+    BOOST_CHECK_EQUAL(parser.evaluate(&x), 12);
+}
+
+// Signed zeros are different constants
+BOOST_AUTO_TEST_CASE(signed_zero) {
+    matheval::Parser parser;
+    parser.parse("atan2(x * 0, -1) + atan2(x * -0, -1)");
+    // Only the second x and the second -1
+    BOOST_CHECK_EQUAL(parser.optimize().eliminated, 2);
+    double const x = 1;
+    BOOST_CHECK_EQUAL(parser.evaluate(&x), 0);
+}
+
+// Every way of evaluating gives the same bits before and after
+BOOST_AUTO_TEST_CASE(same_results) {
+    std::vector<std::string> const exprs = {
+        "sqrt(x**2+y**2) / (1 + sqrt(x**2+y**2))",
+        "(x*y - 1) * (x*y - 1) + ifelse(x*y - 1 > 0, x*y - 1, -(x*y - 1))",
+        "log(abs(x) + 1) * log(abs(x) + 1) - log(abs(y) + 1)",
+        "atan2(x, y) + atan2(y, x) + atan2(x, y) * 2",
+        "x + x + x + x",
+    };
+    for (std::string const &expr : exprs) {
+        for (int mode = 0; mode < 3; ++mode) {
+            // Each way of evaluating is compared with itself, because
+            // the sign of a NaN may differ between them
+            matheval::Parser plain;
+            plain.parse(expr);
+            matheval::Parser shared;
+            shared.parse(expr);
+            shared.optimize();
+            if (mode == 1) {
+                plain.compile();
+                shared.compile();
+            } else if (mode == 2) {
+                plain.compile_native();
+                shared.compile_native();
+            }
+            std::vector<double> xs, ys;
+            for (double x : samples) {
+                for (double y : samples) {
+                    xs.push_back(x);
+                    ys.push_back(y);
+                    double const values[] = {x, y};
+                    double const expected = plain.evaluate(values);
+                    double const result = shared.evaluate(values);
+                    BOOST_CHECK_MESSAGE(same_bits(result, expected),
+                                        expr << " for " << x << ", " << y
+                                             << ": " << result
+                                             << " != " << expected);
+                }
+            }
+
+            // The batch interpreter keeps the registers in blocks
+            double const *columns[] = {xs.data(), ys.data()};
+            std::vector<double> expected(xs.size());
+            std::vector<double> results(xs.size());
+            plain.evaluate(xs.size(), columns, expected.data());
+            shared.evaluate(xs.size(), columns, results.data());
+            for (std::size_t r = 0; r < xs.size(); ++r) {
+                BOOST_CHECK(same_bits(results[r], expected[r]));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(first_error) {
+    matheval::Parser parser;
+    parser.parse("log(x) + 1 / y + log(x) + 1 / y");
+    parser.optimize();
+    double const values[] = {-1, 0};
+    BOOST_CHECK_THROW(parser.evaluate(values), matheval::logInvalid);
+    matheval::errc error;
+    BOOST_CHECK(std::isnan(parser.evaluate(values, error)));
+    BOOST_CHECK(error == matheval::errc::logInvalid);
+}
+
+BOOST_AUTO_TEST_CASE(many_repeats) {
+    std::string expr = "sin(x) * y";
+    for (int i = 0; i < 1000; ++i) {
+        expr += " + sin(x) * y";
+    }
+    matheval::Parser parser;
+    parser.parse(expr);
+    // Each repeat leaves only its sum behind
+    BOOST_CHECK_EQUAL(parser.optimize().eliminated, 1000 * 4);
+    parser.compile();
+    double const values[] = {0.5, 2};
+    BOOST_CHECK_CLOSE(parser.evaluate(values), 1001 * std::sin(0.5) * 2,
+                      1e-9);
+}
@@ -21,3 +21,44 @@ SYMEXPRTEST(var6, "x**y", symtab(), std::pow(x,y));
 
 // Constants have higher priority than variables of the same name
 SYMEXPRTEST(var7, "e", symtab(), boost::math::constants::e<double>())
+
+BOOST_AUTO_TEST_CASE(slots) {
+    matheval::Parser parser;
+    parser.parse("y*x + x - e");
+    BOOST_REQUIRE_EQUAL(parser.variables().size(), 2u);
+    BOOST_CHECK_EQUAL(parser.variables()[0], "y");
+    BOOST_CHECK_EQUAL(parser.variables()[1], "x");
+
+    double const values[] = {y, x};
+    BOOST_CHECK_CLOSE(parser.evaluate(values), y*x + x - boost::math::constants::e<double>(),
+                      std::numeric_limits<double>::epsilon());
+    BOOST_CHECK_CLOSE(parser.evaluate(std::vector<double>{y, x}), y*x + x - boost::math::constants::e<double>(),
+                      std::numeric_limits<double>::epsilon());
+    BOOST_CHECK_THROW(parser.evaluate(std::vector<double>{y}), matheval::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(slots_stable) {
+    matheval::Parser parser;
+    parser.parse("b + (1 + 2) * a");
+    parser.optimize();
+    parser.compile();
+    BOOST_REQUIRE_EQUAL(parser.variables().size(), 2u);
+    BOOST_CHECK_EQUAL(parser.variables()[0], "b");
+    BOOST_CHECK_EQUAL(parser.variables()[1], "a");
+    BOOST_CHECK_EQUAL(parser.evaluate(std::vector<double>{1, 2}), 7);
+
+    // Also if the only use of a variable is optimized away
+    parser.parse("ifelse(1, z, x) + (3 || y) * w");
+    parser.optimize();
+    parser.compile();
+    BOOST_REQUIRE_EQUAL(parser.variables().size(), 4u);
+    BOOST_CHECK_EQUAL(parser.variables()[0], "z");
+    BOOST_CHECK_EQUAL(parser.variables()[1], "x");
+    BOOST_CHECK_EQUAL(parser.variables()[2], "y");
+    BOOST_CHECK_EQUAL(parser.variables()[3], "w");
+    BOOST_CHECK_EQUAL(parser.evaluate(std::vector<double>{1, 2, 3, 4}), 5);
+
+    parser.parse("c");
+    BOOST_REQUIRE_EQUAL(parser.variables().size(), 1u);
+    BOOST_CHECK_EQUAL(parser.evaluate(std::vector<double>{5}), 5);
+}